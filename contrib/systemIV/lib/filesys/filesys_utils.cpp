@@ -3,6 +3,8 @@
 #ifdef WIN32
 #include <io.h>
 #include <direct.h>
+#include <sys/types.h>
+#include <sys/stat.h>
 #else
 #include <unistd.h>
 #include <sys/types.h>
@@ -207,6 +209,24 @@ bool DoesFileExist(const char *_fullPath)
 }
 
 
+bool GetFileStamp(const char *_fullPath, unsigned int &_size, unsigned int &_time)
+{
+#ifndef WIN32
+    struct stat s;
+    if (stat(FindCaseInsensitive(_fullPath), &s) != 0)
+        return false;
+#else
+    struct _stat s;
+    if (_stat(_fullPath, &s) != 0)
+        return false;
+#endif
+
+    _size = (unsigned int) s.st_size;
+    _time = (unsigned int) s.st_mtime;
+    return true;
+}
+
+
 #define FILE_PATH_BUFFER_SIZE 256
 static char s_filePathBuffer[FILE_PATH_BUFFER_SIZE + 1];
 
@@ -10,6 +10,7 @@ LList<char *>   *ListSubDirectoryNames     (const char *_dir);
 
 bool			IsDirectory				   (const char *_fullPath);
 bool            DoesFileExist              (const char *_fullPath);
+bool            GetFileStamp               (const char *_fullPath, unsigned int &_size, unsigned int &_time);  // Size and modification time
 bool            AreFilesIdentical          (const char *_name1, const char *_name2);
 
 char            *ConcatPaths               (const char *_firstComponent, ...);
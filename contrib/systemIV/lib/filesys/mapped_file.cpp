@@ -0,0 +1,95 @@
+#include "lib/universal_include.h"
+
+#include <stdio.h>
+
+#if defined(TARGET_OS_LINUX) || defined(TARGET_OS_MACOSX)
+#include <sys/types.h>
+#include <sys/stat.h>
+#include <sys/mman.h>
+#include <fcntl.h>
+#endif
+
+#include "mapped_file.h"
+#include "filesys_utils.h"
+
+
+#if defined(TARGET_OS_LINUX) || defined(TARGET_OS_MACOSX)
+
+MappedFile::MappedFile( char const *_filename )
+:   m_handle(NULL),
+    m_data(NULL),
+    m_size(0)
+{
+    int fd = open( FindCaseInsensitive(_filename), O_RDONLY );
+    if( fd == -1 ) return;
+
+    struct stat info;
+    if( fstat( fd, &info ) == 0 && info.st_size > 0 )
+    {
+        void *data = mmap( NULL, info.st_size, PROT_READ, MAP_SHARED, fd, 0 );
+        if( data != MAP_FAILED )
+        {
+            m_handle = data;
+            m_data = (unsigned char const *) data;
+            m_size = (unsigned int) info.st_size;
+        }
+    }
+
+    // The mapping stays valid after the descriptor is closed
+    close( fd );
+}
+
+
+MappedFile::~MappedFile()
+{
+    if( m_handle )
+    {
+        munmap( m_handle, m_size );
+    }
+}
+
+#else
+
+MappedFile::MappedFile( char const *_filename )
+:   m_handle(NULL),
+    m_data(NULL),
+    m_size(0)
+{
+    FILE *file = fopen( FindCaseInsensitive(_filename), "rb" );
+    if( !file ) return;
+
+    fseek( file, 0, SEEK_END );
+    long size = ftell( file );
+    fseek( file, 0, SEEK_SET );
+
+    if( size > 0 )
+    {
+        unsigned char *data = new unsigned char[size];
+        if( fread( data, 1, size, file ) == (size_t) size )
+        {
+            m_handle = data;
+            m_data = data;
+            m_size = (unsigned int) size;
+        }
+        else
+        {
+            delete [] data;
+        }
+    }
+
+    fclose( file );
+}
+
+
+MappedFile::~MappedFile()
+{
+    delete [] (unsigned char *) m_handle;
+}
+
+#endif
+
+
+bool MappedFile::IsOpen()
+{
+    return( m_data != NULL );
+}
@@ -0,0 +1,29 @@
+#ifndef _included_mappedfile_h
+#define _included_mappedfile_h
+
+/*
+ *	Read only view of a file on disk.
+ *  Uses mmap where the platform has it, otherwise
+ *  falls back to reading the whole file into memory.
+ *
+ */
+
+
+class MappedFile
+{
+protected:
+    void            *m_handle;
+
+public:
+    unsigned char const *m_data;
+    unsigned int        m_size;
+
+public:
+    MappedFile  ( char const *_filename );
+    ~MappedFile ();
+
+    bool IsOpen ();
+};
+
+
+#endif
@@ -4,6 +4,8 @@
 //
 #ifdef FIXED64_NUMERICS
 
+#include <assert.h>
+
 #include "fixed_64.h"
 
 using std::ostream;
@@ -13,11 +15,6 @@ static const SFix64 MAX_SFIX64 = ~(1ULL << 63);
 static const SInt32 MAX_SINT32 = 0x7FFFFFFF;
 static const SFix64 ONE_HUNDREDTH = 0x28F5C28;
 
-static SInt64 SInt64_Add(SInt64 x, SInt64 y);
-static SInt64 SInt64_Subtract(SInt64 x, SInt64 y);
-static SFix64 SFix64_Multiply(SFix64 x, SFix64 y);
-static SFix64 SFix64_Divide(SFix64 x, SFix64 y);
-
 const Fixed Fixed::MAX = Fixed(MAX_SFIX64);
 const Fixed Fixed::PI = Fixed(0x3243F6A88LL);
 
@@ -38,112 +35,6 @@ Fixed Fixed::Hundredths(int _hundredths)
 	return Fixed(SFix64_Multiply((SFix64)_hundredths << 32, ONE_HUNDREDTH));
 }
 
-Fixed operator + (const Fixed& _lhs, const Fixed& _rhs)
-{
-	Fixed temp(_lhs);
-	
-	temp += _rhs;
-	return temp;
-}
-
-Fixed operator - (const Fixed& _lhs, const Fixed& _rhs)
-{
-	Fixed temp(_lhs);
-	
-	temp -= _rhs;
-	return temp;
-}
-
-Fixed operator * (const Fixed& _lhs, const Fixed& _rhs)
-{
-	Fixed temp(_lhs);
-	
-	temp *= _rhs;
-	return temp;
-}
-
-Fixed operator / (const Fixed& _lhs, const Fixed& _rhs)
-{
-	Fixed temp(_lhs);
-	
-	temp /= _rhs;
-	return temp;
-}
-
-Fixed::Fixed()
-{
-	m_value = 0;
-}
-
-Fixed::Fixed(const Fixed& _f)
-{
-	m_value = _f.m_value;
-}
-
-Fixed::Fixed(SInt32 _n)
-{
-	m_value = (UInt64)_n << 32;
-}
-
-Fixed::Fixed(SInt64 _rawValue)
-{
-	m_value = _rawValue;
-}
-
-Fixed& Fixed::operator += (const Fixed& _rhs)
-{
-	m_value += _rhs.m_value;
-	return *this;
-}
-
-Fixed& Fixed::operator -= (const Fixed& _rhs)
-{
-	m_value -= _rhs.m_value;
-	return *this;
-}
-
-Fixed& Fixed::operator *= (const Fixed& _rhs)
-{
-	m_value = SFix64_Multiply(m_value, _rhs.m_value);
-	return *this;
-}
-
-Fixed& Fixed::operator /= (const Fixed& _rhs)
-{
-	m_value = SFix64_Divide(m_value, _rhs.m_value);
-	return *this;
-}
-
-bool Fixed::operator < (const Fixed& _rhs) const
-{
-	return m_value < _rhs.m_value;
-}
-
-bool Fixed::operator <= (const Fixed& _rhs) const
-{
-	return m_value <= _rhs.m_value;
-}
-
-bool Fixed::operator == (const Fixed& _rhs) const
-{
-	return m_value == _rhs.m_value;
-}
-
-bool Fixed::operator != (const Fixed& _rhs) const
-{
-	return m_value != _rhs.m_value;
-}
-
-bool Fixed::operator >= (const Fixed& _rhs) const
-{
-	return m_value >= _rhs.m_value;
-}
-
-bool Fixed::operator > (const Fixed& _rhs) const
-{
-	return m_value > _rhs.m_value;
-}
-
 double Fixed::DoubleValue() const
 {
 	SInt64 fixedValue = m_value;
@@ -158,22 +49,10 @@ double Fixed::DoubleValue() const
 	return isNegative ? -floatValue : floatValue;
 }
 
-SInt32 Fixed::IntValue() const
-{
-	return m_value >> 32;
-}
+// Portable multiply and divide.  Fixed uses the inline versions in
+// fixed_64.h, which fall back to these where there is no 128 bit integer
 
-Fixed min(const Fixed &a, const Fixed &b)
-{
-	return a < b ? a : b;
-}
-
-Fixed max(const Fixed &a, const Fixed &b)
-{
-	return a > b ? a : b;
-}
-
-static SFix64 SFix64_Multiply(SFix64 x, SFix64 y)
+SFix64 SFix64_Multiply(SFix64 x, SFix64 y)
 {
 	SFix64		z;
 
@@ -322,7 +201,7 @@ DONE:
 	if (mod) mod->hi = mod_hi, mod->lo = mod_lo;
 }
 
-static SFix64 SFix64_Divide(SFix64 x, SFix64 y)
+SFix64 SFix64_Divide(SFix64 x, SFix64 y)
 {
 	SFix64		z;
 
@@ -354,107 +233,188 @@ static SFix64 SFix64_Divide(SFix64 x, SFix64 y)
 
 namespace fixed64
 {
-	/* We use Taylor expansion to define sin(x) between 0 and pi/4 (7 iterations) */
-
-	const Fixed zero( 0 ),
-				one( 1 ),
-				minusOne( -1 ),
-				threeFactorial( 6 ),
-				fiveFactorial( 120 ),
-				sevenFactorial( 5040 ),
-				nineFactorial( 362880 ),
-				elevenFactorial( 39916800 ),
-				oneThousandAndTwentyFour( 1024 ),
-				// These need to be converted to certain representations
-				half( Fixed::Hundredths(50) ),
-				piOverTwo( Fixed::FromDouble(1.5707964f) ),
-				minusPiOverTwo( Fixed::FromDouble(-1.5707964f) ),
-				twoThousandAndFortyEightOverPi( Fixed::FromDouble(651.8986f) );
-
-
-	SInt64 sinInternals[1025] = {
-		#include "fixed64_sin_table.inc"		
+	// Everything below is integer arithmetic on the raw 32.32 values,
+	// so every machine gets the same bits.  Any change to the results
+	// must bump FIXED_NUMERICS_REVISION in fixed_64.h.
+
+	static const SFix64 ONE = 0x100000000LL;
+	static const SFix64 HALF = 0x80000000LL;
+	static const SFix64 PI_OVER_TWO = 0x1921FB544LL;			// Fixed::PI / 2 exactly
+	static const SFix64 TWO_THOUSAND_AND_FORTY_EIGHT_OVER_PI = 0x28BE60DB939LL;
+
+	// sin over 0 .. pi/2 in 1024 steps, and asin over 0 .. 1 in 1024 steps,
+	// generated by fixed_generate_sin.cpp and fixed_generate_asin.cpp
+
+	static const SInt64 sinTable[1025] = {
+		#include "fixed64_sin_table.inc"
 	};
-	
-	SInt64 asinInternals[1025] = {
-		#include "fixed64_asin_table.inc"				
+
+	static const SInt64 asinTable[1025] = {
+		#include "fixed64_asin_table.inc"
 	};
-	
-	Fixed *sinTable = (Fixed *) sinInternals;
-	Fixed *asinTable = (Fixed *) asinInternals;
+
+
+	// Linear interpolation from _table[_index] towards _table[_index+1].
+	// Both tables are increasing, so the step is never negative
+
+	static inline SFix64 Interpolate( const SInt64 *_table, int _index, UInt64 _fraction )
+	{
+		UInt64 step = (UInt64)( _table[_index+1] - _table[_index] );
+		return _table[_index] + (SFix64)( ( step * _fraction ) >> 32 );
+	}
+
+
+	// sin of a non-negative phase, where 1.0 is pi/2048
+
+	static SFix64 SinPhase( UInt64 _phase )
+	{
+		int index = (int)( ( _phase >> 32 ) & 4095 );
+		UInt64 fraction = _phase & 0xFFFFFFFFULL;
+		int quadrant = index >> 10;
+		int offset = index & 1023;
+
+		SFix64 result;
+		if( quadrant == 0 || quadrant == 2 )
+		{
+			result = Interpolate( sinTable, offset, fraction );
+		}
+		else if( fraction == 0 )
+		{
+			result = sinTable[1024 - offset];
+		}
+		else
+		{
+			// Falling quarter : interpolate upwards from the far end
+			result = Interpolate( sinTable, 1023 - offset, 0x100000000ULL - fraction );
+		}
+
+		return quadrant >= 2 ? -result : result;
+	}
+
+
+	static UInt64 Phase( SFix64 _x )
+	{
+		return (UInt64) SFix64_MultiplyInline( _x, TWO_THOUSAND_AND_FORTY_EIGHT_OVER_PI );
+	}
+
+
+	// Bit by bit integer square root of the raw value shifted up 32 bits,
+	// which is the 32.32 square root.  Two bits of the 96 bit input are
+	// brought down each step; the remainder never exceeds 2 * root,
+	// so it fits in 64 bits without a 128 bit type.
+	// See http://en.wikipedia.org/wiki/Methods_of_computing_square_roots#Binary_numeral_system_.28base_2.29
+
+	static UInt64 SqrtRaw( UInt64 _x )
+	{
+		UInt64 root = 0;
+		UInt64 remainder = 0;
+
+		for( int i = 0; i < 48; ++i )
+		{
+			UInt64 bits = ( i < 32 ) ? ( _x >> ( 62 - 2 * i ) ) & 3 : 0;
+			remainder = ( remainder << 2 ) | bits;
+			UInt64 trial = ( root << 2 ) | 1;
+			root <<= 1;
+			if( remainder >= trial )
+			{
+				remainder -= trial;
+				root |= 1;
+			}
+		}
+
+		// Round to nearest : (root + 1/2)^2 = root^2 + root + 1/4
+		if( remainder > root ) ++root;
+
+		return root;
+	}
+
+
+	// asin for 0 <= _x <= 1/2, where the table is close to linear
+
+	static SFix64 AsinSmall( SFix64 _x )
+	{
+		int index = (int)( _x >> 22 );
+		UInt64 fraction = ( (UInt64) _x << 10 ) & 0xFFFFFFFFULL;
+		return Interpolate( asinTable, index, fraction );
+	}
+
+
+	// 2 asin( sqrt( _x / 2 ) ), for 0 <= _x <= 1.
+	// Near 1 asin is too steep to interpolate, so asin and acos use
+	// asin(x) = pi/2 - 2 asin( sqrt( (1-x)/2 ) ) above 1/2 instead
+
+	static SFix64 AsinHalfAngle( SFix64 _x )
+	{
+		return AsinSmall( (SFix64) SqrtRaw( (UInt64) _x >> 1 ) ) << 1;
+	}
 }
 	
+
 Fixed sin( const Fixed &_x )
 {
-	if (_x < fixed64::zero) 
-		return -sin( -_x );
-		
-	// We store a table of 1024 entries which describes the first quarter
-	// of the sin curve. 
-	
-	// So: 0 .. PI/2 == 0 .. 1024
-	//     0 .. 2 PI == 0 .. 4096
-	
-	// This gives us a resolution of 4096 points, we could make it more
-	// precise by interpolating.		
-	int index = (_x * fixed64::twoThousandAndFortyEightOverPi).IntValue() % 4096;
-	
-	// std::cout << " (index = " << index << ")";
-		
-	if (index < 1024)		
-		return fixed64::sinTable[index];
-	else if (1024 <= index < 2048)
-		return fixed64::sinTable[1024 - (index - 1024)];
-	else if (2048 <= index < 3072)
-		return -fixed64::sinTable[index - 2048];
-	else if (3072 <= index)
-		return -fixed64::sinTable[1024 - (index - 3072)];
+	SFix64 x = _x.InternalValue();
+	if( x < 0 )
+	{
+		return Fixed( -fixed64::SinPhase( fixed64::Phase( -x ) ) );
+	}
+
+	return Fixed( fixed64::SinPhase( fixed64::Phase( x ) ) );
 }
 
 Fixed cos( const Fixed &_x )
 {
-	return sin(fixed64::piOverTwo - _x);
+	// A quarter turn is exactly 1024 in phase, so no rounding from adding pi/2
+	SFix64 x = _x.InternalValue();
+	if( x < 0 ) x = -x;
+
+	return Fixed( fixed64::SinPhase( fixed64::Phase( x ) + ( 1024ULL << 32 ) ) );
 }
 
 Fixed asin( const Fixed& _x )
 {
-	// Return results between -pi/2 and +pi/2 
-	if (_x < fixed64::zero)
-		return - asin( - _x );
-		
-	if (_x >= fixed64::one)
-		return fixed64::piOverTwo;
-		
-	int index = (_x * fixed64::oneThousandAndTwentyFour).IntValue();
-	
-	return fixed64::asinTable[index];
+	// Results between -pi/2 and +pi/2
+	SFix64 x = _x.InternalValue();
+	bool negative = ( x < 0 );
+	if( negative ) x = -x;
+
+	SFix64 result;
+	if( x >= fixed64::ONE )			result = fixed64::PI_OVER_TWO;
+	else if( x <= fixed64::HALF )	result = fixed64::AsinSmall( x );
+	else							result = fixed64::PI_OVER_TWO - fixed64::AsinHalfAngle( fixed64::ONE - x );
+
+	return Fixed( negative ? -result : result );
 }
 
-Fixed acos(const Fixed& _x)
+Fixed acos( const Fixed& _x )
 {
-	// Return results bween pi and 0  pi/2 - (-pi/2) = pi... 
-	// pi/2 - (pi/2) = 0
-	return fixed64::piOverTwo - asin(_x);
+	// Results between 0 and pi.  Worked out directly rather than 
+	// as pi/2 - asin, which would lose the small angles near 1
+	SFix64 x = _x.InternalValue();
+
+	SFix64 result;
+	if( x >= fixed64::ONE )				result = 0;
+	else if( x <= -fixed64::ONE )		result = Fixed::PI.InternalValue();
+	else if( x > fixed64::HALF )		result = fixed64::AsinHalfAngle( fixed64::ONE - x );
+	else if( x < -fixed64::HALF )		result = Fixed::PI.InternalValue() - fixed64::AsinHalfAngle( fixed64::ONE + x );
+	else if( x >= 0 )					result = fixed64::PI_OVER_TWO - fixed64::AsinSmall( x );
+	else								result = fixed64::PI_OVER_TWO + fixed64::AsinSmall( -x );
+
+	return Fixed( result );
 }
 
 
 Fixed sqrt( const Fixed &_x )
 {
-	// See: http://en.wikipedia.org/wiki/Methods_of_computing_square_roots#Babylonian_method
+	SFix64 x = _x.InternalValue();
+	assert( x >= 0 );
+	if( x <= 0 ) return Fixed( (SFix64) 0 );
 
-	// We need to use an iterative (fixed point) algorithm to 
-	// approximate sqrt. We use babylonian algorithm:
-	Fixed prev = _x;
-	int iterations = 0;
-	
-	assert(_x >= fixed64::zero);
-	
-	do {
-		Fixed next = fixed64::half * ( prev + _x / prev );
-		if (next == prev || ++iterations == 20)
-			return next;
-		prev = next;
-	} while (true);
+	return Fixed( (SFix64) fixed64::SqrtRaw( (UInt64) x ) );
+}
+
+std::ostream& operator << (std::ostream& _os, const Fixed& _f)
+{
+	return _os << "0x" << std::hex << _f.InternalValue() << std::dec << "(" << _f.DoubleValue() << ")";
 }
 
 #endif // FIXED64_NUMERICS
@@ -12,10 +12,10 @@ typedef signed long long SInt64;
 typedef int SInt32;
 typedef unsigned int UInt32;
 
-#if defined(__BIG_ENDIAN__)
+#if defined(__BIG_ENDIAN__) || (defined(__BYTE_ORDER__) && __BYTE_ORDER__ == __ORDER_BIG_ENDIAN__)
 	typedef struct { SInt64 hi; UInt64 lo; } SInt128;
 	typedef struct { UInt64 hi; UInt64 lo; } UInt128;
-#elif defined(__LITTLE_ENDIAN__)
+#elif defined(__LITTLE_ENDIAN__) || (defined(__BYTE_ORDER__) && __BYTE_ORDER__ == __ORDER_LITTLE_ENDIAN__)
 	typedef struct { UInt64 lo; SInt64 hi; } SInt128;
 	typedef struct { UInt64 lo; UInt64 hi; } UInt128;
 #else
@@ -23,6 +23,63 @@ typedef unsigned int UInt32;
 #endif
 typedef SInt64 SFix64;
 
+// Compilers with a native 128 bit integer (gcc and clang on 64 bit targets)
+// multiply and divide inline.  Everything else calls the portable versions.
+#if defined(__SIZEOF_INT128__)
+	#define FIXED64_NATIVE_INT128
+#endif
+
+// Identifies the results of this implementation, so that machines which
+// would go out of sync refuse to play together.  Bump it whenever any
+// arithmetic or maths function here gives a different answer.
+//   1  Babylonian sqrt, uninterpolated sin and asin tables
+//   2  Integer sqrt, interpolated sin, cos, asin and acos
+#define FIXED_NUMERICS_REVISION	"fixed64-2"
+
+#define FIXED64_MAX_SFIX64		((SFix64)0x7FFFFFFFFFFFFFFFLL)
+
+// Portable multiply and divide, in fixed_64.cpp.  The inline versions
+// below give bit identical results - see fixed_test.cpp
+SFix64 SFix64_Multiply(SFix64 x, SFix64 y);
+SFix64 SFix64_Divide(SFix64 x, SFix64 y);
+
+inline SFix64 SFix64_MultiplyInline(SFix64 x, SFix64 y)
+{
+#ifdef FIXED64_NATIVE_INT128
+	UInt64 ux = x < 0 ? 0 - (UInt64)x : (UInt64)x;
+	UInt64 uy = y < 0 ? 0 - (UInt64)y : (UInt64)y;
+
+	// Below 2^47 the product fits with room to spare, so the portable
+	// version's overflow checks can't fire and it returns exactly this
+	if ((ux | uy) < (1ULL << 47))
+	{
+		SFix64 z = (SFix64)(UInt64)(((unsigned __int128)ux * uy) >> 32);
+		return ((x < 0) != (y < 0)) ? 0 - z : z;
+	}
+#endif
+	return SFix64_Multiply(x, y);
+}
+
+inline SFix64 SFix64_DivideInline(SFix64 x, SFix64 y)
+{
+#ifdef FIXED64_NATIVE_INT128
+	if (!x || !y) return 0;
+
+	UInt64 ux = x < 0 ? 0 - (UInt64)x : (UInt64)x;
+	UInt64 uy = y < 0 ? 0 - (UInt64)y : (UInt64)y;
+
+	unsigned __int128 q = ((unsigned __int128)ux << 32) / uy;
+
+	// Clamped to MAX like the portable version.  Its signed compare would
+	// let a quotient of exactly 2^64-1 through, but that needs |x| > 2^63
+	SFix64 z = (q < (unsigned __int128)FIXED64_MAX_SFIX64) ? (SFix64)(UInt64)q : FIXED64_MAX_SFIX64;
+
+	return ((x < 0) != (y < 0)) ? 0 - z : z;
+#else
+	return SFix64_Divide(x, y);
+#endif
+}
+
 class Fixed
 {
 	friend std::ostream& operator << (std::ostream& _os, const Fixed& _f);
@@ -30,24 +87,64 @@ class Fixed
 	// for serialization
 	friend class Directory;
 	friend class DirectoryData;
+
+	// integer kernels in fixed_64.cpp
+	friend Fixed sqrt(const Fixed& _x);
+	friend Fixed sin(const Fixed& _x);
+	friend Fixed cos(const Fixed& _x);
+	friend Fixed asin(const Fixed& _x);
+	friend Fixed acos(const Fixed& _x);
 								
 	private:
-		Fixed(SFix64 _rawValue);
+		Fixed(SFix64 _rawValue)
+		{
+			m_value = _rawValue;
+		}
 		
 	public:
 		static const Fixed MAX;
 		static const Fixed PI;
 		
-		Fixed(); // init to zero
-		Fixed(SInt32 _n); // construct from integer
-		Fixed(const Fixed& _f); // copy constructor
+		Fixed() // init to zero
+		{
+			m_value = 0;
+		}
+		Fixed(SInt32 _n) // construct from integer
+		{
+			m_value = (UInt64)_n << 32;
+		}
+		Fixed(const Fixed& _f) // copy constructor
+		{
+			m_value = _f.m_value;
+		}
 		static Fixed FromDouble(double _f); // construct from float (NON-PORTABLE)
 		static Fixed Hundredths(int _hundredths); // construct decimal numbers
 		
-		Fixed& operator += (const Fixed& _rhs);
-		Fixed& operator -= (const Fixed& _rhs);
-		Fixed& operator *= (const Fixed& _rhs);
-		Fixed& operator /= (const Fixed& _rhs);
+		UInt64 InternalValue() const
+		{
+			return (UInt64)m_value;
+		}
+		
+		Fixed& operator += (const Fixed& _rhs)
+		{
+			m_value += _rhs.m_value;
+			return *this;
+		}
+		Fixed& operator -= (const Fixed& _rhs)
+		{
+			m_value -= _rhs.m_value;
+			return *this;
+		}
+		Fixed& operator *= (const Fixed& _rhs)
+		{
+			m_value = SFix64_MultiplyInline(m_value, _rhs.m_value);
+			return *this;
+		}
+		Fixed& operator /= (const Fixed& _rhs)
+		{
+			m_value = SFix64_DivideInline(m_value, _rhs.m_value);
+			return *this;
+		}
 		
 		// unary minus
 		Fixed operator -() const
@@ -57,16 +154,19 @@ class Fixed
 			return opposite;
 		}
 		
-		bool operator < (const Fixed& _rhs) const;
-		bool operator <= (const Fixed& _rhs) const;
-		bool operator == (const Fixed& _rhs) const;
-		bool Fixed::operator != (const Fixed& _rhs) const;
-		bool operator >= (const Fixed& _rhs) const;
-		bool operator > (const Fixed& _rhs) const;
+		bool operator < (const Fixed& _rhs) const		{ return m_value < _rhs.m_value; }
+		bool operator <= (const Fixed& _rhs) const		{ return m_value <= _rhs.m_value; }
+		bool operator == (const Fixed& _rhs) const		{ return m_value == _rhs.m_value; }
+		bool operator != (const Fixed& _rhs) const		{ return m_value != _rhs.m_value; }
+		bool operator >= (const Fixed& _rhs) const		{ return m_value >= _rhs.m_value; }
+		bool operator > (const Fixed& _rhs) const		{ return m_value > _rhs.m_value; }
 		
 		// for explicit conversions
 		double DoubleValue() const;
-		SInt32 IntValue() const;
+		SInt32 IntValue() const
+		{
+			return m_value >> 32;
+		}
 				
 		// Temporary, while we replace bare floats in source
 		//operator float() { return FloatValue(); }
@@ -86,16 +186,49 @@ class Fixed
 		SFix64 m_value;
 };
 
-Fixed operator + (const Fixed& _lhs, const Fixed& _rhs);
-Fixed operator - (const Fixed& _lhs, const Fixed& _rhs);
-Fixed operator * (const Fixed& _lhs, const Fixed& _rhs);
-Fixed operator / (const Fixed& _lhs, const Fixed& _rhs);
+inline Fixed operator + (const Fixed& _lhs, const Fixed& _rhs)
+{
+	Fixed temp(_lhs);
+	temp += _rhs;
+	return temp;
+}
+
+inline Fixed operator - (const Fixed& _lhs, const Fixed& _rhs)
+{
+	Fixed temp(_lhs);
+	temp -= _rhs;
+	return temp;
+}
+
+inline Fixed operator * (const Fixed& _lhs, const Fixed& _rhs)
+{
+	Fixed temp(_lhs);
+	temp *= _rhs;
+	return temp;
+}
+
+inline Fixed operator / (const Fixed& _lhs, const Fixed& _rhs)
+{
+	Fixed temp(_lhs);
+	temp /= _rhs;
+	return temp;
+}
+
+inline Fixed min(const Fixed &a, const Fixed &b)
+{
+	return a < b ? a : b;
+}
+
+inline Fixed max(const Fixed &a, const Fixed &b)
+{
+	return a > b ? a : b;
+}
 
-Fixed min(const Fixed &a, const Fixed &b);
-Fixed max(const Fixed &a, const Fixed &b);
 Fixed sqrt(const Fixed& _x);
 Fixed sin(const Fixed& _x);
 Fixed cos(const Fixed& _x);
+Fixed asin(const Fixed& _x);
+Fixed acos(const Fixed& _x);
 
 // For debugging
 std::ostream& operator << (std::ostream& _os, const Fixed& _f);
@@ -27,6 +27,9 @@ typedef SInt64 SFix64;
 
 #define SMALLEST_DOUBLE 1.0e-8
 
+// See fixed_64.h.  Bump it whenever any maths function here gives a different answer
+#define FIXED_NUMERICS_REVISION	"float-1"
+
 inline double CLAMP(double _f)
 {
 	union
@@ -1,7 +1,12 @@
-#include "fixed.h"
+// Writes fixed64_asin_table.inc : asin over 0 .. 1 in steps of 1/1024,
+// in 32.32 fixed point rounded to nearest.  Build with
+//
+//   g++ fixed_generate_asin.cpp -o fixed_generate_asin && ./fixed_generate_asin > fixed64_asin_table.inc
+//
+// Regenerating the table changes results, so bump FIXED_NUMERICS_REVISION in fixed_64.h.
 
 #include <cmath>
-#include <iostream>
+#include <cstdio>
 
 const double piOverTwoThousandAndFortyEight = M_PI / 2048.0;
 
@@ -9,10 +14,11 @@ int main()
 {
 	for (int i = 0; i <= 1024; i++) {
 		double result = asin( i / 1024.0 );
-		
-		std::cout << "0x" << std::hex << Fixed::FromFloat(result).InternalValue() << "ULL";
+		long long value = (long long) floor( result * 4294967296.0 + 0.5 );
+
+		printf( "0x%llxLL", value );
 		if (i < 1024)
-			std::cout << ",\n";
+			printf( ",\n" );
 	}
-	std::cout << "\n";
-}
\ No newline at end of file
+	printf( "\n" );
+}
@@ -1,19 +1,24 @@
-#include "fixed.h"
+// Writes fixed64_sin_table.inc : sin over 0 .. pi/2 in steps of pi/2048,
+// in 32.32 fixed point rounded to nearest.  Build with
+//
+//   g++ fixed_generate_sin.cpp -o fixed_generate_sin && ./fixed_generate_sin > fixed64_sin_table.inc
+//
+// Regenerating the table changes results, so bump FIXED_NUMERICS_REVISION in fixed_64.h.
 
 #include <cmath>
-#include <iostream>
+#include <cstdio>
 
 const double piOverTwoThousandAndFortyEight = M_PI / 2048.0;
 
 int main()
 {
 	for (int i = 0; i <= 1024; i++) {
-		double x = i * piOverTwoThousandAndFortyEight; 
-		double result = sin( x );
-		
-		std::cout << "0x" << std::hex << Fixed::FromFloat(result).InternalValue() << "ULL";
+		double result = sin( i * piOverTwoThousandAndFortyEight );
+		long long value = (long long) floor( result * 4294967296.0 + 0.5 );
+
+		printf( "0x%llxLL", value );
 		if (i < 1024)
-			std::cout << ",\n";
+			printf( ",\n" );
 	}
-	std::cout << "\n";
-}
\ No newline at end of file
+	printf( "\n" );
+}
@@ -1,20 +1,321 @@
+
+// Build from the root directory, eg
+//
+//   g++ -O2 -DFIXED64_NUMERICS -DTARGET_OS_LINUX -Isource -Icontrib/systemIV contrib/systemIV/lib/math/fixed_test.cpp contrib/systemIV/lib/math/fixed_64.cpp
+//
+// Returns non-zero if the inline Fixed arithmetic ever differs from the portable version,
+// or a maths function differs from its golden value.  "a.out golden" prints a new
+// golden table, for when FIXED_NUMERICS_REVISION is bumped.
+
 #include "fixed.h"
 #include <iostream>
 #include <cmath>
+#include <cstdio>
+#include <cstring>
 
 namespace fixed64 {
 	Fixed TaylorExpansionSinFirstQuarter( const Fixed &x );
 }
 
-int main()
+
+#ifdef FIXED64_NUMERICS
+
+//
+// Equivalence of the inline multiply and divide in fixed_64.h with the
+// portable SFix64_Multiply and SFix64_Divide.  Any difference would put
+// machines built with and without a native 128 bit integer out of sync.
+
+static UInt64 s_testRandom = 88172645463325252ULL;
+
+static UInt64 TestRandom()
+{
+	s_testRandom ^= s_testRandom << 13;
+	s_testRandom ^= s_testRandom >> 7;
+	s_testRandom ^= s_testRandom << 17;
+	return s_testRandom;
+}
+
+static long s_numFailures = 0;
+
+static void TestPair( SFix64 x, SFix64 y )
+{
+	SFix64 product = SFix64_MultiplyInline( x, y );
+	SFix64 expectedProduct = SFix64_Multiply( x, y );
+	SFix64 quotient = SFix64_DivideInline( x, y );
+	SFix64 expectedQuotient = SFix64_Divide( x, y );
+
+	if( product != expectedProduct || quotient != expectedQuotient )
+	{
+		if( s_numFailures < 10 )
+		{
+			std::cout << std::hex 
+				<< "MISMATCH x=" << x << " y=" << y 
+				<< " mul " << product << " / " << expectedProduct
+				<< " div " << quotient << " / " << expectedQuotient 
+				<< std::dec << "\n";
+		}
+		++s_numFailures;
+	}
+}
+
+static bool TestEquivalence()
+{
+	//
+	// Every pair of edge values : zero, one, the limits,
+	// and each power of two give or take a little, both signs
+
+	SFix64 edges[1024];
+	int numEdges = 0;
+
+	edges[numEdges++] = 0;
+	edges[numEdges++] = FIXED64_MAX_SFIX64;
+	edges[numEdges++] = (SFix64)(1ULL << 63);
+	edges[numEdges++] = (SFix64)(1ULL << 63) + 1;
+	for( int bit = 0; bit < 63; ++bit )
+	{
+		for( int delta = -2; delta <= 2; ++delta )
+		{
+			SFix64 value = ((SFix64)1 << bit) + delta;
+			if( value <= 0 ) continue;
+			edges[numEdges++] = value;
+			edges[numEdges++] = -value;
+		}
+	}
+
+	for( int i = 0; i < numEdges; ++i )
+	{
+		for( int j = 0; j < numEdges; ++j )
+		{
+			TestPair( edges[i], edges[j] );
+		}
+	}
+
+	std::cout << "Edge pairs : " << numEdges * numEdges << "\n";
+
+
+	//
+	// Every pair of 10 bit mantissas at a spread of magnitudes,
+	// either side of the 2^47 fast path and the overflow limits
+
+	int shifts[] = { 0, 16, 28, 32, 36, 37, 38, 44, 52 };
+	int numShifts = sizeof(shifts) / sizeof(shifts[0]);
+	long numSweep = 0;
+
+	for( int si = 0; si < numShifts; ++si )
+	{
+		for( int sj = 0; sj < numShifts; ++sj )
+		{
+			for( SFix64 a = 0; a < 1024; ++a )
+			{
+				for( SFix64 b = 0; b < 1024; ++b )
+				{
+					SFix64 x = a << shifts[si];
+					SFix64 y = b << shifts[sj];
+					TestPair( x, y );
+					TestPair( -x, y );
+					TestPair( x, -y );
+					TestPair( -x, -y );
+					numSweep += 4;
+				}
+			}
+		}
+	}
+
+	std::cout << "Sweep pairs : " << numSweep << "\n";
+
+
+	//
+	// Random values of random magnitude
+
+	long numRandom = 100000000;
+	for( long i = 0; i < numRandom; ++i )
+	{
+		SFix64 x = (SFix64)( TestRandom() >> (TestRandom() % 64) );
+		SFix64 y = (SFix64)( TestRandom() >> (TestRandom() % 64) );
+		if( TestRandom() & 1 ) x = -x;
+		if( TestRandom() & 1 ) y = -y;
+		TestPair( x, y );
+	}
+
+	std::cout << "Random pairs : " << numRandom << "\n";
+
+#ifdef FIXED64_NATIVE_INT128
+	std::cout << "Native 128 bit arithmetic : ";
+#else
+	std::cout << "Portable arithmetic : ";
+#endif
+	std::cout << ( s_numFailures == 0 ? "identical" : "MISMATCHED" ) << "\n\n";
+
+	return s_numFailures == 0;
+}
+
+
+
+//
+// Golden values for the maths functions.  Every machine must give exactly
+// these results for FIXED_NUMERICS_REVISION, or games between them go out of sync.
+
+typedef Fixed (*MathsFunction)(const Fixed &);
+
+struct GoldenFunction
+{
+	char const		*m_name;
+	MathsFunction	m_function;
+	double			m_inputs[16];
+	int				m_numInputs;
+};
+
+static const GoldenFunction s_goldenFunctions[] = {
+	{ "sqrt", sqrt, { 0.0, 2.3283064365386963e-10, 1e-5, 0.25, 0.5, 1.0, 2.0, 3.0, 10.0, 12345.678, 10000.0, 1e9, 2147483647.0 }, 13 },
+	{ "sin", sin, { 0.0, 1e-6, 0.5235987755982988, 0.7853981633974483, 1.5707963267948966, 2.0, 3.141592653589793, 4.71238898038469, 6.283185307179586, -1.0, 100.0, 1000.5, -12345.6 }, 13 },
+	{ "cos", cos, { 0.0, 1e-6, 0.5235987755982988, 0.7853981633974483, 1.5707963267948966, 2.0, 3.141592653589793, 4.71238898038469, 6.283185307179586, -1.0, 100.0, 1000.5, -12345.6 }, 13 },
+	{ "asin", asin, { -1.0, -0.99999, -0.75, -0.5, -0.25, 0.0, 0.1, 0.5, 0.5000001, 0.7071067811865476, 0.9, 0.999, 1.0, 1.5 }, 14 },
+	{ "acos", acos, { -1.0, -0.99999, -0.75, -0.5, -0.25, 0.0, 0.1, 0.5, 0.5000001, 0.7071067811865476, 0.9, 0.999, 1.0, 1.5 }, 14 }
+};
+
+static const int s_numGoldenFunctions = sizeof(s_goldenFunctions) / sizeof(s_goldenFunctions[0]);
+
+struct GoldenValue
+{
+	char const		*m_name;
+	UInt64			m_input;
+	UInt64			m_output;
+};
+
+static char const *s_goldenRevision = "fixed64-2";
+
+static const GoldenValue s_goldenValues[] = {
+#include "fixed_test_golden.inc"
+};
+
+static const int s_numGoldenValues = sizeof(s_goldenValues) / sizeof(s_goldenValues[0]);
+
+
+static Fixed Evaluate( char const *_name, Fixed const &_input )
+{
+	for( int i = 0; i < s_numGoldenFunctions; ++i )
+	{
+		if( strcmp( s_goldenFunctions[i].m_name, _name ) == 0 )
+		{
+			return s_goldenFunctions[i].m_function( _input );
+		}
+	}
+	return Fixed(0);
+}
+
+static Fixed FromInternalValue( UInt64 _value )
+{
+	// Doubles hold the 32.32 values of the golden inputs exactly
+	return Fixed::FromDouble( (double)(SInt64)_value / 4294967296.0 );
+}
+
+static void PrintGoldenValues()
+{
+	printf( "// Generated by fixed_test golden, for FIXED_NUMERICS_REVISION %s\n", FIXED_NUMERICS_REVISION );
+	for( int i = 0; i < s_numGoldenFunctions; ++i )
+	{
+		GoldenFunction const &function = s_goldenFunctions[i];
+		for( int j = 0; j < function.m_numInputs; ++j )
+		{
+			Fixed input = Fixed::FromDouble( function.m_inputs[j] );
+			Fixed output = function.m_function( input );
+			printf( "\t{ \"%s\", 0x%llxULL, 0x%llxULL },\n", function.m_name, input.InternalValue(), output.InternalValue() );
+		}
+	}
+}
+
+static bool TestGoldenValues()
+{
+	if( strcmp( s_goldenRevision, FIXED_NUMERICS_REVISION ) != 0 )
+	{
+		std::cout << "Golden values are for " << s_goldenRevision 
+			<< " but the numerics are " << FIXED_NUMERICS_REVISION << "\n";
+		return false;
+	}
+
+	int numFailures = 0;
+	for( int i = 0; i < s_numGoldenValues; ++i )
+	{
+		GoldenValue const &golden = s_goldenValues[i];
+		Fixed input = FromInternalValue( golden.m_input );
+		UInt64 output = Evaluate( golden.m_name, input ).InternalValue();
+
+		if( input.InternalValue() != golden.m_input || output != golden.m_output )
+		{
+			std::cout << std::hex << "GOLDEN MISMATCH " << golden.m_name << "( 0x" << golden.m_input 
+				<< " ) = 0x" << output << ", expected 0x" << golden.m_output << std::dec << "\n";
+			++numFailures;
+		}
+	}
+
+	std::cout << "Golden values : " << s_numGoldenValues << ( numFailures == 0 ? " identical" : " MISMATCHED" ) << "\n";
+	return numFailures == 0;
+}
+
+
+//
+// Accuracy against the C library over a dense sweep.  Not part of the
+// sync guarantee, but catches a broken table or kernel before it is golden.
+
+static bool TestAccuracy()
+{
+	double sinError = 0.0, asinError = 0.0, sqrtError = 0.0;
+
+	for( int i = -200000; i <= 200000; ++i )
+	{
+		Fixed x = Fixed::FromDouble( i * 0.00071 );
+		double xd = (double)(SInt64)x.InternalValue() / 4294967296.0;
+		sinError = std::max( sinError, fabs( (double)(SInt64)sin(x).InternalValue() / 4294967296.0 - sin(xd) ) );
+		sinError = std::max( sinError, fabs( (double)(SInt64)cos(x).InternalValue() / 4294967296.0 - cos(xd) ) );
+	}
+
+	for( int i = -100000; i <= 100000; ++i )
+	{
+		Fixed x = Fixed::FromDouble( i / 100000.0 );
+		double xd = (double)(SInt64)x.InternalValue() / 4294967296.0;
+		asinError = std::max( asinError, fabs( (double)(SInt64)asin(x).InternalValue() / 4294967296.0 - asin(xd) ) );
+		asinError = std::max( asinError, fabs( (double)(SInt64)acos(x).InternalValue() / 4294967296.0 - acos(xd) ) );
+	}
+
+	for( int i = 0; i < 1000000; ++i )
+	{
+		Fixed x = Fixed::FromDouble( (double)i * i * 0.0001 + i * 1e-7 );
+		double xd = (double)(SInt64)x.InternalValue() / 4294967296.0;
+		double error = fabs( (double)(SInt64)sqrt(x).InternalValue() / 4294967296.0 - sqrt(xd) );
+		sqrtError = std::max( sqrtError, error / std::max( 1.0, sqrt(xd) ) );
+	}
+
+	std::cout << "Worst error : sin and cos " << sinError << ", asin and acos " << asinError 
+		<< ", sqrt " << sqrtError << " relative\n\n";
+
+	return sinError < 5e-7 && asinError < 5e-7 && sqrtError < 1e-9;
+}
+
+#endif
+
+
+int main( int argc, char *argv[] )
 {
+#ifdef FIXED64_NUMERICS
+	if( argc > 1 && strcmp( argv[1], "golden" ) == 0 )
+	{
+		PrintGoldenValues();
+		return 0;
+	}
+
+	bool success = TestGoldenValues();
+	success = TestAccuracy() && success;
+	success = TestEquivalence() && success;
+	if( !success ) return 1;
+#endif
+
 	std::cout 
-		<< "3.2 + 4.5 = " << Fixed::FromFloat(3.2f) + Fixed::FromFloat(4.5f) << "\n" 
+		<< "3.2 + 4.5 = " << Fixed::FromDouble(3.2) + Fixed::FromDouble(4.5) << "\n" 
 		<< "3 + 4 = " << Fixed(3) + Fixed(4) << "\n"
 		<< "10/2 = " << Fixed(10) / Fixed(2) << "\n"
-		<< "10/0.5 = " << Fixed(10) / Fixed::FromFloat(0.5f) << "\n"
+		<< "10/0.5 = " << Fixed(10) / Fixed::FromDouble(0.5) << "\n"
 		<< "sin(0) = " << sin(Fixed(0)) << "\n"
-		<< "sin(pi/2) = " << sin(Fixed::FromFloat(3.1415926f / 2.0f)) << "\n"
+		<< "sin(pi/2) = " << sin(Fixed::FromDouble(3.1415926 / 2.0)) << "\n"
 		<< "cos(0) = " << cos(Fixed(0))  << "\n"
 		<< "sqrt(10000) = " << sqrt(Fixed(10000)) << "\n"
 		<< std::endl;
@@ -24,7 +325,7 @@ int main()
 		// 	<< "tableSin( " << 360.0 * x / (2 * M_PI) << " degrees) = " << sin(Fixed(float(x))) << " "
 		// 	<< "  actual = " << sin(x) << " \n";
 
-		Fixed fx = Fixed::FromFloat(x);
+		Fixed fx = Fixed::FromDouble(x);
 		Fixed sinfx = sin(fx);
 		//Fixed asinsinfx = asin(sinfx);
 		
@@ -339,8 +339,6 @@ static NetCallBackRetType ListenCallback(NetUdpPacket *udpdata)
 			test.Read( udpdata->m_data, udpdata->m_length );
             delete directory;
         }
-
-        delete udpdata;
     }
 
     return 0;
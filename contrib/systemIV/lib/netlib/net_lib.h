@@ -28,6 +28,8 @@
 
 #define MAX_HOSTNAME_LEN   	256
 #define MAX_PACKET_SIZE  	10240
+#define NET_RECVBATCH		16			// Datagrams a listener can take in one call, on Linux
+#define NET_SENDBATCH		32			// Datagrams a NetSendBatch holds before it must flush
 
 
 typedef struct sockaddr_in NetIpAddress;
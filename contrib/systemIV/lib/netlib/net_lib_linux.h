@@ -23,6 +23,7 @@ typedef void * (*NetThreadFunc)(void *ptr);
 #define NetCloseSocket 				::close
 #define NetGetHostByName 			gethostbyname // Should eventually be getaddrinfo (?)
 #define NetSetSocketNonBlocking(a) 	fcntl(m_sockfd, F_SETFL, fcntl(a,F_GETFD) | O_NONBLOCK)
+#define NetMemoryBarrier()			__sync_synchronize()
 
 // Define portable names for Linux types
 #define NetSocketLenType				socklen_t
@@ -23,6 +23,7 @@ typedef unsigned long (WINAPI *NetThreadFunc)(void *ptr);
 #define NetCloseSocket 				closesocket
 #define NetGetHostByName 			gethostbyname // Should eventually be getaddrinfo (?)
 #define NetSetSocketNonBlocking(a) 	ioctlsocket(a, FIONBIO, (unsigned long *)0x01)
+#define NetMemoryBarrier()			MemoryBarrier()
 
 // Define portable names for Win32 types
 #define NetSocketLenType 			int
@@ -0,0 +1,103 @@
+// ****************************************************************************
+//  A bounded queue for handing items from one thread to another without a
+//  lock.  Exactly one thread may Push and exactly one other thread may Pop.
+//  Anyone else may only ask the Size, and gets an estimate.
+// ****************************************************************************
+
+#ifndef INCLUDED_NET_QUEUE_H
+#define INCLUDED_NET_QUEUE_H
+
+#include "net_lib.h"
+
+
+template <class T>
+class NetQueue
+{
+protected:
+    T                       *m_items;
+    unsigned int            m_mask;                 // Capacity - 1
+
+    volatile unsigned int   m_head;                 // Next to Pop, only written by the consumer
+    volatile unsigned int   m_tail;                 // Next to Push, only written by the producer
+
+public:
+    NetQueue( int _capacity );                      // Rounded up to a power of two
+    ~NetQueue();
+
+    bool    Push        ( T const &_item );         // Producer only, false if full
+    bool    Pop         ( T &_item );               // Consumer only, false if empty
+
+    int     Size        ();
+    int     Capacity    ();
+};
+
+
+//  ===================================================================
+
+template <class T>
+NetQueue<T>::NetQueue( int _capacity )
+:   m_head(0),
+    m_tail(0)
+{
+    unsigned int capacity = 1;
+    while( capacity < (unsigned int) _capacity ) capacity <<= 1;
+
+    m_items = new T[capacity];
+    m_mask = capacity - 1;
+}
+
+
+template <class T>
+NetQueue<T>::~NetQueue()
+{
+    delete [] m_items;
+}
+
+
+template <class T>
+bool NetQueue<T>::Push( T const &_item )
+{
+    unsigned int tail = m_tail;
+    if( tail - m_head > m_mask ) return false;
+
+    m_items[tail & m_mask] = _item;
+
+    // The item must be visible before the consumer sees the new tail
+    NetMemoryBarrier();
+    m_tail = tail + 1;
+    return true;
+}
+
+
+template <class T>
+bool NetQueue<T>::Pop( T &_item )
+{
+    unsigned int head = m_head;
+    if( head == m_tail ) return false;
+
+    // Don't read the item until we've seen the tail that covers it
+    NetMemoryBarrier();
+    _item = m_items[head & m_mask];
+
+    // And finish reading it before the producer may overwrite the slot
+    NetMemoryBarrier();
+    m_head = head + 1;
+    return true;
+}
+
+
+template <class T>
+int NetQueue<T>::Size()
+{
+    return (int)( m_tail - m_head );
+}
+
+
+template <class T>
+int NetQueue<T>::Capacity()
+{
+    return (int)( m_mask + 1 );
+}
+
+
+#endif
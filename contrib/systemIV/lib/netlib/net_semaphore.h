@@ -0,0 +1,34 @@
+// ****************************************************************************
+//  A platform independent counting semaphore, for a thread to sleep on
+//  until another has work for it.  Wait blocks until the count is above
+//  zero and then takes one, Signal adds to it and wakes that many waiters.
+// ****************************************************************************
+
+#ifndef INCLUDED_NET_SEMAPHORE_H
+#define INCLUDED_NET_SEMAPHORE_H
+
+
+#include "net_lib.h"
+
+
+class NetSemaphore
+{
+public:
+	NetSemaphore();
+	~NetSemaphore();
+
+	void			Wait();
+	void			Signal( int _count = 1 );
+
+protected:
+#ifdef WIN32
+	HANDLE			m_semaphore;
+#else
+	NetMutexHandle	m_mutex;
+	pthread_cond_t	m_condition;
+	int				m_count;
+#endif
+};
+
+
+#endif
@@ -0,0 +1,40 @@
+// See net_semaphore.h for module description
+
+#include "net_semaphore.h"
+
+
+NetSemaphore::NetSemaphore()
+:	m_count(0)
+{
+	pthread_mutex_init(&m_mutex, (pthread_mutexattr_t *)0);
+	pthread_cond_init(&m_condition, (pthread_condattr_t *)0);
+}
+
+
+NetSemaphore::~NetSemaphore()
+{
+	pthread_cond_destroy(&m_condition);
+	pthread_mutex_destroy(&m_mutex);
+}
+
+
+void NetSemaphore::Wait()
+{
+	pthread_mutex_lock(&m_mutex);
+	while (m_count == 0)
+	{
+		pthread_cond_wait(&m_condition, &m_mutex);
+	}
+	--m_count;
+	pthread_mutex_unlock(&m_mutex);
+}
+
+
+void NetSemaphore::Signal(int _count)
+{
+	pthread_mutex_lock(&m_mutex);
+	m_count += _count;
+	if (_count == 1)	pthread_cond_signal(&m_condition);
+	else				pthread_cond_broadcast(&m_condition);
+	pthread_mutex_unlock(&m_mutex);
+}
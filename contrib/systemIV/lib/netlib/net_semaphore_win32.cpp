@@ -0,0 +1,27 @@
+#include "lib/universal_include.h"
+
+#include "net_semaphore.h"
+
+
+NetSemaphore::NetSemaphore()
+{
+	m_semaphore = CreateSemaphore(NULL, 0, 0x7fffffff, NULL);
+}
+
+
+NetSemaphore::~NetSemaphore()
+{
+	CloseHandle(m_semaphore);
+}
+
+
+void NetSemaphore::Wait()
+{
+	WaitForSingleObject(m_semaphore, INFINITE);
+}
+
+
+void NetSemaphore::Signal(int _count)
+{
+	ReleaseSemaphore(m_semaphore, _count, NULL);
+}
@@ -0,0 +1,118 @@
+#include "lib/universal_include.h"
+#include "lib/debug_utils.h"
+
+#include "net_send_batch.h"
+#include "net_socket_session.h"
+
+
+NetSendBatch::NetSendBatch()
+:	m_sockfd((NetSocketHandle)-1),
+	m_size(0)
+{
+	m_data = new char[NET_SENDBATCH * MAX_PACKET_SIZE];
+	memset(m_to, 0, sizeof(m_to));
+	memset(m_lengths, 0, sizeof(m_lengths));
+}
+
+
+NetSendBatch::~NetSendBatch()
+{
+	delete [] m_data;
+}
+
+
+NetRetCode NetSendBatch::WriteData(NetSocketSession *_session, void *_buf, int _bufLen)
+{
+	// Too big to hold, so it can't wait
+	if (_bufLen > MAX_PACKET_SIZE)
+	{
+		return _session->WriteData(_buf, _bufLen);
+	}
+
+	NetRetCode result = NetOk;
+
+	if (m_size == NET_SENDBATCH ||
+		(m_size > 0 && m_sockfd != _session->GetSocketHandle()))
+	{
+		result = Flush();
+	}
+
+	m_sockfd = _session->GetSocketHandle();
+	m_to[m_size] = _session->GetDestination();
+	m_lengths[m_size] = _bufLen;
+	memcpy(m_data + m_size * MAX_PACKET_SIZE, _buf, _bufLen);
+	++m_size;
+
+	return result;
+}
+
+
+NetRetCode NetSendBatch::Flush()
+{
+	if (m_size == 0)
+	{
+		return NetOk;
+	}
+
+	if (int(m_sockfd) < 0)
+	{
+		AppDebugOut("NetSendBatch::Flush invalid socket\n");
+		m_size = 0;
+		return NetFailed;
+	}
+
+	NetRetCode result = NetOk;
+
+#if (defined __linux__)
+	struct mmsghdr messages[NET_SENDBATCH];
+	struct iovec buffers[NET_SENDBATCH];
+	memset(messages, 0, sizeof(messages));
+
+	for (int i = 0; i < m_size; ++i)
+	{
+		buffers[i].iov_base = m_data + i * MAX_PACKET_SIZE;
+		buffers[i].iov_len = m_lengths[i];
+		messages[i].msg_hdr.msg_iov = &buffers[i];
+		messages[i].msg_hdr.msg_iovlen = 1;
+		messages[i].msg_hdr.msg_name = &m_to[i];
+		messages[i].msg_hdr.msg_namelen = sizeof(m_to[i]);
+	}
+
+	int numSent = 0;
+	while (numSent < m_size)
+	{
+		int sent = sendmmsg(m_sockfd, messages + numSent, m_size - numSent, 0);
+
+		if (sent <= 0)
+		{
+			// sendmmsg stops at the first datagram that fails, so skip that one
+			AppDebugOut("NetSendBatch::Flush write call failed\n");
+			result = NetFailed;
+			sent = 1;
+		}
+
+		numSent += sent;
+	}
+#else
+	for (int i = 0; i < m_size; ++i)
+	{
+		int bytesSent = sendto(m_sockfd, m_data + i * MAX_PACKET_SIZE, m_lengths[i], 0,
+							   (struct sockaddr *)&m_to[i], sizeof(m_to[i]));
+
+		if (bytesSent < 0)
+		{
+			AppDebugOut("NetSendBatch::Flush write call failed\n");
+			result = NetFailed;
+		}
+	}
+#endif
+
+	m_size = 0;
+	return result;
+}
+
+
+int NetSendBatch::Size() const
+{
+	return m_size;
+}
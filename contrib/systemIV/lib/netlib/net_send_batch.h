@@ -0,0 +1,37 @@
+// ****************************************************************************
+//  Datagrams queued up to be sent together, when the owner calls Flush.
+//  On Linux they go out through sendmmsg, NET_SENDBATCH at a time.
+//  Elsewhere each one is still a sendto of its own.
+// ****************************************************************************
+
+#ifndef INCLUDED_NET_SEND_BATCH_H
+#define INCLUDED_NET_SEND_BATCH_H
+
+#include "net_lib.h"
+
+class NetSocketSession;
+
+
+class NetSendBatch
+{
+public:
+	NetSendBatch();
+	~NetSendBatch();
+
+	// Copies the data, so _buf can be reused straight away.
+	// Flushes first if the batch is full, or was for another socket
+	NetRetCode	WriteData(NetSocketSession *_session, void *_buf, int _bufLen);
+
+	NetRetCode	Flush();
+
+	int			Size() const;
+
+protected:
+	NetSocketHandle		m_sockfd;
+	NetIpAddress		m_to[NET_SENDBATCH];
+	int					m_lengths[NET_SENDBATCH];
+	char				*m_data;						// NET_SENDBATCH buffers of MAX_PACKET_SIZE
+	int					m_size;
+};
+
+#endif
@@ -135,7 +135,7 @@ void DebugOutNetSocketError( int _errorCode )
 }
 
 
-NetRetCode NetSocketListener::StartListening(NetCallBack functionPointer)
+NetRetCode NetSocketListener::StartListening(NetCallBack functionPointer, void *context)
 {
 	// Ensure that we are bound 
 	NetRetCode ret = NetOk;
@@ -154,36 +154,86 @@ NetRetCode NetSocketListener::StartListening(NetCallBack functionPointer)
 	// Signal that we should be listening
 	m_listening = true;
 
-	NetUdpPacket *packet = new NetUdpPacket();
+	// The packets are allocated once and reused for every datagram
+	NetUdpPacket *packets = new NetUdpPacket[NET_RECVBATCH];
+	for (int i = 0; i < NET_RECVBATCH; ++i)
+	{
+		packets[i].m_context = context;
+	}
+
+#if (defined __linux__)
+	// Each packet is filled in place by recvmmsg
+	struct mmsghdr messages[NET_RECVBATCH];
+	struct iovec buffers[NET_RECVBATCH];
+	memset(messages, 0, sizeof(messages));
+
+	for (int i = 0; i < NET_RECVBATCH; ++i)
+	{
+		buffers[i].iov_base = packets[i].m_data;
+		buffers[i].iov_len = MAX_PACKET_SIZE;
+		messages[i].msg_hdr.msg_iov = &buffers[i];
+		messages[i].msg_hdr.msg_iovlen = 1;
+		messages[i].msg_hdr.msg_name = &packets[i].m_clientAddress;
+	}
+#endif
 	
 	while (m_listening)
 	{
-		NetSocketLenType clientAddrLen = sizeof(packet->m_clientAddress);
+		int numPackets = 0;
+
+#if (defined __linux__)
+		// Wait for one datagram, then take as many more as have arrived
+		for (int i = 0; i < NET_RECVBATCH; ++i)
+		{
+			messages[i].msg_hdr.msg_namelen = sizeof(packets[i].m_clientAddress);
+		}
+
+		numPackets = recvmmsg(m_sockfd, messages, NET_RECVBATCH, MSG_WAITFORONE, NULL);
+
+		for (int i = 0; i < numPackets; ++i)
+		{
+			packets[i].m_length = messages[i].msg_len;
+		}
+#else
+		NetSocketLenType clientAddrLen = sizeof(packets[0].m_clientAddress);
 		
-		packet->m_length = recvfrom(m_sockfd, packet->m_data, MAX_PACKET_SIZE, 0, 
-			                        (struct sockaddr *)&packet->m_clientAddress, &clientAddrLen);
+		packets[0].m_length = recvfrom(m_sockfd, packets[0].m_data, MAX_PACKET_SIZE, 0, 
+			                           (struct sockaddr *)&packets[0].m_clientAddress, &clientAddrLen);
+
+		if (packets[0].m_length > 0) numPackets = 1;
+#endif
 		            
-	    if(packet->m_length <= 0)
+	    if(numPackets <= 0)
 	    {   
-            int errorCode = NetGetLastError();            
 	        DebugOutNetSocketError( NetGetLastError() );
-			// Cycle round and reuse the packet
+			// Cycle round and reuse the packets
 	    }
 	    else
 	    {
 			// Call function pointer with datagram data (type is NetUdpPacket) -
-			// the function pointed to must free NetUdpPacket passed in
-			(*functionPointer)(packet);
-			packet = new NetUdpPacket();
+			// the packet still belongs to us, and is reused once the function returns
+			for (int i = 0; i < numPackets; ++i)
+			{
+				if (packets[i].m_length > 0)
+				{
+					(*functionPointer)(&packets[i]);
+				}
+			}
 	    }
 	}
 	
-	delete packet;
+	delete [] packets;
 
 	return NetOk;
 }
 
    
+bool NetSocketListener::IsListening() const
+{
+	return m_listening;
+}
+
+
 void NetSocketListener::StopListening()
 {
 	m_listening = false;
@@ -195,4 +245,5 @@ void NetSocketListener::StopListening()
 	}
 
 	NetCloseSocket(m_sockfd);
+	m_sockfd = -1;
 }
@@ -16,10 +16,13 @@ public:
 	NetSocketListener(unsigned short port);
 	~NetSocketListener();
 
-	NetRetCode	StartListening(NetCallBack fnptr);
+	// The context is handed to the callback in each packet, so that
+	// one callback can serve several listeners
+	NetRetCode	StartListening(NetCallBack fnptr, void *context = NULL);
 	
 	// Asynchronously stops the listener after next accept call
 	void		StopListening();
+	bool		IsListening() const;
 
 	// Called by NetSocketSession to get the socket
 	NetSocketHandle		GetBoundSocketHandle();
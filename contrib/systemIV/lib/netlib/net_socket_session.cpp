@@ -91,3 +91,15 @@ NetRetCode NetSocketSession::WriteData(void *_buf, int _bufLen, int *_numActualB
 	return NetOk;
 }
 
+
+NetSocketHandle NetSocketSession::GetSocketHandle() const
+{
+	return m_sockfd;
+}
+
+
+const NetIpAddress &NetSocketSession::GetDestination() const
+{
+	return m_to;
+}
+
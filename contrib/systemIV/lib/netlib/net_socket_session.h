@@ -18,6 +18,9 @@ public:
 	
 	NetRetCode WriteData(void *_buf, int _bufLen, int *_numActualBytes = 0);
 
+	NetSocketHandle		GetSocketHandle() const;
+	const NetIpAddress	&GetDestination() const;
+
 protected:
 	NetSocketHandle		m_sockfd;
 	NetIpAddress		m_to;
@@ -5,7 +5,8 @@
 #include "net_udp_packet.h"
 
 NetUdpPacket::NetUdpPacket()
-	: m_length(0)
+	: m_length(0),
+	  m_context(NULL)
 {
 	memset(m_data, 0, MAX_PACKET_SIZE * sizeof(char));
 	memset(&m_clientAddress, 0, sizeof(m_clientAddress));
@@ -4,6 +4,8 @@
 
 // ****************************************************************************
 //  An object containing a single UDP datagram
+//  Owned by the NetSocketListener that received it, which reuses it for
+//  the next datagram once the callback returns
 // ****************************************************************************
 
 #include "net_lib.h"
@@ -20,6 +22,7 @@ public:
 	int 			m_length;
 	NetIpAddress	m_clientAddress;
 	char 			m_data[MAX_PACKET_SIZE];
+	void			*m_context;				// As passed to NetSocketListener::StartListening
 };
 
 
@@ -19,9 +19,16 @@ Resource *g_resource = NULL;
 
 
 Resource::Resource()
+:   m_texturesEnabled(true)
 {
 }
 
+void Resource::SetTexturesEnabled( bool _enabled )
+{
+    m_texturesEnabled = _enabled;
+}
+
+
 void Resource::Restart()
 {
     Shutdown();
@@ -91,7 +98,15 @@ Image *Resource::GetImage( const char *filename )
     {
         image = new Image( fullFilename );
         m_imageCache.PutData( fullFilename, image );
-        image->MakeTexture( true, true );
+        if( m_texturesEnabled )
+        {
+            image->MakeTexture( true, true );
+        }
+        else
+        {
+            // Mask it all the same, so its pixels read as they would with a texture
+            image->m_bitmap->ConvertPinkToTransparent();
+        }
         return image;
     }
 }
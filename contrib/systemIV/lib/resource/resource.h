@@ -26,6 +26,7 @@ protected:
     BTree   <BitmapFont *>      m_bitmapFontCache;
     BTree   <bool>              m_testBitmapFontCache;
     BTree   <unsigned int>      m_displayLists;
+    bool                        m_texturesEnabled;
 
 public:
     Resource();
@@ -33,6 +34,8 @@ public:
     void            Restart();
     void            Shutdown();
 
+    void            SetTexturesEnabled  ( bool _enabled );                                                // Off when there is no OpenGL context
+
     Image           *GetImage           ( const char *_filename );
     BitmapFont      *GetBitmapFont      ( const char *_filename );
     bool            TestBitmapFont      ( const char *_filename );
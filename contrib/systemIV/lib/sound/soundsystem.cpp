@@ -341,7 +341,7 @@ SoundInstance *SoundSystem::GetSoundInstance( SoundInstanceId id )
 
 void SoundSystem::TriggerEvent( SoundObjectId _objId, char *_eventName )
 {
-    if( !m_channels ) return;
+    if( !m_channels || m_interface->IsMuted() ) return;
 
 	START_PROFILE("TriggerEvent");
     
@@ -383,7 +383,7 @@ void SoundSystem::TriggerEvent( char *_type, char *_eventName )
 
 void SoundSystem::TriggerEvent( char *_type, char *_eventName, Vector3<float> const &_pos )
 {
-    if( !m_channels ) return;
+    if( !m_channels || m_interface->IsMuted() ) return;
 
 	START_PROFILE("TriggerEvent");
     
@@ -82,3 +82,9 @@ bool SoundSystemInterface::GetObjectPosition( SoundObjectId _id, Vector3<float>
 {
     return false;
 }
+
+
+bool SoundSystemInterface::IsMuted()
+{
+    return false;
+}
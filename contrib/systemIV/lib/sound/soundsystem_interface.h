@@ -51,6 +51,8 @@ public:
     virtual bool    ListProperties          ( LList<char *> *_list );
     virtual bool    GetPropertyRange        ( char *_property, float *_min, float *_max );
     virtual float   GetPropertyValue        ( char *_property, SoundObjectId _id );
+
+    virtual bool    IsMuted                 ();                                 // No new events are triggered while true
 };
 
 
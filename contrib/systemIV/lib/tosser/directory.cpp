@@ -1,6 +1,5 @@
 #include "lib/universal_include.h"
 
-#include <sstream>
 #include <algorithm>
 
 #include <stdio.h>
@@ -10,10 +9,6 @@
 #include "lib/debug_utils.h"
 #include "directory.h"
 
-#define DIRECTORY_MARKERSIZE     1
-#define DIRECTORY_MARKERSTART    "<"
-#define DIRECTORY_MARKEREND      ">"
-
 #define DIRECTORY_MAXSTRINGLENGTH   10240
 #define DIRECTORY_MAXDIRSIZE        1024
 
@@ -1160,36 +1155,410 @@ void HexDumpData( const char *input, int length, int highlight )
 	}
 }
 
+// ============================================================================
+// Buffer serialisation
+// The same layout as the stream versions, read and written in place
+
+
+class DirectoryBufferReader
+{
+public:
+    char const  *m_start;
+    char const  *m_data;
+    char const  *m_end;
+    bool        m_failed;
+
+    DirectoryBufferReader( char const *_data, int _length )
+    :   m_start(_data),
+        m_data(_data),
+        m_end(_data + _length),
+        m_failed(false)
+    {
+    }
+
+    int Position() { return (int) ( m_data - m_start ); }
+
+    bool Has( int _bytes )
+    {
+        if( m_failed || _bytes < 0 || m_end - m_data < _bytes )
+        {
+            m_failed = true;
+        }
+        return !m_failed;
+    }
+
+    template <class T>
+    void ReadNetworkValue( T &v )
+    {
+        if( !Has( sizeof(T) ) ) return;
+#ifndef __BIG_ENDIAN__
+        memcpy( &v, m_data, sizeof(T) );
+#else
+        reverseCopy( (char *) &v, m_data, sizeof(T) );
+#endif
+        m_data += sizeof(T);
+    }
+
+    unsigned char ReadByte()
+    {
+        if( !Has( 1 ) ) return 0;
+        return (unsigned char) *m_data++;
+    }
+
+    int ReadPackedInt()
+    {
+        unsigned char code = ReadByte();
+        if( code != 255 ) return (int) code;
+
+        int fullValue = 0;
+        ReadNetworkValue( fullValue );
+        return fullValue;
+    }
+
+    char *ReadDynamicString()
+    {
+        int size = ReadPackedInt();
+
+        if( m_failed || size == -1 )
+        {
+            return NULL;
+        }
+        else if( size < 0 || size > DIRECTORY_MAXSTRINGLENGTH )
+        {
+            return newStr(DIRECTORY_SAFESTRING);
+        }
+        else if( !Has( size ) )
+        {
+            return NULL;
+        }
+
+        char *string = new char [size+1];
+        memcpy( string, m_data, size );
+        string[size] = '\x0';
+        m_data += size;
+        return string;
+    }
+
+    bool ReadMarker( char const *_marker )
+    {
+        if( !Has( DIRECTORY_MARKERSIZE ) ||
+            strncmp( m_data, _marker, DIRECTORY_MARKERSIZE ) != 0 )
+        {
+            return false;
+        }
+
+        m_data += DIRECTORY_MARKERSIZE;
+        return true;
+    }
+};
+
+
+// Writes until the buffer runs out, then just counts
+
+class DirectoryBufferWriter
+{
+public:
+    char    *m_data;
+    char    *m_end;                                                 // NULL if the caller has already made room
+    int     m_length;
+
+    DirectoryBufferWriter( char *_buffer, char *_end )
+    :   m_data(_buffer),
+        m_end(_end),
+        m_length(0)
+    {
+    }
+
+    bool Fits() { return m_data != NULL; }
+
+    void WriteBytes( void const *_data, int _length )
+    {
+        m_length += _length;
+        if( !m_data ) return;
+
+        if( m_end && m_end - m_data < _length )
+        {
+            m_data = NULL;
+            return;
+        }
+
+        memcpy( m_data, _data, _length );
+        m_data += _length;
+    }
+
+    template <class T>
+    void WriteNetworkValue( T v )
+    {
+#ifndef __BIG_ENDIAN__
+        WriteBytes( &v, sizeof(T) );
+#else
+        char data[sizeof(T)];
+        reverseCopy( data, (char const *) &v, sizeof(T) );
+        WriteBytes( data, sizeof(T) );
+#endif
+    }
+
+    void WriteByte( unsigned char _value )
+    {
+        WriteBytes( &_value, 1 );
+    }
+
+    void WritePackedInt( int _value )
+    {
+        if( _value >= 0 && _value < 255 )
+        {
+            WriteByte( (unsigned char) _value );
+        }
+        else
+        {
+            WriteByte( 255 );
+            WriteNetworkValue( _value );
+        }
+    }
+
+    void WriteDynamicString( char *_string )
+    {
+        if( _string )
+        {
+            int size = strlen(_string);
+            WritePackedInt( size );
+            WriteBytes( _string, size );
+        }
+        else
+        {
+            WritePackedInt( -1 );
+        }
+    }
+};
+
+
+static bool ReadDirectoryData( DirectoryData *_data, DirectoryBufferReader &_input )
+{
+    delete[] _data->m_name;
+    _data->m_name = _input.ReadDynamicString();
+
+    _data->m_type = _input.ReadByte();
+    if( _input.m_failed ) return false;
+
+    switch ( _data->m_type )
+    {
+        case    DIRECTORY_TYPE_INT   :   _input.ReadNetworkValue( _data->m_int );               break;
+        case    DIRECTORY_TYPE_FLOAT :   _input.ReadNetworkValue( _data->m_float );             break;
+        case    DIRECTORY_TYPE_FIXED :   _input.ReadNetworkValue( _data->m_fixed );             break;
+        case    DIRECTORY_TYPE_CHAR  :   _data->m_char = (char) _input.ReadByte();              break;
+        case    DIRECTORY_TYPE_BOOL  :   _data->m_bool = ( _input.ReadByte() != 0 );            break;
+
+        case DIRECTORY_TYPE_STRING:
+            delete[] _data->m_string;
+            _data->m_string = _input.ReadDynamicString();
+            break;
+
+        case DIRECTORY_TYPE_VOID:
+        {
+            delete[] (char *) _data->m_void;
+            _data->m_void = NULL;
+            _data->m_voidLen = 0;
+
+            int dataLen = 0;
+            _input.ReadNetworkValue( dataLen );
+            if( !_input.Has( dataLen ) ) return false;
+
+            _data->m_voidLen = dataLen;
+            _data->m_void = new char[dataLen];
+            memcpy( _data->m_void, _input.m_data, dataLen );
+            _input.m_data += dataLen;
+            break;
+        }
+
+        default:
+            return false;
+    }
+
+    return !_input.m_failed;
+}
+
+
+static bool ReadDirectory( Directory *_dir, DirectoryBufferReader &_input )
+{
+    if( !_input.ReadMarker( DIRECTORY_MARKERSTART ) ) return false;
+
+    delete[] _dir->m_name;
+    _dir->m_name = _input.ReadDynamicString();
+
+    int numUsed = _input.ReadPackedInt();
+    if( _input.m_failed || numUsed < 0 || numUsed > DIRECTORY_MAXDIRSIZE ) return false;
+
+    for ( int d = 0; d < numUsed; ++d )
+    {
+        DirectoryData *data = new DirectoryData();
+        if( !ReadDirectoryData( data, _input ) )
+        {
+            delete data;
+            return false;
+        }
+        _dir->m_data.PutData( data );
+    }
+
+    int numSubdirs = _input.ReadPackedInt();
+    if( _input.m_failed || numSubdirs < 0 || numSubdirs > DIRECTORY_MAXDIRSIZE ) return false;
+
+    for ( int s = 0; s < numSubdirs; ++s )
+    {
+        Directory *newDir = new Directory();
+        if( !ReadDirectory( newDir, _input ) )
+        {
+            delete newDir;
+            return false;
+        }
+        _dir->m_subDirectories.PutData( newDir );
+    }
+
+    return _input.ReadMarker( DIRECTORY_MARKEREND );
+}
+
+
+static void WriteDirectoryData( DirectoryData *_data, DirectoryBufferWriter &_output )
+{
+    _output.WriteDynamicString( _data->m_name );
+    _output.WriteByte( (unsigned char) _data->m_type );
+
+    switch ( _data->m_type )
+    {
+        case    DIRECTORY_TYPE_INT   :   _output.WriteNetworkValue( _data->m_int );             break;
+        case    DIRECTORY_TYPE_FLOAT :   _output.WriteNetworkValue( _data->m_float );           break;
+        case    DIRECTORY_TYPE_FIXED :   _output.WriteNetworkValue( _data->m_fixed );           break;
+        case    DIRECTORY_TYPE_CHAR  :   _output.WriteByte( (unsigned char) _data->m_char );    break;
+        case    DIRECTORY_TYPE_BOOL  :   _output.WriteByte( _data->m_bool ? 1 : 0 );            break;
+
+        case DIRECTORY_TYPE_STRING:
+            _output.WriteDynamicString( _data->m_string );
+            break;
+
+        case DIRECTORY_TYPE_VOID:
+            _output.WriteNetworkValue( _data->m_voidLen );
+            _output.WriteBytes( _data->m_void, _data->m_voidLen );
+            break;
+    }
+}
+
+
+static void WriteDirectory( Directory *_dir, DirectoryBufferWriter &_output );
+
+
+static void WriteDataBlock( Directory *_dir, DirectoryBufferWriter &_output )
+{
+    for ( int d = 0; d < _dir->m_data.Size(); ++d )
+    {
+        if ( _dir->m_data.ValidIndex(d) )
+        {
+            WriteDirectoryData( _dir->m_data[d], _output );
+        }
+    }
+}
+
+
+static void WriteSubDirBlock( Directory *_dir, DirectoryBufferWriter &_output )
+{
+    for ( int s = 0; s < _dir->m_subDirectories.Size(); ++s )
+    {
+        if ( _dir->m_subDirectories.ValidIndex(s) )
+        {
+            WriteDirectory( _dir->m_subDirectories[s], _output );
+        }
+    }
+}
+
+
+static void WriteDirectory( Directory *_dir, DirectoryBufferWriter &_output )
+{
+    _output.WriteBytes( DIRECTORY_MARKERSTART, DIRECTORY_MARKERSIZE );
+    _output.WriteDynamicString( _dir->m_name );
+
+    _output.WritePackedInt( _dir->m_data.NumUsed() );
+    WriteDataBlock( _dir, _output );
+
+    _output.WritePackedInt( _dir->m_subDirectories.NumUsed() );
+    WriteSubDirBlock( _dir, _output );
+
+    _output.WriteBytes( DIRECTORY_MARKEREND, DIRECTORY_MARKERSIZE );
+}
+
+
 bool Directory::Read( char *input, int length )
 {
-    istringstream inputStream( string(input, length) );
-    bool result = Read( inputStream );
-	
+    DirectoryBufferReader reader( input, length );
+    bool result = ReadDirectory( this, reader );
+
 	if (!result) 
 	{
-		AppDebugOut( "Failed to parse directory at position %d.\n", (int) inputStream.tellg() );
+		AppDebugOut( "Failed to parse directory at position %d.\n", reader.Position() );
 		AppDebugOut( "Packet length: %d\n", length );
 		AppDebugOut( "Packet data:\n" );
-		HexDumpData( input, length, inputStream.tellg() );
+		HexDumpData( input, length, reader.Position() );
 		AppDebugOut( "\n" );
-		
-		istringstream inputStream2( string(input, length) );
-		Read( inputStream2 );
 	}
     return result;
 }
 
 
+int Directory::GetWriteSize()
+{
+    DirectoryBufferWriter counter( NULL, NULL );
+    WriteDirectory( this, counter );
+    return counter.m_length + 1;
+}
+
+
+int Directory::Write( char *_buffer, int _bufferSize )
+{
+    DirectoryBufferWriter writer( _buffer, _buffer + _bufferSize );
+    WriteDirectory( this, writer );
+    writer.WriteByte( 0 );                                          // As Write( int & ) always has
+
+    if( !writer.Fits() ) return -1;
+    return writer.m_length;
+}
+
+
+int Directory::WriteDataBlock( char *_buffer )
+{
+    DirectoryBufferWriter writer( _buffer, NULL );
+    ::WriteDataBlock( this, writer );
+    return writer.m_length;
+}
+
+
+int Directory::WriteSubDirBlock( char *_buffer )
+{
+    DirectoryBufferWriter writer( _buffer, NULL );
+    ::WriteSubDirBlock( this, writer );
+    return writer.m_length;
+}
+
+
+int Directory::WritePackedInt( char *_buffer, int _value )
+{
+    DirectoryBufferWriter writer( _buffer, NULL );
+    writer.WritePackedInt( _value );
+    return writer.m_length;
+}
+
+
+int Directory::WriteDynamicString( char *_buffer, char *_string )
+{
+    DirectoryBufferWriter writer( _buffer, NULL );
+    writer.WriteDynamicString( _string );
+    return writer.m_length;
+}
+
+
 char *Directory::Write( int &length )
 {
-    ostringstream outputStream;
-    Write( outputStream );
-    outputStream << '\x0';
-    
-    length = outputStream.tellp();
+    length = GetWriteSize();
 
     char *result = new char[length];
-    outputStream.str().copy(result, length);
+    int written = Write( result, length );
+    AppAssert( written == length );
 
     return result;
 }
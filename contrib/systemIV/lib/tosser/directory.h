@@ -91,15 +91,25 @@ public:
     bool Read  ( std::istream &input );                                                      // returns false if an error occurred while reading
     void Write ( std::ostream &output );
 
-    bool Read   ( char *input, int length );
+    bool Read   ( char *input, int length );                                            // Parses in place, no copy of input
     char *Write ( int &length );                                                        // Creates new string
 
+    int  GetWriteSize   ();                                                             // Exact length of Write( char *, int )
+    int  Write          ( char *_buffer, int _bufferSize );                             // Returns length written, or -1 if it won't fit
+
+    int  WriteDataBlock     ( char *_buffer );                                          // Just the data, or just the subdirectories, as they
+    int  WriteSubDirBlock   ( char *_buffer );                                          // appear in Write, for splicing letters together.
+                                                                                        // Return the length, _buffer NULL only counts
+
     static void WriteDynamicString ( std::ostream &output, char *string );   				// Works with NULL
     static char *ReadDynamicString ( std::istream &input );									// Assigns space for string
     
     static void WritePackedInt     ( std::ostream &output, int _value );
     static int  ReadPackedInt      ( std::istream &input );
 
+    static int  WritePackedInt     ( char *_buffer, int _value );                          // Buffer versions, return the length.
+    static int  WriteDynamicString ( char *_buffer, char *_string );                       // _buffer NULL only counts
+
     static void WriteVoidData      ( std::ostream &output, void *data, int dataLen );       
     static void *ReadVoidData      ( std::istream &input, int *dataLen );				    // Assigns space for data
 
@@ -134,6 +144,10 @@ public:
 #define DIRECTORY_TYPE_VOID     6
 #define DIRECTORY_TYPE_FIXED    7
 
+#define DIRECTORY_MARKERSIZE     1
+#define DIRECTORY_MARKERSTART    "<"
+#define DIRECTORY_MARKEREND      ">"
+
 #define DIRECTORY_SAFEINT        -1
 #define DIRECTORY_SAFEFLOAT      -1.0f
 #define DIRECTORY_SAFECHAR       '?'
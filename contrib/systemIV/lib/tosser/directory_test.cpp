@@ -0,0 +1,292 @@
+
+// Build from the root directory, eg
+//
+//   g++ -O2 -DFIXED64_NUMERICS -DTARGET_OS_LINUX -Isource -Icontrib/systemIV contrib/systemIV/lib/tosser/directory_test.cpp contrib/systemIV/lib/tosser/directory.cpp contrib/systemIV/lib/string_utils.cpp contrib/systemIV/lib/math/fixed_64.cpp
+//
+// Checks the buffer Read and Write of a Directory against the stream versions they
+// replaced on the network path - the bytes written must be identical, and everything
+// read must write back out the same - then times the two.  Returns non-zero on any
+// difference.  "a.out 100000" runs that many letters per timing instead of 20000.
+
+#include "lib/universal_include.h"
+
+#include <stdarg.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#include <sstream>
+#include <string>
+
+#include "lib/tosser/directory.h"
+
+
+void AppDebugOut( char *_msg, ... )
+{
+}
+
+
+void AppReleaseAssertFailed( char const *_msg, ... )
+{
+    va_list ap;
+    va_start( ap, _msg );
+    vprintf( _msg, ap );
+    va_end( ap );
+    printf( "\n" );
+    exit( 1 );
+}
+
+
+//
+// The network path as it was before the buffer versions
+
+static char *StreamWrite( Directory *_dir, int &_length )
+{
+    std::ostringstream outputStream;
+    _dir->Write( outputStream );
+    outputStream << '\x0';
+
+    _length = outputStream.tellp();
+
+    char *result = new char[_length];
+    outputStream.str().copy( result, _length );
+    return result;
+}
+
+
+static bool StreamRead( Directory *_dir, char *_input, int _length )
+{
+    std::istringstream inputStream( std::string( _input, _length ) );
+    return _dir->Read( inputStream );
+}
+
+
+//
+// Letters shaped like the ones the game sends : a server update
+// carrying a batch of client commands, and a lone chat message
+
+static Directory *MakeUpdateLetter( int _numCommands )
+{
+    Directory *letter = new Directory();
+    letter->SetName( "d" );
+    letter->CreateData( "c", "sh" );
+    letter->CreateData( "i", 18211 );
+    letter->CreateData( "l", -1 );
+
+    for( int i = 0; i < _numCommands; ++i )
+    {
+        Directory *command = new Directory();
+        command->SetName( "d" );
+        command->CreateData( "c", "cl" );
+        command->CreateData( "db", i % 6 );
+        command->CreateData( "dd", 1000 + i * 37 );
+        command->CreateData( "dj", Fixed::FromDouble( -120.5 + i ) );
+        command->CreateData( "dk", Fixed::FromDouble( 33.25 - i ) );
+        command->CreateData( "du", i % 3 == 0 );
+        command->CreateData( "dl", (char) ( 'a' + i % 26 ) );
+        command->CreateData( "z", i * 100000 );
+        letter->AddDirectory( command );
+    }
+
+    return letter;
+}
+
+
+static Directory *MakeChatLetter()
+{
+    unsigned char blob[40];
+    for( int i = 0; i < 40; ++i ) blob[i] = (unsigned char) ( i * 7 );
+
+    Directory *letter = new Directory();
+    letter->CreateData( "c", "cs" );
+    letter->CreateData( "dq", 100 );
+    letter->CreateData( "dr", "Launching everything at Moscow, sorry" );
+    letter->CreateData( "do", 0.75f );
+    letter->CreateData( "dt", blob, sizeof(blob) );
+    letter->CreateData( "dv", (char *) NULL );
+    return letter;
+}
+
+
+//
+// Equivalence
+
+static int s_numFailures = 0;
+
+static void Fail( char const *_letterName, char const *_what )
+{
+    printf( "FAILED %s : %s\n", _letterName, _what );
+    ++s_numFailures;
+}
+
+
+static void TestLetter( char const *_letterName, Directory *_letter )
+{
+    int streamLength = 0;
+    char *streamBytes = StreamWrite( _letter, streamLength );
+
+    int length = 0;
+    char *bytes = _letter->Write( length );
+
+    if( length != streamLength || memcmp( bytes, streamBytes, length ) != 0 )
+    {
+        Fail( _letterName, "Write( int & ) differs from the stream" );
+    }
+
+    if( _letter->GetWriteSize() != streamLength )
+    {
+        Fail( _letterName, "GetWriteSize is wrong" );
+    }
+
+    char small[16];
+    if( streamLength > (int) sizeof(small) &&
+        _letter->Write( small, sizeof(small) ) != -1 )
+    {
+        Fail( _letterName, "Write into a small buffer claimed to fit" );
+    }
+
+
+    //
+    // Read both ways and write back out
+
+    Directory fromBuffer;
+    Directory fromStream;
+    bool bufferOk = fromBuffer.Read( streamBytes, streamLength );
+    bool streamOk = StreamRead( &fromStream, streamBytes, streamLength );
+
+    if( !bufferOk || !streamOk )
+    {
+        Fail( _letterName, "Read failed" );
+    }
+    else
+    {
+        int bufferLength = 0;
+        int rereadLength = 0;
+        char *bufferBytes = fromBuffer.Write( bufferLength );
+        char *rereadBytes = StreamWrite( &fromStream, rereadLength );
+
+        if( bufferLength != streamLength || memcmp( bufferBytes, streamBytes, streamLength ) != 0 ||
+            rereadLength != streamLength || memcmp( rereadBytes, streamBytes, streamLength ) != 0 )
+        {
+            Fail( _letterName, "Read does not round trip" );
+        }
+
+        delete [] bufferBytes;
+        delete [] rereadBytes;
+    }
+
+
+    //
+    // Every truncation short of the terminator must be refused
+
+    for( int cut = 0; cut < streamLength - 1; ++cut )
+    {
+        Directory truncated;
+        if( truncated.Read( streamBytes, cut ) )
+        {
+            Fail( _letterName, "Read accepted a truncated letter" );
+            break;
+        }
+    }
+
+    delete [] streamBytes;
+    delete [] bytes;
+}
+
+
+//
+// Timings
+
+static double Seconds( clock_t _start )
+{
+    return (double) ( clock() - _start ) / CLOCKS_PER_SEC;
+}
+
+
+static void TimeLetter( char const *_letterName, Directory *_letter, int _count )
+{
+    int length = 0;
+    char *bytes = _letter->Write( length );
+
+    char *buffer = new char[length];
+    int checksum = 0;
+
+
+    clock_t start = clock();
+    for( int i = 0; i < _count; ++i )
+    {
+        int streamLength = 0;
+        char *streamBytes = StreamWrite( _letter, streamLength );
+        checksum += streamBytes[i % streamLength];
+        delete [] streamBytes;
+    }
+    double streamWrite = Seconds( start );
+
+    start = clock();
+    for( int i = 0; i < _count; ++i )
+    {
+        int written = _letter->Write( buffer, length );
+        checksum += buffer[i % written];
+    }
+    double bufferWrite = Seconds( start );
+
+    start = clock();
+    for( int i = 0; i < _count; ++i )
+    {
+        Directory letter;
+        StreamRead( &letter, bytes, length );
+        checksum += letter.m_subDirectories.NumUsed();
+    }
+    double streamRead = Seconds( start );
+
+    start = clock();
+    for( int i = 0; i < _count; ++i )
+    {
+        Directory letter;
+        letter.Read( bytes, length );
+        checksum += letter.m_subDirectories.NumUsed();
+    }
+    double bufferRead = Seconds( start );
+
+
+    double scale = 1e9 / _count;
+    printf( "%-10s %5d bytes   write  stream %8.0f ns  buffer %8.0f ns  (x%.1f)\n",
+            _letterName, length, streamWrite * scale, bufferWrite * scale, streamWrite / bufferWrite );
+    printf( "%-10s %5s         read   stream %8.0f ns  buffer %8.0f ns  (x%.1f)   [%d]\n",
+            "", "", streamRead * scale, bufferRead * scale, streamRead / bufferRead, checksum );
+
+    delete [] buffer;
+    delete [] bytes;
+}
+
+
+int main( int argc, char *argv[] )
+{
+    int count = ( argc > 1 ? atoi( argv[1] ) : 20000 );
+    if( count < 1 ) count = 1;
+
+    Directory *empty  = MakeUpdateLetter( 0 );
+    Directory *update = MakeUpdateLetter( 40 );
+    Directory *chat   = MakeChatLetter();
+
+    TestLetter( "empty", empty );
+    TestLetter( "update", update );
+    TestLetter( "chat", chat );
+
+    if( s_numFailures > 0 )
+    {
+        printf( "%d failures\n", s_numFailures );
+        return 1;
+    }
+
+    TimeLetter( "empty", empty, count );
+    TimeLetter( "update", update, count / 10 );
+    TimeLetter( "chat", chat, count );
+
+    delete empty;
+    delete update;
+    delete chat;
+
+    return 0;
+}
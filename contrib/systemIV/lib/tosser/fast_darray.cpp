@@ -259,6 +259,41 @@ void FastDArray <T>::RemoveData( int index )
 }
 
 
+template <class T>
+void FastDArray <T>::GetFreeList( LList<int> *_freeList )
+{
+    _freeList->Empty();
+
+    for( int i = firstfree; i != -1; i = freelist[i] )
+    {
+        _freeList->PutDataAtEnd( i );
+    }
+}
+
+
+template <class T>
+void FastDArray <T>::SetFreeList( LList<int> *_freeList )
+{
+    AppAssert( _freeList->Size() == this->m_arraySize - numused );
+
+    firstfree = -1;
+    int lastfree = -1;
+
+    for( int i = 0; i < _freeList->Size(); ++i )
+    {
+        int index = _freeList->GetData(i);
+        AppAssert( index < this->m_arraySize && index >= 0 );
+        AppAssert( this->shadow[index] == 0 );
+
+        if( lastfree == -1 )    firstfree = index;
+        else                    freelist[lastfree] = index;
+
+        freelist[index] = -1;
+        lastfree = index;
+    }
+}
+
+
 template <class T>
 T *FastDArray<T>::GetPointer ()
 {
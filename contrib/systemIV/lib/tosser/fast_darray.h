@@ -2,6 +2,7 @@
 #define _included_fdarray_h
 
 #include "darray.h"
+#include "llist.h"
 
 //=================================================================
 // Fast Dynamic array object
@@ -34,6 +35,9 @@ public:
     
 	void        MarkUsed	( int index );						// SLOW
 	inline void RemoveData  ( int index );					    // FAST
+
+    void        GetFreeList ( LList<int> *_freeList );          // SLOW Unused indices, in the order PutData will use them
+    void        SetFreeList ( LList<int> *_freeList );          // SLOW Must be every unused index, eg from GetFreeList
     
     inline T    *GetPointer ();                                 // FAST Returns next free element, sets to 'used'
     inline T    *GetPointer (int index);                        // FAST Returns next free element, sets to 'used'
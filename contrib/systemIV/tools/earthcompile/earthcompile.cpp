@@ -0,0 +1,270 @@
+
+/*
+ * ============
+ * EARTHCOMPILE
+ * ============
+ *
+ * Compiles the text earth data into the binary files EarthData maps in.
+ * Each .dat in the directory gets a .bin beside it :
+ *
+ *      coastlines.dat, coastlines-low.dat, international.dat   -> lines
+ *      cities.dat                                              -> cities
+ *
+ * Usage : earthcompile [data/earth directory]
+ *
+ * Lines are read through the same TextReader as the game, and parsed the
+ * same way as EarthData::LoadLines and EarthData::LoadCities.  Run it again
+ * whenever a .dat changes - a stale .bin is ignored, not used.
+ *
+ */
+
+#include "lib/universal_include.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "lib/filesys/text_stream_readers.h"
+#include "lib/tosser/llist.h"
+
+#include "world/earthdata_format.h"
+
+
+static bool HashFile( char const *_filename, unsigned int &_hash )
+{
+    FILE *file = fopen( _filename, "rb" );
+    if( !file ) return false;
+
+    _hash = EARTHDATA_HASHSEED;
+
+    unsigned char buffer[4096];
+    while( true )
+    {
+        size_t bytesRead = fread( buffer, 1, sizeof(buffer), file );
+        _hash = EarthData_HashSource( buffer, (unsigned int) bytesRead, _hash );
+        if( bytesRead < sizeof(buffer) ) break;
+    }
+
+    fclose( file );
+    return true;
+}
+
+
+static bool WriteFile( char const *_filename, void const *_data, int _size )
+{
+    char tempFilename[512];
+    snprintf( tempFilename, sizeof(tempFilename), "%s.tmp", _filename );
+    tempFilename[ sizeof(tempFilename) - 1 ] = '\x0';
+
+    FILE *file = fopen( tempFilename, "wb" );
+    if( !file ) return false;
+
+    bool success = ( fwrite( _data, 1, _size, file ) == (size_t) _size );
+    fclose( file );
+
+    if( success )
+    {
+        remove( _filename );
+        success = ( rename( tempFilename, _filename ) == 0 );
+    }
+
+    if( !success ) remove( tempFilename );
+    return success;
+}
+
+
+static void InitHeader( EarthDataHeader *_header, char const *_magic, unsigned int _sourceHash )
+{
+    memset( _header, 0, sizeof(EarthDataHeader) );
+    memcpy( _header->m_magic, _magic, sizeof(_header->m_magic) );
+    _header->m_version = EARTHDATA_VERSION;
+    _header->m_byteOrder = EARTHDATA_BYTEORDER;
+    _header->m_sourceHash = _sourceHash;
+}
+
+
+static bool CompileLines( char const *_source, char const *_target )
+{
+    unsigned int sourceHash;
+    if( !HashFile( _source, sourceHash ) ) return false;
+
+    TextFileReader reader( _source );
+    if( !reader.IsOpen() ) return false;
+
+
+    //
+    // An island is only kept once the next one begins,
+    // so the last in the file is dropped, as in EarthData::LoadLines
+
+    LList<int> offsets;
+    LList<float> points;
+    bool inIsland = false;
+
+    while( reader.ReadLine() )
+    {
+        char *line = reader.GetRestOfLine();
+        if( !line ) continue;
+
+        if( line[0] == 'b' )
+        {
+            offsets.PutDataAtEnd( points.Size() / 2 );
+            inIsland = true;
+            continue;
+        }
+
+        if( !inIsland ) continue;
+
+        float longitude, latitude;
+        sscanf( line, "%f %f", &longitude, &latitude );
+        points.PutDataAtEnd( longitude );
+        points.PutDataAtEnd( latitude );
+    }
+
+    int numIslands = offsets.Size() > 0 ? offsets.Size() - 1 : 0;
+    int numPoints = numIslands > 0 ? offsets[numIslands] : 0;
+
+    int size = sizeof(EarthDataHeader) + ( numIslands + 1 ) * sizeof(int) + numPoints * 2 * sizeof(float);
+    unsigned char *data = new unsigned char[size];
+
+    EarthDataHeader *header = (EarthDataHeader *) data;
+    InitHeader( header, s_earthDataLinesMagic, sourceHash );
+    header->m_numRecords = numIslands;
+    header->m_numPoints = numPoints;
+
+    int *offsetData = (int *) ( data + sizeof(EarthDataHeader) );
+    for( int i = 0; i < numIslands; ++i )
+    {
+        offsetData[i] = offsets[i];
+    }
+    offsetData[numIslands] = numPoints;
+
+    float *pointData = (float *) ( offsetData + numIslands + 1 );
+    for( int i = 0; i < numPoints * 2; ++i )
+    {
+        pointData[i] = points[i];
+    }
+
+    bool success = WriteFile( _target, data, size );
+    delete [] data;
+
+    printf( "%s : %d islands, %d points -> %s\n", _source, numIslands, numPoints, success ? _target : "FAILED" );
+    return success;
+}
+
+
+static bool CompileCities( char const *_source, char const *_target )
+{
+    unsigned int sourceHash;
+    if( !HashFile( _source, sourceHash ) ) return false;
+
+    TextFileReader reader( _source );
+    if( !reader.IsOpen() ) return false;
+
+    LList<EarthDataCity *> cities;
+
+    while( reader.ReadLine() )
+    {
+        char *line = reader.GetRestOfLine();
+        if( !line ) continue;
+
+
+        //
+        // Fixed columns, trimmed exactly as EarthData::LoadCities does
+
+        char name[256];
+        char country[256];
+        float latitude, longitude;
+        int population;
+        int capital;
+
+        memset( name, 0, sizeof(name) );
+        memset( country, 0, sizeof(country) );
+
+        strncpy( name, line, 40 );
+        for( int i = 39; i >= 0; --i )
+        {
+            if( name[i] != ' ' )
+            {
+                name[i+1] = '\x0';
+                break;
+            }
+        }
+
+        strncpy( country, line+41, 40 );
+        for( int i = 39; i >= 0; --i )
+        {
+            if( country[i] != ' ' )
+            {
+                country[i+1] = '\x0';
+                break;
+            }
+        }
+
+        sscanf( line+82, "%f %f %d %d", &longitude, &latitude, &population, &capital );
+
+        EarthDataCity *city = new EarthDataCity;
+        memset( city, 0, sizeof(EarthDataCity) );
+        strncpy( city->m_name, name, sizeof(city->m_name) - 1 );
+        strncpy( city->m_country, country, sizeof(city->m_country) - 1 );
+        city->m_longitude = longitude;
+        city->m_latitude = latitude;
+        city->m_population = population;
+        city->m_capital = capital;
+        cities.PutDataAtEnd( city );
+    }
+
+    int size = sizeof(EarthDataHeader) + cities.Size() * sizeof(EarthDataCity);
+    unsigned char *data = new unsigned char[size];
+
+    EarthDataHeader *header = (EarthDataHeader *) data;
+    InitHeader( header, s_earthDataCitiesMagic, sourceHash );
+    header->m_numRecords = cities.Size();
+
+    EarthDataCity *cityData = (EarthDataCity *) ( data + sizeof(EarthDataHeader) );
+    for( int i = 0; i < cities.Size(); ++i )
+    {
+        cityData[i] = *cities[i];
+    }
+
+    bool success = WriteFile( _target, data, size );
+    delete [] data;
+
+    printf( "%s : %d cities -> %s\n", _source, cities.Size(), success ? _target : "FAILED" );
+
+    cities.EmptyAndDelete();
+    return success;
+}
+
+
+int main( int argc, char *argv[] )
+{
+    char const *directory = ( argc > 1 ? argv[1] : "data/earth" );
+
+    char const *lineFiles[] = { "coastlines", "coastlines-low", "international" };
+    int numLineFiles = sizeof(lineFiles) / sizeof(lineFiles[0]);
+
+    bool success = true;
+    char source[512];
+    char target[512];
+
+    for( int i = 0; i < numLineFiles; ++i )
+    {
+        snprintf( source, sizeof(source), "%s/%s.dat", directory, lineFiles[i] );
+        snprintf( target, sizeof(target), "%s/%s.bin", directory, lineFiles[i] );
+        if( !CompileLines( source, target ) )
+        {
+            printf( "Failed to compile %s\n", source );
+            success = false;
+        }
+    }
+
+    snprintf( source, sizeof(source), "%s/cities.dat", directory );
+    snprintf( target, sizeof(target), "%s/cities.bin", directory );
+    if( !CompileCities( source, target ) )
+    {
+        printf( "Failed to compile %s\n", source );
+        success = false;
+    }
+
+    return success ? 0 : 1;
+}
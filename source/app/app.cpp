@@ -35,6 +35,7 @@
 #include "app/app.h"
 #include "app/game.h"
 #include "app/defcon_soundinterface.h"
+#include "app/defcon_worldview.h"
 #include "app/statusicon.h"
 #include "app/tutorial.h"
 #include "app/modsystem.h"
@@ -52,6 +53,7 @@
 
 #include "network/ClientToServer.h"
 #include "network/Server.h"
+#include "network/letter_codec.h"
 
 #include "world/world.h"
 #include "world/earthdata.h"
@@ -164,7 +166,7 @@ void App::InitMetaServer()
     MatchMaker_LocateService( metaServerLocation, PORT_METASERVER_LISTEN );
 }
 
-static void InitialiseFloatingPointUnit()
+void App::InitialiseFloatingPointUnit()
 {
 #ifdef TARGET_OS_LINUX
 	/*
@@ -193,8 +195,35 @@ void App::MinimalInit()
     //
     // Turn everything on
 
+    InitSimulation();
+
+    g_styleTable = new StyleTable();
+    g_styleTable->Load( "default.txt" );
+    bool success = g_styleTable->Load( g_preferences->GetString(PREFS_INTERFACE_STYLE) );
+
+    m_clientToServer->OpenConnections();
+
+    g_windowManager = WindowManager::Create();
+    InitialiseWindow();
+    
+    g_renderer = new Renderer();
+    InitFonts();
+
+    m_mapRenderer = new MapRenderer();
+    m_mapRenderer->Init();
+
+    m_lobbyRenderer = new LobbyRenderer();
+    m_lobbyRenderer->Initialise();
+    
+    g_inputManager = InputManager::Create();
+
+}
+
+void App::InitSimulation()
+{
 	InitialiseFloatingPointUnit();
     InitialiseHighResTime();
+    LetterCodec::Initialise();
 
     g_fileSystem = new FileSystem();
     g_fileSystem->ParseArchive( "main.dat" );
@@ -234,32 +263,12 @@ void App::MinimalInit()
 	g_languageTable->LoadCurrentLanguage();
     
     g_resource = new Resource();
-    g_styleTable = new StyleTable();
-    g_styleTable->Load( "default.txt" );
-    bool success = g_styleTable->Load( g_preferences->GetString(PREFS_INTERFACE_STYLE) );
 
     m_clientToServer = new ClientToServer();
-    m_clientToServer->OpenConnections();
-
     m_game = new Game();
 
     m_earthData = new EarthData();
     m_earthData->Initialise();
-    
-    g_windowManager = WindowManager::Create();
-    InitialiseWindow();
-    
-    g_renderer = new Renderer();
-    InitFonts();
-
-    m_mapRenderer = new MapRenderer();
-    m_mapRenderer->Init();
-
-    m_lobbyRenderer = new LobbyRenderer();
-    m_lobbyRenderer->Initialise();
-    
-    g_inputManager = InputManager::Create();
-
 }
 
 void App::FinishInit()
@@ -734,21 +743,7 @@ void App::Shutdown()
 
 void App::StartGame()
 {    
-    int numSpectators = g_app->GetGame()->GetOptionValue( "MaxSpectators" );
-    if( numSpectators == 0 )
-    {
-        m_clientToServer->StopIdentifying();
-    }
-
-    bool connectingWindowOpen = EclGetWindow( "Connection Status" );
-    
-    EclRemoveAllWindows();
-
-    g_soundSystem->TriggerEvent( "Music", "StartMusic" );
-
-    m_interface->OpenGameWindows();
-    
-    if( connectingWindowOpen ) EclRegisterWindow( new ConnectingWindow() );
+    OpenGameInterface();
 
     int randSeed = 0;
     for( int i = 0; i < m_world->m_teams.Size(); ++i )
@@ -758,17 +753,9 @@ void App::StartGame()
     syncrandseed( randSeed );
     AppDebugOut( "App RandSeed = %d\n", randSeed );
 
+    GetWorld()->LoadGeography();
     GetWorld()->LoadNodes();
     GetWorld()->AssignCities();
-
-    if( GetGame()->GetOptionValue("GameMode") == GAMEMODE_OFFICEMODE )
-    {
-        g_soundLibrary3d->SetMasterVolume(0);
-        if( !g_windowManager->Windowed() )
-        {
-            ReinitialiseWindow();
-        }
-    }
     
     if( GetGame()->GetOptionValue("MaxGameRealTime") != 0.0f )
     {
@@ -823,6 +810,35 @@ void App::StartGame()
 }
 
 
+void App::OpenGameInterface()
+{
+    int numSpectators = g_app->GetGame()->GetOptionValue( "MaxSpectators" );
+    if( numSpectators == 0 )
+    {
+        m_clientToServer->StopIdentifying();
+    }
+
+    bool connectingWindowOpen = EclGetWindow( "Connection Status" );
+    
+    EclRemoveAllWindows();
+
+    g_soundSystem->TriggerEvent( "Music", "StartMusic" );
+
+    m_interface->OpenGameWindows();
+    
+    if( connectingWindowOpen ) EclRegisterWindow( new ConnectingWindow() );
+
+    if( GetGame()->GetOptionValue("GameMode") == GAMEMODE_OFFICEMODE )
+    {
+        g_soundLibrary3d->SetMasterVolume(0);
+        if( !g_windowManager->Windowed() )
+        {
+            ReinitialiseWindow();
+        }
+    }
+}
+
+
 void App::StartTutorial( int _chapter )
 {
     m_tutorial = new Tutorial( _chapter );
@@ -971,6 +987,7 @@ void App::InitWorld()
     m_game->ResetOptions();
     
     m_world = new World();
+    m_world->SetView( new DefconWorldView() );
     m_world->Init();
 }
 
@@ -1084,6 +1101,32 @@ const char *App::GetAuthKeyPath()
 	return temp;
 }
 
+const char *App::GetRouteCachePath()
+{
+	static char temp[256];
+	sprintf( temp, "%s%s", GetPrefsDirectory(),
+#if defined(TARGET_OS_MACOSX)
+		"uk.co.introversion.defcon.routes"
+#else
+		"routes.dat"
+#endif
+	);
+	return temp;
+}
+
+const char *App::GetEarthDataCachePath()
+{
+	static char temp[256];
+	sprintf( temp, "%s%s", GetPrefsDirectory(),
+#if defined(TARGET_OS_MACOSX)
+		"uk.co.introversion.defcon.earthdata"
+#else
+		"earthdata.dat"
+#endif
+	);
+	return temp;
+}
+
 void App::HideWindow()
 {
 #ifdef TARGET_OS_MACOSX
@@ -61,6 +61,7 @@ public:
     ~App();
 
     void    MinimalInit();
+    void    InitSimulation();                       // Just what a World needs, without a window, sound or network
 	void    FinishInit();
     void    InitMetaServer();
     void    NotifyStartupErrors();
@@ -72,6 +73,7 @@ public:
     bool    InitServer();
     void    InitWorld(); 
     void    StartGame();
+    void    OpenGameInterface();                    // Windows and music for a game in progress
     void    StartTutorial( int _chapter );
 
     void    ShutdownCurrentGame();                  // Closes everything, ie client, server, world etc
@@ -99,6 +101,10 @@ public:
 	
 	static const char *GetAuthKeyPath();
 	static const char *GetPrefsPath();
+	static const char *GetRouteCachePath();
+	static const char *GetEarthDataCachePath();
+
+	static void InitialiseFloatingPointUnit();      // Per thread, for any thread that runs simulation code
 
     void    HideWindow();   // panic button pressed in office mode
     bool    MousePointerIsVisible();
@@ -201,6 +201,14 @@ bool DefconSoundInterface::GetPropertyRange( char *_property, float *_min, float
 }
 
 
+bool DefconSoundInterface::IsMuted()
+{
+    // Hundreds of letters go by in a frame, and their sounds would all play at once
+
+    return g_catchingUp;
+}
+
+
 float DefconSoundInterface::GetPropertyValue( char *_property, SoundObjectId _id )
 {    
     WorldObject *wobj = g_app->m_gameRunning ? 
@@ -20,6 +20,8 @@ public:
     bool    ListProperties          ( LList<char *> *_list );
     bool    GetPropertyRange        ( char *_property, float *_min, float *_max );
     float   GetPropertyValue        ( char *_property, SoundObjectId _id );    
+
+    bool    IsMuted                 ();                 // While catching up with the Server
 };
 
 
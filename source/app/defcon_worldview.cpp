@@ -0,0 +1,127 @@
+#include "lib/universal_include.h"
+
+#include "lib/eclipse/eclipse.h"
+
+#include "app/defcon_worldview.h"
+#include "app/app.h"
+#include "app/globals.h"
+
+#include "interface/interface.h"
+#include "interface/alliances_window.h"
+#include "interface/worldstatus_window.h"
+
+#include "renderer/map_renderer.h"
+#include "renderer/animated_icon.h"
+
+
+int DefconWorldView::GetCurrentSelectionId()
+{
+    return g_app->GetMapRenderer()->GetCurrentSelectionId();
+}
+
+
+int DefconWorldView::GetCurrentHighlightId()
+{
+    return g_app->GetMapRenderer()->GetCurrentHighlightId();
+}
+
+
+void DefconWorldView::SetCurrentSelectionId( int _id )
+{
+    g_app->GetMapRenderer()->SetCurrentSelectionId( _id );
+}
+
+
+float DefconWorldView::GetZoomFactor()
+{
+    return g_app->GetMapRenderer()->GetZoomFactor();
+}
+
+
+float DefconWorldView::GetMouseIdleTime()
+{
+    return g_app->GetMapRenderer()->m_mouseIdleTime;
+}
+
+
+char *DefconWorldView::GetImageFile( int _objectType )
+{
+    return g_app->GetMapRenderer()->m_imageFiles[_objectType];
+}
+
+
+void DefconWorldView::CreateActionMarker( int _objectId, Fixed const &_longitude, Fixed const &_latitude )
+{
+    g_app->GetMapRenderer()->CreateAnimation( MapRenderer::AnimationTypeActionMarker, _objectId,
+                                              _longitude.DoubleValue(), _latitude.DoubleValue() );
+}
+
+
+void DefconWorldView::CreateNukePointer( int _objectId, Fixed const &_longitude, Fixed const &_latitude, int _targetId )
+{
+    MapRenderer *mapRenderer = g_app->GetMapRenderer();
+    int id = mapRenderer->CreateAnimation( MapRenderer::AnimationTypeNukePointer, _objectId,
+                                           _longitude.DoubleValue(), _latitude.DoubleValue() );
+    if( mapRenderer->m_animations.ValidIndex( id ) )
+    {
+        NukePointer *pointer = (NukePointer *)mapRenderer->m_animations[id];
+        if( pointer->m_animationType == MapRenderer::AnimationTypeNukePointer )
+        {
+            pointer->m_targetId = _targetId;
+            pointer->Merge();
+        }
+    }
+}
+
+
+void DefconWorldView::ToggleRenderEverything()
+{
+    g_app->GetMapRenderer()->m_renderEverything = !g_app->GetMapRenderer()->m_renderEverything;
+}
+
+
+void DefconWorldView::ShowMessage( Fixed _longitude, Fixed _latitude, int _teamId, char *_msg, bool _showLarge )
+{
+    g_app->GetInterface()->ShowMessage( _longitude, _latitude, _teamId, _msg, _showLarge );
+}
+
+
+bool DefconWorldView::UsingChatWindow()
+{
+    return g_app->GetInterface()->UsingChatWindow();
+}
+
+
+void DefconWorldView::ShowVote( int _voteId )
+{
+    if( !EclGetWindow("Alliances") )
+    {
+        EclRegisterWindow( new AlliancesWindow() );
+    }
+
+    VotingWindow *vote = (VotingWindow *) EclGetWindow("Vote");
+    if( !vote || vote->m_voteId != _voteId )
+    {
+        VotingWindow *window = new VotingWindow();
+        window->m_voteId = _voteId;
+        EclRegisterWindow( window );
+    }
+}
+
+
+void DefconWorldView::ClosePlacement()
+{
+    EclRemoveWindow( "Side Panel" );
+    EclRemoveWindow( "Placement" );
+}
+
+
+void DefconWorldView::ShowGameOver()
+{
+    g_app->GetMapRenderer()->m_renderEverything = true;
+
+    if( !EclGetWindow( "Stats" ) )
+    {
+        EclRegisterWindow( new StatsWindow()  );
+    }
+}
@@ -0,0 +1,31 @@
+#ifndef _included_defconworldview_h
+#define _included_defconworldview_h
+
+
+#include "world/world_view_interface.h"
+
+
+class DefconWorldView : public WorldViewInterface
+{
+public:
+    int     GetCurrentSelectionId   ();
+    int     GetCurrentHighlightId   ();
+    void    SetCurrentSelectionId   ( int _id );
+    float   GetZoomFactor           ();
+    float   GetMouseIdleTime        ();
+    char   *GetImageFile            ( int _objectType );
+
+    void    CreateActionMarker      ( int _objectId, Fixed const &_longitude, Fixed const &_latitude );
+    void    CreateNukePointer       ( int _objectId, Fixed const &_longitude, Fixed const &_latitude, int _targetId );
+    void    ToggleRenderEverything  ();
+
+    void    ShowMessage             ( Fixed _longitude, Fixed _latitude, int _teamId, char *_msg, bool _showLarge=false );
+    bool    UsingChatWindow         ();
+    void    ShowVote                ( int _voteId );
+    void    ClosePlacement          ();
+    void    ShowGameOver            ();
+};
+
+
+
+#endif
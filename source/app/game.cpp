@@ -6,11 +6,7 @@
 #include "lib/math/random_number.h"
 #include "lib/sound/soundsystem.h"
 #include "lib/metaserver/authentication.h"
-
-#include "interface/interface.h"
-#include "interface/worldstatus_window.h"
-
-#include "lib/eclipse/eclipse.h"
+#include "lib/tosser/directory.h"
 
 #include "app/app.h"
 #include "app/globals.h"
@@ -18,7 +14,7 @@
 #include "app/tutorial.h"
 #include "app/statusicon.h"
 
-#include "renderer/map_renderer.h"
+#include "network/letter_codec.h"
 
 #include "world/world.h"
 #include "world/fleet.h"
@@ -417,7 +413,7 @@ void Game::Update()
             m_maxGameTime <= (10 * 60) &&
             g_app->GetGame()->GetOptionValue("MaxGameRealTime") >= 10 )
         {
-            g_app->GetInterface()->ShowMessage( 0, 0, -1, LANGUAGEPHRASE("message_ten_minute_warning"), true );
+            g_app->GetWorld()->GetView()->ShowMessage( 0, 0, -1, LANGUAGEPHRASE("message_ten_minute_warning"), true );
             m_gameTimeWarning = true;
 
             if( g_app->m_hidden )
@@ -457,8 +453,7 @@ void Game::Update()
                     m_totalNukes[team->m_teamId] = m_nukeCount[team->m_teamId];
                 }
 
-                EclRemoveWindow( "Side Panel" );
-                EclRemoveWindow( "Placement" );                
+                g_app->GetWorld()->GetView()->ClosePlacement();
             }
         }
         m_lastKnownDefcon = defcon;
@@ -518,7 +513,7 @@ void Game::Update()
 
                     if( m_victoryTimer > 0 )
                     {
-                        g_app->GetInterface()->ShowMessage( 0, 0, -1, LANGUAGEPHRASE("message_victory_timer"), true );
+                        g_app->GetWorld()->GetView()->ShowMessage( 0, 0, -1, LANGUAGEPHRASE("message_victory_timer"), true );
                         g_soundSystem->TriggerEvent( "Interface", "DefconChange" );
 
                         if( g_app->m_hidden )
@@ -571,19 +566,14 @@ void Game::Update()
                     m_winner = 999;
                 }
                 strupr(msg);
-                g_app->GetInterface()->ShowMessage( 0, 0, m_winner, msg, true );
+                g_app->GetWorld()->GetView()->ShowMessage( 0, 0, m_winner, msg, true );
+                g_app->GetWorld()->GetView()->ShowGameOver();
 
-                g_app->GetMapRenderer()->m_renderEverything = true;
                 for( int i = 0; i < g_app->GetWorld()->m_teams.Size(); ++i )
                 {
                     g_app->GetWorld()->m_teams[i]->m_desiredGameSpeed = 0;
                 }
 
-                if( !EclGetWindow( "Stats" ) )
-                {
-                    EclRegisterWindow( new StatsWindow()  );
-                }
-
                 g_soundSystem->StopAllSounds( SoundObjectId(), "StartMusic StartMusic" );
                 g_soundSystem->TriggerEvent( "Interface", "GameOver" );
 
@@ -657,3 +647,77 @@ char* GameOption::TranslateValue( char *_value )
 	}
 	return _value;
 }
+
+
+void Game::SaveSnapshot( Directory *_dir )
+{
+    _dir->CreateData( "recalcTimer", m_recalcTimer );
+    _dir->CreateData( "victoryTimer", m_victoryTimer );
+    _dir->CreateData( "maxGameTime", m_maxGameTime );
+    _dir->CreateData( "gameTimeWarning", m_gameTimeWarning );
+    _dir->CreateData( "lockVictoryTimer", m_lockVictoryTimer );
+    _dir->CreateData( "winner", m_winner );
+    _dir->CreateData( "gameMode", m_gameMode );
+    _dir->CreateData( "lastKnownDefcon", m_lastKnownDefcon );
+
+    LetterCodec::WriteInts( _dir, "score", &m_score[0], m_score.Size() );
+    LetterCodec::WriteInts( _dir, "nukeCount", &m_nukeCount[0], m_nukeCount.Size() );
+    LetterCodec::WriteInts( _dir, "totalNukes", &m_totalNukes[0], m_totalNukes.Size() );
+
+    _dir->CreateData( "pointsPerSurvivor", m_pointsPerSurvivor );
+    _dir->CreateData( "pointsPerDeath", m_pointsPerDeath );
+    _dir->CreateData( "pointsPerKill", m_pointsPerKill );
+    _dir->CreateData( "pointsPerNuke", m_pointsPerNuke );
+    _dir->CreateData( "pointsPerCollatoral", m_pointsPerCollatoral );
+
+    for( int i = 0; i < m_options.Size(); ++i )
+    {
+        GameOption *option = m_options[i];
+
+        Directory *optionDir = new Directory();
+        optionDir->SetName( "option" );
+        optionDir->CreateData( "name", option->m_name );
+        optionDir->CreateData( "currentValue", option->m_currentValue );
+        optionDir->CreateData( "currentString", option->m_currentString );
+        _dir->AddDirectory( optionDir );
+    }
+}
+
+
+void Game::LoadSnapshot( Directory *_dir )
+{
+    m_recalcTimer = _dir->GetDataFixed( "recalcTimer" );
+    m_victoryTimer = _dir->GetDataFixed( "victoryTimer" );
+    m_maxGameTime = _dir->GetDataFixed( "maxGameTime" );
+    m_gameTimeWarning = _dir->GetDataBool( "gameTimeWarning" );
+    m_lockVictoryTimer = _dir->GetDataBool( "lockVictoryTimer" );
+    m_winner = _dir->GetDataInt( "winner" );
+    m_gameMode = _dir->GetDataInt( "gameMode" );
+    m_lastKnownDefcon = _dir->GetDataInt( "lastKnownDefcon" );
+
+    LetterCodec::ReadInts( _dir, "score", &m_score[0], m_score.Size() );
+    LetterCodec::ReadInts( _dir, "nukeCount", &m_nukeCount[0], m_nukeCount.Size() );
+    LetterCodec::ReadInts( _dir, "totalNukes", &m_totalNukes[0], m_totalNukes.Size() );
+
+    m_pointsPerSurvivor = _dir->GetDataInt( "pointsPerSurvivor" );
+    m_pointsPerDeath = _dir->GetDataInt( "pointsPerDeath" );
+    m_pointsPerKill = _dir->GetDataInt( "pointsPerKill" );
+    m_pointsPerNuke = _dir->GetDataInt( "pointsPerNuke" );
+    m_pointsPerCollatoral = _dir->GetDataInt( "pointsPerCollatoral" );
+
+    for( int i = 0; i < _dir->m_subDirectories.Size(); ++i )
+    {
+        if( !_dir->m_subDirectories.ValidIndex(i) ) continue;
+        Directory *optionDir = _dir->m_subDirectories[i];
+        if( strcmp( optionDir->m_name, "option" ) != 0 ) continue;
+
+        GameOption *option = GetOption( optionDir->GetDataString( "name" ) );
+        if( option )
+        {
+            option->m_currentValue = optionDir->GetDataInt( "currentValue" );
+            strncpy( option->m_currentString, optionDir->GetDataString( "currentString" ), sizeof(option->m_currentString) );
+            option->m_currentString[ sizeof(option->m_currentString) - 1 ] = '\x0';
+        }
+    }
+}
+
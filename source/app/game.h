@@ -8,6 +8,7 @@
 
 
 class GameOption;
+class Directory;
 
 #define GAMEMODE_STANDARD      0
 #define GAMEMODE_OFFICEMODE    1
@@ -67,6 +68,9 @@ public:
     bool            IsOptionEditable( int _optionId );
 
     void            ResetGame       ();
+
+    void            SaveSnapshot    ( Directory *_dir );
+    void            LoadSnapshot    ( Directory *_dir );
 };
 
 
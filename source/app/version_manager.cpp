@@ -1,8 +1,12 @@
 #include "lib/universal_include.h"
+
+#include <string.h>
+
 #include "lib/tosser/directory.h"
 #include "lib/metaserver/metaserver_defines.h"
 
 #include "network/network_defines.h"
+#include "network/letter_codec.h"
 
 #include "version_manager.h"
 
@@ -73,6 +77,14 @@ void VersionManager::EnsureCompatability( char *_version, Directory *_letter )
 }
 
 
+bool VersionManager::NeedsCompatability( char *_version )
+{
+    return( !DoesSupportModSystem(_version) ||
+            !DoesSupportWhiteBoard(_version) ||
+            !DoesSupportSendTeamScore(_version) );
+}
+
+
 bool VersionManager::DoesSupportModSystem( char *_version )
 {
     float versionNumber = VersionStringToNumber(_version);
@@ -95,3 +107,17 @@ bool VersionManager::DoesSupportSendTeamScore( char *_version )
 
     return( versionNumber >= 1.51f );
 }
+
+
+int VersionManager::ChooseLetterFormat( int _peerFormat )
+{
+    //
+    // Peers that never told us what they can read only know Directory letters
+
+    if( _peerFormat <= LETTER_FORMAT_DIRECTORY )
+    {
+        return LETTER_FORMAT_DIRECTORY;
+    }
+
+    return( _peerFormat < LETTER_FORMAT_CURRENT ? _peerFormat : LETTER_FORMAT_CURRENT );
+}
@@ -13,9 +13,11 @@ public:
     static bool     DoesSupportModSystem    ( char *_version );
     static bool     DoesSupportWhiteBoard   ( char *_version );
     static bool     DoesSupportSendTeamScore( char *_version );
+    static int      ChooseLetterFormat      ( int _peerFormat );                                    // LETTER_FORMAT to send to a peer that can read _peerFormat
 
 
     static void     EnsureCompatability     ( char *_version, Directory *_letter );                 // for server to client messages
+    static bool     NeedsCompatability      ( char *_version );                                     // false if EnsureCompatability never changes a letter
 };
 
 
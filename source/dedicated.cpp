@@ -0,0 +1,365 @@
+
+/*
+ * ================
+ * DEFCON DEDICATED
+ * ================
+ *
+ * Servers with no client attached : no World, renderer, sound or window.
+ * Each relays letters exactly as a hosting client's Server would, and
+ * sleeps between ticks so that many can share one machine.
+ *
+ * Usage : defcon.dedicated [preferences file]
+ *
+ * Game options come from "Option<Name>" entries in the preferences file,
+ * eg "OptionServerName = Tuesday Night" or "OptionMaxTeams = 4".
+ *
+ * "DedicatedGames = N" hosts N independent games on consecutive ports
+ * from ServerPort, advanced by "DedicatedThreads" worker threads.
+ * Only the first game is advertised on the MetaServer.  A game whose
+ * port is taken is not hosted at all, rather than moved to another port
+ * its players would not know to look for.
+ *
+ * Each game is its own Server, with its own history and client table.
+ * As nothing here runs a World, there is no World per game, and no
+ * earth data, route table or terrain to load, let alone share.
+ *
+ */
+
+#include "lib/universal_include.h"
+
+#include <signal.h>
+
+#include "lib/debug_utils.h"
+#include "lib/hi_res_time.h"
+#include "lib/language_table.h"
+#include "lib/preferences.h"
+#include "lib/filesys/file_system.h"
+#include "lib/math/math_utils.h"
+#include "lib/metaserver/authentication.h"
+#include "lib/metaserver/metaserver.h"
+#include "lib/metaserver/metaserver_defines.h"
+#include "lib/metaserver/matchmaker.h"
+#include "lib/netlib/net_lib.h"
+#include "lib/netlib/net_mutex.h"
+#include "lib/netlib/net_thread.h"
+#include "lib/tosser/darray.h"
+#include "lib/tosser/directory.h"
+
+#include "app/globals.h"
+
+#include "network/Server.h"
+#include "network/network_defines.h"
+#include "network/letter_codec.h"
+
+
+#define PREFS_DEDICATED_AUTHKEY         "DedicatedAuthKeyFile"
+#define PREFS_DEDICATED_IDLERESTART     "DedicatedIdleRestart"      // Seconds a finished game waits for rejoins
+#define PREFS_DEDICATED_GAMES           "DedicatedGames"
+#define PREFS_DEDICATED_THREADS         "DedicatedThreads"
+
+
+class DedicatedGame
+{
+public:
+    int         m_port;
+    bool        m_advertise;
+    Server      *m_server;
+    double      m_nextAdvanceTime;
+    double      m_lastClientTime;
+    bool        m_busy;                             // A worker is advancing this game
+
+    DedicatedGame( int _port, bool _advertise )
+    :   m_port(_port),
+        m_advertise(_advertise),
+        m_server(NULL),
+        m_nextAdvanceTime(0.0),
+        m_lastClientTime(0.0),
+        m_busy(false)
+    {
+    }
+};
+
+
+static volatile bool s_quit = false;
+
+static DArray<DedicatedGame *>  s_games;
+static NetMutex                 s_gamesMutex;       // Guards m_busy and m_nextAdvanceTime
+static int                      s_numWorkers = 0;
+
+
+static void HandleQuitSignal( int _signal )
+{
+    s_quit = true;
+}
+
+
+static void InitMetaServer()
+{
+    char authKey[256];
+    Authentication_LoadKey( authKey, g_preferences->GetString( PREFS_DEDICATED_AUTHKEY, "authkey" ) );
+    Authentication_SetKey( authKey );
+
+    if( Authentication_SimpleKeyCheck( authKey ) < 0 )
+    {
+        AppDebugOut( "DEDICATED : Auth key is not valid, the server will not be advertised\n" );
+    }
+    Authentication_RequestStatus( authKey );
+
+    //
+    // The MatchMaker identifies us with the client properties,
+    // which a hosting client would have set from ClientToServer::Advance
+
+    Directory clientProperties;
+    clientProperties.CreateData( NET_METASERVER_AUTHKEY, authKey );
+    clientProperties.CreateData( NET_METASERVER_GAMENAME, APP_NAME );
+    clientProperties.CreateData( NET_METASERVER_GAMEVERSION, APP_VERSION );
+
+    char *metaServerLocation = "metaserver.introversion.co.uk";
+    int port = g_preferences->GetInt( PREFS_NETWORKMETASERVER );
+
+    MetaServer_Initialise();
+    MetaServer_SetClientProperties( &clientProperties );
+    MetaServer_Connect( metaServerLocation, PORT_METASERVER_LISTEN, port );
+    MatchMaker_LocateService( metaServerLocation, PORT_METASERVER_LISTEN );
+}
+
+
+static bool StartServer( DedicatedGame *_game )
+{
+    _game->m_server = new Server();
+    _game->m_server->m_advertise = _game->m_advertise;
+
+    if( !_game->m_server->Initialise( _game->m_port ) )
+    {
+        delete _game->m_server;
+        _game->m_server = NULL;
+        return false;
+    }
+
+    _game->m_nextAdvanceTime = GetHighResTime();
+    _game->m_lastClientTime = GetHighResTime();
+    return true;
+}
+
+
+static void StopServer( DedicatedGame *_game )
+{
+    if( _game->m_server )
+    {
+        _game->m_server->Shutdown();
+        delete _game->m_server;
+        _game->m_server = NULL;
+    }
+}
+
+
+static void AdvanceServer( DedicatedGame *_game )
+{
+    Server *server = _game->m_server;
+    double timeNow = GetHighResTime();
+
+
+    //
+    // Same schedule as DefconMain : slower in the lobby,
+    // and no attempt to catch up after a stall
+
+    server->Advance();
+
+    double timeToAdd = SERVER_ADVANCE_PERIOD.DoubleValue();
+    if( !server->IsGameRunning() ) timeToAdd *= 5.0;
+    double nextAdvanceTime = _game->m_nextAdvanceTime + timeToAdd;
+    if( timeNow > nextAdvanceTime )
+    {
+        nextAdvanceTime = timeNow + timeToAdd;
+    }
+
+
+    //
+    // Once a game has started and everyone has gone,
+    // start again with an empty server
+
+    double idleRestart = g_preferences->GetInt( PREFS_DEDICATED_IDLERESTART, 60 );
+
+    if( server->m_clients.NumUsed() > 0 )
+    {
+        _game->m_lastClientTime = timeNow;
+    }
+    else if( server->IsGameRunning() &&
+             timeNow > _game->m_lastClientTime + idleRestart )
+    {
+        AppDebugOut( "DEDICATED : Game on port %d abandoned, restarting\n", _game->m_port );
+        StopServer( _game );
+        if( !StartServer( _game ) )
+        {
+            AppDebugOut( "DEDICATED : ERROR : Failed to restart game on port %d, it will no longer be hosted\n", _game->m_port );
+        }
+        return;
+    }
+
+    s_gamesMutex.Lock();
+    _game->m_nextAdvanceTime = nextAdvanceTime;
+    s_gamesMutex.Unlock();
+}
+
+
+static NetCallBackRetType WorkerThread( void *ignored )
+{
+    while( !s_quit )
+    {
+        //
+        // Take the game that is furthest behind, unless another worker has it.
+        // Each game is only ever advanced by one worker at a time, so a Server
+        // never sees more threads than it does inside a hosting client.
+
+        s_gamesMutex.Lock();
+
+        DedicatedGame *next = NULL;
+        for( int i = 0; i < s_games.Size(); ++i )
+        {
+            if( s_games.ValidIndex(i) )
+            {
+                DedicatedGame *game = s_games[i];
+                if( !game->m_busy && game->m_server &&
+                    ( !next || game->m_nextAdvanceTime < next->m_nextAdvanceTime ) )
+                {
+                    next = game;
+                }
+            }
+        }
+
+        double timeNow = GetHighResTime();
+        bool due = ( next && next->m_nextAdvanceTime <= timeNow );
+        if( due ) next->m_busy = true;
+
+        s_gamesMutex.Unlock();
+
+
+        //
+        // Otherwise sleep until the next tick, rounded up to the millisecond.
+        // Incoming letters queue up on the listener threads meanwhile.
+
+        if( !due )
+        {
+            int sleepMs = 100;
+            if( next ) sleepMs = min( sleepMs, int( (next->m_nextAdvanceTime - timeNow) * 1000.0 ) + 1 );
+            NetSleep( sleepMs );
+            continue;
+        }
+
+        AdvanceServer( next );
+
+        s_gamesMutex.Lock();
+        next->m_busy = false;
+        s_gamesMutex.Unlock();
+    }
+
+    s_gamesMutex.Lock();
+    --s_numWorkers;
+    s_gamesMutex.Unlock();
+
+    return 0;
+}
+
+
+int main( int argc, char *argv[] )
+{
+    if( argc > 1 && strncmp( argv[1], "-v", 2 ) == 0 )
+    {
+        puts( APP_VERSION );
+        return 0;
+    }
+
+    AppDebugOut( "Defcon dedicated server %s built %s\n", APP_VERSION, __DATE__ );
+
+    InitialiseHighResTime();
+    LetterCodec::Initialise();
+
+    g_fileSystem = new FileSystem();
+    g_fileSystem->ParseArchive( "main.dat" );
+
+    // After the archive, since unrar installs handlers of its own
+    signal( SIGINT, HandleQuitSignal );
+    signal( SIGTERM, HandleQuitSignal );
+
+    g_preferences = new Preferences();
+    g_preferences->Load( "data/prefs_default.txt" );
+    g_preferences->Load( argc > 1 ? argv[1] : "dedicated.txt" );
+
+    g_languageTable = new LanguageTable();
+    g_languageTable->Initialise();
+    g_languageTable->LoadCurrentLanguage();
+
+    InitMetaServer();
+
+
+    //
+    // Start every game, then hand them to the workers
+
+    int numGames = max( 1, g_preferences->GetInt( PREFS_DEDICATED_GAMES, 1 ) );
+    int numThreads = g_preferences->GetInt( PREFS_DEDICATED_THREADS, min( numGames, 4 ) );
+    numThreads = max( 1, min( numThreads, numGames ) );
+    int basePort = g_preferences->GetInt( PREFS_NETWORKSERVERPORT );
+    int numStarted = 0;
+
+    for( int i = 0; i < numGames; ++i )
+    {
+        DedicatedGame *game = new DedicatedGame( basePort + i, i == 0 );
+        s_games.PutData( game );
+
+        if( StartServer( game ) )
+        {
+            ++numStarted;
+        }
+        else
+        {
+            AppDebugOut( "DEDICATED : ERROR : Failed to start game on port %d, it will not be hosted\n", game->m_port );
+        }
+    }
+
+    if( numStarted == 0 )
+    {
+        AppDebugOut( "DEDICATED : ERROR : No games could be started\n" );
+        s_quit = true;
+    }
+
+    AppDebugOut( "DEDICATED : Running %d of %d games on %d threads\n", numStarted, numGames, numThreads );
+
+    for( int i = 0; i < numThreads && !s_quit; ++i )
+    {
+        s_gamesMutex.Lock();
+        ++s_numWorkers;
+        s_gamesMutex.Unlock();
+
+        NetStartThread( WorkerThread );
+    }
+
+    while( !s_quit )
+    {
+        NetSleep( 100 );
+    }
+
+
+    //
+    // Let the workers finish their current Advance before shutting down
+
+    while( true )
+    {
+        s_gamesMutex.Lock();
+        int numWorkers = s_numWorkers;
+        s_gamesMutex.Unlock();
+
+        if( numWorkers == 0 ) break;
+        NetSleep( 10 );
+    }
+
+    for( int i = 0; i < s_games.Size(); ++i )
+    {
+        if( s_games.ValidIndex(i) )
+        {
+            StopServer( s_games[i] );
+        }
+    }
+    s_games.EmptyAndDelete();
+
+    return 0;
+}
@@ -11,8 +11,6 @@
 
 #include "lib/universal_include.h"
 
-#include <unrar/rarbloat.h>
-#include <unrar/sha1.h>
 #include <float.h>
 #include <time.h>
 
@@ -39,10 +37,13 @@
 #include "network/ClientToServer.h"
 #include "network/Server.h"
 #include "network/network_defines.h"
+#include "network/letter_codec.h"
+#include "network/snapshot_parts.h"
 
 #include "world/world.h"
 #include "world/team.h"
 #include "world/fleet.h"
+#include "world/world_snapshot.h"
 
 #include "interface/components/message_dialog.h"
 #include "interface/lobby_window.h"
@@ -63,6 +64,13 @@ float    g_advanceTime = 0.0f;
 double   g_lastServerAdvance = 0.0f;
 float    g_predictionTime = 0.0f;
 int      g_lastProcessedSequenceId = -2;                         // -2=not yet ready to begin. -1=ready for first update (id=0)
+bool     g_catchingUp = false;
+
+
+#define CATCHUP_BACKLOG         10                              // Letters behind the Server before we catch up
+#define CATCHUP_FARBEHIND       50                              // Letters behind before we stop rendering
+#define CATCHUP_TIMEBUDGET      0.05                            // Seconds spent processing letters each time round
+#define CATCHUP_RENDERPERIOD    0.25f                           // Seconds between frames while catching up
 
 
 void UpdateAdvanceTime()
@@ -81,6 +89,15 @@ void UpdateAdvanceTime()
 
 bool TimeToRender(float _lastRenderTime)
 {
+    //
+    // If we are catching up with the Server, render
+    // just often enough to show how it's going
+
+    if( g_catchingUp )
+    {
+        return( GetHighResTime() - _lastRenderTime > CATCHUP_RENDERPERIOD );
+    }
+
 #ifndef TESTBED
     if( !g_app->GetClientToServer() ||
         !g_app->GetClientToServer()->m_synchronising  )
@@ -285,6 +302,52 @@ void RestartTestBed( int result, char *notes )
     }
 }
 
+// The Server sent us a snapshot of the game instead of its whole history,
+// so start from that and carry on with the letter after it
+
+void StartFromSnapshot( SnapshotParts *_snapshot )
+{
+    int seqId = _snapshot->m_seqId;
+    int length = 0;
+    char *data = _snapshot->Join( length );
+
+    g_startTime = FLT_MAX;
+    g_gameTime = 0.0f;
+    g_advanceTime = 0.0f;
+    g_lastServerAdvance = 0.0f;
+    g_predictionTime = 0.0f;
+    g_app->m_gameStartTimer = -1.0f;
+
+    delete g_app->m_world;
+    g_app->m_world = NULL;
+    g_app->InitWorld();
+
+    bool loaded = WorldSnapshot::Load( data, length, seqId );
+    delete [] data;
+
+    if( !loaded )
+    {
+        AppDebugOut( "CLIENT : Failed to load snapshot %d, resynchronising from the whole history\n", seqId );
+
+        delete g_app->m_world;
+        g_app->m_world = NULL;
+        g_app->InitWorld();
+
+        g_app->GetClientToServer()->Resynchronise();
+        g_app->GetClientToServer()->m_snapshotRefused = true;
+        return;
+    }
+
+    AppDebugOut( "CLIENT : Loaded snapshot %d\n", seqId );
+
+    g_lastProcessedSequenceId = seqId;
+    g_app->GetClientToServer()->ResumeFromSnapshot( seqId );
+
+    g_app->OpenGameInterface();
+    g_app->m_gameRunning = true;
+}
+
+
 bool ProcessServerLetters( Directory *letter )
 {
     if( strcmp( letter->m_name, NET_DEFCON_MESSAGE ) != 0 ||
@@ -356,6 +419,11 @@ bool ProcessServerLetters( Directory *letter )
             AppDebugOut( "CLIENT : Server version is %s\n", serverVersion );
         }
 
+        if( letter->HasData( NET_DEFCON_LETTERFORMAT, DIRECTORY_TYPE_INT ) )
+        {
+            g_app->GetClientToServer()->m_serverLetterFormat = letter->GetDataInt( NET_DEFCON_LETTERFORMAT );
+        }
+
         if( !VersionManager::DoesSupportModSystem( g_app->GetClientToServer()->m_serverVersion ) )
         {
             // This server is too old to support Mods, so make sure we de-activate any critical ones
@@ -408,6 +476,26 @@ bool ProcessServerLetters( Directory *letter )
 
         return true;
     }
+    else if( strcmp( cmd, NET_DEFCON_SYNCHASHREQUEST ) == 0 )
+    {
+        g_app->GetClientToServer()->SendSyncHash( letter );
+        return true;
+    }
+    else if( strcmp( cmd, NET_DEFCON_SYNCHASHRESULT ) == 0 )
+    {
+        int clientId = letter->GetDataInt(NET_DEFCON_CLIENTID);
+        int seqId = letter->GetDataInt(NET_DEFCON_SYNCHASHSEQID);
+
+        int path[WORLDHASH_MAXDEPTH];
+        int depth = LetterCodec::ReadInts( letter, NET_DEFCON_SYNCHASHPATH, path, WORLDHASH_MAXDEPTH );
+
+        char pathName[256];
+        LetterCodec::GetHashPathName( path, depth, pathName );
+
+        AppDebugOut( "SYNCERROR Server found that Client %d went out of Sync at letter %d, in %s\n", clientId, seqId, pathName );
+        SyncRandLog( "Out of Sync at %d in %s", seqId, pathName );
+        return true;
+    }
     else if( strcmp( cmd, NET_DEFCON_NETSYNCFIXED ) == 0 )
     {
         int clientId = letter->GetDataInt(NET_DEFCON_CLIENTID);        
@@ -452,6 +540,8 @@ bool ProcessServerLetters( Directory *letter )
 					                                    reasonLanguagePhrase = "dialog_disconnect_kicked_from_game";     break;
                 case Disconnect_DemoFull:               reason = "Too many Demo Players already";
 					                                    reasonLanguagePhrase = "dialog_disconnect_demo_full";            break;
+                case Disconnect_NumericsMismatch:       reason = "The server uses different numerics";
+					                                    reasonLanguagePhrase = "dialog_disconnect_numerics_mismatch";    break;
 				default:                                reason = "Unknown";
 					                                    reasonLanguagePhrase = "dialog_disconnect_unknown";              break;
             }
@@ -510,6 +600,26 @@ bool ProcessServerLetters( Directory *letter )
         }
         return true;            
     }
+    else if( strcmp( cmd, NET_DEFCON_SNAPSHOTREQUEST ) == 0 )
+    {
+        g_app->GetClientToServer()->RequestSnapshot( letter->GetDataInt( NET_DEFCON_SNAPSHOTSEQID ) );
+        return true;
+    }
+    else if( strcmp( cmd, NET_DEFCON_SNAPSHOT ) == 0 )
+    {
+        // Only while we're waiting for the first letter of the history
+
+        if( g_lastProcessedSequenceId == -1 && !g_app->m_gameRunning )
+        {
+            SnapshotParts *snapshot = g_app->GetClientToServer()->ReceiveSnapshotPart( letter );
+            if( snapshot )
+            {
+                StartFromSnapshot( snapshot );
+                snapshot->Release();
+            }
+        }
+        return true;
+    }
     else if( strcmp( cmd, NET_DEFCON_SETMODPATH ) == 0 )
     {
         char *modPath = letter->GetDataString( NET_DEFCON_SETMODPATH );
@@ -564,112 +674,20 @@ bool ProcessServerLetters( Directory *letter )
     }
 }
 
-inline
-void Hash( hash_context &c, unsigned i )
-{
-       unsigned char syncBuffer[4] = {
-               i & 0xFF,
-               (i >> 8) & 0xFF,
-               (i >> 16) & 0xFF,
-               (i >> 24) & 0xFF
-       };
-
-       hash_process( &c, (unsigned char *)syncBuffer, 4 );
-}
-
-inline
-void Hash( hash_context &c, int i )
-{
-       Hash( c, (unsigned) i );
-}
-
-inline 
-void Hash( hash_context &c, float f )
-{
-	union 
-	{
-		float floatPart;
-		unsigned intPart;
-	} value;
-
-	value.floatPart = f;	
-	Hash( c, value.intPart );
-}
-
-inline
-void Hash( hash_context &c, double d )
-{
-	union
-	{
-		double doublePart;
-		unsigned long long intPart;
-	} value;
-	
-	value.doublePart = d;
-	const unsigned long long i = value.intPart;
-	
-	unsigned char syncBuffer[8] = {
-		i & 0xFF,
-		(i >> 8) & 0xFF,
-		(i >> 16) & 0xFF,
-		(i >> 24) & 0xFF,
-		(i >> 32) & 0xFF,
-		(i >> 40) & 0xFF,
-		(i >> 48) & 0xFF,
-		(i >> 56) & 0xFF,
-	};
-	
-	hash_process( &c, (unsigned char *)syncBuffer, 8 );
-}
-
-inline
-void Hash( hash_context &c, const Fixed &f )
-{
-       Hash(c, f.DoubleValue() );
-}
-
 unsigned char GenerateSyncValue()
 {
     START_PROFILE( "GenerateSyncValue" );
 
     //
-    // Generate a number between 0 and 255 that represents every unit in game
-    // So if a single one is different, we will know immediately
-    
-    unsigned char result = 0;
-
-
-    //
-    // Objects
+    // Boil every team, fleet and unit down to a number between 0 and 255
+    // So if a single one is different, we will know immediately.
+    // The whole tree is kept, so the Server can find out which one it was
 
-    hash_context c;
-    hash_initial(&c);
+    Fixed random = syncfrand(255);
+    unsigned int hash = g_app->GetWorld()->m_hash.Generate( g_app->GetWorld(), g_lastProcessedSequenceId, random );
 
-#ifdef TRACK_SYNC_RAND
-    for( int i = 0; i < g_app->GetWorld()->m_objects.Size(); ++i )
-    {
-        if( g_app->GetWorld()->m_objects.ValidIndex(i) )
-        {
-            WorldObject *obj = g_app->GetWorld()->m_objects[i];
-			
-			Hash( c, obj->m_longitude );
-			Hash( c, obj->m_latitude ); 
-			Hash( c, obj->m_vel.x ); 
-			Hash( c, obj->m_vel.y ); 
-			Hash( c, obj->m_currentState );
-        }
-    }
-#endif
+    unsigned char result = (unsigned char) ( hash & 0xFF );
 
-    //
-    // Random value
-    
-	Hash( c, syncfrand(255) );
-	
-	uint32 hashResult[5];
-	hash_final(&c, hashResult);
-	result = hashResult[0] & 0xFF;
-		
     END_PROFILE( "GenerateSyncValue" );
 
     return result;
@@ -736,6 +754,105 @@ void HandleGameStart()
     }
 }
 
+// Processes the next letter from the Server, if it is here yet
+
+bool ProcessNextServerLetter()
+{
+    Directory *letter = g_app->GetClientToServer()->GetNextLetter();
+    if( !letter ) return false;
+
+    if( !strcmp(letter->m_name, NET_DEFCON_MESSAGE) == 0 ||
+        !letter->HasData(NET_DEFCON_SEQID, DIRECTORY_TYPE_INT) )
+    {
+        AppDebugOut( "Client received bogus message, discarded (5)\n" );
+        delete letter;
+        return true;
+    }
+
+    int seqId = letter->GetDataInt( NET_DEFCON_SEQID );                
+    if( seqId == -1 )
+    {
+        // This letter is just for us
+        ProcessServerLetters( letter );
+        delete letter;
+        return true;
+    }
+
+    AppReleaseAssert( seqId == g_lastProcessedSequenceId + 1, "Networking broken!" );
+
+    bool handled = ProcessServerLetters(letter);
+    if(!handled)
+    {
+        g_app->GetClientToServer()->ProcessServerUpdates( letter );
+    }
+
+    if( g_app->m_gameRunning )
+    {
+        g_app->GetWorld()->Update();
+    }
+    else
+    {
+        HandleGameStart();
+    }
+
+    g_lastServerAdvance = (float)seqId * SERVER_ADVANCE_PERIOD.DoubleValue() + g_startTime;
+    g_lastProcessedSequenceId = seqId;       
+
+    delete letter;            
+           
+    if( seqId == 0 && g_app->GetClientToServer()->m_resynchronising > 0.0f )
+    {
+        AppDebugOut( "Client successfully began Resynchronising\n" );
+        g_app->GetClientToServer()->m_resynchronising = -1.0f;
+    }
+
+    unsigned char sync = GenerateSyncValue();
+    SyncRandLog( "Sync %d = %d", g_lastProcessedSequenceId, sync );
+    g_app->GetClientToServer()->SendSyncronisation( g_lastProcessedSequenceId, sync );
+    g_app->GetClientToServer()->UploadSnapshot( g_lastProcessedSequenceId );
+
+    return true;
+}
+
+
+// Normally we process one letter each time round the main loop.  After a stall,
+// a rejoin or a resync we can be far behind the Server, so we process as many as
+// fit in a time budget instead, and render and play sounds only when caught up
+
+void CatchUpWithServer()
+{
+    int backlog = 0;
+    if( g_lastProcessedSequenceId >= -1 )
+    {
+        backlog = g_app->GetClientToServer()->GetEstimatedServerSeqId() - g_lastProcessedSequenceId;
+    }
+
+    if( backlog > CATCHUP_FARBEHIND )
+    {
+        if( !g_catchingUp ) AppDebugOut( "CLIENT : %d letters behind the Server, catching up\n", backlog );
+        g_catchingUp = true;
+    }
+    else if( backlog <= CATCHUP_BACKLOG && g_catchingUp )
+    {
+        AppDebugOut( "CLIENT : Caught up with the Server\n" );
+        g_catchingUp = false;
+    }
+
+    if( backlog <= CATCHUP_BACKLOG )
+    {
+        ProcessNextServerLetter();
+        return;
+    }
+
+    double budgetEnds = GetHighResTime() + CATCHUP_TIMEBUDGET;
+
+    while( ProcessNextServerLetter() )
+    {
+        if( GetHighResTime() > budgetEnds ) break;
+    }
+}
+
+
 void DefconMain()
 {
     g_app = new App();
@@ -847,62 +964,9 @@ void DefconMain()
 
 
             //
-            // Read latest update from Server
-            Directory *letter = g_app->GetClientToServer()->GetNextLetter();
+            // Read the latest updates from the Server
 
-            if( letter )
-            {
-                if( !strcmp(letter->m_name, NET_DEFCON_MESSAGE) == 0 ||
-                    !letter->HasData(NET_DEFCON_SEQID, DIRECTORY_TYPE_INT) )
-                {
-                    AppDebugOut( "Client received bogus message, discarded (5)\n" );
-                    delete letter;
-                }
-                else
-                {
-                    int seqId = letter->GetDataInt( NET_DEFCON_SEQID );                
-                    if( seqId == -1 )
-                    {
-                        // This letter is just for us
-                        ProcessServerLetters( letter );
-                        delete letter;
-                    }
-                    else
-                    {
-                        AppReleaseAssert( seqId == g_lastProcessedSequenceId + 1, "Networking broken!" );
-
-                        bool handled = ProcessServerLetters(letter);
-                        if(!handled)
-                        {
-                            g_app->GetClientToServer()->ProcessServerUpdates( letter );
-                        }
-                
-                        if( g_app->m_gameRunning )
-                        {
-                            g_app->GetWorld()->Update();
-                        }
-                        else
-                        {
-                            HandleGameStart();
-                        }
-
-                        g_lastServerAdvance = (float)seqId * SERVER_ADVANCE_PERIOD.DoubleValue() + g_startTime;
-                        g_lastProcessedSequenceId = seqId;       
-
-                        delete letter;            
-                               
-                        if( seqId == 0 && g_app->GetClientToServer()->m_resynchronising > 0.0f )
-                        {
-                            AppDebugOut( "Client successfully began Resynchronising\n" );
-                            g_app->GetClientToServer()->m_resynchronising = -1.0f;
-                        }
-
-                        unsigned char sync = GenerateSyncValue();
-                        SyncRandLog( "Sync %d = %d", g_lastProcessedSequenceId, sync );
-                        g_app->GetClientToServer()->SendSyncronisation( g_lastProcessedSequenceId, sync );
-                    }
-                }
-            }
+            CatchUpWithServer();
 
             END_PROFILE("Client Main Loop");
         }
@@ -917,7 +981,7 @@ void DefconMain()
             lastRenderTime = GetHighResTime();
             g_app->Update();
             g_app->Render();
-            g_soundSystem->Advance();
+            if( !g_catchingUp ) g_soundSystem->Advance();
             if( g_profiler ) g_profiler->Advance();
         }
     }
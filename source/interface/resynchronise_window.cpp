@@ -5,14 +5,17 @@
 #include "lib/language_table.h"
 #include "lib/sound/soundsystem.h"
 #include "lib/gucci/window_manager.h"
+#include "lib/math/math_utils.h"
 
 #include "app/app.h"
 #include "app/globals.h"
 #include "lib/multiline_text.h"
 
+#include "network/ClientToServer.h"
+#include "network/snapshot_parts.h"
+
 #include "world/world.h"
 
-#include "connecting_window.h"
 #include "resynchronise_window.h"
 
 
@@ -36,10 +39,6 @@ class ResynchronisedButton : public InterfaceButton
         g_app->GetClientToServer()->Resynchronise();
 
         g_soundSystem->StopAllSounds( SoundObjectId(), "StartMusic StartMusic" );
-
-        ConnectingWindow *connectWindow = new ConnectingWindow();
-        connectWindow->m_popupLobbyAtEnd = false;
-        EclRegisterWindow( connectWindow );
     }
 };
 
@@ -47,9 +46,10 @@ class ResynchronisedButton : public InterfaceButton
 
 ResynchroniseWindow::ResynchroniseWindow()
 :   InterfaceWindow("Resynchronise", "dialog_resync_title", true ),
-    m_debugVersion(false)
+    m_debugVersion(false),
+    m_maxBacklog(0)
 {
-    SetSize( 300, 200 );
+    SetSize( 300, 260 );
     SetPosition( g_windowManager->WindowW()/2 - m_w/2,
                  g_windowManager->WindowH()/2 - m_h/2 );
     
@@ -64,7 +64,7 @@ void ResynchroniseWindow::Create()
     }
 
     InvertedBox *box = new InvertedBox();
-    box->SetProperties( "invert", 10, 30, m_w-20, m_h - 70, " ", " ", false, false );
+    box->SetProperties( "invert", 10, 30, m_w-20, m_h - 120, " ", " ", false, false );
     RegisterButton(box);
 
     ResynchronisedButton *resync = new ResynchronisedButton();
@@ -109,6 +109,58 @@ void ResynchroniseWindow::Render( bool _hasFocus )
     }
 
 	 g_renderer->SetFont();
+
+    RenderProgress();
+}
+
+
+void ResynchroniseWindow::RenderProgress()
+{
+    ClientToServer *client = g_app->GetClientToServer();
+
+    char *caption = NULL;
+    float fraction = 0.0f;
+
+    if( client->m_resynchronising > 0.0f )
+    {
+        SnapshotParts *snapshot = client->m_snapshotDownload;
+        if( snapshot && snapshot->m_numParts > 0 )
+        {
+            caption = LANGUAGEPHRASE("dialog_state_receiving_snapshot");
+            fraction = snapshot->GetNumReceived() / (float) snapshot->m_numParts;
+        }
+        else
+        {
+            caption = LANGUAGEPHRASE("dialog_state_requesting");
+        }
+    }
+    else if( g_catchingUp )
+    {
+        int backlog = client->GetEstimatedServerSeqId() - g_lastProcessedSequenceId;
+        m_maxBacklog = max( m_maxBacklog, backlog );
+
+        caption = LANGUAGEPHRASE("dialog_state_catching_up");
+        fraction = 1.0f - backlog / (float) m_maxBacklog;
+    }
+    else
+    {
+        m_maxBacklog = 0;
+        return;
+    }
+
+    Clamp( fraction, 0.0f, 1.0f );
+    Colour col( (1-fraction)*255, fraction*255, 0, 255 );
+
+    float yPos = m_y + m_h - 80;
+
+    g_renderer->SetFont( "kremlin" );
+    g_renderer->TextCentreSimple( m_x+m_w/2, yPos, col, 16, caption );
+    g_renderer->SetFont();
+
+    yPos += 20;
+
+    g_renderer->RectFill( m_x+30, yPos, (m_w-60)*fraction, 15, col );
+    g_renderer->Rect( m_x+30, yPos, (m_w-60), 15, White );
 }
 
 
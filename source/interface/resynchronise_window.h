@@ -9,6 +9,11 @@ class ResynchroniseWindow : public InterfaceWindow
 public:
     bool m_debugVersion;
 
+protected:
+    int  m_maxBacklog;
+
+    void RenderProgress();
+
 public:
     ResynchroniseWindow();
 
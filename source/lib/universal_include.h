@@ -177,6 +177,10 @@
     #define FLOAT_NUMERICS
 #endif
 
+#ifdef DEDICATED_SERVER
+    #undef PROFILER_ENABLED                 // The profiler syncs with OpenGL
+#endif
+
 //#define TRACK_MEMORY_LEAKS
 
 #include <stdio.h>
@@ -3,7 +3,7 @@
 #include "lib/netlib/net_lib.h"
 #include "lib/netlib/net_udp_packet.h"
 #include "lib/netlib/net_socket_listener.h"
-#include "lib/netlib/net_mutex.h"
+#include "lib/netlib/net_queue.h"
 #include "lib/netlib/net_thread.h"
 #include "lib/netlib/net_socket.h"
 #include "lib/metaserver/matchmaker.h"
@@ -25,8 +25,12 @@
 #include "network/Server.h"
 #include "network/ClientToServer.h"
 #include "network/network_defines.h"
+#include "network/letter_codec.h"
+#include "network/snapshot_parts.h"
 
 #include "world/world.h"
+#include "world/world_hash.h"
+#include "world/world_snapshot.h"
 
 
 // ***ListenCallback
@@ -43,7 +47,7 @@ static NetCallBackRetType ListenCallback(NetUdpPacket *udpdata)
 		IpAddressToStr( fromAddr, newip );
 
         Directory *letter = new Directory();
-        bool success = letter->Read(udpdata->m_data, udpdata->m_length);
+        bool success = LetterCodec::Read( letter, udpdata->m_data, udpdata->m_length );
 
         if( success )
         {
@@ -57,8 +61,6 @@ static NetCallBackRetType ListenCallback(NetUdpPacket *udpdata)
 
         s_bytesReceived += udpdata->m_length;
         s_bytesReceived += UDP_HEADER_SIZE;
-
-        delete udpdata;
     }
 
     float timeNow = GetHighResTime();
@@ -94,17 +96,27 @@ ClientToServer::ClientToServer()
     m_resynchronising(-1.0f),
     m_synchronising(false),
     m_connectionAttempts(0),
-    m_listener(NULL)
+    m_listener(NULL),
+    m_sendBuffer(NULL),
+    m_sendBufferSize(0),
+    m_snapshotRequestSeqId(-1),
+    m_snapshotUpload(NULL),
+    m_snapshotUploadPart(0),
+    m_snapshotUploadPasses(0),
+    m_snapshotUploadTimer(0.0f),
+    m_snapshotDownload(NULL),
+    m_snapshotRefused(false),
+    m_fromSnapshot(false)
 {
     m_lastValidSequenceIdFromServer = -1;
     m_serverSequenceId = -1;
     m_connectionState = StateDisconnected;
 
-    m_inboxMutex = new NetMutex();
-    m_outboxMutex = new NetMutex();
+    m_received = new NetQueue<ReceivedLetter>( CLIENT_RECEIVEDSIZE );
 
     m_password[0] = '\x0';
     strcpy( m_serverVersion, "1.0" );
+    m_serverLetterFormat = LETTER_FORMAT_DIRECTORY;
 
     m_netLib = new NetLib();
     m_netLib->Initialise ();
@@ -114,6 +126,15 @@ ClientToServer::ClientToServer()
 ClientToServer::~ClientToServer()
 {
     while( m_outbox.Size() > 0 ) {}
+
+    delete [] m_sendBuffer;
+
+    if( m_snapshotUpload ) m_snapshotUpload->Release();
+    if( m_snapshotDownload ) m_snapshotDownload->Release();
+
+    m_inbox.EmptyAndDelete();
+
+    // m_received stays, as the listener thread is never stopped
 }
 
 
@@ -185,8 +206,6 @@ void ClientToServer::AdvanceSender()
     static float s_timer = 0;
     static float s_interval = 5.0f;
  
-    g_app->GetClientToServer()->m_outboxMutex->Lock();
-    
     while (g_app->GetClientToServer()->m_outbox.Size())
     {
         Directory *letter = g_app->GetClientToServer()->m_outbox[0];
@@ -196,11 +215,11 @@ void ClientToServer::AdvanceSender()
 
         if( m_connectionState > StateDisconnected )
         {
-            int letterSize = 0;
-            char *byteStream = letter->Write(letterSize);
+            int letterFormat = VersionManager::ChooseLetterFormat( m_serverLetterFormat );
+            int letterSize = LetterCodec::Write( letter, letterFormat, m_sendBuffer, m_sendBufferSize );
             NetSocketSession *socket = g_app->GetClientToServer()->m_sendSocket;
             int writtenData = 0;
-            NetRetCode result = socket->WriteData( byteStream, letterSize, &writtenData );
+            NetRetCode result = socket->WriteData( m_sendBuffer, letterSize, &writtenData );
             
             if( result != NetOk )           AppDebugOut("CLIENT write data bad result %d\n", (int) result );
             if( writtenData != 0 &&
@@ -210,13 +229,10 @@ void ClientToServer::AdvanceSender()
             s_bytesSent += UDP_HEADER_SIZE;
             
             delete letter;
-            delete byteStream;            
         }
         g_app->GetClientToServer()->m_outbox.RemoveData(0);
     }
 
-    g_app->GetClientToServer()->m_outboxMutex->Unlock();
-
     
     float timeNow = GetHighResTime();
     if( timeNow > s_timer + s_interval )
@@ -246,11 +262,11 @@ void ClientToServer::Advance()
     //
     // If we are disconnected burn all messages in the inbox
 
+    FileReceivedLetters();
+
     if( m_connectionState == StateDisconnected )
     {
-        m_inboxMutex->Lock();
         m_inbox.EmptyAndDelete();
-        m_inboxMutex->Unlock();
     }
 
 
@@ -294,6 +310,10 @@ void ClientToServer::Advance()
             letter->CreateData( NET_DEFCON_COMMAND, NET_DEFCON_CLIENT_JOIN );
             letter->CreateData( NET_METASERVER_GAMEVERSION, APP_VERSION );
             letter->CreateData( NET_DEFCON_SYSTEMTYPE, APP_SYSTEM );
+            letter->CreateData( NET_DEFCON_NUMERICS, FIXED_NUMERICS_REVISION );
+            letter->CreateData( NET_DEFCON_LETTERFORMAT, LETTER_FORMAT_CURRENT );
+            letter->CreateData( NET_DEFCON_SNAPSHOTVERSION, WORLDSNAPSHOT_VERSION );
+            letter->CreateData( NET_DEFCON_SYNCHASHREVISION, WORLDHASH_REVISION );
 
             char authKey[256];
             Authentication_GetKey(authKey);
@@ -406,8 +426,26 @@ void ClientToServer::Advance()
         {
             AppDebugOut( "Client requesting Resynchronisation...\n" );
 
+            //
+            // Saying how much of a snapshot we have, if we can take one
+
+            int snapshotSeqId = -1;
+            int snapshotPart = 0;
+
+            if( m_snapshotRefused )
+            {
+                snapshotPart = -1;
+            }
+            else if( m_snapshotDownload )
+            {
+                snapshotSeqId = m_snapshotDownload->m_seqId;
+                snapshotPart = m_snapshotDownload->GetFirstMissing();
+            }
+
             Directory *letter = new Directory();
             letter->CreateData( NET_DEFCON_COMMAND, NET_DEFCON_RESYNCHRONISE );
+            letter->CreateData( NET_DEFCON_SNAPSHOTSEQID, snapshotSeqId );
+            letter->CreateData( NET_DEFCON_SNAPSHOTPART, snapshotPart );
             SendLetter( letter );
 
             m_resynchronising = timeNow + 1.0f;
@@ -415,6 +453,39 @@ void ClientToServer::Advance()
     }
 
 
+    //
+    // Upload the snapshot the Server asked for, a little at a time
+
+    if( m_snapshotUpload && m_connectionState == StateConnected )
+    {
+        float timeNow = GetHighResTime();
+        if( timeNow > m_snapshotUploadTimer )
+        {
+            for( int i = 0; i < CLIENT_SNAPSHOTUPLOADPARTS && m_snapshotUpload; ++i )
+            {
+                Directory *letter = new Directory();
+                letter->CreateData( NET_DEFCON_COMMAND, NET_DEFCON_SNAPSHOTUPLOAD );
+                m_snapshotUpload->WritePart( letter, m_snapshotUploadPart );
+                SendLetter( letter );
+
+                ++m_snapshotUploadPart;
+                if( m_snapshotUploadPart >= m_snapshotUpload->m_numParts )
+                {
+                    m_snapshotUploadPart = 0;
+                    ++m_snapshotUploadPasses;
+                    if( m_snapshotUploadPasses >= CLIENT_SNAPSHOTUPLOADPASSES )
+                    {
+                        m_snapshotUpload->Release();
+                        m_snapshotUpload = NULL;
+                    }
+                }
+            }
+
+            m_snapshotUploadTimer = timeNow + CLIENT_SNAPSHOTUPLOADPERIOD;
+        }
+    }
+
+
     //
     // Advance the sender
 
@@ -470,52 +541,31 @@ void ClientToServer::ReceiveChatMessage( unsigned char teamId, int messageId )
 
 int ClientToServer::GetNextLetterSeqID()
 {
-    int result = -1;
+    if( m_inbox.NumDirect() > 0 ) return -1;
 
-    m_inboxMutex->Lock();
-    if( m_inbox.Size() > 0 )
-    {
-        result = m_inbox[0]->GetDataInt( NET_DEFCON_SEQID );
-    }    
-    m_inboxMutex->Unlock();
-
-    return result;
+    return m_inbox.GetFirstSeqId();
 }
 
 
 Directory *ClientToServer::GetNextLetter()
 {
-    m_inboxMutex->Lock();
-    Directory *letter = NULL;
-    
-    if( m_inbox.Size() > 0 )
-    {
-        letter = m_inbox[0];
-        int seqId = letter->GetDataInt( NET_DEFCON_SEQID );
-        
-        if( seqId == g_lastProcessedSequenceId+1 ||
-            seqId == -1 )
-        {
-            // This is the next letter, remove from list
-            // (assume its now dealt with)
-            m_inbox.RemoveData(0);
-        }
-        else if( seqId < g_lastProcessedSequenceId+1 )
-        {
-            // This is a duplicate old letter, throw it away
-            m_inbox.RemoveData(0);
-            letter = NULL;
-        }
-        else
-        {
-            // We're not ready to read this letter yet
-            letter = NULL;
-        }
-    }
+    FileReceivedLetters();
+
+    //
+    // Letters just for us come first
+
+    Directory *letter = m_inbox.RemoveDirect();
+    if( letter ) return letter;
+
+
+    //
+    // Throw away duplicates of letters already dealt with,
+    // then take the next one if it's here yet
+    // (assume its now dealt with)
 
-    m_inboxMutex->Unlock();
+    m_inbox.DiscardBefore( g_lastProcessedSequenceId+1 );
 
-    return letter;
+    return m_inbox.Remove( g_lastProcessedSequenceId+1 );
 }
 
 
@@ -557,25 +607,54 @@ float ClientToServer::GetEstimatedLatency()
 void ClientToServer::ReceiveLetter( Directory *letter )
 {
     //
-    // Simulate network packet loss
-    
-#ifdef _DEBUG
-    if( g_keys[KEY_F] )
-    {    
-        delete letter;
+    // Is this part of the MatchMaker service?
+
+    if( strcmp( letter->m_name, NET_MATCHMAKER_MESSAGE ) == 0 )
+    {
+        MatchMaker_ReceiveMessage( m_listener, letter );
         return;
     }
-#endif
 
 
     //
-    // Is this part of the MatchMaker service?
+    // Everything else is handed over to the main thread.
+    // If it has fallen this far behind, treat the letter as lost
+    // - the Server sends again anything we haven't acknowledged
 
-    if( strcmp( letter->m_name, NET_MATCHMAKER_MESSAGE ) == 0 )
+    ReceivedLetter received;
+    received.m_letter = letter;
+    received.m_receivedAt = GetHighResTime();
+
+    if( !m_received->Push( received ) )
     {
-        MatchMaker_ReceiveMessage( m_listener, letter );
+        AppDebugOut( "Client inbox full, letter discarded\n" );
+        delete letter;
+    }
+}
+
+
+void ClientToServer::FileReceivedLetters()
+{
+    ReceivedLetter received;
+    while( m_received->Pop( received ) )
+    {
+        FileLetter( received.m_letter, received.m_receivedAt );
+    }
+}
+
+
+void ClientToServer::FileLetter( Directory *letter, double _receivedAt )
+{
+    //
+    // Simulate network packet loss
+    
+#ifdef _DEBUG
+    if( g_keys[KEY_F] )
+    {    
+        delete letter;
         return;
     }
+#endif
 
 
     //
@@ -608,7 +687,7 @@ void ClientToServer::ReceiveLetter( Directory *letter )
     {
         letter->RemoveDirectory( NET_DEFCON_PREVUPDATE );
         prevUpdate->SetName( NET_DEFCON_MESSAGE );
-        ReceiveLetter( prevUpdate );
+        FileLetter( prevUpdate, _receivedAt );
     }
 
 
@@ -623,7 +702,7 @@ void ClientToServer::ReceiveLetter( Directory *letter )
 
     
     //
-    // If this letter is just for us put it to the front of the queue
+    // If this letter is just for us keep it apart from the rest
         
     if( !letter->HasData( NET_DEFCON_SEQID, DIRECTORY_TYPE_INT ) )
     {
@@ -636,19 +715,15 @@ void ClientToServer::ReceiveLetter( Directory *letter )
     int seqId = letter->GetDataInt( NET_DEFCON_SEQID );
     if( seqId == -1 )
     {
-        m_inboxMutex->Lock();
-        m_inbox.PutDataAtStart( letter );
-        m_inboxMutex->Unlock();
+        m_inbox.PutDirect( letter );
         return;
     }
 
 
     //
     // Check for duplicates
-    // Throw away stuff if we're not supposed to be connected
     
-    if( seqId <= m_lastValidSequenceIdFromServer ||
-        m_connectionState == StateDisconnected )
+    if( seqId <= m_lastValidSequenceIdFromServer || seqId < 0 )
     {
         delete letter;
         return;
@@ -658,8 +733,8 @@ void ClientToServer::ReceiveLetter( Directory *letter )
     //
     // Work out our start time
 
-    double newStartTime = GetHighResTime() - (float)seqId * SERVER_ADVANCE_PERIOD.DoubleValue();
-    if( !g_app->m_gameRunning ) newStartTime = GetHighResTime() - (float)seqId * SERVER_ADVANCE_PERIOD.DoubleValue() * 5.0f;
+    double newStartTime = _receivedAt - (float)seqId * SERVER_ADVANCE_PERIOD.DoubleValue();
+    if( !g_app->m_gameRunning ) newStartTime = _receivedAt - (float)seqId * SERVER_ADVANCE_PERIOD.DoubleValue() * 5.0f;
     if( newStartTime < g_startTime ||
         newStartTime > g_startTime + 0.1f ) 
     {
@@ -668,47 +743,37 @@ void ClientToServer::ReceiveLetter( Directory *letter )
 
 
     //
-    // Do a sorted insert of the letter into the inbox
+    // File the letter by its sequence id
+    // Throw it away if we already have it
 
-    m_inboxMutex->Lock();
-
-    bool inserted = false;
-    for( int i = m_inbox.Size()-1; i >= 0; --i )
-    {
-        Directory *thisLetter = m_inbox[i];
-        int thisSeqId = thisLetter->GetDataInt(NET_DEFCON_SEQID);
-        if( seqId > thisSeqId )
-        {
-            m_inbox.PutDataAtIndex( letter, i+1 );
-            inserted = true;
-            break;
-        }
-        else if( seqId == thisSeqId )
-        {
-            // Throw this letter away, it's a duplicate
-            delete letter;
-            inserted = true;
-            break;
-        }
-    }
-    if( !inserted )
+    if( !m_inbox.Put( letter ) )
     {
-        m_inbox.PutDataAtStart( letter );
+        delete letter;
+        return;
     }
 
 
     //
     // Recalculate our last Known Sequence Id
 
-    for( int i = 0; i < m_inbox.Size(); ++i )
+    UpdateLastValidSequenceId( seqId );
+}
+
+
+void ClientToServer::UpdateLastValidSequenceId( int _fromSeqId )
+{
+    if( m_inbox.Size() == 0 ) return;
+
+    int lastSeqId = m_inbox.GetLastSeqId();
+
+    for( int seqId = max( _fromSeqId, m_inbox.GetFirstSeqId() ); 
+         seqId <= lastSeqId && seqId <= m_lastValidSequenceIdFromServer+1; 
+         ++seqId )
     {
-        Directory *thisLetter = m_inbox[i];
-        int thisSeqId = thisLetter->GetDataInt( NET_DEFCON_SEQID );
-        if( thisSeqId > m_lastValidSequenceIdFromServer+1 )
-        {
-            break;
-        }
-        m_lastValidSequenceIdFromServer = max( m_lastValidSequenceIdFromServer, thisSeqId );
+        Directory *thisLetter = m_inbox.Get( seqId );
+        if( !thisLetter ) continue;
+
+        m_lastValidSequenceIdFromServer = max( m_lastValidSequenceIdFromServer, seqId );
 
         if( thisLetter->m_subDirectories.Size() == 0 &&
             thisLetter->HasData( NET_DEFCON_NUMEMPTYUPDATES, DIRECTORY_TYPE_INT ) )
@@ -716,11 +781,9 @@ void ClientToServer::ReceiveLetter( Directory *letter )
             int numEmptyUpdates = thisLetter->GetDataInt( NET_DEFCON_NUMEMPTYUPDATES );
             AppAssert( numEmptyUpdates != -1 );
             m_lastValidSequenceIdFromServer = max( m_lastValidSequenceIdFromServer, 
-                                                   thisSeqId + numEmptyUpdates - 1 );
+                                                   seqId + numEmptyUpdates - 1 );
         }
     }
-
-    m_inboxMutex->Unlock();
 }
 
 void ClientToServer::SendLetter( Directory *letter )
@@ -731,43 +794,38 @@ void ClientToServer::SendLetter( Directory *letter )
 
         letter->SetName     ( NET_DEFCON_MESSAGE );
 
-        m_outboxMutex->Lock();
         m_outbox.PutDataAtEnd( letter );
-        m_outboxMutex->Unlock();
     }
 }
 
 
 bool ClientToServer::IsSequenceIdInQueue( int _seqId )
 {
-    bool found = false;
+    if( m_inbox.Get( _seqId ) ) return true;
+
+
+    //
+    // It may be one of a run of empty updates
 
-    m_inboxMutex->Lock();
-    for( int i = 0; i < m_inbox.Size(); ++i )
+    int lastSeqId = min( _seqId, m_inbox.GetLastSeqId() );
+
+    for( int thisSeqId = m_inbox.GetFirstSeqId(); thisSeqId != -1 && thisSeqId <= lastSeqId; ++thisSeqId )
     {
-        Directory *thisLetter = m_inbox[i];
-        int thisSeqId = thisLetter->GetDataInt( NET_DEFCON_SEQID );
-        if( thisSeqId == _seqId )
-        {
-            found = true;
-            break;
-        }
+        Directory *thisLetter = m_inbox.Get( thisSeqId );
 
-        if( thisLetter->m_subDirectories.Size() == 0 &&
+        if( thisLetter &&
+            thisLetter->m_subDirectories.Size() == 0 &&
             thisLetter->HasData( NET_DEFCON_NUMEMPTYUPDATES, DIRECTORY_TYPE_INT ) )
         {
             int numEmptyUpdates = thisLetter->GetDataInt( NET_DEFCON_NUMEMPTYUPDATES );
-            if( _seqId >= thisSeqId &&
-                _seqId < thisSeqId + numEmptyUpdates )
+            if( _seqId < thisSeqId + numEmptyUpdates )
             {
-                found = true;
-                break;
+                return true;
             }
         }
     }
-    m_inboxMutex->Unlock();
 
-    return found;
+    return false;
 }
 
 
@@ -776,11 +834,9 @@ int ClientToServer::CountPacketLoss()
     int packetLoss = 0;
     int lastSeqId = g_lastProcessedSequenceId;
 
-    m_inboxMutex->Lock();
-    for( int i = 0; i < m_inbox.Size(); ++i )
+    for( int thisSeqId = m_inbox.GetFirstSeqId(); thisSeqId != -1 && thisSeqId <= m_inbox.GetLastSeqId(); ++thisSeqId )
     {
-        Directory *thisLetter = m_inbox[i];
-        int thisSeqId = thisLetter->GetDataInt( NET_DEFCON_SEQID );
+        if( !m_inbox.Get( thisSeqId ) ) continue;
 
         if( thisSeqId > lastSeqId + 1 )
         {
@@ -789,7 +845,6 @@ int ClientToServer::CountPacketLoss()
 
         lastSeqId = thisSeqId;
     }
-    m_inboxMutex->Unlock();
 
     return packetLoss;
 }
@@ -810,6 +865,7 @@ bool ClientToServer::ClientJoin( char *ip, int _serverPort )
     m_lastValidSequenceIdFromServer = -1;
     m_serverSequenceId = -1;
     m_connectionAttempts = 0;
+    m_serverLetterFormat = LETTER_FORMAT_DIRECTORY;
 
     m_sendSocket = new NetSocketSession( *m_listener, ip, _serverPort );	
     m_connectionState = StateConnecting;
@@ -854,9 +910,15 @@ void ClientToServer::ClientLeave( bool _notifyServer )
     m_outOfSyncClients.Empty();
     m_demoClients.Empty();
 
-    m_inboxMutex->Lock();
+    if( m_snapshotUpload ) m_snapshotUpload->Release();
+    if( m_snapshotDownload ) m_snapshotDownload->Release();
+    m_snapshotUpload = NULL;
+    m_snapshotDownload = NULL;
+    m_snapshotRequestSeqId = -1;
+    m_snapshotRefused = false;
+    m_fromSnapshot = false;
+
     m_inbox.EmptyAndDelete();
-    m_inboxMutex->Unlock();
 
     g_lastProcessedSequenceId = -2;
 
@@ -1219,6 +1281,65 @@ void ClientToServer::SendSyncronisation( int _lastProcessedId, unsigned char _sy
 }
 
 
+void ClientToServer::SendSyncHash( Directory *_request )
+{
+    int seqId = _request->GetDataInt( NET_DEFCON_SYNCHASHSEQID );
+
+    int path[WORLDHASH_MAXDEPTH];
+    int depth = LetterCodec::ReadInts( _request, NET_DEFCON_SYNCHASHPATH, path, WORLDHASH_MAXDEPTH );
+
+
+    //
+    // Pin the tree, so it is still there for the Server's next question
+
+    WorldHashNode *node = NULL;
+    WorldHashTree *tree = NULL;
+
+    if( g_app->GetWorld() )
+    {
+        tree = g_app->GetWorld()->m_hash.Pin( seqId );
+        if( tree ) node = tree->FindNode( path, depth );
+    }
+
+    Directory *letter = new Directory();
+
+    letter->CreateData( NET_DEFCON_COMMAND,             NET_DEFCON_SYNCHASH );
+    letter->CreateData( NET_DEFCON_SYNCHASHSEQID,       seqId );
+    LetterCodec::WriteInts( letter, NET_DEFCON_SYNCHASHPATH, path, depth );
+
+    if( !node )
+    {
+        letter->CreateData( NET_DEFCON_SYNCHASHCHILDREN, -1 );
+    }
+    else
+    {
+        int numChildren = min( node->m_numChildren, WORLDHASH_MAXCHILDREN );
+        letter->CreateData( NET_DEFCON_SYNCHASHCHILDREN, numChildren );
+
+        if( numChildren > 0 )
+        {
+            int *keys = new int[numChildren];
+            int *values = new int[numChildren];
+
+            for( int i = 0; i < numChildren; ++i )
+            {
+                WorldHashNode *child = tree->GetNode( node->m_firstChild + i );
+                keys[i] = child->m_key;
+                values[i] = (int) child->m_hash;
+            }
+
+            LetterCodec::WriteInts( letter, NET_DEFCON_SYNCHASHKEYS, keys, numChildren );
+            LetterCodec::WriteInts( letter, NET_DEFCON_SYNCHASHVALUES, values, numChildren );
+
+            delete [] keys;
+            delete [] values;
+        }
+    }
+
+    SendLetter( letter );
+}
+
+
 void ClientToServer::SetSyncState( int _clientId, bool _synchronised )
 {
     if( !_synchronised && IsSynchronised(_clientId) )
@@ -1294,27 +1415,7 @@ bool ClientToServer::AmIDemoClient()
 
 void ClientToServer::GetDemoLimitations( int &_maxGameSize, int &_maxDemoPlayers, bool &_allowDemoServers )
 {
-    Directory *demoLims = MetaServer_RequestData( NET_METASERVER_DATA_DEMOLIMITS );
-
-    if( demoLims &&
-        demoLims->HasData( NET_METASERVER_MAXDEMOGAMESIZE, DIRECTORY_TYPE_INT ) &&
-        demoLims->HasData( NET_METASERVER_MAXDEMOPLAYERS, DIRECTORY_TYPE_INT ) &&
-        demoLims->HasData( NET_METASERVER_ALLOWDEMOSERVERS, DIRECTORY_TYPE_BOOL) )
-    {
-        // The MetaServer gave us these numbers
-        _maxGameSize = demoLims->GetDataInt( NET_METASERVER_MAXDEMOGAMESIZE );
-        _maxDemoPlayers = demoLims->GetDataInt( NET_METASERVER_MAXDEMOPLAYERS );
-        _allowDemoServers = demoLims->GetDataBool( NET_METASERVER_ALLOWDEMOSERVERS );
-        delete demoLims;
-    }
-    else
-    {
-        // We don't have a clear answer from the MetaServer
-        // So go with sensible defaults
-        _maxGameSize = 2;
-        _maxDemoPlayers = 2;
-        _allowDemoServers = true;
-    }    
+    Server::GetDemoLimitations( _maxGameSize, _maxDemoPlayers, _allowDemoServers );
 }
 
 
@@ -1389,9 +1490,26 @@ void ClientToServer::ProcessServerUpdates( Directory *letter )
             letterCopy->CreateData( NET_DEFCON_NUMEMPTYUPDATES, numEmptyUpdates-1 );
             letterCopy->CreateData( NET_DEFCON_SEQID, seqId+1 );
             
-            m_inboxMutex->Lock();
-            m_inbox.PutDataAtStart( letterCopy );
-            m_inboxMutex->Unlock();
+            //
+            // A single empty update that arrived on its own may
+            // already be here, but the run covers it, so the run
+            // stays unless that turns out to be a longer run
+
+            Directory *existing = m_inbox.Remove( seqId+1 );
+            if( existing &&
+                existing->m_subDirectories.Size() == 0 &&
+                existing->HasData( NET_DEFCON_NUMEMPTYUPDATES, DIRECTORY_TYPE_INT ) &&
+                existing->GetDataInt( NET_DEFCON_NUMEMPTYUPDATES ) > numEmptyUpdates-1 )
+            {
+                delete letterCopy;
+                letterCopy = existing;
+            }
+            else
+            {
+                delete existing;
+            }
+
+            m_inbox.Put( letterCopy );
         }
 
         return;
@@ -1704,6 +1822,115 @@ void ClientToServer::Resynchronise()
     //m_clientId = -1;
 
     m_resynchronising = GetHighResTime();
+
+    // If we loaded a snapshot and then went out of sync, it may have been
+    // the snapshot that was wrong, so this time go through the whole history
+
+    m_snapshotRefused = m_fromSnapshot;
+    m_fromSnapshot = false;
+
+    if( m_snapshotDownload ) m_snapshotDownload->Release();
+    m_snapshotDownload = NULL;
+
+    if( m_snapshotUpload ) m_snapshotUpload->Release();
+    m_snapshotUpload = NULL;
+    m_snapshotRequestSeqId = -1;
+}
+
+
+void ClientToServer::RequestSnapshot( int _seqId )
+{
+    if( _seqId == -1 )
+    {
+        if( m_snapshotUpload ) m_snapshotUpload->Release();
+        m_snapshotUpload = NULL;
+        m_snapshotRequestSeqId = -1;
+        return;
+    }
+
+    if( m_snapshotUpload && m_snapshotUpload->m_seqId == _seqId ) return;
+
+    if( _seqId > g_lastProcessedSequenceId )
+    {
+        m_snapshotRequestSeqId = _seqId;
+    }
+}
+
+
+void ClientToServer::UploadSnapshot( int _lastProcessedId )
+{
+    if( _lastProcessedId != m_snapshotRequestSeqId ) return;
+    m_snapshotRequestSeqId = -1;
+
+    // No use to anyone if we're out of sync ourselves
+    if( !g_app->m_gameRunning || !IsSynchronised( m_clientId ) ) return;
+
+    int length = 0;
+    char *data = WorldSnapshot::Save( _lastProcessedId, length );
+
+    if( m_snapshotUpload ) m_snapshotUpload->Release();
+    m_snapshotUpload = new SnapshotParts( _lastProcessedId, WORLDSNAPSHOT_VERSION, data, length );
+    m_snapshotUploadPart = 0;
+    m_snapshotUploadPasses = 0;
+    m_snapshotUploadTimer = 0.0f;
+
+    delete [] data;
+
+    AppDebugOut( "CLIENT : Uploading snapshot %d to the Server (%d bytes, %d parts)\n", 
+                 _lastProcessedId, length, m_snapshotUpload->m_numParts );
+}
+
+
+SnapshotParts *ClientToServer::ReceiveSnapshotPart( Directory *letter )
+{
+    if( m_snapshotRefused ) return NULL;
+
+    if( !letter->HasData( NET_DEFCON_SNAPSHOTSEQID, DIRECTORY_TYPE_INT ) ||
+        !letter->HasData( NET_DEFCON_SNAPSHOTVERSION, DIRECTORY_TYPE_INT ) )
+    {
+        AppDebugOut( "Client received bogus snapshot, discarded\n" );
+        return NULL;
+    }
+
+    int seqId = letter->GetDataInt( NET_DEFCON_SNAPSHOTSEQID );
+    int version = letter->GetDataInt( NET_DEFCON_SNAPSHOTVERSION );
+    if( version != WORLDSNAPSHOT_VERSION ) return NULL;
+
+    if( !m_snapshotDownload || seqId > m_snapshotDownload->m_seqId )
+    {
+        AppDebugOut( "CLIENT : Receiving snapshot %d from the Server\n", seqId );
+
+        if( m_snapshotDownload ) m_snapshotDownload->Release();
+        m_snapshotDownload = new SnapshotParts( seqId, version );
+
+        // Tell the Server which parts have arrived, so it can skip them
+        if( m_resynchronising < 0.0f ) m_resynchronising = GetHighResTime();
+    }
+
+    if( !m_snapshotDownload->ReadPart( letter ) ||
+        !m_snapshotDownload->IsComplete() )
+    {
+        return NULL;
+    }
+
+    SnapshotParts *snapshot = m_snapshotDownload;
+    m_snapshotDownload = NULL;
+    return snapshot;
+}
+
+
+void ClientToServer::ResumeFromSnapshot( int _seqId )
+{
+    m_fromSnapshot = true;
+    m_resynchronising = -1.0f;
+
+
+    //
+    // The Server carries on from the letter after the snapshot
+
+    m_lastValidSequenceIdFromServer = max( m_lastValidSequenceIdFromServer, _seqId );
+
+    UpdateLastValidSequenceId( m_inbox.GetFirstSeqId() );
 }
 
 
@@ -5,11 +5,29 @@
 #include "lib/tosser/llist.h"
 #include "lib/tosser/directory.h"
 
+#include "network/letter_inbox.h"
+
 class NetLib;
 class NetSocketListener;
 class NetSocketSession;
-class NetMutex;
 class ChatMessage;
+class SnapshotParts;
+
+template <class T> class NetQueue;
+
+
+#define CLIENT_SNAPSHOTUPLOADPARTS      2                                   // Parts sent each CLIENT_SNAPSHOTUPLOADPERIOD
+#define CLIENT_SNAPSHOTUPLOADPERIOD     0.1f
+#define CLIENT_SNAPSHOTUPLOADPASSES     3                                   // Times round all the parts, for the ones lost
+
+#define CLIENT_RECEIVEDSIZE             4096                                // Letters the listener thread can get ahead of the main thread
+
+
+struct ReceivedLetter
+{
+    Directory           *m_letter;
+    double              m_receivedAt;
+};
 
 
 class ClientToServer
@@ -19,12 +37,14 @@ private:
     char                *m_serverIp;
     int                 m_serverPort;
 
+    char                *m_sendBuffer;                                      // Reused by AdvanceSender for every letter
+    int                 m_sendBufferSize;
+
 public:
     NetSocketListener   *m_listener;
     NetSocketSession    *m_sendSocket; 
-    NetMutex            *m_inboxMutex;
-    NetMutex            *m_outboxMutex;
-    LList               <Directory *> m_inbox;
+    NetQueue            <ReceivedLetter> *m_received;                      // Pushed by the listener thread, filed into m_inbox by the main thread
+    LetterInbox         m_inbox;
     LList               <Directory *> m_outbox;
 
     LList               <ChatMessage *> m_chatSendQueue;
@@ -37,6 +57,15 @@ public:
     float               m_receiveRate;
     bool                m_synchronising;                                    // Set to true when the "connecting" window is open
     float               m_resynchronising;
+
+    int                 m_snapshotRequestSeqId;                             // Take a snapshot for the Server just after this letter, or -1
+    SnapshotParts       *m_snapshotUpload;                                  // Being sent to the Server, or NULL
+    int                 m_snapshotUploadPart;
+    int                 m_snapshotUploadPasses;
+    float               m_snapshotUploadTimer;
+    SnapshotParts       *m_snapshotDownload;                                // Being sent to us instead of the history, or NULL
+    bool                m_snapshotRefused;                                  // Resynchronise from the whole history instead
+    bool                m_fromSnapshot;                                     // Our World was loaded from a snapshot
     
     LList               <int> m_outOfSyncClients;
     LList               <int> m_demoClients;
@@ -55,6 +84,7 @@ public:
     int     m_clientId;
     char    m_password[128];
     char    m_serverVersion[128];
+    int     m_serverLetterFormat;                                           // Newest LETTER_FORMAT the server can read
 
 public:
     ClientToServer();
@@ -68,7 +98,10 @@ public:
 
     void OpenConnections        ();                                 // Close and re-open listeners
 
-    void ReceiveLetter          ( Directory *letter );
+    void ReceiveLetter          ( Directory *letter );              // Listener thread
+    void FileReceivedLetters    ();                                 // Into m_inbox, on the main thread
+    void FileLetter             ( Directory *letter, double _receivedAt );
+    void UpdateLastValidSequenceId( int _fromSeqId );              // Walks on through the held letters from here
     void SendLetter             ( Directory *letter );
     void ProcessServerUpdates   ( Directory *letter );
 
@@ -113,10 +146,16 @@ public:
     void ReceiveChatMessage     ( unsigned char teamId, int messageId );
 
     void SendSyncronisation     ( int _lastProcessedId, unsigned char _sync );
+    void SendSyncHash           ( Directory *_request );                        // Our world hashes for the node the Server asks about
     void SetSyncState           ( int _clientId, bool _synchronised );
     bool IsSynchronised         ( int _clientId );
     void Resynchronise          ();
 
+    void RequestSnapshot        ( int _seqId );                                 // From the Server, -1 stops uploading
+    void UploadSnapshot         ( int _lastProcessedId );                       // Takes it, if this is the letter asked for
+    SnapshotParts *ReceiveSnapshotPart( Directory *letter );                    // Returns it once complete, to Release
+    void ResumeFromSnapshot     ( int _seqId );                                 // The World has been loaded from it
+
     void SetClientDemo          ( int _clientId );
     bool IsClientDemo           ( int _clientId );
     bool AmIDemoClient          ();
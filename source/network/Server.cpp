@@ -11,7 +11,8 @@
 #include "lib/netlib/net_lib.h"
 #include "lib/netlib/net_udp_packet.h"
 #include "lib/netlib/net_socket_listener.h"
-#include "lib/netlib/net_mutex.h"
+#include "lib/netlib/net_queue.h"
+#include "lib/netlib/net_send_batch.h"
 #include "lib/netlib/net_thread.h"
 #include "lib/netlib/net_socket.h"
 #include "lib/hi_res_time.h"
@@ -29,15 +30,15 @@
 
 #include "world/team.h"
 #include "world/world.h"
+#include "world/world_hash.h"
 
 #include "network/Server.h"
 #include "network/ServerToClient.h"
 #include "network/ClientToServer.h"
+#include "network/ServerLobby.h"
 #include "network/network_defines.h"
-
-
-static NetSocketListener *s_listener = NULL;
-static bool s_listenerRunning = false;
+#include "network/letter_codec.h"
+#include "network/snapshot_parts.h"
 
 
 // ****************************************************************************
@@ -52,6 +53,65 @@ ServerTeam::ServerTeam(int _clientId, int _teamType)
 
 
 
+// ****************************************************************************
+// Host state
+// ****************************************************************************
+
+// A Server normally runs inside a client, and reads the game state from
+// that client's World and Game.  The dedicated server has neither, and
+// reads the ServerLobby it keeps from its own letters instead.
+
+#ifdef DEDICATED_SERVER
+typedef LobbyTeam HostTeam;
+#else
+typedef Team HostTeam;
+#endif
+
+
+static LList<HostTeam *> &GetHostTeams( ServerLobby *_lobby )
+{
+#ifdef DEDICATED_SERVER
+    return _lobby->m_teams;
+#else
+    return g_app->GetWorld()->m_teams;
+#endif
+}
+
+
+static HostTeam *GetHostTeam( ServerLobby *_lobby, int _teamId )
+{
+#ifdef DEDICATED_SERVER
+    return _lobby->GetTeam( _teamId );
+#else
+    return g_app->GetWorld()->GetTeam( _teamId );
+#endif
+}
+
+
+static int GetHostTeamScore( ServerLobby *_lobby, int _teamId )
+{
+#ifdef DEDICATED_SERVER
+    HostTeam *team = _lobby->GetTeam( _teamId );
+    return( team ? team->m_score : 0 );
+#else
+    return g_app->GetGame()->GetScore( _teamId );
+#endif
+}
+
+
+static bool AmIDemoServer()
+{
+#ifdef DEDICATED_SERVER
+    char authKey[256];
+    Authentication_GetKey( authKey );
+    return Authentication_IsDemoKey( authKey );
+#else
+    return g_app->GetClientToServer()->AmIDemoClient();
+#endif
+}
+
+
+
 
 // ****************************************************************************
 // Class Server
@@ -60,47 +120,47 @@ ServerTeam::ServerTeam(int _clientId, int _teamType)
 // ***ListenCallback
 static NetCallBackRetType ListenCallback(NetUdpPacket *udpdata)
 {
-    static int s_bytesReceived = 0;
-    static float s_timer = 0.0f;
     static float s_interval = 5.0f;
 
+    Server *server = NULL;
+
     if (udpdata)
     {
+        server = (Server *) udpdata->m_context;
+
         NetIpAddress fromAddr = udpdata->m_clientAddress;
         char newip[16];
 		IpAddressToStr( fromAddr, newip );
         
         int newPort = udpdata->GetPort();
         
-        if ( g_app->GetServer() )
+        if ( server )
         {
             Directory *letter = new Directory();
-            bool success = letter->Read( udpdata->m_data, udpdata->m_length );
+            bool success = LetterCodec::Read( letter, udpdata->m_data, udpdata->m_length );
             if( success )
             {
-                g_app->GetServer()->ReceiveLetter( letter, newip, newPort );
+                server->ReceiveLetter( letter, newip, newPort );
             }
             else
             {
                 AppDebugOut( "Server received bogus letter, discarded (10)\n" );
                 delete letter;
             }
-        }
-    
-        s_bytesReceived += udpdata->m_length;
-        s_bytesReceived += UDP_HEADER_SIZE;
 
-        delete udpdata;
+            server->m_bytesReceived += udpdata->m_length;
+            server->m_bytesReceived += UDP_HEADER_SIZE;
+        }
     }
 
 
 
     float timeNow = GetHighResTime();
-    if( timeNow > s_timer + s_interval )
+    if( server && timeNow > server->m_receiveRateTimer + s_interval )
     {
-        if( g_app->GetServer() ) g_app->GetServer()->m_receiveRate = s_bytesReceived / s_interval;
-        s_timer = timeNow;
-        s_bytesReceived = 0;
+        server->m_receiveRate = server->m_bytesReceived / s_interval;
+        server->m_receiveRateTimer = timeNow;
+        server->m_bytesReceived = 0;
     }
 
     return 0;
@@ -111,39 +171,95 @@ static NetCallBackRetType ListenCallback(NetUdpPacket *udpdata)
 Server::Server()
 :   m_netLib(NULL),
     m_sequenceId(0),
-    m_inboxMutex(NULL),
-    m_outboxMutex(NULL),
+    m_inbox(NULL),
     m_syncronised(true),
     m_sendRate(0.0f),
-    m_nextClientId(0)
+    m_receiveRate(0.0f),
+    m_receiveRateTimer(0.0f),
+    m_bytesReceived(0),
+    m_nextClientId(0),
+    m_listener(NULL),
+    m_listenerRunning(false),
+    m_sendRateTimer(0.0f),
+    m_bytesSent(0),
+    m_largestLetter(0),
+    m_sendBuffer(NULL),
+    m_sendBufferSize(0),
+    m_sendBatch(NULL),
+    m_advertise(true),
+    m_lobby(NULL),
+    m_snapshot(NULL),
+    m_snapshotUpload(NULL),
+    m_snapshotUploaderId(-1),
+    m_nextSnapshotSeqId(0),
+    m_nextSnapshotClient(0),
+    m_syncProbeSeqId(-1),
+    m_syncProbeDepth(0),
+    m_syncProbeStarted(0),
+    m_syncProbeAsked(0)
 {
+    for( int i = 0; i < 2; ++i )
+    {
+        m_syncProbeClientId[i] = -1;
+        m_syncProbeReply[i] = NULL;
+    }
 }
 
 
 Server::~Server()
 {
+    delete [] m_sendBuffer;
+    delete m_sendBatch;
+
+    if( m_snapshot ) m_snapshot->Release();
+    if( m_snapshotUpload ) m_snapshotUpload->Release();
+
+    delete m_syncProbeReply[0];
+    delete m_syncProbeReply[1];
+
+#ifdef DEDICATED_SERVER
+    delete m_lobby;
+#endif
 }
 
 
 // ***ListenThread
-static NetCallBackRetType ListenThread(void *ignored)
+static NetCallBackRetType ListenThread(void *server)
 {
-    s_listenerRunning = true;
-    
-    s_listener->StartListening( ListenCallback );
+    ((Server *) server)->Listen();
+    return 0;
+}
+
+
+void Server::Listen()
+{
+    m_listener->StartListening( ListenCallback, this );
        
-    // blocks until s_listener stops listening
+    // blocks until m_listener stops listening
 
-    s_listenerRunning = false;
-    return 0;
+    m_listenerRunning = false;
 }
 
 
 // *** Initialise
-bool Server::Initialise()
+bool Server::Initialise( int _port )
 {
-    m_inboxMutex = new NetMutex();
-    m_outboxMutex = new NetMutex();
+#ifdef DEDICATED_SERVER
+    //
+    // There is no host client to own the game options,
+    // so they are fixed from the preferences at startup
+
+    m_lobby = new ServerLobby();
+    if( !m_lobby->LoadOptions( "data/gameoptions.txt" ) )
+    {
+        AppDebugOut( "ERROR: Server failed to load game options\n" );
+        return false;
+    }
+    m_lobby->LoadPreferences();
+#endif
+
+    m_inbox = new NetQueue<Directory *>( SERVER_INBOXSIZE );
+    m_sendBatch = new NetSendBatch();
 
     m_netLib = new NetLib();
     m_netLib->Initialise();
@@ -151,23 +267,27 @@ bool Server::Initialise()
     //
     // Try the port number from Preferences first
 
-    int ourPort = g_preferences->GetInt( PREFS_NETWORKSERVERPORT );    
-    s_listener = new NetSocketListener( ourPort );
-    NetRetCode result = s_listener->Bind();
+    int ourPort = _port;
+    if( ourPort == -1 ) ourPort = g_preferences->GetInt( PREFS_NETWORKSERVERPORT );    
+    m_listener = new NetSocketListener( ourPort );
+    NetRetCode result = m_listener->Bind();
 
 
+#ifndef DEDICATED_SERVER
     //
-    // If that didn't work, try port 0
+    // If that didn't work, try port 0.
+    // A dedicated server's games are found on known ports, so it never does
 
     if( result != NetOk )
     {
         AppDebugOut( "Server failed to bind to Port %d\n", ourPort );
         AppDebugOut( "Server looking for any available port number...\n" );
 
-        delete s_listener;
-        s_listener = new NetSocketListener(0);
-        result = s_listener->Bind();
+        delete m_listener;
+        m_listener = new NetSocketListener(0);
+        result = m_listener->Bind();
     }
+#endif
 
     //
     // If it still didn't work, bail out now
@@ -175,12 +295,14 @@ bool Server::Initialise()
     if( result != NetOk )
     {
         AppDebugOut( "ERROR: Server failed to establish Network Listener\n" );
-        delete s_listener;
-        s_listener = NULL;
+        delete m_listener;
+        m_listener = NULL;
         return false;
     }
     
-    NetStartThread( ListenThread );    
+    // Set before the thread starts, so Shutdown always knows to wait for it
+    m_listenerRunning = true;
+    NetStartThread( ListenThread, this );    
 
     AppDebugOut( "Server started on port %d\n", GetLocalPort() );
     
@@ -190,15 +312,67 @@ bool Server::Initialise()
 
 bool Server::IsRunning()
 {
-    return( s_listenerRunning );
+    return( m_listenerRunning );
+}
+
+
+bool Server::IsGameRunning()
+{
+#ifdef DEDICATED_SERVER
+    return m_lobby->m_gameRunning;
+#else
+    return g_app->m_gameRunning;
+#endif
+}
+
+
+int Server::GetOptionValue( char *_name )
+{
+#ifdef DEDICATED_SERVER
+    return m_lobby->GetOptionValue( _name );
+#else
+    return g_app->GetGame()->GetOptionValue( _name );
+#endif
+}
+
+
+char *Server::GetOptionString( char *_name )
+{
+#ifdef DEDICATED_SERVER
+    GameOption *option = m_lobby->GetOption( _name );
+#else
+    GameOption *option = g_app->GetGame()->GetOption( _name );
+#endif
+
+    return( option ? option->m_currentString : NULL );
+}
+
+
+bool Server::IsCriticalModRunning()
+{
+#ifdef DEDICATED_SERVER
+    return false;                                   // Dedicated servers run without mods
+#else
+    return g_modSystem->IsCriticalModRunning();
+#endif
+}
+
+
+void Server::GetCriticalModPath( char *_modPath )
+{
+#ifdef DEDICATED_SERVER
+    _modPath[0] = '\x0';
+#else
+    g_modSystem->GetCriticalModPath( _modPath );
+#endif
 }
 
 
 int Server::GetLocalPort()
 {
-    if( !s_listener ) return -1;
+    if( !m_listener ) return -1;
 
-    return s_listener->GetPort();
+    return m_listener->GetPort();
 }
 
 
@@ -214,7 +388,6 @@ void Server::Shutdown()
 
     for( int j = 0; j < 3; ++j )
     {
-        m_outboxMutex->Lock();
         for( int i = 0; i < m_clients.Size(); ++i )
         {
             if( m_clients.ValidIndex(i) )
@@ -234,7 +407,6 @@ void Server::Shutdown()
                 if(j==0) AppDebugOut( "SERVER : Sent Disconnect to client %d\n", sToc->m_clientId );
             }
         }
-        m_outboxMutex->Unlock();
     
         AdvanceSender();
 
@@ -250,28 +422,57 @@ void Server::Shutdown()
     m_disconnectedClients.EmptyAndDelete();
     m_history.EmptyAndDelete();
     m_teams.EmptyAndDelete();
-    
-    m_inboxMutex->Lock();
-    m_inbox.EmptyAndDelete();
-    m_inboxMutex->Unlock();
-    delete m_inboxMutex;
-    m_inboxMutex = NULL;
 
-    m_outboxMutex->Lock();
+    if( m_snapshot ) m_snapshot->Release();
+    if( m_snapshotUpload ) m_snapshotUpload->Release();
+    m_snapshot = NULL;
+    m_snapshotUpload = NULL;
+
+    EndSyncProbe( false );
+    
     m_outbox.EmptyAndDelete();
-    m_outboxMutex->Unlock();
-    delete m_outboxMutex;
-    m_outboxMutex = NULL;
 
-    if( s_listener )
+    if( m_advertise )
+    {
+        MetaServer_StopRegisteringOverWAN();
+        MetaServer_StopRegisteringOverLAN();
+    }
+    MatchMaker_StopRequestingIdentity( m_listener );
+
+    if( m_listener )
+    {
+        //
+        // Wait for the listener thread to let go of us,
+        // since other Servers may carry on in this process.
+        // If it hasn't started listening yet, stopping now would be missed.
+        // Once stopped its socket is shut down, so the blocking read returns
+
+        while( m_listenerRunning && !m_listener->IsListening() )
+        {
+            NetSleep(1);
+        }
+
+        m_listener->StopListening();
+        while( m_listenerRunning )
+        {
+            NetSleep(10);
+        }
+
+        delete m_listener;
+        m_listener = NULL;
+    }
+
+    //
+    // Nothing can push into the inbox now
+
+    Directory *letter = NULL;
+    while( m_inbox->Pop( letter ) )
     {
-        s_listener->StopListening();
-        s_listener = NULL;
+        delete letter;
     }
 
-    MetaServer_StopRegisteringOverWAN();
-    MetaServer_StopRegisteringOverLAN();
-    MatchMaker_StopRequestingIdentity( s_listener );
+    delete m_inbox;
+    m_inbox = NULL;
 
     AppDebugOut( "SERVER : Shut down complete\n" );
 }
@@ -324,7 +525,7 @@ int Server::RegisterNewClient ( Directory *_client, int _clientId )
 
     AppAssert(GetClientId(ip,port) == -1);
     
-    ServerToClient *sToC = new ServerToClient(ip, port, s_listener);
+    ServerToClient *sToC = new ServerToClient(ip, port, m_listener);
     
     if( _clientId == -1 )
     {
@@ -354,6 +555,27 @@ int Server::RegisterNewClient ( Directory *_client, int _clientId )
         strcpy( sToC->m_system, _client->GetDataString( NET_DEFCON_SYSTEMTYPE ) );
     }
 
+    if( _client->HasData( NET_DEFCON_NUMERICS, DIRECTORY_TYPE_STRING ) )
+    {
+        strncpy( sToC->m_numerics, _client->GetDataString( NET_DEFCON_NUMERICS ), sizeof(sToC->m_numerics) - 1 );
+        sToC->m_numerics[ sizeof(sToC->m_numerics) - 1 ] = '\x0';
+    }
+
+    if( _client->HasData( NET_DEFCON_LETTERFORMAT, DIRECTORY_TYPE_INT ) )
+    {
+        sToC->m_letterFormat = _client->GetDataInt( NET_DEFCON_LETTERFORMAT );
+    }
+
+    if( _client->HasData( NET_DEFCON_SNAPSHOTVERSION, DIRECTORY_TYPE_INT ) )
+    {
+        sToC->m_snapshotVersion = _client->GetDataInt( NET_DEFCON_SNAPSHOTVERSION );
+    }
+
+    if( _client->HasData( NET_DEFCON_SYNCHASHREVISION, DIRECTORY_TYPE_INT ) )
+    {
+        sToC->m_syncHashRevision = _client->GetDataInt( NET_DEFCON_SYNCHASHREVISION );
+    }
+
     m_clients.PutData(sToC);
 
     const char *version = strcmp(sToC->m_version, "1.0") == 0 ? 
@@ -451,7 +673,8 @@ void Server::RemoveClient( int clientId, int reason )
                                         reason == Disconnect_BadPassword        ? "invalid password" : 
                                         reason == Disconnect_GameFull           ? "game full" : 
                                         reason == Disconnect_DemoFull           ? "too many demo users" :
-                                        reason == Disconnect_KickedFromGame     ? "kicked" 
+                                        reason == Disconnect_KickedFromGame     ? "kicked" :
+                                        reason == Disconnect_NumericsMismatch   ? "different numerics" 
                                                                                 : "unknown" );
 
                 AppDebugOut("SERVER: Client at %s:%d disconnected (%s)\n", 
@@ -491,7 +714,7 @@ void Server::RemoveClient( int clientId, int reason )
                 //
                 // Remove his teams if we're still in the lobby
 
-                if( !g_app->m_gameRunning )
+                if( !IsGameRunning() )
                 {
                     for( int t = 0; t < m_teams.Size(); ++t )
                     {
@@ -553,9 +776,9 @@ void Server::RegisterNewTeam ( int clientId, int _teamType )
     //
     // If we are full do something different
 
-    int maxTeams = g_app->GetGame()->GetOptionValue("MaxTeams");
+    int maxTeams = GetOptionValue("MaxTeams");
     
-    if( m_teams.NumUsed() >= maxTeams || g_app->m_gameRunning )
+    if( m_teams.NumUsed() >= maxTeams || IsGameRunning() )
     {
         AppDebugOut( "SERVER: Failed to create new team - already at max, or game already started\n" );
         return;
@@ -574,9 +797,9 @@ void Server::RegisterNewTeam ( int clientId, int _teamType )
         int maxDemoGameSize;
         int maxDemoPlayers;
         bool allowDemoServers;
-        g_app->GetClientToServer()->GetDemoLimitations( maxDemoGameSize, maxDemoPlayers, allowDemoServers );
+        GetDemoLimitations( maxDemoGameSize, maxDemoPlayers, allowDemoServers );
 
-        if( g_app->GetClientToServer()->AmIDemoClient() )
+        if( AmIDemoServer() )
         {
             // We (the server) are a DEMO.  Always allow 2 player demo games.
             maxDemoPlayers = max( maxDemoPlayers, 2 );
@@ -588,7 +811,7 @@ void Server::RegisterNewTeam ( int clientId, int _teamType )
             return;
         }
 
-        if( g_app->GetGame()->GetOptionValue("GameMode") != 0 )
+        if( GetOptionValue("GameMode") != 0 )
         {
             AppDebugOut( "SERVER: Failed to create Demo team because GameMode isn't default\n" );
             return;
@@ -640,7 +863,7 @@ void Server::RegisterSpectator( int _clientId )
         //
         // If he has any (non-AI) teams remove them now
 
-        if( !g_app->m_gameRunning )
+        if( !IsGameRunning() )
         {
             for( int t = 0; t < m_teams.Size(); ++t )
             {
@@ -686,11 +909,10 @@ void Server::SendClientId( int _clientId )
         letter->m_data->CreateData( NET_DEFCON_CLIENTID, _clientId );
         letter->m_data->CreateData( NET_DEFCON_SEQID, -1 );
         letter->m_data->CreateData( NET_DEFCON_VERSION, APP_VERSION );
+        letter->m_data->CreateData( NET_DEFCON_LETTERFORMAT, LETTER_FORMAT_CURRENT );
         letter->m_receiverId = _clientId;
         
-        m_outboxMutex->Lock();
         m_outbox.PutDataAtEnd( letter );
-        m_outboxMutex->Unlock();
 
         AppDebugOut( "SERVER: Client at %s:%d requested ID.  Sent ID %d.\n", sToC->m_ip, sToC->m_port, _clientId );
     }
@@ -699,16 +921,8 @@ void Server::SendClientId( int _clientId )
 
 Directory *Server::GetNextLetter()
 {
-    m_inboxMutex->Lock();
     Directory *letter = NULL;
-
-    if( m_inbox.Size() > 0 )
-    {
-        letter = m_inbox[0];
-        m_inbox.RemoveData(0);
-    }
-
-    m_inboxMutex->Unlock();
+    m_inbox->Pop( letter );
     return letter;
 }
 
@@ -720,13 +934,16 @@ void Server::ReceiveLetter( Directory *update, char *fromIP, int _fromPort )
     
     if( strcmp( update->m_name, NET_MATCHMAKER_MESSAGE ) == 0 )
     {
-        MatchMaker_ReceiveMessage( s_listener, update );
+        MatchMaker_ReceiveMessage( m_listener, update );
     }
-    else
+    else if( !m_inbox->Push( update ) )
     {
-        m_inboxMutex->Lock();
-        m_inbox.PutDataAtEnd(update);
-        m_inboxMutex->Unlock();
+        //
+        // Advance has fallen a long way behind, so this
+        // goes the same way as a letter lost on the wire
+
+        AppDebugOut( "SERVER : Inbox full, letter discarded\n" );
+        delete update;
     }
 }
 
@@ -739,6 +956,10 @@ void Server::SendLetter( ServerToClientLetter *letter )
         m_sequenceId++;
 
         m_history.PutDataAtEnd( letter );
+
+#ifdef DEDICATED_SERVER
+        m_lobby->ProcessLetter( letter->m_data );
+#endif
     }   
 }
 
@@ -748,44 +969,47 @@ void Server::AdvanceSender()
 {
     START_PROFILE( "AdvanceSender" );
 
-    static int s_bytesSent = 0;
-    static float s_timer = 0;
     static float s_interval = 5.0f;
-    static int s_largest = 0;
-
-    m_outboxMutex->Lock();
 
     while (m_outbox.Size())
     {
         ServerToClientLetter *letter = m_outbox[0];
         AppAssert(letter);
-        AppAssert(letter->m_data);
-        
-        letter->m_data->CreateData( NET_DEFCON_LASTSEQID, m_sequenceId );
+        AppAssert(letter->m_data || letter->m_encodedLetter);
 
         ServerToClient *client = GetClient(letter->m_receiverId);
         if( letter->m_clientDisconnected ) client = GetDisconnectedClient(letter->m_receiverId);
         
         if (client)
         {           
-            VersionManager::EnsureCompatability( client->m_version, letter->m_data );
-
-		    int linearSize = 0;
             NetSocketSession *socket = client->GetSocket();
-            char *linearisedLetter = letter->m_data->Write(linearSize);  
-		    NetRetCode result = socket->WriteData( linearisedLetter, linearSize );
+            int linearSize = 0;
+
+            if( letter->m_encodedLetter )
+            {
+                linearSize = LetterCodec::WriteEncoded( letter->m_encodedLetter, m_sequenceId, letter->m_encodedPrevUpdate,
+                                                        m_sendBuffer, m_sendBufferSize );
+            }
+            else
+            {
+                letter->m_data->CreateData( NET_DEFCON_LASTSEQID, m_sequenceId );
+                VersionManager::EnsureCompatability( client->m_version, letter->m_data );
+                int letterFormat = VersionManager::ChooseLetterFormat( client->m_letterFormat );
+                linearSize = LetterCodec::Write( letter->m_data, letterFormat, m_sendBuffer, m_sendBufferSize );
+            }
+
+		    NetRetCode result = m_sendBatch->WriteData( socket, m_sendBuffer, linearSize );
             if( result != NetOk ) AppDebugOut( "SERVER write data result %d", (int) result );
             
             int totalSize = linearSize + UDP_HEADER_SIZE;
-            s_bytesSent += totalSize;
+            m_bytesSent += totalSize;
 
-            if( totalSize > s_largest )
+            if( totalSize > m_largestLetter )
             {
-                s_largest = totalSize;
-                AppDebugOut( "Largest server letter sent : %d bytes\n", s_largest );
+                m_largestLetter = totalSize;
+                AppDebugOut( "Largest server letter sent : %d bytes\n", m_largestLetter );
             }
 
-            delete linearisedLetter;
             delete letter;                                        
         }
 
@@ -793,15 +1017,20 @@ void Server::AdvanceSender()
         m_outbox.RemoveData(0);        
     }
 
-    m_outboxMutex->Unlock();    
+    //
+    // Everything for this tick goes out together
+
+    NetRetCode result = m_sendBatch->Flush();
+    if( result != NetOk ) AppDebugOut( "SERVER write data result %d", (int) result );
+    
 
 
     float timeNow = GetHighResTime();
-    if( timeNow > s_timer + s_interval )
+    if( timeNow > m_sendRateTimer + s_interval )
     {
-        m_sendRate = s_bytesSent / s_interval;
-        s_bytesSent = 0;
-        s_timer = timeNow;
+        m_sendRate = m_bytesSent / s_interval;
+        m_bytesSent = 0;
+        m_sendRateTimer = timeNow;
     }
 
     END_PROFILE( "AdvanceSender" );
@@ -817,6 +1046,8 @@ int Server::CountEmptyMessages( int _startingSeqId )
         if( m_history.ValidIndex(i) )
         {
             ServerToClientLetter *theLetter = m_history[i];
+            if( !theLetter ) break;
+
             char *cmd = theLetter->m_data->GetDataString( NET_DEFCON_COMMAND );
             if( strcmp(cmd, NET_DEFCON_UPDATE ) == 0 &&
                        theLetter->m_data->m_subDirectories.NumUsed() == 0 )
@@ -861,6 +1092,13 @@ void Server::UpdateClients()
             }
 #endif
 
+            if( s2c->m_snapshot )
+            {
+                // The history starts again after the snapshot, once it has loaded it
+                SendSnapshotParts( s2c );
+                continue;
+            }
+
             s2c->m_lastSentSequenceId = max( s2c->m_lastSentSequenceId, s2c->m_lastKnownSequenceId );
             
             int sendFrom = s2c->m_lastSentSequenceId + 1;            
@@ -868,7 +1106,7 @@ void Server::UpdateClients()
             if( sendTo - sendFrom > 3 ) sendTo = sendFrom + 3;
                        
             int fallenBehindThreshold = 10;
-            if( !g_app->m_gameRunning ) fallenBehindThreshold = 4;
+            if( !IsGameRunning() ) fallenBehindThreshold = 4;
 
             if( s2c->m_lastKnownSequenceId < m_history.Size() - fallenBehindThreshold )
             {
@@ -888,7 +1126,7 @@ void Server::UpdateClients()
                 }
 
                 sendTo = sendFrom + 10;  
-                if( !g_app->m_gameRunning ) sendTo = sendFrom + 50;
+                if( !IsGameRunning() ) sendTo = sendFrom + 50;
             }
 
 
@@ -906,14 +1144,19 @@ void Server::UpdateClients()
                 letter->m_data->CreateData( NET_DEFCON_NUMEMPTYUPDATES, numEmptyMessages );
                 letter->m_data->CreateData( NET_DEFCON_SEQID, sendFrom );
 
-                m_outboxMutex->Lock();
                 m_outbox.PutDataAtEnd( letter );
-                m_outboxMutex->Unlock();
 
                 s2c->m_lastSentSequenceId = sendFrom + numEmptyMessages - 1;
             }
             else
             {
+                //
+                // Clients that need nothing taken out of their letters share
+                // one encoding of each, instead of a copy to encode each time
+
+                bool shareEncoding = !VersionManager::NeedsCompatability( s2c->m_version );
+                int letterFormat = VersionManager::ChooseLetterFormat( s2c->m_letterFormat );
+
                 for( int l = sendFrom; l < sendTo; ++l )
                 {
                     if( m_history.ValidIndex(l) )
@@ -922,9 +1165,18 @@ void Server::UpdateClients()
                         if( theLetter )
                         {
                             ServerToClientLetter *letterCopy = new ServerToClientLetter();
-                            letterCopy->m_data = new Directory(theLetter->m_data);
                             letterCopy->m_receiverId = s2c->m_clientId;
 
+                            if( shareEncoding )
+                            {
+                                letterCopy->m_encodedLetter = theLetter->GetEncoded( letterFormat );
+                                letterCopy->m_encodedLetter->AddRef();
+                            }
+                            else
+                            {
+                                letterCopy->m_data = new Directory(theLetter->m_data);
+                            }
+
                             // To help combat packet loss, re-send messages that have definately been sent
                             // (ie < lastSentSequenceId) but havent yet been acknowledged (>lastKnownSequenceId)
 
@@ -937,16 +1189,28 @@ void Server::UpdateClients()
                                 historyIndex -= 9;
                             }
 
+                            ServerToClientLetter *prevLetter = NULL;
                             if( historyIndex < l && m_history.ValidIndex(historyIndex) )
                             {
-                                Directory *prevData = new Directory(m_history[historyIndex]->m_data);
-                                prevData->SetName( NET_DEFCON_PREVUPDATE );
-                                letterCopy->m_data->AddDirectory( prevData );
+                                prevLetter = m_history[historyIndex];
+                            }
+
+                            if( prevLetter )
+                            {
+                                if( shareEncoding )
+                                {
+                                    letterCopy->m_encodedPrevUpdate = prevLetter->GetEncoded( letterFormat );
+                                    letterCopy->m_encodedPrevUpdate->AddRef();
+                                }
+                                else
+                                {
+                                    Directory *prevData = new Directory(prevLetter->m_data);
+                                    prevData->SetName( NET_DEFCON_PREVUPDATE );
+                                    letterCopy->m_data->AddDirectory( prevData );
+                                }
                             }
 
-                            m_outboxMutex->Lock();
                             m_outbox.PutDataAtEnd( letterCopy );
-                            m_outboxMutex->Unlock();
 
                             s2c->m_lastSentSequenceId = l;
                         }
@@ -975,7 +1239,7 @@ void Server::UpdateClients()
                 float timeBehind = GetHighResTime() - s2c->m_lastMessageReceived;
                 if( timeBehind > 3.0f )
                 {
-                    if( g_app->m_gameRunning )
+                    if( IsGameRunning() )
                     {
                         s2c->m_disconnected = Disconnect_ReadyForReconnect;
                     }
@@ -1005,15 +1269,21 @@ void Server::AuthenticateClients ()
                 AuthenticateClient( s2c->m_clientId );
             }
 
-            // Do a key check via the metaserver
+            // Do a key check via the metaserver,
+            // which mustn't hide a numerics mismatch
             int keyResult = Authentication_GetStatus( s2c->m_authKey );
-            if( keyResult < 0 )
+            if( keyResult < 0 && s2c->m_basicAuthCheck != -7 )
             {
                 s2c->m_basicAuthCheck = -3;
             }
             
-            // If its bad kick them now
-            if( s2c->m_basicAuthCheck < 0 )
+            // If its bad kick them now.
+            // Different numerics can only go out of sync, whatever the authentication level
+            if( s2c->m_basicAuthCheck == -7 )
+            {
+                RemoveClient( s2c->m_clientId, Disconnect_NumericsMismatch );
+            }
+            else if( s2c->m_basicAuthCheck < 0 )
             {
 #if AUTHENTICATION_LEVEL == 1
                 int kickReason = ( s2c->m_basicAuthCheck == -1 ? Disconnect_InvalidKey :
@@ -1124,7 +1394,7 @@ bool Server::IsDisconnectedClient( char *_ip, int _port )
 
 bool Server::CanClientRejoin( Directory *_message )
 {
-    if( !g_app->m_gameRunning ) return false;
+    if( !IsGameRunning() ) return false;
 
     int authKeyId = _message->GetDataInt( NET_METASERVER_AUTHKEYID );
     char *authKey = _message->GetDataString( NET_METASERVER_AUTHKEY );
@@ -1291,6 +1561,11 @@ void Server::HandleSyncMessage( Directory *incoming )
                 }
             }
         }
+
+        if( m_syncProbeSeqId == -1 )
+        {
+            StartSyncProbe( sequenceId );
+        }
     }
     
 
@@ -1320,91 +1595,635 @@ void Server::HandleSyncMessage( Directory *incoming )
 }
 
 
-void Server::ResynchroniseClient( int _clientId )
+void Server::ResynchroniseClient( int _clientId, Directory *_message )
 {
-    AppDebugOut( "Server received request to resynchronise client %d\n", _clientId );
-
     ServerToClient *sToC = GetClient(_clientId);
-    if( sToC )
-    {
-        sToC->m_lastKnownSequenceId = -1;
-        sToC->m_lastSentSequenceId = -1;        
-    }
-}
-
-
-void Server::SendModPath()
-{
-    char modPath[4096];
-    g_modSystem->GetCriticalModPath( modPath );
+    if( !sToC ) return;
 
-    ServerToClientLetter *letter = new ServerToClientLetter();    
-    letter->m_data = new Directory();
-    letter->m_data->SetName( NET_DEFCON_MESSAGE );    
-    letter->m_data->CreateData( NET_DEFCON_COMMAND, NET_DEFCON_SETMODPATH );
-    letter->m_data->CreateData( NET_DEFCON_SETMODPATH, modPath );
-    
-    SendLetter( letter );
-}
 
+    //
+    // Clients that can load a snapshot keep asking until it has arrived,
+    // saying which part they need next
 
-bool Server::CheckForExploits( Directory *message )
-{
-    char *cmd = message->GetDataString( NET_DEFCON_COMMAND );
+    int snapshotPart = -1;
+    int snapshotSeqId = -1;
 
-    //
-    // Exploit : Users can set a fleet movement request to an unreachable area, eg Hudson bay.
-    // This causes fleets to travel in a straight line directly to that invalid area,
-    // passing directly through any land masses in the way.
-    // Affects version 1.42 clients only.
+    if( _message->HasData( NET_DEFCON_SNAPSHOTPART, DIRECTORY_TYPE_INT ) &&
+        _message->HasData( NET_DEFCON_SNAPSHOTSEQID, DIRECTORY_TYPE_INT ) )
+    {
+        snapshotPart = _message->GetDataInt( NET_DEFCON_SNAPSHOTPART );
+        snapshotSeqId = _message->GetDataInt( NET_DEFCON_SNAPSHOTSEQID );
+    }
 
-    if( strcmp( cmd, NET_DEFCON_FLEETMOVE ) == 0 )
+    if( snapshotPart >= 0 )
     {
-        Fixed longitude = message->GetDataFixed(NET_DEFCON_LONGITUDE);
-        Fixed latitude = message->GetDataFixed(NET_DEFCON_LATTITUDE);
+        if( sToC->m_snapshot )
+        {
+            if( snapshotSeqId == sToC->m_snapshot->m_seqId )
+            {
+                sToC->m_snapshotAckedPart = snapshotPart;
+                sToC->m_snapshotNextPart = max( sToC->m_snapshotNextPart, snapshotPart );
+            }
+            return;
+        }
 
-        int nearestNode = g_app->GetWorld()->GetClosestNode( longitude, latitude );
+        if( snapshotSeqId != -1 )
+        {
+            // Late acknowledgement of a snapshot it has already loaded
+            return;
+        }
 
-        return( nearestNode == -1 );
+        AppDebugOut( "Server received request to resynchronise client %d\n", _clientId );
+        if( StartSendingSnapshot( sToC ) ) return;
+    }
+    else
+    {
+        AppDebugOut( "Server received request to resynchronise client %d\n", _clientId );
     }
 
 
     //
-    // No known exploit in here
+    // Replay the whole history
 
-    return false;
+    if( sToC->m_snapshot )
+    {
+        sToC->m_snapshot->Release();
+        sToC->m_snapshot = NULL;
+    }
+
+    sToC->m_lastKnownSequenceId = -1;
+    sToC->m_lastSentSequenceId = -1;        
 }
 
 
-void Server::Advance()
+void Server::RequestSnapshot()
 {
-    START_PROFILE( "Server Main Loop" );
+    if( !IsGameRunning() ) return;
+
 
     //
-    // Do some magic stuff in the very first Server Advance
+    // Keep asking until the snapshot is due, in case the request was lost,
+    // and give up on an upload that is taking too long
 
-    if( m_sequenceId == 0 )
+    if( m_snapshotUpload )
     {
-        SendModPath();
+        if( m_sequenceId < m_snapshotUpload->m_seqId )
+        {
+            SendSnapshotRequest( m_snapshotUploaderId, m_snapshotUpload->m_seqId );
+        }
+        else if( m_sequenceId > m_snapshotUpload->m_seqId + SERVER_SNAPSHOTTIMEOUT )
+        {
+            AppDebugOut( "SERVER: Client %d failed to upload snapshot %d\n", m_snapshotUploaderId, m_snapshotUpload->m_seqId );
+            SendSnapshotRequest( m_snapshotUploaderId, -1 );
+            m_snapshotUpload->Release();
+            m_snapshotUpload = NULL;
+        }
+        return;
     }
 
+    if( m_sequenceId < m_nextSnapshotSeqId ) return;
+    m_nextSnapshotSeqId = m_sequenceId + SERVER_SNAPSHOTINTERVAL;
+
 
     //
-    // Compile all incoming messages into a ServerToClientLetter
+    // Ask the next client that is keeping up and in sync
+
+    int numClients = m_clients.Size();
+    for( int i = 0; i < numClients; ++i )
+    {
+        int index = ( m_nextSnapshotClient + i ) % numClients;
+        if( m_clients.ValidIndex(index) )
+        {
+            ServerToClient *sToC = m_clients[index];
+            if( sToC->m_snapshotVersion > 0 &&
+                sToC->m_caughtUp &&
+                sToC->m_syncErrorSeqId == -1 &&
+                !sToC->m_snapshot )
+            {
+                int seqId = m_sequenceId + SERVER_SNAPSHOTLEADTIME;
+                m_snapshotUpload = new SnapshotParts( seqId, sToC->m_snapshotVersion );
+                m_snapshotUploaderId = sToC->m_clientId;
+                m_nextSnapshotClient = index + 1;
+
+                SendSnapshotRequest( sToC->m_clientId, seqId );
+                break;
+            }
+        }
+    }
+}
+
 
+void Server::SendSnapshotRequest( int _clientId, int _seqId )
+{
     ServerToClientLetter *letter = new ServerToClientLetter();
     letter->m_data = new Directory();
     letter->m_data->SetName( NET_DEFCON_MESSAGE );
-    letter->m_data->CreateData( NET_DEFCON_COMMAND, NET_DEFCON_UPDATE );
-    
-    
-    while( true )
-    {
-        Directory *incoming = GetNextLetter();
+    letter->m_data->CreateData( NET_DEFCON_COMMAND, NET_DEFCON_SNAPSHOTREQUEST );
+    letter->m_data->CreateData( NET_DEFCON_SNAPSHOTSEQID, _seqId );
+    letter->m_data->CreateData( NET_DEFCON_SEQID, -1 );
+    letter->m_receiverId = _clientId;
 
-        if( !incoming ) break;
+    m_outbox.PutDataAtEnd( letter );
+}
 
-        //
+
+void Server::ReceiveSnapshotPart( int _clientId, Directory *_message )
+{
+    if( !m_snapshotUpload || _clientId != m_snapshotUploaderId ) return;
+    if( !m_snapshotUpload->ReadPart( _message ) || !m_snapshotUpload->IsComplete() ) return;
+
+    SnapshotParts *snapshot = m_snapshotUpload;
+    int seqId = snapshot->m_seqId;
+    m_snapshotUpload = NULL;
+
+    SendSnapshotRequest( _clientId, -1 );
+
+
+    //
+    // The uploader could be out of sync without knowing it yet,
+    // so only keep the snapshot if nobody disagrees with its sync value
+
+    ServerToClient *uploader = GetClient( _clientId );
+    bool agreed = ( uploader &&
+                    uploader->m_syncErrorSeqId == -1 &&
+                    uploader->m_sync.ValidIndex(seqId) );
+    int numOthers = 0;
+    int numSame = 0;
+
+    for( int i = 0; agreed && i < m_clients.Size(); ++i )
+    {
+        if( m_clients.ValidIndex(i) )
+        {
+            ServerToClient *sToC = m_clients[i];
+            if( sToC != uploader && sToC->m_sync.ValidIndex(seqId) )
+            {
+                ++numOthers;
+                if( sToC->m_sync[seqId] == uploader->m_sync[seqId] ) ++numSame;
+            }
+        }
+    }
+
+    if( !agreed || ( numOthers > 0 && numSame == 0 ) )
+    {
+        AppDebugOut( "SERVER: Discarded snapshot %d from client %d, its sync value wasn't agreed\n", seqId, _clientId );
+        snapshot->Release();
+        return;
+    }
+
+    AppDebugOut( "SERVER: Received snapshot %d from client %d (%d bytes)\n", seqId, _clientId, snapshot->GetByteSize() );
+
+    if( m_snapshot ) m_snapshot->Release();
+    m_snapshot = snapshot;
+}
+
+
+bool Server::StartSendingSnapshot( ServerToClient *_sToC )
+{
+    if( !_sToC || !m_snapshot ) return false;
+    if( _sToC->m_snapshotVersion != m_snapshot->m_version ) return false;
+
+    AppDebugOut( "SERVER: Sending snapshot %d to client %d\n", m_snapshot->m_seqId, _sToC->m_clientId );
+
+    if( _sToC->m_snapshot ) _sToC->m_snapshot->Release();
+    _sToC->m_snapshot = m_snapshot;
+    _sToC->m_snapshot->AddRef();
+    _sToC->m_snapshotNextPart = 0;
+    _sToC->m_snapshotAckedPart = 0;
+
+    _sToC->m_lastKnownSequenceId = -1;
+    _sToC->m_lastSentSequenceId = -1;
+
+    return true;
+}
+
+
+void Server::SendSnapshotParts( ServerToClient *_sToC )
+{
+    SnapshotParts *snapshot = _sToC->m_snapshot;
+    if( _sToC->m_snapshotAckedPart >= snapshot->m_numParts ) return;        // It has them all, and is loading
+
+    for( int i = 0; i < SERVER_SNAPSHOTPARTSPERTICK; ++i )
+    {
+        if( _sToC->m_snapshotNextPart >= snapshot->m_numParts )
+        {
+            // Go round again, for the parts that were lost
+            _sToC->m_snapshotNextPart = _sToC->m_snapshotAckedPart;
+        }
+
+        ServerToClientLetter *letter = new ServerToClientLetter();
+        letter->m_data = new Directory();
+        letter->m_data->SetName( NET_DEFCON_MESSAGE );
+        letter->m_data->CreateData( NET_DEFCON_COMMAND, NET_DEFCON_SNAPSHOT );
+        letter->m_data->CreateData( NET_DEFCON_SEQID, -1 );
+        snapshot->WritePart( letter->m_data, _sToC->m_snapshotNextPart );
+        letter->m_receiverId = _sToC->m_clientId;
+
+        m_outbox.PutDataAtEnd( letter );
+
+        ++_sToC->m_snapshotNextPart;
+    }
+}
+
+
+// Each client keeps a tree of hashes over its World for the latest letters.
+// When one is out of sync we compare its tree with a client that disagrees,
+// a node at a time, following the first child that differs down to a leaf
+
+void Server::StartSyncProbe( int _seqId )
+{
+    ServerToClient *outOfSync = NULL;
+    ServerToClient *reference = NULL;
+
+    for( int i = 0; i < m_clients.Size(); ++i )
+    {
+        if( m_clients.ValidIndex(i) && m_clients[i]->m_syncErrorSeqId == _seqId )
+        {
+            outOfSync = m_clients[i];
+            break;
+        }
+    }
+
+    if( !outOfSync ) return;
+
+    for( int i = 0; i < m_clients.Size(); ++i )
+    {
+        if( m_clients.ValidIndex(i) )
+        {
+            ServerToClient *thisClient = m_clients[i];
+            if( thisClient != outOfSync &&
+                thisClient->m_sync.ValidIndex(_seqId) &&
+                thisClient->m_sync[_seqId] != outOfSync->m_sync[_seqId] &&
+                ( !reference || thisClient->m_syncErrorSeqId == -1 ) )
+            {
+                reference = thisClient;
+            }
+        }
+    }
+
+    if( !reference ) return;
+
+    m_syncProbeSeqId = _seqId;
+    m_syncProbeClientId[0] = outOfSync->m_clientId;
+    m_syncProbeClientId[1] = reference->m_clientId;
+    m_syncProbeDepth = 0;
+    m_syncProbeStarted = m_sequenceId;
+    m_syncProbeAsked = m_sequenceId;
+
+    AppDebugOut( "SYNCERROR Server: Comparing world hashes of clients %d and %d at letter %d\n",
+                 m_syncProbeClientId[0], m_syncProbeClientId[1], _seqId );
+
+    SendSyncHashRequest( m_syncProbeClientId[0] );
+    SendSyncHashRequest( m_syncProbeClientId[1] );
+}
+
+
+void Server::AdvanceSyncProbe()
+{
+    if( m_syncProbeSeqId == -1 ) return;
+
+    if( !GetClient( m_syncProbeClientId[0] ) ||
+        !GetClient( m_syncProbeClientId[1] ) ||
+        m_sequenceId > m_syncProbeStarted + SERVER_SYNCPROBETIMEOUT )
+    {
+        AppDebugOut( "SYNCERROR Server: Gave up comparing world hashes at letter %d\n", m_syncProbeSeqId );
+        EndSyncProbe( false );
+        return;
+    }
+
+    if( m_sequenceId >= m_syncProbeAsked + SERVER_SYNCPROBERESEND )
+    {
+        for( int i = 0; i < 2; ++i )
+        {
+            if( !m_syncProbeReply[i] ) SendSyncHashRequest( m_syncProbeClientId[i] );
+        }
+        m_syncProbeAsked = m_sequenceId;
+    }
+}
+
+
+void Server::SendSyncHashRequest( int _clientId )
+{
+    ServerToClientLetter *letter = new ServerToClientLetter();
+    letter->m_data = new Directory();
+    letter->m_data->SetName( NET_DEFCON_MESSAGE );
+    letter->m_data->CreateData( NET_DEFCON_COMMAND, NET_DEFCON_SYNCHASHREQUEST );
+    letter->m_data->CreateData( NET_DEFCON_SYNCHASHSEQID, m_syncProbeSeqId );
+    LetterCodec::WriteInts( letter->m_data, NET_DEFCON_SYNCHASHPATH, m_syncProbePath, m_syncProbeDepth );
+    letter->m_data->CreateData( NET_DEFCON_SEQID, -1 );
+    letter->m_receiverId = _clientId;
+
+    m_outbox.PutDataAtEnd( letter );
+}
+
+
+void Server::ReceiveSyncHash( int _clientId, Directory *_message )
+{
+    if( m_syncProbeSeqId == -1 ) return;
+
+    int index = -1;
+    for( int i = 0; i < 2; ++i )
+    {
+        if( m_syncProbeClientId[i] == _clientId ) index = i;
+    }
+
+    if( index == -1 || m_syncProbeReply[index] ) return;
+
+
+    //
+    // Ignore answers to questions we asked before
+
+    if( _message->GetDataInt( NET_DEFCON_SYNCHASHSEQID ) != m_syncProbeSeqId ) return;
+
+    int path[SERVER_SYNCPROBEMAXDEPTH];
+    int depth = LetterCodec::ReadInts( _message, NET_DEFCON_SYNCHASHPATH, path, SERVER_SYNCPROBEMAXDEPTH );
+    if( depth != m_syncProbeDepth ) return;
+
+    for( int i = 0; i < depth; ++i )
+    {
+        if( path[i] != m_syncProbePath[i] ) return;
+    }
+
+    m_syncProbeReply[index] = new Directory( _message );
+
+    if( m_syncProbeReply[0] && m_syncProbeReply[1] )
+    {
+        CompareSyncHashes();
+    }
+}
+
+
+void Server::CompareSyncHashes()
+{
+    int numChildren[2];
+
+    for( int i = 0; i < 2; ++i )
+    {
+        numChildren[i] = -1;
+        if( m_syncProbeReply[i]->HasData( NET_DEFCON_SYNCHASHCHILDREN, DIRECTORY_TYPE_INT ) )
+        {
+            numChildren[i] = m_syncProbeReply[i]->GetDataInt( NET_DEFCON_SYNCHASHCHILDREN );
+        }
+    }
+
+
+    //
+    // Finished if only one of them has this node, or it has no children
+
+    if( numChildren[0] == -1 && numChildren[1] == -1 )
+    {
+        AppDebugOut( "SYNCERROR Server: Clients no longer have the world hashes for letter %d\n", m_syncProbeSeqId );
+        EndSyncProbe( false );
+        return;
+    }
+
+    if( numChildren[0] <= 0 || numChildren[1] <= 0 ||
+        m_syncProbeDepth >= SERVER_SYNCPROBEMAXDEPTH )
+    {
+        EndSyncProbe( true );
+        return;
+    }
+
+
+    //
+    // Otherwise follow the first child that differs
+
+    int *keys[2];
+    int *values[2];
+
+    for( int i = 0; i < 2; ++i )
+    {
+        keys[i] = new int[WORLDHASH_MAXCHILDREN];
+        values[i] = new int[WORLDHASH_MAXCHILDREN];
+
+        int numKeys = LetterCodec::ReadInts( m_syncProbeReply[i], NET_DEFCON_SYNCHASHKEYS, keys[i], WORLDHASH_MAXCHILDREN );
+        int numValues = LetterCodec::ReadInts( m_syncProbeReply[i], NET_DEFCON_SYNCHASHVALUES, values[i], WORLDHASH_MAXCHILDREN );
+        numChildren[i] = min( numKeys, numValues );
+    }
+
+    int differs = -1;
+    bool onlyOne = false;
+
+    for( int i = 0; i < numChildren[0] && differs == -1; ++i )
+    {
+        int j = 0;
+        while( j < numChildren[1] && keys[1][j] != keys[0][i] ) ++j;
+
+        if( j == numChildren[1] )                   { differs = keys[0][i]; onlyOne = true; }
+        else if( values[1][j] != values[0][i] )     { differs = keys[0][i]; }
+    }
+
+    for( int j = 0; j < numChildren[1] && differs == -1; ++j )
+    {
+        int i = 0;
+        while( i < numChildren[0] && keys[0][i] != keys[1][j] ) ++i;
+
+        if( i == numChildren[0] )                   { differs = keys[1][j]; onlyOne = true; }
+    }
+
+    for( int i = 0; i < 2; ++i )
+    {
+        delete [] keys[i];
+        delete [] values[i];
+    }
+
+    if( differs == -1 )
+    {
+        // The children agree, so it's this node itself
+        EndSyncProbe( true );
+    }
+    else if( onlyOne )
+    {
+        m_syncProbePath[m_syncProbeDepth++] = differs;
+        EndSyncProbe( true );
+    }
+    else
+    {
+        DescendSyncProbe( differs );
+    }
+}
+
+
+void Server::DescendSyncProbe( int _key )
+{
+    m_syncProbePath[m_syncProbeDepth++] = _key;
+
+    for( int i = 0; i < 2; ++i )
+    {
+        delete m_syncProbeReply[i];
+        m_syncProbeReply[i] = NULL;
+
+        SendSyncHashRequest( m_syncProbeClientId[i] );
+    }
+
+    m_syncProbeAsked = m_sequenceId;
+}
+
+
+void Server::EndSyncProbe( bool _found )
+{
+    if( _found )
+    {
+        char pathName[256];
+        LetterCodec::GetHashPathName( m_syncProbePath, m_syncProbeDepth, pathName );
+
+        AppDebugOut( "SYNCERROR Server: Client %d differs from client %d at letter %d, in %s\n",
+                     m_syncProbeClientId[0], m_syncProbeClientId[1], m_syncProbeSeqId, pathName );
+
+        ServerToClientLetter *letter = new ServerToClientLetter();
+        letter->m_data = new Directory();
+        letter->m_data->SetName( NET_DEFCON_MESSAGE );
+        letter->m_data->CreateData( NET_DEFCON_COMMAND, NET_DEFCON_SYNCHASHRESULT );
+        letter->m_data->CreateData( NET_DEFCON_CLIENTID, m_syncProbeClientId[0] );
+        letter->m_data->CreateData( NET_DEFCON_SYNCHASHSEQID, m_syncProbeSeqId );
+        LetterCodec::WriteInts( letter->m_data, NET_DEFCON_SYNCHASHPATH, m_syncProbePath, m_syncProbeDepth );
+        SendLetter( letter );
+    }
+
+    for( int i = 0; i < 2; ++i )
+    {
+        delete m_syncProbeReply[i];
+        m_syncProbeReply[i] = NULL;
+        m_syncProbeClientId[i] = -1;
+    }
+
+    m_syncProbeSeqId = -1;
+    m_syncProbeDepth = 0;
+}
+
+
+void Server::SendModPath()
+{
+    char modPath[4096];
+    GetCriticalModPath( modPath );
+
+    ServerToClientLetter *letter = new ServerToClientLetter();    
+    letter->m_data = new Directory();
+    letter->m_data->SetName( NET_DEFCON_MESSAGE );    
+    letter->m_data->CreateData( NET_DEFCON_COMMAND, NET_DEFCON_SETMODPATH );
+    letter->m_data->CreateData( NET_DEFCON_SETMODPATH, modPath );
+    
+    SendLetter( letter );
+}
+
+
+void Server::SendGameOptions()
+{
+    //
+    // Send every option as if it had been changed in the lobby.
+    // GameMode goes first, as changing it resets most of the others.
+
+#ifdef DEDICATED_SERVER
+    LList<GameOption *> &options = m_lobby->m_options;
+#else
+    LList<GameOption *> &options = g_app->GetGame()->m_options;
+#endif
+
+    ServerToClientLetter *letter = new ServerToClientLetter();
+    letter->m_data = new Directory();
+    letter->m_data->SetName( NET_DEFCON_MESSAGE );
+    letter->m_data->CreateData( NET_DEFCON_COMMAND, NET_DEFCON_UPDATE );
+
+    for( int pass = 0; pass < 2; ++pass )
+    {
+        for( int i = 0; i < options.Size(); ++i )
+        {
+            GameOption *option = options[i];
+            bool gameMode = ( strcmp( option->m_name, "GameMode" ) == 0 );
+            if( gameMode != (pass == 0) ) continue;
+
+            Directory *update = new Directory();
+            update->SetName( NET_DEFCON_MESSAGE );
+            update->CreateData( NET_DEFCON_COMMAND,     NET_DEFCON_CHANGEOPTION );
+            update->CreateData( NET_DEFCON_OPTIONID,    (unsigned char) i );
+
+            if( option->m_change == -1 )
+            {
+                update->CreateData( NET_DEFCON_OPTIONVALUE, option->m_currentString );
+            }
+            else
+            {
+                update->CreateData( NET_DEFCON_OPTIONVALUE, option->m_currentValue );
+            }
+
+            letter->m_data->AddDirectory( update );
+        }
+    }
+
+    SendLetter( letter );
+}
+
+
+bool Server::CheckForExploits( Directory *message )
+{
+    char *cmd = message->GetDataString( NET_DEFCON_COMMAND );
+
+    //
+    // Exploit : Users can set a fleet movement request to an unreachable area, eg Hudson bay.
+    // This causes fleets to travel in a straight line directly to that invalid area,
+    // passing directly through any land masses in the way.
+    // Affects version 1.42 clients only.
+
+#ifndef DEDICATED_SERVER
+    if( strcmp( cmd, NET_DEFCON_FLEETMOVE ) == 0 )
+    {
+        Fixed longitude = message->GetDataFixed(NET_DEFCON_LONGITUDE);
+        Fixed latitude = message->GetDataFixed(NET_DEFCON_LATTITUDE);
+
+        int nearestNode = g_app->GetWorld()->GetClosestNode( longitude, latitude );
+
+        return( nearestNode == -1 );
+    }
+#else
+    //
+    // A dedicated server has no travel nodes to check fleet moves against.
+    // It also has no host, so nobody may change the game options.
+
+    if( strcmp( cmd, NET_DEFCON_CHANGEOPTION ) == 0 )
+    {
+        return true;
+    }
+#endif
+
+
+    //
+    // No known exploit in here
+
+    return false;
+}
+
+
+void Server::Advance()
+{
+    START_PROFILE( "Server Main Loop" );
+
+    //
+    // Do some magic stuff in the very first Server Advance
+
+    if( m_sequenceId == 0 )
+    {
+        SendModPath();
+#ifdef DEDICATED_SERVER
+        SendGameOptions();
+#endif
+    }
+
+
+    //
+    // Compile all incoming messages into a ServerToClientLetter
+
+    ServerToClientLetter *letter = new ServerToClientLetter();
+    letter->m_data = new Directory();
+    letter->m_data->SetName( NET_DEFCON_MESSAGE );
+    letter->m_data->CreateData( NET_DEFCON_COMMAND, NET_DEFCON_UPDATE );
+    
+    
+    while( true )
+    {
+        Directory *incoming = GetNextLetter();
+
+        if( !incoming ) break;
+
+        //
         // Sanity check the message
 
         if( strcmp(incoming->m_name, NET_DEFCON_MESSAGE) != 0 ||
@@ -1439,6 +2258,12 @@ void Server::Advance()
                 {
                     clientId = RegisterNewClient( incoming );                   
                 }
+
+                if( IsGameRunning() )
+                {
+                    // Rather than the whole history, if we can
+                    StartSendingSnapshot( GetClient(clientId) );
+                }
             }
 
             SendClientId( clientId );            
@@ -1454,7 +2279,21 @@ void Server::Advance()
         {
             if( clientId != -1 )
             {
-                ResynchroniseClient( clientId );
+                ResynchroniseClient( clientId, incoming );
+            }
+        }
+        else if( strcmp(cmd, NET_DEFCON_SNAPSHOTUPLOAD) == 0 )
+        {
+            if( clientId != -1 )
+            {
+                ReceiveSnapshotPart( clientId, incoming );
+            }
+        }
+        else if( strcmp(cmd, NET_DEFCON_SYNCHASH) == 0 )
+        {
+            if( clientId != -1 )
+            {
+                ReceiveSyncHash( clientId, incoming );
             }
         }
         else if ( strcmp(cmd, NET_DEFCON_REQUEST_SPECTATE) == 0 )
@@ -1466,7 +2305,7 @@ void Server::Advance()
         }
         else if ( strcmp(cmd, NET_DEFCON_REQUEST_TEAM ) == 0 )
         {
-            if( clientId != -1 && !g_app->m_gameRunning )
+            if( clientId != -1 && !IsGameRunning() )
             {
                 int teamType = incoming->GetDataInt(NET_DEFCON_TEAMTYPE);
                 RegisterNewTeam(clientId, teamType );
@@ -1543,6 +2382,14 @@ void Server::Advance()
                 {
                     sToc->m_lastKnownSequenceId = lastSeqId;
                 }
+
+                if( sToc->m_snapshot && lastSeqId >= sToc->m_snapshot->m_seqId )
+                {
+                    // It has loaded the snapshot, so carry on from the letter after it
+                    AppDebugOut( "SERVER: Client %d loaded snapshot %d\n", clientId, sToc->m_snapshot->m_seqId );
+                    sToc->m_snapshot->Release();
+                    sToc->m_snapshot = NULL;
+                }
             }
         }
 
@@ -1553,6 +2400,18 @@ void Server::Advance()
     SendLetter( letter );
 
 
+    //
+    // Keep a recent snapshot of the game for clients that rejoin or resynchronise
+
+    RequestSnapshot();
+
+
+    //
+    // Keep looking for where the last desync happened
+
+    AdvanceSyncProbe();
+
+
     //
     // Update all clients by sending the next updates to them
     
@@ -1593,7 +2452,7 @@ void Server::Advance()
     // Save our server settings to a file 
     // for other testbed clients to read
 
-    if( !g_app->m_gameRunning )
+    if( !IsGameRunning() )
     {
         static float s_testBedTimer = 0.0f;
         if( GetHighResTime() > s_testBedTimer )
@@ -1606,7 +2465,7 @@ void Server::Advance()
                 char localHost[256];
                 GetLocalHostIP( localHost, 256 );
                 int localPort = GetLocalPort();
-                int maxTeams = g_app->GetGame()->GetOptionValue("MaxTeams");
+                int maxTeams = GetOptionValue("MaxTeams");
 
                 fprintf( file, "IP         %s\n", localHost );
                 fprintf( file, "PORT       %d\n", localPort );
@@ -1625,15 +2484,17 @@ void Server::Advance()
 
 void Server::Advertise()
 {
-    bool advertiseOnWan = g_app->GetGame()->GetOptionValue("AdvertiseOnInternet");
-    bool advertiseOnLan = g_app->GetGame()->GetOptionValue("AdvertiseOnLAN");
+    if( !m_advertise ) return;
+
+    bool advertiseOnWan = GetOptionValue("AdvertiseOnInternet");
+    bool advertiseOnLan = GetOptionValue("AdvertiseOnLAN");
 
     char authKey[256];
     Authentication_GetKey( authKey );
     int authResult = Authentication_GetStatus(authKey);
 
-    int maxTeams        = g_app->GetGame()->GetOptionValue("MaxTeams");
-    int maxSpectators   = g_app->GetGame()->GetOptionValue("MaxSpectators");
+    int maxTeams        = GetOptionValue("MaxTeams");
+    int maxSpectators   = GetOptionValue("MaxSpectators");
     int currentTeams    = m_teams.NumUsed();
     int numSpectators   = GetNumSpectators();
     int numDemoTeams    = GetNumDemoTeams();
@@ -1644,7 +2505,7 @@ void Server::Advertise()
 
     if( advertiseOnWan || advertiseOnLan )
     {
-        char *serverName = g_app->GetGame()->GetOption("ServerName")->m_currentString;
+        char *serverName = GetOptionString("ServerName");
 
         char localIp[256];
         GetLocalHostIP( localIp, 256 );
@@ -1669,21 +2530,25 @@ void Server::Advertise()
         serverProperties.CreateData( NET_METASERVER_MAXTEAMS,       (unsigned char) maxTeams );
         serverProperties.CreateData( NET_METASERVER_NUMSPECTATORS,  (unsigned char) numSpectators );
         serverProperties.CreateData( NET_METASERVER_MAXSPECTATORS,  (unsigned char) maxSpectators );
-        serverProperties.CreateData( NET_METASERVER_GAMEMODE,       (unsigned char) g_app->GetGame()->GetOptionValue("GameMode") );
-        serverProperties.CreateData( NET_METASERVER_SCOREMODE,      (unsigned char) g_app->GetGame()->GetOptionValue("ScoreMode") );
+        serverProperties.CreateData( NET_METASERVER_GAMEMODE,       (unsigned char) GetOptionValue("GameMode") );
+        serverProperties.CreateData( NET_METASERVER_SCOREMODE,      (unsigned char) GetOptionValue("ScoreMode") );
 
-        if( g_app->m_gameRunning )
+#ifndef DEDICATED_SERVER
+        if( IsGameRunning() )
         {
             serverProperties.CreateData( NET_METASERVER_GAMETIME, g_app->GetWorld()->m_theDate.m_theDate.IntValue() );
         }
+#endif
 
 
         //
         // Game state
 
         int state = 0;
-        if( g_app->m_gameRunning ) state = 1;
-        if( g_app->m_gameRunning && g_app->GetGame()->m_winner != -1 ) state = 2;
+        if( IsGameRunning() ) state = 1;
+#ifndef DEDICATED_SERVER
+        if( IsGameRunning() && g_app->GetGame()->m_winner != -1 ) state = 2;
+#endif
 
         serverProperties.CreateData( NET_METASERVER_GAMEINPROGRESS, (unsigned char) state );
 
@@ -1693,15 +2558,17 @@ void Server::Advertise()
 
         LList<int> teamOrdering;
 
-        for( int i = 0; i <  g_app->GetWorld()->m_teams.Size(); ++i )
+        LList<HostTeam *> &teams = GetHostTeams( m_lobby );
+
+        for( int i = 0; i < teams.Size(); ++i )
         {
-            Team *team = g_app->GetWorld()->m_teams[i];
-            int teamScore = g_app->GetGame()->GetScore(team->m_teamId);
+            HostTeam *team = teams[i];
+            int teamScore = GetHostTeamScore( m_lobby, team->m_teamId );
 
             bool added = false;
             for( int j = 0; j < teamOrdering.Size(); ++j )
             {
-                int thisScore = g_app->GetGame()->GetScore( teamOrdering[j] );
+                int thisScore = GetHostTeamScore( m_lobby, teamOrdering[j] );
                 if( teamScore < thisScore )
                 {
                     teamOrdering.PutDataAtIndex( team->m_teamId, j );
@@ -1725,12 +2592,12 @@ void Server::Advertise()
         for( int i = teamOrdering.Size()-1; i >= 0; --i )
         {            
             int teamId = teamOrdering[i];
-            Team *team = g_app->GetWorld()->GetTeam(teamId);
+            HostTeam *team = GetHostTeam( m_lobby, teamId );
             ServerToClient *client = GetClient( team->m_clientId );
             bool isDemo = client && Authentication_IsDemoKey(client->m_authKey);
 
             char fullName[512];
-            int score = g_app->GetGame()->GetScore( team->m_teamId );
+            int score = GetHostTeamScore( m_lobby, team->m_teamId );
             if( team->m_type == Team::TypeAI )
 			{
 				sprintf( fullName, LANGUAGEPHRASE("dialog_worldstatus_cpu_team_name") );
@@ -1767,7 +2634,7 @@ void Server::Advertise()
         //
         // Password
 
-        char *password = g_app->GetGame()->GetOption("ServerPassword")->m_currentString;
+        char *password = GetOptionString("ServerPassword");
         if( password && strlen(password) > 0 )
         {
             serverProperties.CreateData( NET_METASERVER_PASSWORD, password );
@@ -1778,7 +2645,7 @@ void Server::Advertise()
         // Mod path
 
         char modPath[4096];
-        g_modSystem->GetCriticalModPath( modPath );
+        GetCriticalModPath( modPath );
         
         if( modPath[0] != '\x0' )
         {
@@ -1822,7 +2689,7 @@ void Server::Advertise()
     // (he's playing single player, so no point)
 
     bool singlePlayer = false;    
-    if( g_app->m_gameRunning && 
+    if( IsGameRunning() && 
         m_clients.NumUsed() == 1 && 
         maxSpectators == 0 )
     {
@@ -1839,7 +2706,7 @@ void Server::Advertise()
         !full &&
         !singlePlayer )
     {
-        MatchMaker_StartRequestingIdentity( s_listener );
+        MatchMaker_StartRequestingIdentity( m_listener );
         MetaServer_StartRegisteringOverWAN();
     }
     else if( MetaServer_IsRegisteringOverWAN() )
@@ -1850,7 +2717,7 @@ void Server::Advertise()
             singlePlayer )
         {
             MetaServer_StopRegisteringOverWAN();
-            MatchMaker_StopRequestingIdentity( s_listener );
+            MatchMaker_StopRequestingIdentity( m_listener );
         }
     }
 
@@ -1951,6 +2818,31 @@ void Server::AuthenticateClient ( int _clientId )
     ServerToClient *client = GetClient(_clientId);
     AppAssert(client);
 
+    //
+    // The simulation must give identical results on every machine,
+    // so a client built with different numerics can never play here
+
+    if( strcmp( client->m_numerics, FIXED_NUMERICS_REVISION ) != 0 )
+    {
+        client->m_basicAuthCheck = -7;
+        AppDebugOut( "Client %d uses numerics %s, but this server uses %s\n", 
+                     _clientId, client->m_numerics, FIXED_NUMERICS_REVISION );
+        return;
+    }
+
+    //
+    // Likewise a client that cuts its sync byte from a different hash
+    // would be flagged out of sync on its first update
+
+    if( client->m_syncHashRevision != WORLDHASH_REVISION )
+    {
+        client->m_basicAuthCheck = -7;
+        AppDebugOut( "Client %d uses sync hash revision %d, but this server uses %d\n",
+                     _clientId, client->m_syncHashRevision, WORLDHASH_REVISION );
+        return;
+    }
+
+
     //
     // Basic key check first
 
@@ -2008,14 +2900,14 @@ void Server::AuthenticateClient ( int _clientId )
     // Are there too many teams already?
 
     int numTeams = GetNumTeams( _clientId );
-    int maxTeams = g_app->GetGame()->GetOptionValue("MaxTeams");
+    int maxTeams = GetOptionValue("MaxTeams");
     int numSpectators = GetNumSpectators();
-    int maxSpectators = g_app->GetGame()->GetOptionValue("MaxSpectators");
+    int maxSpectators = GetOptionValue("MaxSpectators");
     
     if( numTeams == 0 )
     {
-        if( g_app->GetWorld()->m_teams.Size() >= maxTeams || 
-            g_app->m_gameRunning )
+        if( GetHostTeams( m_lobby ).Size() >= maxTeams || 
+            IsGameRunning() )
         {
             if( numSpectators >= maxSpectators )
             {
@@ -2043,16 +2935,16 @@ void Server::AuthenticateClient ( int _clientId )
         int maxDemoGameSize;
         int maxDemoPlayers;
         bool allowDemoServers;
-        g_app->GetClientToServer()->GetDemoLimitations( maxDemoGameSize, maxDemoPlayers, allowDemoServers );
+        GetDemoLimitations( maxDemoGameSize, maxDemoPlayers, allowDemoServers );
 
-        if( g_app->GetClientToServer()->AmIDemoClient() )
+        if( AmIDemoServer() )
         {
             // We (the server) are a DEMO.  Always allow 2 player demo games.
             maxDemoPlayers = max( maxDemoPlayers, 2 );
         }
 
         if( numDemoTeams >= maxDemoPlayers ||
-            g_app->GetGame()->GetOptionValue("GameMode") != 0 )
+            GetOptionValue("GameMode") != 0 )
         {
             if( numSpectators >= maxSpectators )
             {
@@ -2067,7 +2959,7 @@ void Server::AuthenticateClient ( int _clientId )
             }
         }
 
-        if( g_modSystem->IsCriticalModRunning() )
+        if( IsCriticalModRunning() )
         {
             AppDebugOut( "Cannot allow Demo users to join when MODs are running\n" );
             client->m_basicAuthCheck = -6;
@@ -2081,7 +2973,7 @@ void Server::AuthenticateClient ( int _clientId )
     // (ie < v1.2) we must disconnect them now.
 
     if( !VersionManager::DoesSupportModSystem(client->m_version) &&
-        g_modSystem->IsCriticalModRunning() )
+        IsCriticalModRunning() )
     {
         AppDebugOut( "This client does not support MODs, disconnecting\n" );
         client->m_basicAuthCheck = -5;
@@ -2092,7 +2984,7 @@ void Server::AuthenticateClient ( int _clientId )
     //
     // Check for a password
 
-    char *password = g_app->GetGame()->GetOption("ServerPassword")->m_currentString;
+    char *password = GetOptionString("ServerPassword");
 
     if( password && 
         strlen(password) > 0 &&
@@ -2115,22 +3007,39 @@ void Server::AuthenticateClient ( int _clientId )
 
 int Server::GetHistoryByteSize ()
 {
-    int byteSize = 0;
-    
-    for( int i = 0; i < m_history.Size(); ++i )
+    return m_history.GetByteSize();
+}
+
+
+void Server::GetDemoLimitations( int &_maxGameSize, int &_maxDemoPlayers, bool &_allowDemoServers )
+{
+    Directory *demoLims = MetaServer_RequestData( NET_METASERVER_DATA_DEMOLIMITS );
+
+    if( demoLims &&
+        demoLims->HasData( NET_METASERVER_MAXDEMOGAMESIZE, DIRECTORY_TYPE_INT ) &&
+        demoLims->HasData( NET_METASERVER_MAXDEMOPLAYERS, DIRECTORY_TYPE_INT ) &&
+        demoLims->HasData( NET_METASERVER_ALLOWDEMOSERVERS, DIRECTORY_TYPE_BOOL) )
     {
-        ServerToClientLetter *letter = m_history[i];
-        byteSize += sizeof(letter);
-        byteSize += letter->m_data->GetByteSize();
+        // The MetaServer gave us these numbers
+        _maxGameSize = demoLims->GetDataInt( NET_METASERVER_MAXDEMOGAMESIZE );
+        _maxDemoPlayers = demoLims->GetDataInt( NET_METASERVER_MAXDEMOPLAYERS );
+        _allowDemoServers = demoLims->GetDataBool( NET_METASERVER_ALLOWDEMOSERVERS );
+        delete demoLims;
     }
-  
-    return byteSize;
+    else
+    {
+        // We don't have a clear answer from the MetaServer
+        // So go with sensible defaults
+        _maxGameSize = 2;
+        _maxDemoPlayers = 2;
+        _allowDemoServers = true;
+    }    
 }
 
 
 bool Server::GetIdentity( char *_ip, int *_port )
 {
-    return MatchMaker_GetIdentity( s_listener, _ip, _port );
+    return MatchMaker_GetIdentity( m_listener, _ip, _port );
 }
 
 
@@ -5,16 +5,34 @@
 #include "lib/tosser/darray.h"
 #include "lib/tosser/directory.h"
 
+#include "network/letter_codec.h"
+#include "network/letter_history.h"
+
 
 class NetLib;
-class NetMutex;
+class NetSendBatch;
 class NetSocketListener;
 class ServerToClient;
 class ServerToClientLetter;
 class ServerTeam;
+class ServerLobby;
+class SnapshotParts;
+
+template <class T> class NetQueue;
 
 #define UDP_HEADER_SIZE     32           // 12 bytes for UDP header, 20 bytes for IP header
 
+#define SERVER_INBOXSIZE                4096                // Letters the listener thread can get ahead of Advance
+
+#define SERVER_SNAPSHOTINTERVAL         600                 // Letters between asking for new snapshots
+#define SERVER_SNAPSHOTLEADTIME         10                  // Snapshots are taken this many letters from now
+#define SERVER_SNAPSHOTTIMEOUT          300                 // Letters to wait for an upload to finish
+#define SERVER_SNAPSHOTPARTSPERTICK     2                   // Parts sent each Advance to a client loading one
+
+#define SERVER_SYNCPROBEMAXDEPTH        8                   // Deeper than any WorldHash
+#define SERVER_SYNCPROBERESEND          10                  // Letters between asking again for hashes that haven't arrived
+#define SERVER_SYNCPROBETIMEOUT         300                 // Letters to wait before giving up on finding a desync
+
 
 
 
@@ -22,12 +40,56 @@ class Server
 {
 protected:
     NetLib          *m_netLib;   
-    LList           <ServerToClientLetter *> m_history;
+    LetterHistory   m_history;
+
+    NetSocketListener   *m_listener;
+    bool            m_listenerRunning;
+
+    float           m_sendRateTimer;
+    int             m_bytesSent;
+    int             m_largestLetter;
+
+    char            *m_sendBuffer;                              // Reused by AdvanceSender for every letter
+    int             m_sendBufferSize;
+    NetSendBatch    *m_sendBatch;                               // Flushed once at the end of AdvanceSender
+
+    SnapshotParts   *m_snapshot;                                // Newest complete one, for clients that rejoin or resynchronise
+    SnapshotParts   *m_snapshotUpload;                          // Being uploaded by m_snapshotUploaderId, or NULL
+    int             m_snapshotUploaderId;
+    int             m_nextSnapshotSeqId;                        // When to ask for the next one
+    int             m_nextSnapshotClient;                       // Clients take turns at taking them
+
+    int             m_syncProbeSeqId;                           // Letter whose world hashes are being compared, or -1
+    int             m_syncProbeClientId[2];                     // The client out of sync, and one that disagrees with it
+    Directory       *m_syncProbeReply[2];                       // Their hashes for the node, NULL until they arrive
+    int             m_syncProbePath[SERVER_SYNCPROBEMAXDEPTH];  // Keys from the root to the node being compared
+    int             m_syncProbeDepth;
+    int             m_syncProbeStarted;                         // m_sequenceId when we started
+    int             m_syncProbeAsked;                           // and when we last asked
 
 protected:
     int             CountEmptyMessages  ( int _startingSeqId );    
     void            AuthenticateClients ();
 
+    int             GetOptionValue      ( char *_name );
+    char            *GetOptionString    ( char *_name );
+    bool            IsCriticalModRunning();
+    void            GetCriticalModPath  ( char *_modPath );
+
+    void            RequestSnapshot         ();
+    void            SendSnapshotRequest     ( int _clientId, int _seqId );        // -1 stops an upload
+    void            ReceiveSnapshotPart     ( int _clientId, Directory *_message );
+    bool            StartSendingSnapshot    ( ServerToClient *_sToC );            // False if the client can't load it
+    void            SendSnapshotParts       ( ServerToClient *_sToC );
+
+    void            StartSyncProbe          ( int _seqId );
+    void            AdvanceSyncProbe        ();                                   // Asks again, or gives up
+    void            SendSyncHashRequest     ( int _clientId );
+    void            ReceiveSyncHash         ( int _clientId, Directory *_message );
+    void            CompareSyncHashes       ();
+    void            DescendSyncProbe        ( int _key );
+    void            EndSyncProbe            ( bool _found );                      // Tells everyone where, if _found
+
 public:
     int             m_sequenceId;
     int             m_nextClientId;
@@ -36,22 +98,27 @@ public:
     DArray          <ServerToClient *>  m_disconnectedClients;
     DArray          <ServerTeam *>      m_teams;
 
-    NetMutex        *m_inboxMutex;
-    NetMutex        *m_outboxMutex;
-    LList           <Directory *> m_inbox;
-    LList           <ServerToClientLetter *> m_outbox;
+    NetQueue        <Directory *> *m_inbox;                  // Pushed by the listener thread, popped by Advance
+    LList           <ServerToClientLetter *> m_outbox;          // Only touched by the thread that runs Advance
     
     bool            m_syncronised;
     float           m_sendRate;
     float           m_receiveRate;
+    float           m_receiveRateTimer;
+    int             m_bytesReceived;                            // Counted on the listener thread
+
+    bool            m_advertise;                                // The MetaServer takes one registration per process
+
+    ServerLobby     *m_lobby;                                   // Dedicated server only, NULL otherwise
 
 public:
     Server();
     ~Server();
 
-    bool Initialise			();
+    bool Initialise			( int _port=-1 );                     // -1 uses the port in the preferences
     void Shutdown           ();
     bool IsRunning          ();
+    bool IsGameRunning      ();
 
     Directory *GetNextLetter();
 
@@ -66,17 +133,19 @@ public:
     void RegisterNewTeam    ( int _clientId, int _teamType );    
     void RemoveAI           ( Directory *_message );
     void RegisterSpectator  ( int _clientId );
-    void ResynchroniseClient( int _clientId );
+    void ResynchroniseClient( int _clientId, Directory *_message );
     
     void NotifyNetSyncError ( int _clientId );
     void NotifyNetSyncFixed ( int _clientId );
 
+    void Listen             ();                                 // Blocks until Shutdown
     void Advance			();
     void AdvanceSender		();
     void Advertise          ();
     void UpdateClients      ();
 
     void SendModPath        ();
+    void SendGameOptions    ();
 
     int  GetNumTeams        ( int _clientId );
     int  GetNumSpectators   ();
@@ -99,6 +168,8 @@ public:
     bool TestBedReadyToContinue();
 
     int  GetHistoryByteSize ();
+
+    static void GetDemoLimitations( int &_maxGameSize, int &_maxDemoPlayers, bool &_allowDemoServers );    // Uses defaults if not yet known
 };
 
 
@@ -119,7 +190,8 @@ enum            // Disconnection types
     Disconnect_GameFull,
     Disconnect_KickedFromGame,
     Disconnect_DemoFull,
-    Disconnect_ReadyForReconnect
+    Disconnect_ReadyForReconnect,
+    Disconnect_NumericsMismatch
 };
 
 
@@ -133,15 +205,36 @@ public:
     bool            m_clientDisconnected;
     Directory       *m_data;
 
+    EncodedLetter   *m_encoded[LETTER_NUMFORMATS];                  // History letters : m_data in each format, once it's been needed
+    EncodedLetter   *m_encodedLetter;                               // Outbox letters : sent instead of m_data
+    EncodedLetter   *m_encodedPrevUpdate;
+
     ServerToClientLetter()
     :   m_receiverId(-1),
         m_data(NULL),
-        m_clientDisconnected(false)
-    {}
+        m_clientDisconnected(false),
+        m_encodedLetter(NULL),
+        m_encodedPrevUpdate(NULL)
+    {
+        for( int i = 0; i < LETTER_NUMFORMATS; ++i ) m_encoded[i] = NULL;
+    }
 
     ~ServerToClientLetter()
     {
         if( m_data ) delete m_data;        
+
+        for( int i = 0; i < LETTER_NUMFORMATS; ++i )
+        {
+            if( m_encoded[i] ) m_encoded[i]->Release();
+        }
+        if( m_encodedLetter ) m_encodedLetter->Release();
+        if( m_encodedPrevUpdate ) m_encodedPrevUpdate->Release();
+    }
+
+    EncodedLetter *GetEncoded( int _format )
+    {
+        if( !m_encoded[_format] ) m_encoded[_format] = new EncodedLetter( m_data, _format );
+        return m_encoded[_format];
     }
 };
 
@@ -0,0 +1,411 @@
+#include "lib/universal_include.h"
+
+#include <string.h>
+#include <stdlib.h>
+
+#include "lib/debug_utils.h"
+#include "lib/preferences.h"
+#include "lib/string_utils.h"
+#include "lib/filesys/file_system.h"
+#include "lib/filesys/text_stream_readers.h"
+#include "lib/tosser/directory.h"
+
+#include "app/game.h"
+
+#include "world/team.h"
+
+#include "network/ServerLobby.h"
+#include "network/network_defines.h"
+
+
+
+LobbyTeam::LobbyTeam( int _teamId, int _type, int _clientId )
+:   m_teamId(_teamId),
+    m_clientId(_clientId),
+    m_type(_type),
+    m_allianceId(-1),
+    m_score(0),
+    m_readyToStart(false)
+{
+    sprintf( m_name, "Player %d", _teamId );
+}
+
+
+
+ServerLobby::ServerLobby()
+:   m_gameStartTimer(-1.0f),
+    m_gameRunning(false)
+{
+}
+
+
+ServerLobby::~ServerLobby()
+{
+    m_teams.EmptyAndDelete();
+    m_options.EmptyAndDelete();
+}
+
+
+bool ServerLobby::LoadOptions( char *_filename )
+{
+    //
+    // Same format and order as Game::Game, since
+    // option changes are sent as indexes into this list
+
+    TextReader *in = g_fileSystem->GetTextReader( _filename );
+    if( !in || !in->IsOpen() )
+    {
+        delete in;
+        return false;
+    }
+
+    while( in->ReadLine() )
+    {
+        if( !in->TokenAvailable() ) continue;
+
+        char *param = in->GetNextToken();
+
+        GameOption *option = new GameOption();
+        m_options.PutData( option );
+
+        strcpy( option->m_name,     param );
+        option->m_min       = atof( in->GetNextToken() );
+        option->m_max       = atof( in->GetNextToken() );
+        option->m_default   = atof( in->GetNextToken() );
+        option->m_change    = atoi( in->GetNextToken() );
+        option->m_currentValue = option->m_default;
+        option->m_currentString[0] = '\x0';
+
+        if( option->m_change == 0 )
+        {
+            // Drop down menu - the names aren't needed here
+            int numOptions = option->m_max - option->m_min;
+            numOptions ++;
+            for( int i = 0; i < numOptions; ++i )
+            {
+                in->ReadLine();
+            }
+        }
+
+        if( option->m_change == -1 )
+        {
+            // String - load default
+            in->ReadLine();
+            strcpy( option->m_currentString, in->GetRestOfLine() );
+            StripTrailingWhitespace( option->m_currentString );
+        }
+    }
+
+    delete in;
+
+    return true;
+}
+
+
+void ServerLobby::LoadPreferences()
+{
+    for( int i = 0; i < m_options.Size(); ++i )
+    {
+        GameOption *option = m_options[i];
+
+        char key[256];
+        sprintf( key, "Option%s", option->m_name );
+
+        if( option->m_change == -1 )
+        {
+            char *value = g_preferences->GetString( key );
+            if( value )
+            {
+                strncpy( option->m_currentString, value, sizeof(option->m_currentString) );
+                option->m_currentString[ sizeof(option->m_currentString) - 1 ] = '\x0';
+            }
+        }
+        else
+        {
+            int value = g_preferences->GetInt( key, option->m_currentValue );
+            if( value < option->m_min ) value = option->m_min;
+            if( value > option->m_max ) value = option->m_max;
+            option->m_currentValue = value;
+        }
+    }
+}
+
+
+GameOption *ServerLobby::GetOption( char *_name )
+{
+    for( int i = 0; i < m_options.Size(); ++i )
+    {
+        GameOption *option = m_options[i];
+        if( strcmp( option->m_name, _name ) == 0 )
+        {
+            return option;
+        }
+    }
+
+    return NULL;
+}
+
+
+int ServerLobby::GetOptionValue( char *_name )
+{
+    GameOption *option = GetOption(_name);
+    if( option )
+    {
+        return option->m_currentValue;
+    }
+
+    return -1;
+}
+
+
+LobbyTeam *ServerLobby::GetTeam( int _teamId )
+{
+    for( int i = 0; i < m_teams.Size(); ++i )
+    {
+        LobbyTeam *team = m_teams[i];
+        if( team->m_teamId == _teamId )
+        {
+            return team;
+        }
+    }
+
+    return NULL;
+}
+
+
+int ServerLobby::FindFreeAllianceId()
+{
+    for( int a = 0; a < 6; ++a )
+    {
+        bool used = false;
+        for( int i = 0; i < m_teams.Size(); ++i )
+        {
+            if( m_teams[i]->m_allianceId == a )
+            {
+                used = true;
+                break;
+            }
+        }
+
+        if( !used ) return a;
+    }
+
+    return -1;
+}
+
+
+void ServerLobby::RemoveTeam( int _teamId )
+{
+    for( int i = 0; i < m_teams.Size(); ++i )
+    {
+        LobbyTeam *team = m_teams[i];
+        if( team->m_teamId == _teamId )
+        {
+            m_teams.RemoveData(i);
+            delete team;
+            --i;
+        }
+    }
+}
+
+
+void ServerLobby::RemoveTeams( int _clientId )
+{
+    //
+    // Matches World::RemoveTeams : in the lobby the client's teams go,
+    // in game they are handed to the AI.  Everyone else has to ready up again.
+
+    for( int i = 0; i < m_teams.Size(); ++i )
+    {
+        LobbyTeam *team = m_teams[i];
+        if( team->m_type != Team::TypeUnassigned &&
+            team->m_type != Team::TypeAI &&
+            team->m_clientId == _clientId )
+        {
+            if( m_gameRunning )
+            {
+                team->m_type = Team::TypeAI;
+            }
+            else
+            {
+                m_teams.RemoveData(i);
+                delete team;
+                --i;
+            }
+        }
+        else
+        {
+            team->m_readyToStart = false;
+        }
+    }
+}
+
+
+void ServerLobby::ProcessLetter( Directory *_letter )
+{
+    if( !_letter->HasData( NET_DEFCON_COMMAND, DIRECTORY_TYPE_STRING ) ) return;
+
+    char *cmd = _letter->GetDataString( NET_DEFCON_COMMAND );
+
+    if( strcmp( cmd, NET_DEFCON_TEAMASSIGN ) == 0 )
+    {
+        int teamId   = _letter->GetDataInt(NET_DEFCON_TEAMID);
+        int teamType = _letter->GetDataInt(NET_DEFCON_TEAMTYPE);
+        int clientId = _letter->GetDataInt(NET_DEFCON_CLIENTID);
+
+        LobbyTeam *team = new LobbyTeam( teamId, teamType, clientId );
+        team->m_allianceId = FindFreeAllianceId();
+        m_teams.PutData( team );
+    }
+    else if( strcmp( cmd, NET_DEFCON_SPECTATORASSIGN ) == 0 ||
+             strcmp( cmd, NET_DEFCON_CLIENTGOODBYE ) == 0 )
+    {
+        RemoveTeams( _letter->GetDataInt(NET_DEFCON_CLIENTID) );
+    }
+    else if( strcmp( cmd, NET_DEFCON_UPDATE ) == 0 )
+    {
+        for( int i = 0; i < _letter->m_subDirectories.Size(); ++i )
+        {
+            if( _letter->m_subDirectories.ValidIndex(i) )
+            {
+                ProcessUpdate( _letter->m_subDirectories[i] );
+            }
+        }
+    }
+
+
+    //
+    // Every client checks for the game start after each letter,
+    // so the countdown below ends on the same letter for everyone
+
+    if( !m_gameRunning )
+    {
+        HandleGameStart();
+    }
+}
+
+
+void ServerLobby::ProcessUpdate( Directory *_update )
+{
+    if( !_update->HasData( NET_DEFCON_COMMAND, DIRECTORY_TYPE_STRING ) ) return;
+
+    char *cmd = _update->GetDataString( NET_DEFCON_COMMAND );
+
+    if( strcmp( cmd, NET_DEFCON_START_GAME ) == 0 )
+    {
+        LobbyTeam *team = GetTeam( _update->GetDataUChar(NET_DEFCON_TEAMID) );
+        if( team )
+        {
+            team->m_readyToStart = !team->m_readyToStart;
+        }
+    }
+    else if( strcmp( cmd, NET_DEFCON_REQUEST_TERRITORY ) == 0 )
+    {
+        LobbyTeam *team = GetTeam( _update->GetDataUChar(NET_DEFCON_TEAMID) );
+        if( team )
+        {
+            team->m_readyToStart = false;
+        }
+    }
+    else if( strcmp( cmd, NET_DEFCON_REQUEST_ALLIANCE ) == 0 )
+    {
+        LobbyTeam *team = GetTeam( _update->GetDataUChar(NET_DEFCON_TEAMID) );
+        if( team )
+        {
+            team->m_allianceId = _update->GetDataUChar(NET_DEFCON_ALLIANCEID);
+            team->m_readyToStart = false;
+        }
+    }
+    else if( strcmp( cmd, NET_DEFCON_CHANGEOPTION ) == 0 )
+    {
+        int optionIndex = (int)_update->GetDataUChar( NET_DEFCON_OPTIONID );
+        if( m_options.ValidIndex(optionIndex) )
+        {
+            GameOption *option = m_options[optionIndex];
+            if( _update->HasData( NET_DEFCON_OPTIONVALUE, DIRECTORY_TYPE_INT ) )
+            {
+                option->m_currentValue = _update->GetDataInt(NET_DEFCON_OPTIONVALUE);
+            }
+            else if( _update->HasData( NET_DEFCON_OPTIONVALUE, DIRECTORY_TYPE_STRING ) )
+            {
+                strcpy( option->m_currentString, _update->GetDataString(NET_DEFCON_OPTIONVALUE) );
+            }
+        }
+
+        for( int i = 0; i < m_teams.Size(); ++i )
+        {
+            m_teams[i]->m_readyToStart = false;
+        }
+    }
+    else if( strcmp( cmd, NET_DEFCON_SETTEAMNAME ) == 0 )
+    {
+        if( !_update->HasData( NET_DEFCON_SPECTATOR ) )
+        {
+            LobbyTeam *team = GetTeam( _update->GetDataUChar(NET_DEFCON_TEAMID) );
+            char *teamName = _update->GetDataString(NET_DEFCON_OPTIONVALUE);
+            if( team && teamName )
+            {
+                strncpy( team->m_name, teamName, sizeof(team->m_name) );
+                team->m_name[ sizeof(team->m_name) - 1 ] = '\x0';
+            }
+        }
+    }
+    else if( strcmp( cmd, NET_DEFCON_TEAM_SCORE ) == 0 )
+    {
+        LobbyTeam *team = GetTeam( _update->GetDataUChar(NET_DEFCON_TEAMID) );
+        if( team )
+        {
+            team->m_score = _update->GetDataInt(NET_DEFCON_SCORE);
+        }
+    }
+    else if( strcmp( cmd, NET_DEFCON_REMOVEAI ) == 0 )
+    {
+        int teamId = _update->GetDataUChar(NET_DEFCON_TEAMID);
+        LobbyTeam *team = GetTeam( teamId );
+        if( team && team->m_type == Team::TypeAI )
+        {
+            RemoveTeam( teamId );
+        }
+    }
+}
+
+
+void ServerLobby::HandleGameStart()
+{
+    //
+    // Mirrors HandleGameStart in defcon.cpp
+
+    bool ready = ( m_teams.Size() > 0 );
+
+    for( int i = 0; i < m_teams.Size(); ++i )
+    {
+        LobbyTeam *team = m_teams[i];
+        if( team->m_type == Team::TypeUnassigned ||
+            !team->m_readyToStart )
+        {
+            ready = false;
+            break;
+        }
+    }
+
+    if( ready )
+    {
+        if( m_gameStartTimer < 0 )
+        {
+            m_gameStartTimer = 4;
+        }
+        else if( m_gameStartTimer > 0 )
+        {
+            m_gameStartTimer -= 0.5f;
+            if( m_gameStartTimer <= 0 )
+            {
+                AppDebugOut( "SERVER : All teams ready, game started\n" );
+                m_gameRunning = true;
+            }
+        }
+    }
+    else
+    {
+        m_gameStartTimer = -1;
+    }
+}
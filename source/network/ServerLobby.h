@@ -0,0 +1,64 @@
+/* The lobby state a dedicated server tracks for itself.
+   A normal server reads this from the World and Game of the client running alongside it;
+   a dedicated server has neither, so it follows the same letters every client processes. */
+
+
+#ifndef _SERVERLOBBY_H
+#define _SERVERLOBBY_H
+
+#include "lib/tosser/llist.h"
+
+class Directory;
+class GameOption;
+
+
+class LobbyTeam
+{
+public:
+    int     m_teamId;
+    int     m_clientId;
+    int     m_type;
+    int     m_allianceId;
+    int     m_score;                                // As last reported by the team's own client
+    bool    m_readyToStart;
+    char    m_name[256];
+
+    LobbyTeam( int _teamId, int _type, int _clientId );
+};
+
+
+class ServerLobby
+{
+protected:
+    float   m_gameStartTimer;
+
+protected:
+    void    ProcessUpdate       ( Directory *_update );
+    void    HandleGameStart     ();
+
+    void    RemoveTeams         ( int _clientId );
+    void    RemoveTeam          ( int _teamId );
+    int     FindFreeAllianceId  ();
+
+public:
+    LList   <GameOption *> m_options;               // Same order as Game::m_options on every client
+    LList   <LobbyTeam *>  m_teams;                 // Same order as World::m_teams on every client
+    bool    m_gameRunning;
+
+public:
+    ServerLobby();
+    ~ServerLobby();
+
+    bool        LoadOptions     ( char *_filename );
+    void        LoadPreferences ();                 // Applies "Option<Name>" preferences over the defaults
+
+    GameOption  *GetOption      ( char *_name );
+    int         GetOptionValue  ( char *_name );
+
+    LobbyTeam   *GetTeam        ( int _teamId );
+
+    void        ProcessLetter   ( Directory *_letter );    // Call on each letter as it enters the history
+};
+
+
+#endif
@@ -14,6 +14,8 @@
 #include "network/ClientToServer.h"
 #include "network/Server.h"
 #include "network/network_defines.h"
+#include "network/letter_codec.h"
+#include "network/snapshot_parts.h"
 
 
 
@@ -31,6 +33,12 @@ ServerToClient::ServerToClient( char *_ip, int _port,
     m_spectator(false),
     m_authKeyId(0),
     m_syncErrorSeqId(-1),
+    m_letterFormat(LETTER_FORMAT_DIRECTORY),
+    m_snapshotVersion(0),
+    m_syncHashRevision(0),
+    m_snapshot(NULL),
+    m_snapshotNextPart(0),
+    m_snapshotAckedPart(0),
     m_lastBackedUp(0.0f)
 {   
     strcpy ( m_ip, _ip );
@@ -38,6 +46,9 @@ ServerToClient::ServerToClient( char *_ip, int _port,
 
     strcpy ( m_version, "1.0" );
 
+    // Clients from before the numerics revision was sent were all float builds
+    strcpy ( m_numerics, "float-1" );
+
     m_socket = new NetSocketSession(*_listener, _ip, _port);
 
     m_chatMessages.SetSize(100);
@@ -51,6 +62,8 @@ ServerToClient::ServerToClient( char *_ip, int _port,
 ServerToClient::~ServerToClient()
 {
     delete m_socket;
+
+    if( m_snapshot ) m_snapshot->Release();
 }
 
 
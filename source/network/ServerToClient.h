@@ -7,6 +7,7 @@
 class NetSocketSession;
 class NetSocketListener;
 class ServerToClientLetter;
+class SnapshotParts;
 
 #include "lib/tosser/darray.h"
 
@@ -22,10 +23,14 @@ public:
 
     char                m_version[256];
     char                m_system[256];
+    char                m_numerics[64];                     // FIXED_NUMERICS_REVISION the client was built with
+    int                 m_letterFormat;                     // Newest LETTER_FORMAT the client can read
+    int                 m_snapshotVersion;                  // WORLDSNAPSHOT_VERSION the client can load, 0 if none
+    int                 m_syncHashRevision;                 // WORLDHASH_REVISION its sync byte comes from, 0 if none
     char                m_authKey[256];
     int                 m_authKeyId;
     char                m_password[128];
-    int                 m_basicAuthCheck;                   // 0=not done, 1=pass, -1=basicfail, -2=duplicate, -3=keybad, -4=badpass, -5=full, -6=game started
+    int                 m_basicAuthCheck;                   // 0=not done, 1=pass, -1=basicfail, -2=duplicate, -3=keybad, -4=badpass, -5=full, -6=game started, -7=numerics or sync hash
     int                 m_disconnected;                     // Can be Disconnect_ClientLeave etc
     bool                m_spectator;
     
@@ -39,6 +44,10 @@ public:
     DArray<bool>            m_chatMessages;
     DArray<unsigned char>   m_sync;
 
+    SnapshotParts       *m_snapshot;                        // Being sent instead of the history, or NULL
+    int                 m_snapshotNextPart;
+    int                 m_snapshotAckedPart;                // The client has every part before this
+
 protected:
     NetSocketSession   *m_socket;
     
@@ -0,0 +1,1203 @@
+#include "lib/universal_include.h"
+
+#include <stdio.h>
+#include <string.h>
+
+#include "lib/debug_utils.h"
+#include "lib/string_utils.h"
+#include "lib/math/math_utils.h"
+#include "lib/tosser/directory.h"
+#include "lib/tosser/hash_table.h"
+#include "lib/metaserver/metaserver_defines.h"
+
+#include "world/world_hash.h"
+
+#include "network/letter_codec.h"
+#include "network/network_defines.h"
+
+
+#define LETTERCODEC_MAXSTRINGLENGTH     10240                   // As Directory
+#define LETTERCODEC_MAXDIRSIZE          1024
+#define LETTERCODEC_MAXDEPTH            16
+#define LETTERCODEC_MAXSHAPES           256
+
+#define LETTERCODEC_STRINGNULL          0
+#define LETTERCODEC_STRINGLITERAL       1
+#define LETTERCODEC_STRINGTAG           2
+
+
+// ============================================================================
+// Tag table
+// Append only - see letter_codec.h
+
+static char const *s_letterTags[] =
+{
+    NET_DEFCON_MESSAGE,
+    NET_DEFCON_COMMAND,
+
+    NET_DEFCON_CLIENT_JOIN,
+    NET_DEFCON_CLIENT_LEAVE,
+    NET_DEFCON_START_GAME,
+    NET_DEFCON_REQUEST_TEAM,
+    NET_DEFCON_REQUEST_SPECTATE,
+    NET_DEFCON_REQUEST_ALLIANCE,
+    NET_DEFCON_REQUEST_TERRITORY,
+    NET_DEFCON_REQUEST_FLEET,
+    NET_DEFCON_RESYNCHRONISE,
+    NET_DEFCON_OBJSTATECHANGE,
+    NET_DEFCON_OBJACTION,
+    NET_DEFCON_OBJPLACEMENT,
+    NET_DEFCON_OBJSPECIALACTION,
+    NET_DEFCON_OBJSETWAYPOINT,
+    NET_DEFCON_OBJCLEARACTIONQUEUE,
+    NET_DEFCON_FLEETMOVE,
+    NET_DEFCON_CHANGEOPTION,
+    NET_DEFCON_SETGAMESPEED,
+    NET_DEFCON_SETTEAMNAME,
+    NET_DEFCON_AGGRESSIONCHANGE,
+    NET_DEFCON_CHATMESSAGE,
+    NET_DEFCON_BEGINVOTE,
+    NET_DEFCON_CASTVOTE,
+    NET_DEFCON_CEASEFIRE,
+    NET_DEFCON_SHARERADAR,
+    NET_DEFCON_REMOVEAI,
+    NET_DEFCON_OBJCLEARLASTACTION,
+    NET_DEFCON_WHITEBOARD,
+    NET_DEFCON_TEAM_SCORE,
+    NET_DEFCON_SYNCHRONISE,
+
+    NET_DEFCON_TEAMID,
+    NET_DEFCON_ALLIANCEID,
+    NET_DEFCON_OBJECTID,
+    NET_DEFCON_FLEETID,
+    NET_DEFCON_TERRITORYID,
+    NET_DEFCON_TEAMTYPE,
+    NET_DEFCON_STATE,
+    NET_DEFCON_TARGETOBJECTID,
+    NET_DEFCON_LONGITUDE,
+    NET_DEFCON_LATTITUDE,
+    NET_DEFCON_UNITTYPE,
+    NET_DEFCON_ACTIONTYPE,
+    NET_DEFCON_OPTIONID,
+    NET_DEFCON_OPTIONVALUE,
+    NET_DEFCON_TARGETTEAMID,
+    NET_DEFCON_CHATCHANNEL,
+    NET_DEFCON_CHATMSG,
+    NET_DEFCON_VOTETYPE,
+    NET_DEFCON_VOTEDATA,
+    NET_DEFCON_SPECTATOR,
+    NET_DEFCON_CHATMSGID,
+    NET_DEFCON_RANDSEED,
+    NET_DEFCON_LONGITUDE2,
+    NET_DEFCON_LATTITUDE2,
+    NET_DEFCON_SCORE,
+    NET_DEFCON_LASTPROCESSEDSEQID,
+    NET_DEFCON_SYNCVALUE,
+
+    NET_DEFCON_DISCONNECT,
+    NET_DEFCON_CLIENTHELLO,
+    NET_DEFCON_CLIENTGOODBYE,
+    NET_DEFCON_CLIENTID,
+    NET_DEFCON_TEAMASSIGN,
+    NET_DEFCON_NETSYNCERROR,
+    NET_DEFCON_NETSYNCFIXED,
+    NET_DEFCON_UPDATE,
+    NET_DEFCON_PREVUPDATE,
+    NET_DEFCON_NUMEMPTYUPDATES,
+    NET_DEFCON_SPECTATORASSIGN,
+    NET_DEFCON_SYNCERRORID,
+    NET_DEFCON_CLIENTISDEMO,
+    NET_DEFCON_SETMODPATH,
+    NET_DEFCON_VERSION,
+    NET_DEFCON_SYSTEMTYPE,
+    NET_DEFCON_NUMERICS,
+    NET_DEFCON_LETTERFORMAT,
+    NET_DEFCON_SEQID,
+    NET_DEFCON_LASTSEQID,
+
+    NET_METASERVER_COMMAND,
+    NET_METASERVER_GAMEVERSION,
+    NET_METASERVER_AUTHKEY,
+    NET_METASERVER_AUTHKEYID,
+    NET_METASERVER_PASSWORD,
+    NET_METASERVER_MODPATH,
+};
+
+static int const s_numLetterTags = sizeof(s_letterTags) / sizeof(s_letterTags[0]);
+
+
+// Built once by LetterCodec::Initialise, before any thread is started,
+// and only read after that : the senders on every thread share it
+
+static HashTable<int> s_tagIndex;
+
+
+static int GetLetterTag( char const *_string )
+{
+    AppAssert( s_tagIndex.NumUsed() > 0 );
+
+    int index = s_tagIndex.GetIndex( _string );
+    if( index == -1 ) return -1;
+    return s_tagIndex.GetData( (unsigned int) index );
+}
+
+
+// ============================================================================
+// Writing
+
+class LetterWriter
+{
+protected:
+    struct Shape
+    {
+        int     m_firstField;
+        int     m_numFields;
+    };
+
+    char    *m_data;
+    int     m_length;
+    int     m_capacity;
+
+    DirectoryData   **m_fields;                                 // The DirectoryData each shape was first seen with
+    int             m_numFields;
+    int             m_maxFields;
+
+    Shape   m_shapes[LETTERCODEC_MAXSHAPES];
+    int     m_numShapes;
+    bool    m_inlineShapes;                                     // Never refer back, so the bytes can be spliced into any letter.
+                                                                // New shapes are still numbered, as the reader numbers them
+
+    void    Reserve     ( int _bytes );
+    int     FindShape   ( Directory *_dir, DirectoryData *_extra );
+    int     AddShape    ( Directory *_dir, DirectoryData *_extra );
+
+public:
+    LetterWriter( char *_buffer, int _bufferSize );                 // Takes the buffer over, grows it as needed
+    ~LetterWriter();
+
+    void    WriteByte       ( unsigned char _value );
+    void    WriteBytes      ( void const *_data, int _length );
+    void    WriteNetworkBytes( void const *_data, int _length );    // In Directory's byte order
+    void    WriteVarInt     ( unsigned int _value );
+    void    WriteInt        ( int _value );
+    void    WriteString     ( char const *_string );
+
+    void    WriteShape      ( Directory *_dir, DirectoryData *_extra );    // _extra is a field the values will be followed by
+    void    WriteValues     ( Directory *_dir );
+    void    WriteSubDirs    ( Directory *_dir );
+    void    WriteDirectory  ( Directory *_dir, char const *_name );
+
+    void    SetInlineShapes ()      { m_inlineShapes = true; }
+    int     GetLength       ()      { return m_length; }
+
+    char    *Release        ( int &_length, int &_bufferSize );    // Hands the buffer back
+};
+
+
+LetterWriter::LetterWriter( char *_buffer, int _bufferSize )
+:   m_data(_buffer),
+    m_length(0),
+    m_capacity(_buffer ? _bufferSize : 0),
+    m_fields(NULL),
+    m_numFields(0),
+    m_maxFields(0),
+    m_numShapes(0),
+    m_inlineShapes(false)
+{
+}
+
+
+LetterWriter::~LetterWriter()
+{
+    delete [] m_data;
+    delete [] m_fields;
+}
+
+
+void LetterWriter::Reserve( int _bytes )
+{
+    if( m_length + _bytes <= m_capacity ) return;
+
+    int capacity = max( m_capacity * 2, 256 );
+    while( capacity < m_length + _bytes ) capacity *= 2;
+
+    char *data = new char[capacity];
+    if( m_data ) memcpy( data, m_data, m_length );
+    delete [] m_data;
+
+    m_data = data;
+    m_capacity = capacity;
+}
+
+
+void LetterWriter::WriteByte( unsigned char _value )
+{
+    Reserve( 1 );
+    m_data[m_length++] = (char) _value;
+}
+
+
+void LetterWriter::WriteBytes( void const *_data, int _length )
+{
+    Reserve( _length );
+    memcpy( m_data + m_length, _data, _length );
+    m_length += _length;
+}
+
+
+void LetterWriter::WriteNetworkBytes( void const *_data, int _length )
+{
+#ifndef __BIG_ENDIAN__
+    WriteBytes( _data, _length );
+#else
+    Reserve( _length );
+    char const *source = (char const *) _data;
+    for( int i = 0; i < _length; ++i )
+    {
+        m_data[m_length + i] = source[_length - 1 - i];
+    }
+    m_length += _length;
+#endif
+}
+
+
+void LetterWriter::WriteVarInt( unsigned int _value )
+{
+    Reserve( 5 );
+    while( _value >= 0x80 )
+    {
+        m_data[m_length++] = (char) ( ( _value & 0x7F ) | 0x80 );
+        _value >>= 7;
+    }
+    m_data[m_length++] = (char) _value;
+}
+
+
+void LetterWriter::WriteInt( int _value )
+{
+    // Zigzag, so small negative numbers (-1 especially) stay short
+    unsigned int zigzag = ( (unsigned int) _value << 1 ) ^ (unsigned int) ( _value >> 31 );
+    WriteVarInt( zigzag );
+}
+
+
+void LetterWriter::WriteString( char const *_string )
+{
+    if( !_string )
+    {
+        WriteVarInt( LETTERCODEC_STRINGNULL );
+        return;
+    }
+
+    int tag = GetLetterTag( _string );
+    if( tag != -1 )
+    {
+        WriteVarInt( LETTERCODEC_STRINGTAG + tag );
+        return;
+    }
+
+    int length = strlen( _string );
+    WriteVarInt( LETTERCODEC_STRINGLITERAL );
+    WriteVarInt( length );
+    WriteBytes( _string, length );
+}
+
+
+int LetterWriter::FindShape( Directory *_dir, DirectoryData *_extra )
+{
+    if( m_inlineShapes ) return -1;
+
+    int numFields = _dir->m_data.NumUsed() + ( _extra ? 1 : 0 );
+
+    for( int s = 0; s < m_numShapes; ++s )
+    {
+        Shape *shape = &m_shapes[s];
+        if( shape->m_numFields != numFields ) continue;
+
+        bool match = true;
+        int field = shape->m_firstField;
+        for( int d = 0; d < _dir->m_data.Size() && match; ++d )
+        {
+            if( !_dir->m_data.ValidIndex(d) ) continue;
+
+            DirectoryData *data = _dir->m_data[d];
+            DirectoryData *shapeData = m_fields[field++];
+            match = ( data->m_type == shapeData->m_type &&
+                      strcmp( data->m_name, shapeData->m_name ) == 0 );
+        }
+
+        if( match && _extra )
+        {
+            DirectoryData *shapeData = m_fields[field];
+            match = ( _extra->m_type == shapeData->m_type &&
+                      strcmp( _extra->m_name, shapeData->m_name ) == 0 );
+        }
+
+        if( match ) return s;
+    }
+
+    return -1;
+}
+
+
+int LetterWriter::AddShape( Directory *_dir, DirectoryData *_extra )
+{
+    if( m_numShapes >= LETTERCODEC_MAXSHAPES ) return -1;
+
+    int numFields = _dir->m_data.NumUsed() + ( _extra ? 1 : 0 );
+    if( m_numFields + numFields > m_maxFields )
+    {
+        int maxFields = max( m_maxFields * 2, 64 );
+        while( maxFields < m_numFields + numFields ) maxFields *= 2;
+
+        DirectoryData **fields = new DirectoryData *[maxFields];
+        if( m_fields ) memcpy( fields, m_fields, m_numFields * sizeof(DirectoryData *) );
+        delete [] m_fields;
+
+        m_fields = fields;
+        m_maxFields = maxFields;
+    }
+
+    Shape *shape = &m_shapes[m_numShapes];
+    shape->m_firstField = m_numFields;
+    shape->m_numFields = numFields;
+
+    for( int d = 0; d < _dir->m_data.Size(); ++d )
+    {
+        if( _dir->m_data.ValidIndex(d) )
+        {
+            m_fields[m_numFields++] = _dir->m_data[d];
+        }
+    }
+
+    if( _extra ) m_fields[m_numFields++] = _extra;
+
+    return m_numShapes++;
+}
+
+
+void LetterWriter::WriteShape( Directory *_dir, DirectoryData *_extra )
+{
+    int shape = FindShape( _dir, _extra );
+    if( shape != -1 )
+    {
+        WriteVarInt( shape + 1 );
+        return;
+    }
+
+    // Once the table is full new shapes are still sent in full, just not remembered
+    AddShape( _dir, _extra );
+
+    WriteVarInt( 0 );
+    WriteVarInt( _dir->m_data.NumUsed() + ( _extra ? 1 : 0 ) );
+
+    for( int d = 0; d < _dir->m_data.Size(); ++d )
+    {
+        if( _dir->m_data.ValidIndex(d) )
+        {
+            DirectoryData *data = _dir->m_data[d];
+            WriteString( data->m_name );
+            WriteByte( (unsigned char) data->m_type );
+        }
+    }
+
+    if( _extra )
+    {
+        WriteString( _extra->m_name );
+        WriteByte( (unsigned char) _extra->m_type );
+    }
+}
+
+
+void LetterWriter::WriteValues( Directory *_dir )
+{
+    for( int d = 0; d < _dir->m_data.Size(); ++d )
+    {
+        if( !_dir->m_data.ValidIndex(d) ) continue;
+
+        DirectoryData *data = _dir->m_data[d];
+        switch( data->m_type )
+        {
+            case DIRECTORY_TYPE_INT:        WriteInt( data->m_int );                                        break;
+            case DIRECTORY_TYPE_FLOAT:      WriteNetworkBytes( &data->m_float, sizeof(data->m_float) );     break;
+            case DIRECTORY_TYPE_FIXED:      WriteNetworkBytes( &data->m_fixed, sizeof(data->m_fixed) );     break;
+            case DIRECTORY_TYPE_CHAR:       WriteByte( (unsigned char) data->m_char );                      break;
+            case DIRECTORY_TYPE_BOOL:       WriteByte( data->m_bool ? 1 : 0 );                              break;
+            case DIRECTORY_TYPE_STRING:     WriteString( data->m_string );                                  break;
+
+            case DIRECTORY_TYPE_VOID:
+                WriteVarInt( data->m_voidLen );
+                WriteBytes( data->m_void, data->m_voidLen );
+                break;
+        }
+    }
+}
+
+
+void LetterWriter::WriteSubDirs( Directory *_dir )
+{
+    for( int s = 0; s < _dir->m_subDirectories.Size(); ++s )
+    {
+        if( _dir->m_subDirectories.ValidIndex(s) )
+        {
+            Directory *subDir = _dir->m_subDirectories[s];
+
+            // A NET_DEFCON_PREVUPDATE is always spelled out in full, so that a letter
+            // copied for one client comes out the same as a shared EncodedLetter
+            bool inlineShapes = m_inlineShapes;
+            if( subDir->m_name && strcmp( subDir->m_name, NET_DEFCON_PREVUPDATE ) == 0 )
+            {
+                m_inlineShapes = true;
+            }
+
+            WriteDirectory( subDir, subDir->m_name );
+            m_inlineShapes = inlineShapes;
+        }
+    }
+}
+
+
+void LetterWriter::WriteDirectory( Directory *_dir, char const *_name )
+{
+    WriteString( _name );
+    WriteShape( _dir, NULL );
+    WriteValues( _dir );
+
+    WriteVarInt( _dir->m_subDirectories.NumUsed() );
+    WriteSubDirs( _dir );
+}
+
+
+char *LetterWriter::Release( int &_length, int &_bufferSize )
+{
+    char *result = m_data;
+    _length = m_length;
+    _bufferSize = m_capacity;
+
+    m_data = NULL;
+    m_length = 0;
+    m_capacity = 0;
+
+    return result;
+}
+
+
+// ============================================================================
+// Reading
+// Straight from the packet, every read checked against its end
+
+class LetterReader
+{
+protected:
+    struct ShapeField
+    {
+        char        *m_name;
+        bool        m_owned;                                    // Literal names are ours, tags point into the table
+        int         m_type;
+    };
+
+    struct Shape
+    {
+        int     m_firstField;
+        int     m_numFields;
+    };
+
+    unsigned char const *m_data;
+    unsigned char const *m_end;
+    bool                m_failed;
+
+    ShapeField  *m_fields;
+    int         m_numFields;
+    int         m_maxFields;
+
+    Shape   m_shapes[LETTERCODEC_MAXSHAPES];
+    int     m_numShapes;
+
+    ShapeField *AddField ();
+
+public:
+    LetterReader( char const *_data, int _length );
+    ~LetterReader();
+
+    bool            Failed          () { return m_failed; }
+    bool            AtEnd           () { return m_data == m_end; }
+
+    unsigned char   ReadByte        ();
+    void            ReadNetworkBytes( void *_data, int _length );
+    unsigned int    ReadVarInt      ();
+    int             ReadInt         ();
+    char            *ReadString     ( bool &_owned );           // NULL if bogus or if NULL was sent
+
+    bool            ReadDirectory   ( Directory *_dir, int _depth );
+};
+
+
+LetterReader::LetterReader( char const *_data, int _length )
+:   m_data( (unsigned char const *) _data ),
+    m_end( (unsigned char const *) _data + _length ),
+    m_failed(false),
+    m_fields(NULL),
+    m_numFields(0),
+    m_maxFields(0),
+    m_numShapes(0)
+{
+}
+
+
+LetterReader::~LetterReader()
+{
+    for( int i = 0; i < m_numFields; ++i )
+    {
+        if( m_fields[i].m_owned ) delete [] m_fields[i].m_name;
+    }
+
+    delete [] m_fields;
+}
+
+
+unsigned char LetterReader::ReadByte()
+{
+    if( m_data >= m_end )
+    {
+        m_failed = true;
+        return 0;
+    }
+
+    return *m_data++;
+}
+
+
+void LetterReader::ReadNetworkBytes( void *_data, int _length )
+{
+    if( m_end - m_data < _length )
+    {
+        m_failed = true;
+        memset( _data, 0, _length );
+        return;
+    }
+
+#ifndef __BIG_ENDIAN__
+    memcpy( _data, m_data, _length );
+#else
+    char *target = (char *) _data;
+    for( int i = 0; i < _length; ++i )
+    {
+        target[i] = m_data[_length - 1 - i];
+    }
+#endif
+
+    m_data += _length;
+}
+
+
+unsigned int LetterReader::ReadVarInt()
+{
+    unsigned int result = 0;
+
+    for( int shift = 0; shift < 35; shift += 7 )
+    {
+        unsigned char byte = ReadByte();
+        result |= (unsigned int) ( byte & 0x7F ) << shift;
+        if( !( byte & 0x80 ) ) return result;
+    }
+
+    m_failed = true;
+    return 0;
+}
+
+
+int LetterReader::ReadInt()
+{
+    unsigned int zigzag = ReadVarInt();
+    return (int) ( zigzag >> 1 ) ^ -(int) ( zigzag & 1 );
+}
+
+
+char *LetterReader::ReadString( bool &_owned )
+{
+    _owned = false;
+
+    unsigned int code = ReadVarInt();
+    if( code == LETTERCODEC_STRINGNULL ) return NULL;
+
+    if( code == LETTERCODEC_STRINGLITERAL )
+    {
+        unsigned int length = ReadVarInt();
+        if( m_failed ||
+            length > LETTERCODEC_MAXSTRINGLENGTH ||
+            length > (unsigned int) ( m_end - m_data ) )
+        {
+            m_failed = true;
+            return NULL;
+        }
+
+        char *string = new char[length + 1];
+        memcpy( string, m_data, length );
+        string[length] = '\x0';
+        m_data += length;
+
+        _owned = true;
+        return string;
+    }
+
+    unsigned int tag = code - LETTERCODEC_STRINGTAG;
+    if( tag >= (unsigned int) s_numLetterTags )
+    {
+        m_failed = true;
+        return NULL;
+    }
+
+    return (char *) s_letterTags[tag];
+}
+
+
+LetterReader::ShapeField *LetterReader::AddField()
+{
+    if( m_numFields == m_maxFields )
+    {
+        int maxFields = max( m_maxFields * 2, 64 );
+        ShapeField *fields = new ShapeField[maxFields];
+        if( m_fields ) memcpy( fields, m_fields, m_numFields * sizeof(ShapeField) );
+        delete [] m_fields;
+
+        m_fields = fields;
+        m_maxFields = maxFields;
+    }
+
+    return &m_fields[m_numFields++];
+}
+
+
+bool LetterReader::ReadDirectory( Directory *_dir, int _depth )
+{
+    if( _depth > LETTERCODEC_MAXDEPTH ) return false;
+
+
+    //
+    // Name
+
+    bool owned;
+    char *name = ReadString( owned );
+    if( m_failed ) return false;
+
+    if( name ) _dir->SetName( name );
+    if( owned ) delete [] name;
+
+
+    //
+    // Shape
+
+    unsigned int shapeCode = ReadVarInt();
+    if( m_failed ) return false;
+
+    int firstField;
+    int numFields;
+
+    if( shapeCode == 0 )
+    {
+        numFields = (int) ReadVarInt();
+        if( m_failed || numFields < 0 || numFields > LETTERCODEC_MAXDIRSIZE ) return false;
+
+        firstField = m_numFields;
+        for( int f = 0; f < numFields; ++f )
+        {
+            ShapeField *field = AddField();
+            field->m_name = NULL;
+            field->m_owned = false;
+            field->m_name = ReadString( field->m_owned );
+            field->m_type = ReadByte();
+            if( m_failed || !field->m_name ) return false;
+        }
+
+        // Sent in full but never referred to again once the table is full
+        if( m_numShapes < LETTERCODEC_MAXSHAPES )
+        {
+            m_shapes[m_numShapes].m_firstField = firstField;
+            m_shapes[m_numShapes].m_numFields = numFields;
+            ++m_numShapes;
+        }
+    }
+    else
+    {
+        if( shapeCode > (unsigned int) m_numShapes ) return false;
+
+        Shape *shape = &m_shapes[shapeCode - 1];
+        firstField = shape->m_firstField;
+        numFields = shape->m_numFields;
+    }
+
+
+    //
+    // Values
+
+    for( int f = 0; f < numFields; ++f )
+    {
+        ShapeField *field = &m_fields[firstField + f];
+
+        DirectoryData *data = new DirectoryData();
+        data->SetName( field->m_name );
+        data->m_type = field->m_type;
+
+        switch( field->m_type )
+        {
+            case DIRECTORY_TYPE_INT:        data->m_int = ReadInt();                                        break;
+            case DIRECTORY_TYPE_FLOAT:      ReadNetworkBytes( &data->m_float, sizeof(data->m_float) );      break;
+            case DIRECTORY_TYPE_FIXED:      ReadNetworkBytes( &data->m_fixed, sizeof(data->m_fixed) );      break;
+            case DIRECTORY_TYPE_CHAR:       data->m_char = (char) ReadByte();                               break;
+            case DIRECTORY_TYPE_BOOL:       data->m_bool = ( ReadByte() != 0 );                             break;
+
+            case DIRECTORY_TYPE_STRING:
+            {
+                char *string = ReadString( owned );
+                if( owned )         data->m_string = string;
+                else if( string )   data->m_string = newStr( string );
+                break;
+            }
+
+            case DIRECTORY_TYPE_VOID:
+            {
+                unsigned int length = ReadVarInt();
+                if( m_failed || length > (unsigned int) ( m_end - m_data ) )
+                {
+                    m_failed = true;
+                    break;
+                }
+                data->m_voidLen = (int) length;
+                data->m_void = new char[length];
+                memcpy( data->m_void, m_data, length );
+                m_data += length;
+                break;
+            }
+
+            default:
+                m_failed = true;
+                break;
+        }
+
+        _dir->m_data.PutData( data );
+        if( m_failed ) return false;
+    }
+
+
+    //
+    // Subdirectories
+
+    int numSubdirs = (int) ReadVarInt();
+    if( m_failed || numSubdirs < 0 || numSubdirs > LETTERCODEC_MAXDIRSIZE ) return false;
+
+    for( int s = 0; s < numSubdirs; ++s )
+    {
+        Directory *subDir = new Directory();
+        _dir->m_subDirectories.PutData( subDir );
+        if( !ReadDirectory( subDir, _depth + 1 ) ) return false;
+    }
+
+    return true;
+}
+
+
+// ============================================================================
+// LetterCodec
+
+void LetterCodec::Initialise()
+{
+    if( s_tagIndex.NumUsed() > 0 ) return;
+
+    for( int i = 0; i < s_numLetterTags; ++i )
+    {
+        // Some names are shared between the defcon and metaserver sets,
+        // the first one in the table is the one we send
+        if( s_tagIndex.GetIndex( s_letterTags[i] ) == -1 )
+        {
+            s_tagIndex.PutData( s_letterTags[i], i );
+        }
+    }
+}
+
+
+int LetterCodec::Write( Directory *_letter, int _format, char *&_buffer, int &_bufferSize )
+{
+    AppAssert( _letter );
+
+    if( _format == LETTER_FORMAT_DIRECTORY )
+    {
+        int length = _letter->Write( _buffer, _bufferSize );
+        if( length == -1 )
+        {
+            delete [] _buffer;
+            _bufferSize = _letter->GetWriteSize();
+            _buffer = new char[_bufferSize];
+
+            length = _letter->Write( _buffer, _bufferSize );
+            AppAssert( length == _bufferSize );
+        }
+        return length;
+    }
+
+    AppAssert( _format == LETTER_FORMAT_BINARY );
+
+    LetterWriter writer( _buffer, _bufferSize );
+    writer.WriteByte( LETTERCODEC_MARKER );
+    writer.WriteByte( (unsigned char) _format );
+    writer.WriteDirectory( _letter, _letter->m_name );
+
+    int length = 0;
+    _buffer = writer.Release( length, _bufferSize );
+    return length;
+}
+
+
+bool LetterCodec::IsBinary( char *_input, int _length )
+{
+    return( _input &&
+            _length >= 2 &&
+            (unsigned char) _input[0] == LETTERCODEC_MARKER );
+}
+
+
+bool LetterCodec::Read( Directory *_letter, char *_input, int _length )
+{
+    AppAssert( _letter );
+
+    if( !IsBinary( _input, _length ) )
+    {
+        return _letter->Read( _input, _length );
+    }
+
+    int format = (unsigned char) _input[1];
+    if( format != LETTER_FORMAT_BINARY )
+    {
+        AppDebugOut( "Received letter in unknown format %d\n", format );
+        return false;
+    }
+
+    LetterReader reader( _input + 2, _length - 2 );
+    return( reader.ReadDirectory( _letter, 0 ) &&
+            !reader.Failed() &&
+            reader.AtEnd() );
+}
+
+
+int LetterCodec::WriteEncoded( EncodedLetter *_letter, int _lastSeqId, EncodedLetter *_prevUpdate,
+                               char *&_buffer, int &_bufferSize )
+{
+    AppAssert( _letter );
+    AppAssert( !_prevUpdate || _prevUpdate->m_format == _letter->m_format );
+
+    int numSubDirs = _letter->m_numSubDirs + ( _prevUpdate ? 1 : 0 );
+
+    LetterWriter writer( _buffer, _bufferSize );
+    writer.WriteBytes( _letter->m_data, _letter->m_headLength );
+
+    if( _letter->m_format == LETTER_FORMAT_DIRECTORY )
+    {
+        char fields[ sizeof(NET_DEFCON_LASTSEQID) + 16 ];
+        int length = Directory::WriteDynamicString( fields, NET_DEFCON_LASTSEQID );
+        fields[length++] = DIRECTORY_TYPE_INT;
+        writer.WriteBytes( fields, length );
+        writer.WriteNetworkBytes( &_lastSeqId, sizeof(_lastSeqId) );
+
+        length = Directory::WritePackedInt( fields, numSubDirs );
+        writer.WriteBytes( fields, length );
+    }
+    else
+    {
+        writer.WriteInt( _lastSeqId );
+        writer.WriteVarInt( numSubDirs );
+    }
+
+    writer.WriteBytes( _letter->m_data + _letter->m_headLength, _letter->m_length - _letter->m_headLength );
+
+    if( _prevUpdate )
+    {
+        writer.WriteBytes( _prevUpdate->m_prevUpdate, _prevUpdate->m_prevUpdateLength );
+    }
+
+    if( _letter->m_format == LETTER_FORMAT_DIRECTORY )
+    {
+        writer.WriteBytes( DIRECTORY_MARKEREND, DIRECTORY_MARKERSIZE );
+        writer.WriteByte( 0 );                                              // As Directory::Write
+    }
+
+    int length = 0;
+    _buffer = writer.Release( length, _bufferSize );
+    return length;
+}
+
+
+void LetterCodec::WriteInts( Directory *_dir, char *_name, int *_values, int _count )
+{
+    //
+    // Zigzag varints, as LetterWriter::WriteInt does for a single int
+
+    unsigned char *packed = new unsigned char[ _count * 5 + 1 ];
+    int length = 0;
+
+    for( int i = 0; i < _count; ++i )
+    {
+        unsigned int zigzag = ( (unsigned int) _values[i] << 1 ) ^ (unsigned int) ( _values[i] >> 31 );
+
+        while( zigzag >= 0x80 )
+        {
+            packed[length++] = (unsigned char) ( zigzag | 0x80 );
+            zigzag >>= 7;
+        }
+
+        packed[length++] = (unsigned char) zigzag;
+    }
+
+    _dir->CreateData( _name, (void *) packed, length );
+
+    delete [] packed;
+}
+
+
+static bool ReadPackedInt( unsigned char *&_packed, unsigned char *_end, int &_value )
+{
+    unsigned int zigzag = 0;
+
+    for( int shift = 0; shift < 35; shift += 7 )
+    {
+        if( _packed >= _end ) return false;
+
+        unsigned char byte = *_packed++;
+        zigzag |= (unsigned int) ( byte & 0x7f ) << shift;
+
+        if( !( byte & 0x80 ) )
+        {
+            _value = (int) ( zigzag >> 1 ) ^ -(int) ( zigzag & 1 );
+            return true;
+        }
+    }
+
+    return false;
+}
+
+
+int LetterCodec::ReadInts( Directory *_dir, char *_name, int *_values, int _maxCount )
+{
+    int length = 0;
+    unsigned char *packed = (unsigned char *) _dir->GetDataVoid( _name, &length );
+    if( !packed ) return 0;
+
+    unsigned char *end = packed + length;
+    int count = 0;
+
+    while( count < _maxCount && ReadPackedInt( packed, end, _values[count] ) )
+    {
+        ++count;
+    }
+
+    return count;
+}
+
+
+void LetterCodec::WriteIntList( Directory *_dir, char *_name, LList<int> *_list )
+{
+    int count = _list->Size();
+    int *values = new int[ count + 1 ];
+
+    for( int i = 0; i < count; ++i )
+    {
+        values[i] = _list->GetData(i);
+    }
+
+    WriteInts( _dir, _name, values, count );
+
+    delete [] values;
+}
+
+
+void LetterCodec::ReadIntList( Directory *_dir, char *_name, LList<int> *_list )
+{
+    int length = 0;
+    unsigned char *packed = (unsigned char *) _dir->GetDataVoid( _name, &length );
+    if( !packed ) return;
+
+    unsigned char *end = packed + length;
+    int value;
+
+    while( ReadPackedInt( packed, end, value ) )
+    {
+        _list->PutDataAtEnd( value );
+    }
+}
+
+
+void LetterCodec::GetHashPathName( int *_path, int _depth, char *_name )
+{
+    static char *s_subsystemNames[] = { "random", "world", "teams", "fleets", "cities",
+                                        "radar", "gunfire", "explosions" };
+
+    if( _depth == 0 )
+    {
+        strcpy( _name, "root" );
+        return;
+    }
+
+    int subsystem = _path[0];
+
+    if( subsystem >= 0 && subsystem < WorldHash_Objects )
+    {
+        strcpy( _name, s_subsystemNames[subsystem] );
+    }
+    else if( subsystem >= WorldHash_Objects && subsystem < WorldHash_NumSubsystems )
+    {
+        sprintf( _name, "objects %s", WorldObject::GetTypeName( subsystem - WorldHash_Objects ) );
+    }
+    else
+    {
+        sprintf( _name, "subsystem %d", subsystem );
+    }
+
+    bool byTeam = ( subsystem == WorldHash_Teams ||
+                    subsystem == WorldHash_Fleets ||
+                    subsystem == WorldHash_Radar );
+
+    for( int i = 1; i < _depth && i < WORLDHASH_MAXDEPTH; ++i )
+    {
+        char part[64];
+
+        if( byTeam && i == 1 )                  sprintf( part, " / team %d", _path[i] );
+        else if( byTeam )                       sprintf( part, " / fleet %d", _path[i] );
+        else if( i == 1 )                       sprintf( part, " / slots %d-%d", _path[i] * WORLDHASH_BUCKETSIZE,
+                                                                                 ( _path[i] + 1 ) * WORLDHASH_BUCKETSIZE - 1 );
+        else                                    sprintf( part, " / slot %d", _path[i] );
+
+        strcat( _name, part );
+    }
+}
+
+
+// ============================================================================
+// EncodedLetter
+
+EncodedLetter::EncodedLetter( Directory *_letter, int _format )
+:   m_refCount(1),
+    m_format(_format),
+    m_data(NULL),
+    m_headLength(0),
+    m_length(0),
+    m_numSubDirs(0),
+    m_prevUpdate(NULL),
+    m_prevUpdateLength(0)
+{
+    AppAssert( _letter );
+    AppAssert( !_letter->HasData( NET_DEFCON_LASTSEQID ) );
+
+    m_numSubDirs = _letter->m_subDirectories.NumUsed();
+
+    if( _format == LETTER_FORMAT_DIRECTORY )
+    {
+        //
+        // "<", name, number of data + 1, data | subdirectories
+        // The spliced letter gets NET_DEFCON_LASTSEQID, the number of subdirectories and ">"
+
+        int numData = _letter->m_data.NumUsed();
+        int dataLength = _letter->WriteDataBlock( NULL );
+        int subDirLength = _letter->WriteSubDirBlock( NULL );
+
+        m_headLength = DIRECTORY_MARKERSIZE +
+                       Directory::WriteDynamicString( NULL, _letter->m_name ) +
+                       Directory::WritePackedInt( NULL, numData + 1 ) +
+                       dataLength;
+        m_length = m_headLength + subDirLength;
+        m_data = new char[m_length];
+
+        char *pos = m_data;
+        memcpy( pos, DIRECTORY_MARKERSTART, DIRECTORY_MARKERSIZE );
+        pos += DIRECTORY_MARKERSIZE;
+        pos += Directory::WriteDynamicString( pos, _letter->m_name );
+        pos += Directory::WritePackedInt( pos, numData + 1 );
+        pos += _letter->WriteDataBlock( pos );
+        pos += _letter->WriteSubDirBlock( pos );
+        AppAssert( pos == m_data + m_length );
+
+
+        //
+        // The same data and subdirectories, reused as a whole subdirectory
+
+        char *data = m_data + m_headLength - dataLength;
+        char *subDirs = m_data + m_headLength;
+
+        m_prevUpdateLength = DIRECTORY_MARKERSIZE +
+                             Directory::WriteDynamicString( NULL, NET_DEFCON_PREVUPDATE ) +
+                             Directory::WritePackedInt( NULL, numData ) +
+                             dataLength +
+                             Directory::WritePackedInt( NULL, m_numSubDirs ) +
+                             subDirLength +
+                             DIRECTORY_MARKERSIZE;
+        m_prevUpdate = new char[m_prevUpdateLength];
+
+        pos = m_prevUpdate;
+        memcpy( pos, DIRECTORY_MARKERSTART, DIRECTORY_MARKERSIZE );
+        pos += DIRECTORY_MARKERSIZE;
+        pos += Directory::WriteDynamicString( pos, NET_DEFCON_PREVUPDATE );
+        pos += Directory::WritePackedInt( pos, numData );
+        memcpy( pos, data, dataLength );
+        pos += dataLength;
+        pos += Directory::WritePackedInt( pos, m_numSubDirs );
+        memcpy( pos, subDirs, subDirLength );
+        pos += subDirLength;
+        memcpy( pos, DIRECTORY_MARKEREND, DIRECTORY_MARKERSIZE );
+        pos += DIRECTORY_MARKERSIZE;
+        AppAssert( pos == m_prevUpdate + m_prevUpdateLength );
+    }
+    else
+    {
+        AppAssert( _format == LETTER_FORMAT_BINARY );
+
+        //
+        // Marker, format, name, shape with NET_DEFCON_LASTSEQID last, values | subdirectories
+        // The spliced letter gets the NET_DEFCON_LASTSEQID value and the number of subdirectories
+
+        DirectoryData lastSeqId;
+        lastSeqId.SetName( NET_DEFCON_LASTSEQID );
+        lastSeqId.SetData( 0 );
+
+        int bufferSize = 0;
+
+        LetterWriter writer( NULL, 0 );
+        writer.WriteByte( LETTERCODEC_MARKER );
+        writer.WriteByte( (unsigned char) _format );
+        writer.WriteString( _letter->m_name );
+        writer.WriteShape( _letter, &lastSeqId );
+        writer.WriteValues( _letter );
+        m_headLength = writer.GetLength();
+        writer.WriteSubDirs( _letter );
+        m_data = writer.Release( m_length, bufferSize );
+
+
+        //
+        // Shapes in the letter it is spliced into are numbered differently,
+        // so as a subdirectory it spells out every one of its own
+
+        LetterWriter prevUpdate( NULL, 0 );
+        prevUpdate.SetInlineShapes();
+        prevUpdate.WriteDirectory( _letter, NET_DEFCON_PREVUPDATE );
+        m_prevUpdate = prevUpdate.Release( m_prevUpdateLength, bufferSize );
+    }
+}
+
+
+EncodedLetter::~EncodedLetter()
+{
+    delete [] m_data;
+    delete [] m_prevUpdate;
+}
+
+
+void EncodedLetter::AddRef()
+{
+    ++m_refCount;
+}
+
+
+void EncodedLetter::Release()
+{
+    AppAssert( m_refCount > 0 );
+    if( --m_refCount == 0 )
+    {
+        delete this;
+    }
+}
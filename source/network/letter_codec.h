@@ -0,0 +1,119 @@
+
+/*
+ * ============
+ * LETTER CODEC
+ * ============
+ *
+ * Puts game letters on the wire in a compact binary form, and takes
+ * them off again in either that form or Directory's own.
+ * Everything above the socket still reads and writes a Directory.
+ *
+ *  Letter      : LETTERCODEC_MARKER, format byte, Dir
+ *  Dir         : String name, shape, a value for each field of the shape,
+ *                varint number of subdirectories, Dir for each
+ *  Shape       : varint, 0 for a new shape which then follows as
+ *                varint field count and String name + type byte per field,
+ *                or n to reuse the (n-1)th new shape of this letter.
+ *                Nothing in a NET_DEFCON_PREVUPDATE reuses a shape
+ *  String      : varint, 0 for NULL, 1 for a literal which then follows
+ *                as varint length and bytes, or n for s_letterTags[n-2]
+ *  Values      : int as a zigzag varint, float and Fixed in the same byte
+ *                order as Directory, char and bool as one byte,
+ *                string as a String, void as varint length and bytes
+ *
+ * The names and commands of our letters are all in the tag table, so a
+ * typical field costs its value plus a byte, and every command of the
+ * same kind in an update shares one shape.
+ *
+ * The tag table is part of the format : add new tags at the end
+ * and bump LETTER_FORMAT_CURRENT whenever it or the layout changes.
+ * Peers agree a format through VersionManager::ChooseLetterFormat.
+ *
+ */
+
+#ifndef _included_lettercodec_h
+#define _included_lettercodec_h
+
+class Directory;
+class EncodedLetter;
+
+template <class T> class LList;
+
+
+#define LETTER_FORMAT_DIRECTORY         0                       // Directory::Write, all versions understand this
+#define LETTER_FORMAT_BINARY            1
+#define LETTER_FORMAT_CURRENT           LETTER_FORMAT_BINARY
+#define LETTER_NUMFORMATS               (LETTER_FORMAT_CURRENT + 1)
+
+#define LETTERCODEC_MARKER              0xB7                    // Never DIRECTORY_MARKERSTART
+
+
+class LetterCodec
+{
+public:
+    static void Initialise  ();                                                     // At startup, before any network thread
+
+    static int  Write       ( Directory *_letter, int _format,                      // Into the caller's buffer, which is replaced
+                              char *&_buffer, int &_bufferSize );                   // by a bigger one if needed.  Returns the length
+    static bool Read        ( Directory *_letter, char *_input, int _length );      // Either format, returns false if bogus
+
+    static bool IsBinary    ( char *_input, int _length );
+
+    static int  WriteEncoded( EncodedLetter *_letter, int _lastSeqId,                // _letter with NET_DEFCON_LASTSEQID added
+                              EncodedLetter *_prevUpdate,                           // and _prevUpdate, if any, as NET_DEFCON_PREVUPDATE.
+                              char *&_buffer, int &_bufferSize );                   // As Write
+
+    //
+    // Arrays of ints packed into one void field, for letters and snapshots alike,
+    // since Directory's own lists are large.  ReadInts returns the count read
+
+    static void WriteInts   ( Directory *_dir, char *_name, int *_values, int _count );
+    static int  ReadInts    ( Directory *_dir, char *_name, int *_values, int _maxCount );
+    static void WriteIntList( Directory *_dir, char *_name, LList<int> *_list );
+    static void ReadIntList ( Directory *_dir, char *_name, LList<int> *_list );
+
+    static void GetHashPathName( int *_path, int _depth, char *_name );             // Of a WorldHash node as sent in a probe,
+                                                                                    // human readable, _name at least 256 chars
+};
+
+
+
+/*
+ * ==============
+ * ENCODED LETTER
+ * ==============
+ *
+ * A server history letter encoded once, in pieces, so that every client it
+ * goes to can be sent the same bytes with only its own fields spliced in.
+ * Immutable once built, and shared between the history and the outbox by
+ * reference count.  Only used from the main thread.
+ *
+ */
+
+class EncodedLetter
+{
+protected:
+    int     m_refCount;
+
+    ~EncodedLetter();
+
+public:
+    int     m_format;
+
+    char    *m_data;                                // The letter up to NET_DEFCON_LASTSEQID,
+    int     m_headLength;                           // then from there its subdirectories
+    int     m_length;
+    int     m_numSubDirs;
+
+    char    *m_prevUpdate;                          // The whole letter again, as a NET_DEFCON_PREVUPDATE subdirectory
+    int     m_prevUpdateLength;
+
+public:
+    EncodedLetter( Directory *_letter, int _format );
+
+    void    AddRef  ();
+    void    Release ();                             // Deletes on the last one
+};
+
+
+#endif
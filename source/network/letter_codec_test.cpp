@@ -0,0 +1,211 @@
+// Build from the root directory, eg
+//
+//   g++ -O2 -DTARGET_OS_LINUX -Isource -Icontrib/systemIV source/network/letter_codec_test.cpp source/network/letter_codec.cpp contrib/systemIV/lib/tosser/directory.cpp contrib/systemIV/lib/string_utils.cpp contrib/systemIV/lib/math/fixed_64.cpp
+//
+// Checks that a server update encoded once and shared, with each client's
+// NET_DEFCON_LASTSEQID and NET_DEFCON_PREVUPDATE spliced in by WriteEncoded,
+// comes out byte for byte the same as the per-client copy the server builds
+// when it can't share, in both letter formats.  Both must read back as the
+// same Directory.  Returns non-zero on any difference.
+
+#include "lib/universal_include.h"
+
+#include <stdarg.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "lib/tosser/directory.h"
+
+#include "network/letter_codec.h"
+#include "network/network_defines.h"
+
+
+void AppDebugOut( char *_msg, ... )
+{
+}
+
+
+void AppReleaseAssertFailed( char const *_msg, ... )
+{
+    va_list ap;
+    va_start( ap, _msg );
+    vprintf( _msg, ap );
+    va_end( ap );
+    printf( "\n" );
+    exit( 1 );
+}
+
+
+//
+// Server updates as Server::AdvanceSender sends them : a sequence
+// number and a batch of client commands, some of the same shape
+
+static Directory *MakeUpdateLetter( int _seqId, int _numCommands )
+{
+    Directory *letter = new Directory();
+    letter->SetName( NET_DEFCON_MESSAGE );
+    letter->CreateData( NET_DEFCON_COMMAND, NET_DEFCON_UPDATE );
+    letter->CreateData( NET_DEFCON_SEQID, _seqId );
+
+    for( int i = 0; i < _numCommands; ++i )
+    {
+        Directory *command = new Directory();
+        command->SetName( NET_DEFCON_MESSAGE );
+
+        switch( i % 3 )
+        {
+            case 0:
+                command->CreateData( NET_DEFCON_COMMAND, NET_DEFCON_OBJSETWAYPOINT );
+                command->CreateData( NET_DEFCON_OBJECTID, 1000 + i * 37 );
+                command->CreateData( NET_DEFCON_LONGITUDE, Fixed::FromDouble( -120.5 + i ) );
+                command->CreateData( NET_DEFCON_LATTITUDE, Fixed::FromDouble( 33.25 - i ) );
+                break;
+
+            case 1:
+                command->CreateData( NET_DEFCON_COMMAND, NET_DEFCON_OBJSTATECHANGE );
+                command->CreateData( NET_DEFCON_OBJECTID, 2000 + i );
+                command->CreateData( NET_DEFCON_STATE, i % 4 );
+                break;
+
+            case 2:
+                command->CreateData( NET_DEFCON_COMMAND, NET_DEFCON_CHATMESSAGE );
+                command->CreateData( NET_DEFCON_TEAMID, i % 6 );
+                command->CreateData( NET_DEFCON_CHATCHANNEL, 100 );
+                command->CreateData( NET_DEFCON_CHATMSG, "Launching everything at Moscow, sorry" );
+                command->CreateData( NET_DEFCON_SPECTATOR, i % 2 == 0 );
+                break;
+        }
+
+        command->CreateData( NET_DEFCON_LASTPROCESSEDSEQID, _seqId - 1 );
+        letter->AddDirectory( command );
+    }
+
+    return letter;
+}
+
+
+//
+// Equivalence
+
+static int s_numFailures = 0;
+
+static void Fail( char const *_letterName, int _format, char const *_what )
+{
+    printf( "FAILED %s, format %d : %s\n", _letterName, _format, _what );
+    ++s_numFailures;
+}
+
+
+static void TestLetter( char const *_letterName, Directory *_letter, Directory *_prevLetter,
+                        int _format, int _lastSeqId )
+{
+    //
+    // Shared, as Server::AdvanceSender sends to clients that can take it
+
+    EncodedLetter *encoded = new EncodedLetter( _letter, _format );
+    EncodedLetter *encodedPrev = ( _prevLetter ? new EncodedLetter( _prevLetter, _format ) : NULL );
+
+    char *sharedBytes = NULL;
+    int sharedSize = 0;
+    int sharedLength = LetterCodec::WriteEncoded( encoded, _lastSeqId, encodedPrev, sharedBytes, sharedSize );
+
+
+    //
+    // Per client, as it sends to the rest
+
+    Directory *copy = new Directory( _letter );
+    if( _prevLetter )
+    {
+        Directory *prevData = new Directory( _prevLetter );
+        prevData->SetName( NET_DEFCON_PREVUPDATE );
+        copy->AddDirectory( prevData );
+    }
+    copy->CreateData( NET_DEFCON_LASTSEQID, _lastSeqId );
+
+    char *copyBytes = NULL;
+    int copySize = 0;
+    int copyLength = LetterCodec::Write( copy, _format, copyBytes, copySize );
+
+    if( sharedLength != copyLength || memcmp( sharedBytes, copyBytes, copyLength ) != 0 )
+    {
+        Fail( _letterName, _format, "shared bytes differ from the per-client copy" );
+    }
+
+
+    //
+    // And both read back as the letter that was meant
+
+    Directory fromShared;
+    Directory fromCopy;
+    if( !LetterCodec::Read( &fromShared, sharedBytes, sharedLength ) ||
+        !LetterCodec::Read( &fromCopy, copyBytes, copyLength ) )
+    {
+        Fail( _letterName, _format, "Read failed" );
+    }
+    else
+    {
+        int expectedLength = 0;
+        int sharedReadLength = 0;
+        int copyReadLength = 0;
+        char *expected = copy->Write( expectedLength );
+        char *sharedRead = fromShared.Write( sharedReadLength );
+        char *copyRead = fromCopy.Write( copyReadLength );
+
+        if( sharedReadLength != expectedLength || memcmp( sharedRead, expected, expectedLength ) != 0 )
+        {
+            Fail( _letterName, _format, "shared bytes read back as a different letter" );
+        }
+
+        if( copyReadLength != expectedLength || memcmp( copyRead, expected, expectedLength ) != 0 )
+        {
+            Fail( _letterName, _format, "per-client bytes read back as a different letter" );
+        }
+
+        delete [] expected;
+        delete [] sharedRead;
+        delete [] copyRead;
+    }
+
+    encoded->Release();
+    if( encodedPrev ) encodedPrev->Release();
+
+    delete copy;
+    delete [] sharedBytes;
+    delete [] copyBytes;
+}
+
+
+int main( int argc, char *argv[] )
+{
+    LetterCodec::Initialise();
+
+    Directory *empty     = MakeUpdateLetter( 18211, 0 );
+    Directory *emptyPrev = MakeUpdateLetter( 18210, 0 );
+    Directory *update    = MakeUpdateLetter( 18211, 40 );
+    Directory *prev      = MakeUpdateLetter( 18210, 25 );
+
+    for( int format = 0; format < LETTER_NUMFORMATS; ++format )
+    {
+        TestLetter( "empty",                empty,  NULL,       format, 18209 );
+        TestLetter( "empty with previous",  empty,  emptyPrev,  format, 18209 );
+        TestLetter( "update",               update, NULL,       format, -1 );
+        TestLetter( "update with previous", update, prev,       format, 18209 );
+        TestLetter( "update with empty",    update, emptyPrev,  format, 0 );
+        TestLetter( "empty with update",    empty,  prev,       format, 123456789 );
+    }
+
+    delete empty;
+    delete emptyPrev;
+    delete update;
+    delete prev;
+
+    if( s_numFailures > 0 )
+    {
+        printf( "%d failures\n", s_numFailures );
+        return 1;
+    }
+
+    printf( "Shared letters match the per-client copies in all %d formats\n", LETTER_NUMFORMATS );
+    return 0;
+}
@@ -0,0 +1,285 @@
+#include "lib/universal_include.h"
+
+#include <string.h>
+
+#include "lib/debug_utils.h"
+#include "lib/tosser/directory.h"
+
+#include "network/Server.h"
+#include "network/letter_codec.h"
+#include "network/letter_history.h"
+
+
+// ============================================================================
+// LetterHistoryChunk
+
+LetterHistoryChunk::LetterHistoryChunk()
+:   m_loaded(true),
+    m_logged(false),
+    m_logOffset(0),
+    m_lastUsed(0)
+{
+    memset( m_letters, 0, sizeof(m_letters) );
+    memset( m_offsets, 0, sizeof(m_offsets) );
+}
+
+
+LetterHistoryChunk::~LetterHistoryChunk()
+{
+    Unload();
+}
+
+
+void LetterHistoryChunk::Unload()
+{
+    for( int i = 0; i < LETTERHISTORY_CHUNKSIZE; ++i )
+    {
+        delete m_letters[i];
+        m_letters[i] = NULL;
+    }
+    m_loaded = false;
+}
+
+
+// ============================================================================
+// LetterHistory
+
+LetterHistory::LetterHistory()
+:   m_size(0),
+    m_log(NULL),
+    m_logFailed(false),
+    m_logSize(0),
+    m_numColdLoaded(0),
+    m_useCounter(0),
+    m_buffer(NULL),
+    m_bufferSize(0)
+{
+    m_chunks.SetStepDouble();
+}
+
+
+LetterHistory::~LetterHistory()
+{
+    EmptyAndDelete();
+}
+
+
+void LetterHistory::EmptyAndDelete()
+{
+    m_chunks.EmptyAndDelete();
+    m_size = 0;
+
+    if( m_log ) fclose( m_log );                                // tmpfile, so this deletes it
+    m_log = NULL;
+    m_logFailed = false;
+    m_logSize = 0;
+
+    m_numColdLoaded = 0;
+    m_useCounter = 0;
+
+    delete [] m_buffer;
+    m_buffer = NULL;
+    m_bufferSize = 0;
+}
+
+
+bool LetterHistory::IsHot( int _chunk )
+{
+    int numChunks = ( m_size + LETTERHISTORY_CHUNKSIZE - 1 ) / LETTERHISTORY_CHUNKSIZE;
+    return _chunk >= numChunks - LETTERHISTORY_HOTCHUNKS;
+}
+
+
+ServerToClientLetter *LetterHistory::GetData( int _seqId )
+{
+    AppAssert( ValidIndex(_seqId) );
+
+    int chunkIndex = _seqId / LETTERHISTORY_CHUNKSIZE;
+    LetterHistoryChunk *chunk = m_chunks[chunkIndex];
+
+    if( !chunk->m_loaded && !ReadFromLog( chunkIndex ) )
+    {
+        return NULL;
+    }
+
+    chunk->m_lastUsed = ++m_useCounter;
+    return chunk->m_letters[ _seqId % LETTERHISTORY_CHUNKSIZE ];
+}
+
+
+void LetterHistory::PutDataAtEnd( ServerToClientLetter *_letter )
+{
+    AppAssert( _letter && _letter->m_data );
+
+    int chunkIndex = m_size / LETTERHISTORY_CHUNKSIZE;
+    int index = m_size % LETTERHISTORY_CHUNKSIZE;
+
+    if( index == 0 )
+    {
+        m_chunks.PutData( new LetterHistoryChunk(), chunkIndex );
+
+        int coolChunk = chunkIndex - LETTERHISTORY_HOTCHUNKS;
+        if( coolChunk >= 0 ) WriteToLog( coolChunk );
+    }
+
+    m_chunks[chunkIndex]->m_letters[index] = _letter;
+    ++m_size;
+}
+
+
+bool LetterHistory::OpenLog()
+{
+    if( m_log ) return true;
+    if( m_logFailed ) return false;
+
+    m_log = tmpfile();
+    if( !m_log )
+    {
+        AppDebugOut( "Failed to create the letter history log, keeping the whole history in memory\n" );
+        m_logFailed = true;
+        return false;
+    }
+
+    m_logSize = 0;
+    return true;
+}
+
+
+void LetterHistory::WriteToLog( int _chunk )
+{
+    LetterHistoryChunk *chunk = m_chunks[_chunk];
+    AppAssert( chunk->m_loaded && !chunk->m_logged );
+
+    if( !OpenLog() ) return;
+
+
+    //
+    // Append each letter, noting where it starts
+
+    bool success = ( fseek( m_log, m_logSize, SEEK_SET ) == 0 );
+    int chunkLength = 0;
+
+    for( int i = 0; success && i < LETTERHISTORY_CHUNKSIZE; ++i )
+    {
+        int length = LetterCodec::Write( chunk->m_letters[i]->m_data, LETTER_FORMAT_CURRENT,
+                                         m_buffer, m_bufferSize );
+        success = ( fwrite( m_buffer, 1, length, m_log ) == (size_t) length );
+
+        chunk->m_offsets[i] = chunkLength;
+        chunkLength += length;
+    }
+
+    chunk->m_offsets[LETTERHISTORY_CHUNKSIZE] = chunkLength;
+
+    if( !success )
+    {
+        // Keep this one in memory, and try the log again with the next
+
+        AppDebugOut( "Failed to write to the letter history log\n" );
+        return;
+    }
+
+    chunk->m_logged = true;
+    chunk->m_logOffset = m_logSize;
+    m_logSize += chunkLength;
+
+    chunk->Unload();
+}
+
+
+bool LetterHistory::ReadFromLog( int _chunk )
+{
+    LetterHistoryChunk *chunk = m_chunks[_chunk];
+    AppAssert( !chunk->m_loaded && chunk->m_logged );
+
+
+    //
+    // Make room, dropping the old chunk that has gone unused longest
+
+    if( m_numColdLoaded >= LETTERHISTORY_COLDCHUNKS )
+    {
+        LetterHistoryChunk *leastUsed = NULL;
+
+        for( int i = 0; i < m_chunks.Size(); ++i )
+        {
+            if( m_chunks.ValidIndex(i) && !IsHot(i) )
+            {
+                LetterHistoryChunk *thisChunk = m_chunks[i];
+                if( thisChunk->m_loaded && thisChunk->m_logged &&
+                    ( !leastUsed || thisChunk->m_lastUsed < leastUsed->m_lastUsed ) )
+                {
+                    leastUsed = thisChunk;
+                }
+            }
+        }
+
+        AppAssert( leastUsed );
+        leastUsed->Unload();
+        --m_numColdLoaded;
+    }
+
+
+    //
+    // Read it all in, then decode each letter
+
+    int chunkLength = chunk->m_offsets[LETTERHISTORY_CHUNKSIZE];
+    if( chunkLength > m_bufferSize )
+    {
+        delete [] m_buffer;
+        m_buffer = new char[chunkLength];
+        m_bufferSize = chunkLength;
+    }
+
+    if( fseek( m_log, chunk->m_logOffset, SEEK_SET ) != 0 ||
+        fread( m_buffer, 1, chunkLength, m_log ) != (size_t) chunkLength )
+    {
+        AppDebugOut( "Failed to read chunk %d from the letter history log\n", _chunk );
+        return false;
+    }
+
+    for( int i = 0; i < LETTERHISTORY_CHUNKSIZE; ++i )
+    {
+        ServerToClientLetter *letter = new ServerToClientLetter();
+        letter->m_data = new Directory();
+
+        int offset = chunk->m_offsets[i];
+        if( !LetterCodec::Read( letter->m_data, m_buffer + offset, chunk->m_offsets[i+1] - offset ) )
+        {
+            AppDebugOut( "Letter %d in the letter history log is corrupt\n", _chunk * LETTERHISTORY_CHUNKSIZE + i );
+            delete letter;
+            chunk->Unload();
+            return false;
+        }
+
+        chunk->m_letters[i] = letter;
+    }
+
+    chunk->m_loaded = true;
+    ++m_numColdLoaded;
+    return true;
+}
+
+
+int LetterHistory::GetByteSize()
+{
+    int byteSize = m_logSize;
+
+    for( int i = 0; i < m_chunks.Size(); ++i )
+    {
+        if( m_chunks.ValidIndex(i) && m_chunks[i]->m_loaded )
+        {
+            LetterHistoryChunk *chunk = m_chunks[i];
+            for( int j = 0; j < LETTERHISTORY_CHUNKSIZE; ++j )
+            {
+                ServerToClientLetter *letter = chunk->m_letters[j];
+                if( letter )
+                {
+                    byteSize += sizeof(letter);
+                    byteSize += letter->m_data->GetByteSize();
+                }
+            }
+        }
+    }
+
+    return byteSize;
+}
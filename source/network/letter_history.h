@@ -0,0 +1,99 @@
+
+/*
+ * ==============
+ * LETTER HISTORY
+ * ==============
+ *
+ * Every letter the Server has sent, indexed by sequence id.
+ *
+ * Letters are held in chunks of LETTERHISTORY_CHUNKSIZE, found by
+ * sequence id in one step.  The newest LETTERHISTORY_HOTCHUNKS chunks
+ * stay in memory, which covers every client that is keeping up or has
+ * only dropped a few packets.  Older chunks are written out, in the
+ * binary letter format, to a temporary log and deleted, so a long game
+ * no longer grows the Server without bound.  A rejoining client reads
+ * them back a chunk at a time; at most LETTERHISTORY_COLDCHUNKS of
+ * those are kept loaded, the least recently used going first.
+ *
+ * A letter from GetData stays valid until another old chunk is loaded,
+ * so it is safe to hold two letters at once (a letter and its
+ * NET_DEFCON_PREVUPDATE).  If the log can't be created everything stays
+ * in memory, as before.  Main thread only.
+ *
+ */
+
+#ifndef _included_letterhistory_h
+#define _included_letterhistory_h
+
+#include <stdio.h>
+
+#include "lib/tosser/darray.h"
+
+class ServerToClientLetter;
+
+
+#define LETTERHISTORY_CHUNKSIZE         256                     // Letters per chunk, about 25 seconds of play
+#define LETTERHISTORY_HOTCHUNKS         8                       // Always in memory
+#define LETTERHISTORY_COLDCHUNKS        2                       // Read back from the log at once, at least 2
+
+
+class LetterHistoryChunk
+{
+public:
+    ServerToClientLetter    *m_letters[LETTERHISTORY_CHUNKSIZE];    // NULL while the chunk is only in the log
+    bool                    m_loaded;
+
+    bool                    m_logged;                               // Copied into the log and safe to unload
+    long                    m_logOffset;
+    int                     m_offsets[LETTERHISTORY_CHUNKSIZE+1];   // Of each letter from m_logOffset
+
+    int                     m_lastUsed;
+
+public:
+    LetterHistoryChunk();
+    ~LetterHistoryChunk();
+
+    void    Unload();
+};
+
+
+class LetterHistory
+{
+protected:
+    DArray          <LetterHistoryChunk *> m_chunks;
+    int             m_size;
+
+    FILE            *m_log;
+    bool            m_logFailed;
+    long            m_logSize;
+
+    int             m_numColdLoaded;
+    int             m_useCounter;
+
+    char            *m_buffer;                                      // Letters on their way to and from the log
+    int             m_bufferSize;
+
+protected:
+    bool    IsHot           ( int _chunk );
+    bool    OpenLog         ();
+    void    WriteToLog      ( int _chunk );
+    bool    ReadFromLog     ( int _chunk );
+
+public:
+    LetterHistory();
+    ~LetterHistory();
+
+    inline int  Size        () const                    { return m_size; }
+    inline bool ValidIndex  ( int _seqId ) const        { return _seqId >= 0 && _seqId < m_size; }
+
+    ServerToClientLetter    *GetData    ( int _seqId );             // NULL only if the log can't be read
+    ServerToClientLetter    *operator [] ( int _seqId )             { return GetData( _seqId ); }
+
+    void    PutDataAtEnd    ( ServerToClientLetter *_letter );      // Takes ownership
+    void    EmptyAndDelete  ();
+
+    int     GetByteSize     ();                                     // In memory and in the log
+};
+
+
+#endif
@@ -0,0 +1,217 @@
+// Build from the root directory, eg
+//
+//   g++ -O2 -DTARGET_OS_LINUX -Isource -Icontrib/systemIV source/network/letter_history_test.cpp source/network/letter_history.cpp source/network/letter_codec.cpp contrib/systemIV/lib/tosser/directory.cpp contrib/systemIV/lib/string_utils.cpp contrib/systemIV/lib/math/fixed_64.cpp
+//
+// Fills a LetterHistory well past LETTERHISTORY_HOTCHUNKS, so the older chunks
+// are spilled to the log, then reads it back the way a rejoining client does.
+// Every letter must come back as it went in, hot chunks must hand back the very
+// letters they were given, and a letter from GetData must stay valid while one
+// more old chunk is loaded (a letter and its NET_DEFCON_PREVUPDATE).  Returns
+// non-zero on any difference.
+
+#include "lib/universal_include.h"
+
+#include <stdarg.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "lib/tosser/directory.h"
+
+#include "network/Server.h"
+#include "network/letter_codec.h"
+#include "network/letter_history.h"
+#include "network/network_defines.h"
+
+
+#define NUM_CHUNKS      (LETTERHISTORY_HOTCHUNKS + 6)
+#define NUM_LETTERS     (NUM_CHUNKS * LETTERHISTORY_CHUNKSIZE - 100)       // The last chunk part full
+
+
+void AppDebugOut( char *_msg, ... )
+{
+}
+
+
+void AppReleaseAssertFailed( char const *_msg, ... )
+{
+    va_list ap;
+    va_start( ap, _msg );
+    vprintf( _msg, ap );
+    va_end( ap );
+    printf( "\n" );
+    exit( 1 );
+}
+
+
+//
+// Server updates, each a little different so a letter from the wrong place shows
+
+static Directory *MakeUpdateLetter( int _seqId )
+{
+    Directory *letter = new Directory();
+    letter->SetName( NET_DEFCON_MESSAGE );
+    letter->CreateData( NET_DEFCON_COMMAND, NET_DEFCON_UPDATE );
+    letter->CreateData( NET_DEFCON_SEQID, _seqId );
+
+    for( int i = 0; i < _seqId % 5; ++i )
+    {
+        Directory *command = new Directory();
+        command->SetName( NET_DEFCON_MESSAGE );
+        command->CreateData( NET_DEFCON_COMMAND, NET_DEFCON_OBJSETWAYPOINT );
+        command->CreateData( NET_DEFCON_OBJECTID, _seqId * 7 + i );
+        command->CreateData( NET_DEFCON_LONGITUDE, Fixed::FromDouble( -120.5 + i ) );
+        command->CreateData( NET_DEFCON_LATTITUDE, Fixed::FromDouble( _seqId * 0.01 ) );
+        command->CreateData( NET_DEFCON_LASTPROCESSEDSEQID, _seqId - 1 );
+        letter->AddDirectory( command );
+    }
+
+    return letter;
+}
+
+
+//
+// Checks
+
+static int s_numFailures = 0;
+
+static void Fail( int _seqId, char const *_what )
+{
+    printf( "FAILED letter %d : %s\n", _seqId, _what );
+    ++s_numFailures;
+}
+
+
+static bool SameLetter( Directory *_a, Directory *_b )
+{
+    int lengthA = 0;
+    int lengthB = 0;
+    char *bytesA = _a->Write( lengthA );
+    char *bytesB = _b->Write( lengthB );
+
+    bool same = ( lengthA == lengthB && memcmp( bytesA, bytesB, lengthA ) == 0 );
+
+    delete [] bytesA;
+    delete [] bytesB;
+    return same;
+}
+
+
+static void CheckLetter( LetterHistory &_history, Directory **_expected, int _seqId,
+                         ServerToClientLetter *_letter )
+{
+    if( !_letter || !_letter->m_data )
+    {
+        Fail( _seqId, "GetData returned nothing" );
+    }
+    else if( !SameLetter( _letter->m_data, _expected[_seqId] ) )
+    {
+        Fail( _seqId, "came back different" );
+    }
+}
+
+
+int main( int argc, char *argv[] )
+{
+    LetterCodec::Initialise();
+
+    LetterHistory history;
+    Directory **expected = new Directory *[NUM_LETTERS];
+    ServerToClientLetter **given = new ServerToClientLetter *[NUM_LETTERS];
+
+    for( int i = 0; i < NUM_LETTERS; ++i )
+    {
+        expected[i] = MakeUpdateLetter( i );
+
+        ServerToClientLetter *letter = new ServerToClientLetter();
+        letter->m_data = new Directory( expected[i] );
+        given[i] = letter;
+
+        history.PutDataAtEnd( letter );
+    }
+
+    if( history.Size() != NUM_LETTERS ) Fail( -1, "Size is wrong" );
+
+    int numChunks = ( NUM_LETTERS + LETTERHISTORY_CHUNKSIZE - 1 ) / LETTERHISTORY_CHUNKSIZE;
+    int firstHot = ( numChunks - LETTERHISTORY_HOTCHUNKS ) * LETTERHISTORY_CHUNKSIZE;
+
+
+    //
+    // Hot chunks are never spilled, so their letters are the ones given
+
+    for( int i = firstHot; i < NUM_LETTERS; ++i )
+    {
+        if( history.GetData(i) != given[i] ) Fail( i, "hot letter is not the one given" );
+    }
+
+
+    //
+    // Every letter in order, as a client catching up from the start reads them
+
+    for( int i = 0; i < NUM_LETTERS; ++i )
+    {
+        CheckLetter( history, expected, i, history.GetData(i) );
+    }
+
+
+    //
+    // A letter and its NET_DEFCON_PREVUPDATE from another old chunk, as
+    // Server::Advance fetches them.  Loading the second must not free the first,
+    // and a repeated GetData of a loaded chunk must not load it again
+
+    for( int chunk = 1; chunk < numChunks - LETTERHISTORY_HOTCHUNKS; ++chunk )
+    {
+        int seqId = chunk * LETTERHISTORY_CHUNKSIZE + 3;
+        int prevSeqId = seqId - 10;
+
+        ServerToClientLetter *letter = history.GetData( seqId );
+        ServerToClientLetter *prevLetter = history.GetData( prevSeqId );
+
+        CheckLetter( history, expected, seqId, letter );
+        CheckLetter( history, expected, prevSeqId, prevLetter );
+
+        if( history.GetData( seqId ) != letter )            Fail( seqId, "reloaded while still held" );
+        if( history.GetData( prevSeqId ) != prevLetter )    Fail( prevSeqId, "reloaded while still held" );
+    }
+
+
+    //
+    // Two rejoining clients far apart, taking turns.  Each only holds its
+    // letter until the other's next GetData loads one more old chunk
+
+    int seqIdA = 0;
+    int seqIdB = 5 * LETTERHISTORY_CHUNKSIZE;
+    ServerToClientLetter *letterA = history.GetData( seqIdA );
+
+    while( seqIdB < firstHot )
+    {
+        ServerToClientLetter *letterB = history.GetData( seqIdB );
+
+        CheckLetter( history, expected, seqIdA, letterA );
+        CheckLetter( history, expected, seqIdB, letterB );
+
+        seqIdA += 37;
+        letterA = history.GetData( seqIdA );
+
+        CheckLetter( history, expected, seqIdB, letterB );
+        CheckLetter( history, expected, seqIdA, letterA );
+
+        seqIdB += 41;
+    }
+
+    int byteSize = history.GetByteSize();
+    history.EmptyAndDelete();
+
+    for( int i = 0; i < NUM_LETTERS; ++i ) delete expected[i];
+    delete [] expected;
+    delete [] given;
+
+    if( s_numFailures > 0 )
+    {
+        printf( "%d failures\n", s_numFailures );
+        return 1;
+    }
+
+    printf( "%d letters in %d chunks round trip the log, %d bytes\n", NUM_LETTERS, numChunks, byteSize );
+    return 0;
+}
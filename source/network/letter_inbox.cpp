@@ -0,0 +1,145 @@
+#include "lib/universal_include.h"
+
+#include <string.h>
+
+#include "lib/debug_utils.h"
+#include "lib/math/math_utils.h"
+#include "lib/tosser/directory.h"
+
+#include "network/network_defines.h"
+#include "network/letter_inbox.h"
+
+
+LetterInbox::LetterInbox()
+:   m_capacity(LETTERINBOX_MINSIZE),
+    m_size(0),
+    m_firstSeqId(0),
+    m_lastSeqId(0)
+{
+    m_letters = new Directory *[m_capacity];
+    memset( m_letters, 0, m_capacity * sizeof(Directory *) );
+}
+
+
+LetterInbox::~LetterInbox()
+{
+    EmptyAndDelete();
+    delete [] m_letters;
+}
+
+
+bool LetterInbox::Grow( int _span )
+{
+    if( _span > LETTERINBOX_MAXSIZE ) return false;
+
+    int capacity = m_capacity;
+    while( capacity < _span ) capacity *= 2;
+
+    Directory **letters = new Directory *[capacity];
+    memset( letters, 0, capacity * sizeof(Directory *) );
+
+    if( m_size > 0 )
+    {
+        for( int seqId = m_firstSeqId; seqId <= m_lastSeqId; ++seqId )
+        {
+            letters[seqId & (capacity-1)] = m_letters[seqId & (m_capacity-1)];
+        }
+    }
+
+    delete [] m_letters;
+    m_letters = letters;
+    m_capacity = capacity;
+    return true;
+}
+
+
+bool LetterInbox::Put( Directory *_letter )
+{
+    int seqId = _letter->GetDataInt( NET_DEFCON_SEQID );
+    AppAssert( seqId >= 0 );
+
+    if( m_size == 0 )
+    {
+        m_firstSeqId = seqId;
+        m_lastSeqId = seqId;
+    }
+    else
+    {
+        int firstSeqId = min( m_firstSeqId, seqId );
+        int lastSeqId = max( m_lastSeqId, seqId );
+        int span = lastSeqId - firstSeqId + 1;
+
+        if( span > m_capacity && !Grow( span ) ) return false;
+
+        if( m_letters[seqId & (m_capacity-1)] ) return false;
+
+        m_firstSeqId = firstSeqId;
+        m_lastSeqId = lastSeqId;
+    }
+
+    m_letters[seqId & (m_capacity-1)] = _letter;
+    ++m_size;
+    return true;
+}
+
+
+Directory *LetterInbox::Get( int _seqId )
+{
+    if( m_size == 0 || _seqId < m_firstSeqId || _seqId > m_lastSeqId ) return NULL;
+
+    return m_letters[_seqId & (m_capacity-1)];
+}
+
+
+Directory *LetterInbox::Remove( int _seqId )
+{
+    Directory *letter = Get( _seqId );
+    if( !letter ) return NULL;
+
+    m_letters[_seqId & (m_capacity-1)] = NULL;
+    --m_size;
+
+
+    //
+    // Close up the range over any gaps at either end
+
+    if( m_size > 0 )
+    {
+        while( !m_letters[m_firstSeqId & (m_capacity-1)] ) ++m_firstSeqId;
+        while( !m_letters[m_lastSeqId & (m_capacity-1)] ) --m_lastSeqId;
+    }
+
+    return letter;
+}
+
+
+void LetterInbox::DiscardBefore( int _seqId )
+{
+    while( m_size > 0 && m_firstSeqId < _seqId )
+    {
+        delete Remove( m_firstSeqId );
+    }
+}
+
+
+void LetterInbox::PutDirect( Directory *_letter )
+{
+    m_direct.PutDataAtEnd( _letter );
+}
+
+
+Directory *LetterInbox::RemoveDirect()
+{
+    if( m_direct.Size() == 0 ) return NULL;
+
+    Directory *letter = m_direct[0];
+    m_direct.RemoveData(0);
+    return letter;
+}
+
+
+void LetterInbox::EmptyAndDelete()
+{
+    DiscardBefore( m_lastSeqId + 1 );
+    m_direct.EmptyAndDelete();
+}
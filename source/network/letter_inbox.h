@@ -0,0 +1,67 @@
+/*
+ * ============
+ * LETTER INBOX
+ * ============
+ *
+ * Letters from the Server waiting to be processed by a client, indexed
+ * by sequence id.
+ *
+ * They arrive in any order and more than once.  Each one goes straight
+ * into the slot for its sequence id, in a ring that doubles whenever the
+ * held letters span more than it can take, so filing a letter, finding
+ * the next one and spotting a duplicate are all one step however far
+ * behind the client is.  Letters just for us (sequence id -1) are kept
+ * apart and come out first, in the order they arrived.
+ *
+ * Owns the letters it holds.  Main thread only.
+ *
+ */
+
+#ifndef _included_letterinbox_h
+#define _included_letterinbox_h
+
+#include "lib/tosser/llist.h"
+
+class Directory;
+
+
+#define LETTERINBOX_MINSIZE             256                     // Slots in the ring to begin with
+#define LETTERINBOX_MAXSIZE             65536                   // Letters further apart than this are refused
+
+
+class LetterInbox
+{
+protected:
+    Directory       **m_letters;                                // By sequence id, modulo m_capacity
+    int             m_capacity;                                 // Always a power of two
+    int             m_size;
+    int             m_firstSeqId;                               // Of the letters held, if m_size > 0
+    int             m_lastSeqId;
+
+    LList           <Directory *> m_direct;
+
+protected:
+    bool    Grow            ( int _span );
+
+public:
+    LetterInbox();
+    ~LetterInbox();
+
+    bool        Put             ( Directory *_letter );         // False if it's a duplicate or too far away, and not taken
+    Directory   *Get            ( int _seqId );                 // NULL if it isn't here
+    Directory   *Remove         ( int _seqId );                 // Gives up ownership, NULL if it isn't here
+    void        DiscardBefore   ( int _seqId );
+
+    void        PutDirect       ( Directory *_letter );
+    Directory   *RemoveDirect   ();                             // The oldest, NULL if none
+
+    inline int  Size            () const                        { return m_size; }
+    inline int  NumDirect       () const                        { return m_direct.Size(); }
+    inline int  GetFirstSeqId   () const                        { return m_size > 0 ? m_firstSeqId : -1; }
+    inline int  GetLastSeqId    () const                        { return m_size > 0 ? m_lastSeqId : -1; }
+
+    void        EmptyAndDelete  ();
+};
+
+
+#endif
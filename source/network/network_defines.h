@@ -78,6 +78,8 @@
 #define     NET_DEFCON_OBJCLEARLASTACTION           "cy"
 #define     NET_DEFCON_WHITEBOARD                   "c1"
 #define     NET_DEFCON_TEAM_SCORE                   "c2"
+#define     NET_DEFCON_SNAPSHOTUPLOAD               "c3"
+#define     NET_DEFCON_SYNCHASH                     "c4"
 
 #define     NET_DEFCON_SYNCHRONISE                  "s"
 
@@ -139,6 +141,23 @@
 #define     NET_DEFCON_SETMODPATH                   "sn"
 #define     NET_DEFCON_VERSION                      "so"
 #define     NET_DEFCON_SYSTEMTYPE                   "sp"
+#define     NET_DEFCON_NUMERICS                     "sq"
+#define     NET_DEFCON_LETTERFORMAT                 "sr"
+#define     NET_DEFCON_SNAPSHOT                     "ss"
+#define     NET_DEFCON_SNAPSHOTREQUEST              "st"
+#define     NET_DEFCON_SNAPSHOTSEQID                "su"
+#define     NET_DEFCON_SNAPSHOTPART                 "sv"
+#define     NET_DEFCON_SNAPSHOTNUMPARTS             "sw"
+#define     NET_DEFCON_SNAPSHOTDATA                 "sx"
+#define     NET_DEFCON_SNAPSHOTVERSION              "sy"
+#define     NET_DEFCON_SYNCHASHREQUEST              "sz"
+#define     NET_DEFCON_SYNCHASHRESULT               "s0"
+#define     NET_DEFCON_SYNCHASHSEQID                "s1"
+#define     NET_DEFCON_SYNCHASHPATH                 "s2"
+#define     NET_DEFCON_SYNCHASHKEYS                 "s3"
+#define     NET_DEFCON_SYNCHASHVALUES               "s4"
+#define     NET_DEFCON_SYNCHASHCHILDREN             "s5"
+#define     NET_DEFCON_SYNCHASHREVISION             "s6"
 #define     NET_DEFCON_SEQID                        "i"
 #define     NET_DEFCON_LASTSEQID                    "l"
 
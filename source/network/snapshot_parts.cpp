@@ -0,0 +1,193 @@
+#include "lib/universal_include.h"
+
+#include <string.h>
+
+#include "lib/debug_utils.h"
+#include "lib/tosser/directory.h"
+
+#include "network/network_defines.h"
+#include "network/snapshot_parts.h"
+
+
+SnapshotParts::SnapshotParts( int _seqId, int _version )
+:   m_refCount(1),
+    m_parts(NULL),
+    m_lengths(NULL),
+    m_numReceived(0),
+    m_seqId(_seqId),
+    m_version(_version),
+    m_numParts(0)
+{
+}
+
+
+SnapshotParts::SnapshotParts( int _seqId, int _version, char *_data, int _length )
+:   m_refCount(1),
+    m_numReceived(0),
+    m_seqId(_seqId),
+    m_version(_version)
+{
+    m_numParts = ( _length + SNAPSHOTPARTS_PARTSIZE - 1 ) / SNAPSHOTPARTS_PARTSIZE;
+    if( m_numParts < 1 ) m_numParts = 1;
+
+    m_parts = new char *[m_numParts];
+    m_lengths = new int[m_numParts];
+
+    for( int i = 0; i < m_numParts; ++i )
+    {
+        int offset = i * SNAPSHOTPARTS_PARTSIZE;
+        int length = _length - offset;
+        if( length > SNAPSHOTPARTS_PARTSIZE ) length = SNAPSHOTPARTS_PARTSIZE;
+
+        m_parts[i] = new char[length];
+        m_lengths[i] = length;
+        memcpy( m_parts[i], _data + offset, length );
+    }
+
+    m_numReceived = m_numParts;
+}
+
+
+SnapshotParts::~SnapshotParts()
+{
+    for( int i = 0; i < m_numParts; ++i )
+    {
+        delete [] m_parts[i];
+    }
+
+    delete [] m_parts;
+    delete [] m_lengths;
+}
+
+
+void SnapshotParts::AddRef()
+{
+    ++m_refCount;
+}
+
+
+void SnapshotParts::Release()
+{
+    --m_refCount;
+    if( m_refCount == 0 ) delete this;
+}
+
+
+bool SnapshotParts::IsComplete()
+{
+    return( m_numParts > 0 && m_numReceived == m_numParts );
+}
+
+
+int SnapshotParts::GetFirstMissing()
+{
+    for( int i = 0; i < m_numParts; ++i )
+    {
+        if( !m_parts[i] ) return i;
+    }
+
+    return m_numParts;
+}
+
+
+int SnapshotParts::GetNumReceived()
+{
+    return m_numReceived;
+}
+
+
+int SnapshotParts::GetByteSize()
+{
+    int byteSize = 0;
+
+    for( int i = 0; i < m_numParts; ++i )
+    {
+        if( m_parts[i] ) byteSize += m_lengths[i];
+    }
+
+    return byteSize;
+}
+
+
+char *SnapshotParts::Join( int &_length )
+{
+    if( !IsComplete() ) return NULL;
+
+    _length = GetByteSize();
+    char *result = new char[_length];
+
+    int offset = 0;
+    for( int i = 0; i < m_numParts; ++i )
+    {
+        memcpy( result + offset, m_parts[i], m_lengths[i] );
+        offset += m_lengths[i];
+    }
+
+    return result;
+}
+
+
+void SnapshotParts::WritePart( Directory *_letter, int _part )
+{
+    AppAssert( _part >= 0 && _part < m_numParts && m_parts[_part] );
+
+    _letter->CreateData( NET_DEFCON_SNAPSHOTSEQID, m_seqId );
+    _letter->CreateData( NET_DEFCON_SNAPSHOTVERSION, m_version );
+    _letter->CreateData( NET_DEFCON_SNAPSHOTPART, _part );
+    _letter->CreateData( NET_DEFCON_SNAPSHOTNUMPARTS, m_numParts );
+    _letter->CreateData( NET_DEFCON_SNAPSHOTDATA, m_parts[_part], m_lengths[_part] );
+}
+
+
+bool SnapshotParts::ReadPart( Directory *_letter )
+{
+    if( !_letter->HasData( NET_DEFCON_SNAPSHOTSEQID, DIRECTORY_TYPE_INT ) ||
+        !_letter->HasData( NET_DEFCON_SNAPSHOTVERSION, DIRECTORY_TYPE_INT ) ||
+        !_letter->HasData( NET_DEFCON_SNAPSHOTPART, DIRECTORY_TYPE_INT ) ||
+        !_letter->HasData( NET_DEFCON_SNAPSHOTNUMPARTS, DIRECTORY_TYPE_INT ) ||
+        !_letter->HasData( NET_DEFCON_SNAPSHOTDATA, DIRECTORY_TYPE_VOID ) )
+    {
+        return false;
+    }
+
+    int seqId       = _letter->GetDataInt( NET_DEFCON_SNAPSHOTSEQID );
+    int version     = _letter->GetDataInt( NET_DEFCON_SNAPSHOTVERSION );
+    int part        = _letter->GetDataInt( NET_DEFCON_SNAPSHOTPART );
+    int numParts    = _letter->GetDataInt( NET_DEFCON_SNAPSHOTNUMPARTS );
+
+    if( seqId != m_seqId || version != m_version ) return false;
+    if( numParts < 1 || numParts > 65536 ) return false;
+    if( m_numParts > 0 && numParts != m_numParts ) return false;
+    if( part < 0 || part >= numParts ) return false;
+
+    int length = 0;
+    char *data = (char *) _letter->GetDataVoid( NET_DEFCON_SNAPSHOTDATA, &length );
+    if( !data || length <= 0 || length > SNAPSHOTPARTS_PARTSIZE ) return false;
+
+
+    //
+    // The first part to arrive tells us how many there are
+
+    if( m_numParts == 0 )
+    {
+        m_numParts = numParts;
+        m_parts = new char *[m_numParts];
+        m_lengths = new int[m_numParts];
+
+        for( int i = 0; i < m_numParts; ++i )
+        {
+            m_parts[i] = NULL;
+            m_lengths[i] = 0;
+        }
+    }
+
+    if( !m_parts[part] )
+    {
+        m_parts[part] = new char[length];
+        m_lengths[part] = length;
+        memcpy( m_parts[part], data, length );
+        ++m_numReceived;
+    }
+
+    return true;
+}
@@ -0,0 +1,61 @@
+
+/*
+ * ==============
+ * SNAPSHOT PARTS
+ * ==============
+ *
+ * An encoded WorldSnapshot, cut into parts small enough to travel as
+ * letters.  The Server never looks inside : a client encodes one and
+ * uploads it, the Server keeps it and sends it on to clients that
+ * resynchronise or rejoin, and they put it back together.
+ *
+ * Parts can arrive in any order and more than once.  Shared by
+ * reference count, and only used from the main thread.
+ *
+ */
+
+#ifndef _included_snapshotparts_h
+#define _included_snapshotparts_h
+
+class Directory;
+
+
+#define SNAPSHOTPARTS_PARTSIZE          4096                    // Bytes of snapshot in each letter
+
+
+class SnapshotParts
+{
+protected:
+    int     m_refCount;
+
+    char    **m_parts;
+    int     *m_lengths;
+    int     m_numReceived;
+
+    ~SnapshotParts();
+
+public:
+    int     m_seqId;                                            // Taken just after this letter was processed
+    int     m_version;                                          // WORLDSNAPSHOT_VERSION of the client that took it
+    int     m_numParts;                                         // 0 until the first part arrives
+
+public:
+    SnapshotParts( int _seqId, int _version );
+    SnapshotParts( int _seqId, int _version, char *_data, int _length );       // Cut into parts, copying _data
+
+    void    AddRef          ();
+    void    Release         ();                                 // Deletes on the last one
+
+    bool    IsComplete      ();
+    int     GetFirstMissing ();                                 // m_numParts if complete
+    int     GetNumReceived  ();
+    int     GetByteSize     ();
+
+    char    *Join           ( int &_length );                   // New array, NULL until complete
+
+    void    WritePart       ( Directory *_letter, int _part );
+    bool    ReadPart        ( Directory *_letter );             // False if it doesn't belong here, or is bogus
+};
+
+
+#endif
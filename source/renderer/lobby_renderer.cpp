@@ -534,15 +534,15 @@ void LobbyRenderer::RenderGlobe()
             AppDebugAssert( island );
 
             glBegin( GL_LINE_STRIP );
-            for( int j = 0; j < island->m_points.Size(); j++ )
+            for( int j = 0; j < island->m_numPoints; j++ )
             {
-                Vector3<float> *thePoint = island->m_points[j];
+                float const *thePoint = island->m_points + j * 2;
             
                 Vector3<float> thisPoint(0,0,1);
-                thisPoint.RotateAroundY( thePoint->x/180.0f * M_PI );
+                thisPoint.RotateAroundY( thePoint[0]/180.0f * M_PI );
                 Vector3<float> right = thisPoint ^ Vector3<float>::UpVector();   
                 right.Normalise();
-                thisPoint.RotateAround( right * thePoint->y/180.0f * M_PI );
+                thisPoint.RotateAround( right * thePoint[1]/180.0f * M_PI );
             
                 glVertex3fv( thisPoint.GetData() );
             }
@@ -562,15 +562,15 @@ void LobbyRenderer::RenderGlobe()
                 AppDebugAssert( island );
 
                 glBegin( GL_LINE_STRIP );
-                for( int j = 0; j < island->m_points.Size(); j++ )
+                for( int j = 0; j < island->m_numPoints; j++ )
                 {
-                    Vector3<float> *thePoint = island->m_points[j];
+                    float const *thePoint = island->m_points + j * 2;
                 
                     Vector3<float> thisPoint(0,0,1);
-                    thisPoint.RotateAroundY( thePoint->x/180.0f * M_PI );
+                    thisPoint.RotateAroundY( thePoint[0]/180.0f * M_PI );
                     Vector3<float> right = thisPoint ^ Vector3<float>::UpVector();   
                     right.Normalise();
-                    thisPoint.RotateAround( right * thePoint->y/180.0f * M_PI );
+                    thisPoint.RotateAround( right * thePoint[1]/180.0f * M_PI );
                 
                     glVertex3fv( thisPoint.GetData() );
                 }
@@ -149,7 +149,6 @@ void MapRenderer::Init()
     m_territories[World::TerritoryAfrica]       = g_resource->GetImage( "earth/africa.bmp" );    
 
     bmpTravelNodes = g_resource->GetImage( "earth/travel_nodes.bmp");
-    bmpSailableWater = g_resource->GetImage( "earth/sailable.bmp" );
   
 	sprintf(m_imageFiles[WorldObject::TypeSilo], "graphics/silo.bmp");
 	sprintf(m_imageFiles[WorldObject::TypeRadarStation], "graphics/radarstation.bmp");
@@ -285,6 +284,8 @@ void MapRenderer::Render()
         right += GetLongitudeMod();
     }
 
+    UpdateSonarPings();
+
     // Now go through and render objects on top of the landscape.
     GetWindowBounds( &left, &right, &top, &bottom );
     for( int x = 0; x < 2; ++x )
@@ -446,6 +447,56 @@ void MapRenderer::RenderExplosions()
 }
 
 
+void MapRenderer::UpdateSonarPings()
+{
+    //
+    // Turn sonar pings made since the last frame into animations
+
+    World *world = g_app->GetWorld();
+
+    for( int i = 0; i < world->m_geography.m_sonarPings.Size(); ++i )
+    {
+        SonarContact *contact = world->m_geography.m_sonarPings[i];
+
+        if( contact->m_animationId == -1 )
+        {
+            contact->m_animationId = CreateAnimation( AnimationTypeSonarPing, contact->m_objectId,
+                                                      contact->m_longitude.DoubleValue(), contact->m_latitude.DoubleValue() );
+            SonarPing *ping = (SonarPing *)m_animations[contact->m_animationId];
+            ping->m_teamId = contact->m_teamId;
+
+            if( world->m_myTeamId == -1 ||
+                world->m_myTeamId == contact->m_teamId ||
+                m_renderEverything ||
+                world->IsVisible( contact->m_longitude, contact->m_latitude, world->m_myTeamId ) )
+            {
+                g_soundSystem->TriggerEvent( SoundObjectId(contact->m_objectId), "SonarPing" );
+            }
+        }
+
+
+        //
+        // The animation fades in and out with radar coverage, for as long as
+        // both last.  Its slot may have gone to another animation since
+
+        if( m_animations.ValidIndex( contact->m_animationId ) )
+        {
+            AnimatedIcon *anim = m_animations[contact->m_animationId];
+            if( anim->m_animationType == AnimationTypeSonarPing &&
+                anim->m_fromObjectId == contact->m_objectId &&
+                anim->m_longitude == (float) contact->m_longitude.DoubleValue() &&
+                anim->m_latitude == (float) contact->m_latitude.DoubleValue() )
+            {
+                for( int t = 0; t < MAX_TEAMS; ++t )
+                {
+                    anim->m_visible[t] = contact->m_visible[t];
+                }
+            }
+        }
+    }
+}
+
+
 void MapRenderer::RenderAnimations()
 {
     for( int i = 0; i < m_animations.Size(); ++i )
@@ -539,14 +590,15 @@ void MapRenderer::RenderCountryControl()
                 g_renderer->SetDepthBuffer( true, true );
                 g_renderer->SetBlendMode( Renderer::BlendModeNormal );
                 float maxDistance = 5.0f / g_app->GetWorld()->GetGameScale().DoubleValue();
+                ObjectStore &store = g_app->GetWorld()->m_objectStore;
 
                 for( int i = 0; i < g_app->GetWorld()->m_objects.Size(); ++i )
                 {
-                    if( g_app->GetWorld()->m_objects.ValidIndex(i) )
+                    if( g_app->GetWorld()->m_objects.ValidIndex(i) &&
+                        store.m_teamId[i] == team->m_teamId )
                     {
                         WorldObject *wobj = g_app->GetWorld()->m_objects[i];
                         if( wobj && 
-                            wobj->m_teamId == team->m_teamId &&
                             !wobj->IsMovingObject() )
                         {
                             g_renderer->CircleFill( wobj->m_longitude.DoubleValue(), wobj->m_latitude.DoubleValue(),
@@ -2348,13 +2400,14 @@ void MapRenderer::RenderNukeUnits()
     Team *team = g_app->GetWorld()->GetMyTeam();
     if( team )
     {
+        ObjectStore &store = g_app->GetWorld()->m_objectStore;
         for( int i = 0; i < g_app->GetWorld()->m_objects.Size(); ++i )
         {
             if( g_app->GetWorld()->m_objects.ValidIndex(i) )
             {
-                WorldObject *obj = g_app->GetWorld()->m_objects[i];
-                if( obj->m_teamId == team->m_teamId )
+                if( store.m_teamId[i] == team->m_teamId )
                 {
+                    WorldObject *obj = g_app->GetWorld()->m_objects[i];
                     int nukeCount = 0;
 
                     switch( obj->m_type )
@@ -2436,22 +2489,19 @@ void MapRenderer::RenderCoastlines()
         {
         }
 
+        glEnableClientState( GL_VERTEX_ARRAY );
+
         for( int i = 0; i < list->Size(); ++i )
         {
             Island *island = list->GetData(i);
             AppDebugAssert( island );
 
-            glBegin( GL_LINE_STRIP );
-
-            for( int j = 0; j < island->m_points.Size(); j++ )
-            {
-                Vector3<float> thePoint = *island->m_points[j];
-                glVertex2f( thePoint.x, thePoint.y );
-            }
-
-            glEnd();
+            glVertexPointer( 2, GL_FLOAT, 0, island->m_points );
+            glDrawArrays( GL_LINE_STRIP, 0, island->m_numPoints );
         }
 
+        glDisableClientState( GL_VERTEX_ARRAY );
+
         glEndList();
     }
 
@@ -2485,22 +2535,19 @@ void MapRenderer::RenderBorders()
     {
         glNewList(displayListId, GL_COMPILE);
 
+        glEnableClientState( GL_VERTEX_ARRAY );
+
         for( int i = 0; i < g_app->GetEarthData()->m_borders.Size(); ++i )
         {
             Island *island = g_app->GetEarthData()->m_borders[i];
             AppDebugAssert( island );
 
-            glBegin( GL_LINE_STRIP );
-
-            for( int j = 0; j < island->m_points.Size(); j++ )
-            {
-                Vector3<float> thePoint = *island->m_points[j];
-                glVertex2f( thePoint.x, thePoint.y );
-            }
-
-            glEnd();
+            glVertexPointer( 2, GL_FLOAT, 0, island->m_points );
+            glDrawArrays( GL_LINE_STRIP, 0, island->m_numPoints );
         }
 
+        glDisableClientState( GL_VERTEX_ARRAY );
+
         glEndList();
     }
 
@@ -2844,16 +2891,18 @@ void MapRenderer::RenderRadar( bool _allies, bool _outlined )
     int myTeamId = g_app->GetWorld()->m_myTeamId;
     float timeFactor = g_predictionTime * g_app->GetWorld()->GetTimeScaleFactor().DoubleValue();
 
+    ObjectStore &store = g_app->GetWorld()->m_objectStore;
+
     for( int i = 0; i < g_app->GetWorld()->m_objects.Size(); ++i )
     {
         if( g_app->GetWorld()->m_objects.ValidIndex(i) )
         {
-            WorldObject *wobj = g_app->GetWorld()->m_objects[i];            
-            Team *team = g_app->GetWorld()->GetTeam(wobj->m_teamId);
+            Team *team = g_app->GetWorld()->GetTeam( store.m_teamId[i] );
 
             if( (_allies && team->m_sharingRadar[myTeamId]) ||
-                (!_allies && wobj->m_teamId == myTeamId) )
+                (!_allies && store.m_teamId[i] == myTeamId) )
             {
+                WorldObject *wobj = g_app->GetWorld()->m_objects[i];
                 float size = wobj->GetRadarRange().DoubleValue();      
                 if( size > 0.0f )
                 {
@@ -3020,9 +3069,11 @@ void MapRenderer::RenderNodes()
             g_renderer->Text( node->m_longitude.DoubleValue() + 0.5f, 
                               node->m_latitude.DoubleValue() + 0.5f, White, 2.0f, num );
             
-            for( int j = 0; j < node->m_routeTable.Size(); ++j )
+            for( int j = 0; j < g_app->GetWorld()->m_nodes.Size(); ++j )
             {
-                Node *nextNode = g_app->GetWorld()->m_nodes[node->m_routeTable[j]->m_nextNodeId];
+                if( !node->HasRoute( j ) ) continue;
+
+                Node *nextNode = g_app->GetWorld()->m_nodes[node->GetNextNodeId( j )];
                 g_renderer->Line(node->m_longitude.DoubleValue(), 
                                  node->m_latitude.DoubleValue(), 
                                  nextNode->m_longitude.DoubleValue(), 
@@ -3872,104 +3923,6 @@ void MapRenderer::GetWindowBounds( float *left, float *right, float *top, float
     *bottom = *top-height;
 }
 
-bool MapRenderer::IsValidTerritory( int teamId, Fixed longitude, Fixed latitude, bool seaUnit )
-{    
-    if( latitude > 100 || latitude < -100 )
-    {
-        return false;
-    }
-
-    if( longitude < -180 )
-    {
-        longitude = -180;
-    }
-    else if( longitude > 180 )
-    {
-        longitude = 179;
-    }    
-    if( teamId == -1 )
-    {
-        int pixelX = ( bmpSailableWater->Width() * (longitude+180)/360 ).IntValue();
-        int pixelY = ( bmpSailableWater->Height() * (latitude+100)/200 ).IntValue();
-        Colour theCol = bmpSailableWater->GetColour( pixelX, pixelY );
-
-        return ( theCol.m_r > 20 && 
-                 theCol.m_g > 20 &&
-                 theCol.m_b > 20 );
-    }
-    else
-    {
-        bool isValid = false;
-        Team *team = g_app->GetWorld()->GetTeam(teamId);
-        for( int i = 0; i < team->m_territories.Size(); ++i )
-        {
-            Image *img = m_territories[team->m_territories[i]];            
-            AppDebugAssert( img );
-
-            int pixelX = ( img->Width() * (longitude+180)/360 ).IntValue();
-            int pixelY = ( img->Height() * (latitude+100)/200 ).IntValue();
-
-            Colour theCol = img->GetColour( pixelX, pixelY );
-            Colour sailableCol = bmpSailableWater->GetColour( pixelX, pixelY );
-            int landthreshold = 130;
-            int waterthreshold = 60;
-            if( !seaUnit )
-            {
-                if ( theCol.m_r > landthreshold && 
-                     theCol.m_g > landthreshold &&
-                     theCol.m_b > landthreshold &&
-                     sailableCol.m_r <= waterthreshold && 
-                     sailableCol.m_g <= waterthreshold &&
-                     sailableCol.m_b <= waterthreshold )
-                {
-                    isValid = true;
-                }
-            }
-            else
-            {
-                if ( theCol.m_r > waterthreshold && 
-                     theCol.m_g > waterthreshold &&
-                     theCol.m_b > waterthreshold &&
-                     sailableCol.m_r > waterthreshold && 
-                     sailableCol.m_g > waterthreshold &&
-                     sailableCol.m_b > waterthreshold )
-                {
-                    isValid = true;
-                }
-
-            }
-        }
-        return isValid;
-    }
-    return false;
-}
-
-bool MapRenderer::IsCoastline(Fixed longitude, Fixed latitude )
-{
-    Image *img = g_resource->GetImage( "earth/coastlines.bmp" );
-    int pixelX = ( img->Width() * (longitude+180)/360 ).IntValue();
-    int pixelY = ( img->Height() * (latitude+100)/200 ).IntValue();
-
-    Colour theCol = img->GetColour( pixelX, pixelY );
-
-    return ( theCol.m_r > 20 &&
-             theCol.m_g > 20 &&
-             theCol.m_b > 20 );
-}
-
-int MapRenderer::GetTerritory( Fixed longitude, Fixed latitide, bool seaArea )
-{
-    for( int i = 0; i < g_app->GetWorld()->m_teams.Size(); ++i )
-    {
-        Team *team = g_app->GetWorld()->m_teams[i];
-        if( IsValidTerritory( team->m_teamId, longitude, latitide, seaArea ) )
-        {
-            return team->m_teamId;
-        }
-    }
-    return -1;
-}
-
 float MapRenderer::GetZoomFactor()
 {
     return m_zoomFactor;
@@ -4038,55 +3991,6 @@ void MapRenderer::SetCurrentSelectionId( int id )
     }
 }
 
-int MapRenderer::GetTerritoryId( Fixed longitude, Fixed latitude )
-{
-    for( int i = 0; i < World::NumTerritories; ++i )
-    {
-        Image *img = m_territories[i];
-        
-        AppDebugAssert( img );
-
-        int pixelX = ( img->Width() * (longitude+180)/360 ).IntValue();
-        int pixelY = ( img->Height() * (latitude+100)/200 ).IntValue();
-
-        Colour theCol = img->GetColour( pixelX, pixelY );
-        if ( theCol.m_r > 20 && 
-             theCol.m_g > 20 &&
-             theCol.m_b > 20 )
-        {
-            return i;
-        }
-    }
-    return -1;
-}
-
-int MapRenderer::GetTerritoryIdUnique( Fixed longitude, Fixed latitude )
-{
-    int prevTerritory = -1;
-    for( int i = 0; i < World::NumTerritories; ++i )
-    {
-        Image *img = m_territories[i];
-        
-        AppDebugAssert( img );
-
-        int pixelX = ( img->Width() * (longitude+180)/360 ).IntValue();
-        int pixelY = ( img->Height() * (latitude+100)/200 ).IntValue();
-
-        Colour theCol = img->GetColour( pixelX, pixelY );
-        if ( theCol.m_r > 20 && 
-             theCol.m_g > 20 &&
-             theCol.m_b > 20 )
-        {
-            if( prevTerritory != -1 )
-            {
-                return -1;
-            }
-            prevTerritory = i;
-        }
-    }
-    return prevTerritory;
-}
-
 void MapRenderer::CenterViewport( float longitude, float latitude, int zoom, int camSpeed )
 {
     m_cameraLongitude = longitude;
@@ -16,8 +16,6 @@ class AnimatedIcon;
 #define    PREFS_GRAPHICS_COUNTRYNAMES     "RenderCountryNames"
 #define    PREFS_GRAPHICS_WATER            "RenderWater"
 #define    PREFS_GRAPHICS_RADIATION        "RenderRadiation"
-#define    PREFS_GRAPHICS_LOWRESWORLD      "RenderLowDetailWorld"
-#define    PREFS_GRAPHICS_TRAILS           "RenderObjectTrails"
 
 #define    STYLE_WORLD_COASTLINES          "WorldCoastlines"
 #define    STYLE_WORLD_BORDERS             "WorldBorders"
@@ -76,7 +74,6 @@ protected:
     Image   *bmpExplosion;
 
     Image   *bmpTravelNodes;
-    Image   *bmpSailableWater;
 
     float   m_oldMouseX;  // Used for mouse idle time
     float   m_oldMouseY;
@@ -182,6 +179,7 @@ public:
     void    RenderGunfire();
     void    RenderExplosions();
     void    RenderAnimations();
+    void    UpdateSonarPings();
     void    RenderBlips();
     void    RenderUnitHighlight( int _objectId );
     void    RenderNukeUnits();
@@ -208,9 +206,6 @@ public:
     void    ConvertPixelsToAngle        ( float pixelX, float pixelY, float *longitude, float *latitude,  bool absoluteLongitude = false );
     void    ConvertAngleToPixels        ( float longitude, float latitude, float *pixelX, float *pixelY );
 
-    bool    IsValidTerritory            ( int teamId, Fixed longitude, Fixed latitude, bool seaUnit );
-    int     GetTerritory                ( Fixed longitude, Fixed latitide, bool seaArea = false );
-    bool    IsCoastline                 ( Fixed longitude, Fixed latitude );
 
     float   GetZoomFactor();
     float   GetDrawScale();
@@ -219,8 +214,6 @@ public:
     int     GetLongitudeMod();
 
     Image   *GetTerritoryImage( int territoryId );
-    int     GetTerritoryId( Fixed longitude, Fixed latitude );
-    int     GetTerritoryIdUnique( Fixed longitude, Fixed latitude );
 
     int     GetCurrentSelectionId();
     void    SetCurrentSelectionId( int id );
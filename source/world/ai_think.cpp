@@ -0,0 +1,269 @@
+#include "lib/universal_include.h"
+
+#include "lib/debug_utils.h"
+#include "lib/preferences.h"
+#include "lib/math/math_utils.h"
+#include "lib/netlib/net_thread.h"
+
+#include "app/app.h"
+#include "app/globals.h"
+
+#include "world/ai_think.h"
+#include "world/world.h"
+#include "world/team.h"
+
+
+AISnapshot::AISnapshot()
+:   m_maxTargetPoints(0),
+    m_numTerritories(World::NumTerritories),
+    m_numTargetPoints(0),
+    m_targetPoints(NULL),
+    m_numEnemyCentres(NULL),
+    m_enemyCentres(NULL)
+{
+    m_numEnemyCentres = new int[ MAX_TEAMS ];
+    m_enemyCentres = new Vector3<Fixed>[ MAX_TEAMS * m_numTerritories ];
+
+    for( int i = 0; i < MAX_TEAMS; ++i )
+    {
+        m_numEnemyCentres[i] = 0;
+    }
+}
+
+
+AISnapshot::~AISnapshot()
+{
+    delete [] m_targetPoints;
+    delete [] m_numEnemyCentres;
+    delete [] m_enemyCentres;
+}
+
+
+void AISnapshot::Take()
+{
+    World *world = g_app->GetWorld();
+
+
+    //
+    // Target points
+
+    m_numTargetPoints = world->m_aiTargetPoints.Size();
+
+    if( m_numTargetPoints > m_maxTargetPoints )
+    {
+        delete [] m_targetPoints;
+        m_maxTargetPoints = m_numTargetPoints;
+        m_targetPoints = new Vector3<Fixed>[ m_maxTargetPoints ];
+    }
+
+    for( int i = 0; i < m_numTargetPoints; ++i )
+    {
+        m_targetPoints[i] = *world->m_aiTargetPoints[i];
+    }
+
+
+    //
+    // Enemy territories, as Fleet::FindGoodAttackSpot judges them
+
+    for( int i = 0; i < MAX_TEAMS; ++i )
+    {
+        m_numEnemyCentres[i] = 0;
+    }
+
+    for( int t = 0; t < world->m_teams.Size(); ++t )
+    {
+        int teamId = world->m_teams[t]->m_teamId;
+
+        for( int j = 0; j < m_numTerritories; ++j )
+        {
+            int owner = world->GetTerritoryOwner(j);
+            if( owner != -1 &&
+                !world->IsFriend( owner, teamId ) )
+            {
+                m_enemyCentres[ teamId * m_numTerritories + m_numEnemyCentres[teamId] ] = world->m_populationCenter[j];
+                m_numEnemyCentres[teamId]++;
+            }
+        }
+    }
+}
+
+
+void AISnapshot::GetEnemyCentres( int _teamId, Vector3<Fixed> *&_centres, int &_numCentres )
+{
+    AppDebugAssert( _teamId >= 0 && _teamId < MAX_TEAMS );
+
+    _centres = m_enemyCentres + _teamId * m_numTerritories;
+    _numCentres = m_numEnemyCentres[_teamId];
+}
+
+
+// ============================================================================
+
+
+AIThink::AIThink()
+:   m_numWorkers(0),
+    m_workersStarted(false),
+    m_quit(false),
+    m_tasks(NULL),
+    m_numTasks(0),
+    m_nextTask(0)
+{
+    m_tasks = new Team *[ MAX_TEAMS ];
+}
+
+
+AIThink::~AIThink()
+{
+    //
+    // Wake the workers to see m_quit, and wait for them all to go
+    // before the semaphores do
+
+    m_mutex.Lock();
+    m_quit = true;
+    m_mutex.Unlock();
+
+    if( m_numWorkers > 0 )
+    {
+        m_workReady.Signal( m_numWorkers );
+    }
+
+    for( int i = 0; i < m_numWorkers; ++i )
+    {
+        m_workerDone.Wait();
+    }
+
+    delete [] m_tasks;
+}
+
+
+void AIThink::StartWorkers()
+{
+    m_workersStarted = true;
+
+    int numThreads = g_preferences ? g_preferences->GetInt( PREFS_AI_THREADS, 2 ) : 0;
+    numThreads = max( 0, min( numThreads, MAX_TEAMS - 1 ) );
+
+    for( int i = 0; i < numThreads; ++i )
+    {
+        if( NetStartThread( WorkerThread, this ) != NetOk ) break;
+        ++m_numWorkers;
+    }
+
+    AppDebugOut( "AI think phase running on %d worker threads\n", m_numWorkers );
+}
+
+
+NetCallBackRetType AIThink::WorkerThread( void *_think )
+{
+    AIThink *think = (AIThink *) _think;
+
+    // Same floating point mode as the main thread, or Fixed could round differently
+    App::InitialiseFloatingPointUnit();
+
+    //
+    // Sleep until there is something to do, then take tasks until there aren't any.
+    // A late wake up may find them all gone, and just goes back to sleep
+
+    while( true )
+    {
+        think->m_workReady.Wait();
+
+        think->m_mutex.Lock();
+        bool quit = think->m_quit;
+        think->m_mutex.Unlock();
+
+        if( quit ) break;
+
+        while( think->RunNextTask() )
+        {
+            think->m_taskDone.Signal();
+        }
+    }
+
+    think->m_workerDone.Signal();
+
+    return 0;
+}
+
+
+bool AIThink::RunNextTask()
+{
+    m_mutex.Lock();
+    Team *team = NULL;
+    if( m_nextTask < m_numTasks )
+    {
+        team = m_tasks[m_nextTask];
+        ++m_nextTask;
+    }
+    m_mutex.Unlock();
+
+    if( !team ) return false;
+
+    team->ThinkAI( m_snapshot );
+
+    return true;
+}
+
+
+void AIThink::Think()
+{
+    World *world = g_app->GetWorld();
+
+    if( !m_workersStarted )
+    {
+        StartWorkers();
+    }
+
+
+    //
+    // Decide on the main thread what each team will want,
+    // then hand out one task per team that has something to think about
+
+    int numTasks = 0;
+
+    for( int i = 0; i < world->m_teams.Size(); ++i )
+    {
+        Team *team = world->m_teams[i];
+        if( team->m_type == Team::TypeAI &&
+            team->PrepareThinkAI() )
+        {
+            m_tasks[numTasks] = team;
+            ++numTasks;
+        }
+    }
+
+    if( numTasks == 0 ) return;
+
+    m_snapshot.Take();
+
+    m_mutex.Lock();
+    m_numTasks = numTasks;
+    m_nextTask = 0;
+    m_mutex.Unlock();
+
+    int numWoken = min( numTasks, m_numWorkers );
+    if( numWoken > 0 )
+    {
+        m_workReady.Signal( numWoken );
+    }
+
+
+    //
+    // Help out, then wait for the tasks the workers took
+
+    int numRunHere = 0;
+    while( RunNextTask() )
+    {
+        ++numRunHere;
+    }
+
+    for( int i = numRunHere; i < numTasks; ++i )
+    {
+        m_taskDone.Wait();
+    }
+
+    m_mutex.Lock();
+    m_numTasks = 0;
+    m_nextTask = 0;
+    m_mutex.Unlock();
+}
@@ -0,0 +1,90 @@
+#ifndef _included_aithink_h
+#define _included_aithink_h
+
+#include "lib/math/fixed.h"
+#include "lib/math/vector3.h"
+#include "lib/netlib/net_lib.h"
+#include "lib/netlib/net_mutex.h"
+#include "lib/netlib/net_semaphore.h"
+
+class Team;
+
+#define PREFS_AI_THREADS        "AIThreads"                             // Worker threads for the AI think phase, 0 for none
+
+
+/*
+ *  The parts of the World the AI think phase reads, copied out
+ *  on the main thread so the workers never touch an LList.
+ *
+ */
+
+class AISnapshot
+{
+protected:
+    int             m_maxTargetPoints;
+    int             m_numTerritories;
+
+public:
+    int             m_numTargetPoints;
+    Vector3<Fixed>  *m_targetPoints;                // World::m_aiTargetPoints
+    int             *m_numEnemyCentres;             // By team
+    Vector3<Fixed>  *m_enemyCentres;                // [teamId * m_numTerritories + n], population centres of enemy territories
+
+public:
+    AISnapshot();
+    ~AISnapshot();
+
+    void    Take                ();
+    void    GetEnemyCentres     ( int _teamId, Vector3<Fixed> *&_centres, int &_numCentres );
+};
+
+
+// ============================================================================
+
+
+/*
+ *  Splits the AI teams' turn in two.  Think runs the read-only, expensive part
+ *  of each team's AI (so far the sailing distances behind Fleet::FindGoodAttackSpot)
+ *  one team per task on a pool of worker threads, against an AISnapshot.
+ *  The World then runs Team::RunAI in team order as before, which picks up
+ *  whatever was thought of where its inputs are still the same.
+ *
+ *  Nothing here draws from syncrand or changes the World, so the
+ *  simulation comes out the same with any number of threads.
+ *
+ */
+
+class AIThink
+{
+protected:
+    NetSemaphore    m_workReady;                    // Wakes a sleeping worker, for tasks or to quit
+    NetSemaphore    m_taskDone;                     // Once for each task a worker finishes
+    NetSemaphore    m_workerDone;                   // Once by each worker as it quits
+
+    int             m_numWorkers;                   // Worker threads started, main thread only
+    bool            m_workersStarted;
+
+    NetMutex        m_mutex;                        // Guards everything below
+    bool            m_quit;
+
+    Team            **m_tasks;
+    int             m_numTasks;
+    int             m_nextTask;
+
+    static NetCallBackRetType WorkerThread( void *_think );
+
+    void    StartWorkers        ();
+    bool    RunNextTask         ();                 // False if there was nothing left to take
+
+public:
+    AISnapshot      m_snapshot;
+
+public:
+    AIThink();
+    ~AIThink();
+
+    void    Think               ();                 // Just before the AI teams run, from World::Update
+};
+
+
+#endif
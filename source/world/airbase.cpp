@@ -3,6 +3,7 @@
 #include "lib/math/random_number.h"
 #include "lib/language_table.h"
 #include "lib/preferences.h"
+#include "lib/tosser/directory.h"
 
 #include "app/app.h"
 #include "app/globals.h"
@@ -10,8 +11,6 @@
 
 #include "network/network_defines.h"
 
-#include "renderer/map_renderer.h"
-
 #include "world/world.h"
 #include "world/airbase.h"
 #include "world/bomber.h"
@@ -234,14 +233,15 @@ void AirBase::RunAI()
                 FastDArray<int> targetList;
                 if( !eventFound )
                 {
+                    ObjectStore &store = g_app->GetWorld()->m_objectStore;
                     for( int i = 0; i < g_app->GetWorld()->m_objects.Size(); ++i )
                     {
-                        if( g_app->GetWorld()->m_objects.ValidIndex(i) )
+                        if( g_app->GetWorld()->m_objects.ValidIndex(i) &&
+                            store.IsVisible( i, m_teamId ) &&
+                            !g_app->GetWorld()->IsFriend( m_teamId, store.m_teamId[i] ) )
                         {
                             WorldObject *obj = g_app->GetWorld()->m_objects[i];
-                            if( !g_app->GetWorld()->IsFriend( m_teamId, obj->m_teamId ) &&
-                                obj->IsMovingObject() &&
-                                obj->m_visible[m_teamId] &&
+                            if( obj->IsMovingObject() &&
                                 g_app->GetWorld()->GetDistanceSqd( m_longitude, m_latitude, obj->m_longitude, obj->m_latitude ) <= aggressionDistance * aggressionDistance )
                             {
                                 targetList.PutData( obj->m_objectId );
@@ -565,3 +565,20 @@ void AirBase::Render()
     }    
 }
 
+
+void AirBase::SaveSnapshot( Directory *_dir )
+{
+    WorldObject::SaveSnapshot( _dir );
+
+    _dir->CreateData( "fighterRegenTimer", m_fighterRegenTimer );
+}
+
+
+void AirBase::LoadSnapshot( Directory *_dir )
+{
+    WorldObject::LoadSnapshot( _dir );
+
+    m_fighterRegenTimer = _dir->GetDataFixed( "fighterRegenTimer" );
+}
+
+
@@ -29,6 +29,9 @@ public:
 
     int  IsValidCombatTarget     ( int _objectId );                                      // returns TargetType...
     int  IsValidMovementTarget   ( Fixed longitude, Fixed latitude );                    //
+
+    void    SaveSnapshot    ( Directory *_dir );
+    void    LoadSnapshot    ( Directory *_dir );
 };
 
 
@@ -8,9 +8,6 @@
 #include "app/app.h"
 #include "app/globals.h"
 
-#include "renderer/map_renderer.h"
-
-#include "interface/interface.h"
 
 #include "world/world.h"
 #include "world/battleship.h"
@@ -166,26 +163,25 @@ int BattleShip::GetTarget( Fixed range )
     Fleet *fleet = team->GetFleet( m_fleetId );
     WorldObject *currentTarget = NULL;
 
+    ObjectStore &store = g_app->GetWorld()->m_objectStore;
     int objectsSize = g_app->GetWorld()->m_objects.Size();
     for( int i = 0; i < objectsSize; ++i )
     {
-        if( g_app->GetWorld()->m_objects.ValidIndex(i) )
+        if( g_app->GetWorld()->m_objects.ValidIndex(i) &&
+            store.m_teamId[i] != TEAMID_SPECIALOBJECTS &&
+            store.IsVisible( i, m_teamId ) )
         {
             WorldObject *obj = g_app->GetWorld()->m_objects[i];
-            if( obj->m_teamId != TEAMID_SPECIALOBJECTS )
+            bool validNewTarget = !currentTarget ||
+                                    GetAttackPriority( currentTarget->m_type ) > GetAttackPriority( obj->m_type );
+
+            if( validNewTarget &&
+                !team->m_ceaseFire[ obj->m_teamId ] &&
+                !g_app->GetWorld()->IsFriend( obj->m_teamId, m_teamId ) &&                    
+                g_app->GetWorld()->GetAttackOdds( m_type, obj->m_type, m_objectId ) > 0 &&
+                g_app->GetWorld()->GetDistanceSqd( m_longitude, m_latitude, obj->m_longitude, obj->m_latitude ) < range * range )
             {
-                bool validNewTarget = !currentTarget ||
-                                        GetAttackPriority( currentTarget->m_type ) > GetAttackPriority( obj->m_type );
-
-                if( validNewTarget &&
-                    obj->m_visible[m_teamId] &&
-                    !team->m_ceaseFire[ obj->m_teamId ] &&
-                    !g_app->GetWorld()->IsFriend( obj->m_teamId, m_teamId ) &&                    
-                    g_app->GetWorld()->GetAttackOdds( m_type, obj->m_type, m_objectId ) > 0 &&
-                    g_app->GetWorld()->GetDistanceSqd( m_longitude, m_latitude, obj->m_longitude, obj->m_latitude ) < range * range )
-                {
-                    currentTarget = obj;
-                }
+                currentTarget = obj;
             }
         }
     }
@@ -10,7 +10,6 @@
 #include "app/app.h"
 #include "app/globals.h"
 
-#include "renderer/map_renderer.h"
 
 #include "world/world.h"
 #include "world/blip.h"
@@ -44,13 +43,13 @@ bool Blip::Update()
     m_speed = 4 / g_app->GetWorld()->GetTimeScaleFactor();
     m_turnRate = 40 / g_app->GetWorld()->GetTimeScaleFactor();
     if( m_type == BlipTypeSelect &&
-        m_origin != g_app->GetMapRenderer()->GetCurrentSelectionId() )
+        m_origin != g_app->GetWorld()->GetView()->GetCurrentSelectionId() )
     {
         return true;
     }
     if( m_type == BlipTypeHighlight )
     {
-        WorldObject *highlight = g_app->GetWorld()->GetWorldObject( g_app->GetMapRenderer()->GetCurrentHighlightId() );
+        WorldObject *highlight = g_app->GetWorld()->GetWorldObject( g_app->GetWorld()->GetView()->GetCurrentHighlightId() );
         if( highlight )
         {
             if( m_origin != highlight->m_fleetId )
@@ -59,7 +58,7 @@ bool Blip::Update()
             }
         }
 
-        WorldObject *obj = g_app->GetWorld()->GetWorldObject( g_app->GetMapRenderer()->GetCurrentSelectionId() );
+        WorldObject *obj = g_app->GetWorld()->GetWorldObject( g_app->GetWorld()->GetView()->GetCurrentSelectionId() );
         if( obj )
         {
             if( m_origin != obj->m_fleetId )
@@ -68,19 +67,19 @@ bool Blip::Update()
             }
         }
 
-        if( g_app->GetMapRenderer()->GetCurrentSelectionId() == -1 &&
-            g_app->GetMapRenderer()->GetCurrentHighlightId() == -1 )
+        if( g_app->GetWorld()->GetView()->GetCurrentSelectionId() == -1 &&
+            g_app->GetWorld()->GetView()->GetCurrentHighlightId() == -1 )
         {
             return true;
         }
     }
     if( m_type == BlipTypeMouseTracker )
     {
-        if( g_app->GetMapRenderer()->m_mouseIdleTime < 3.0f )
+        if( g_app->GetWorld()->GetView()->GetMouseIdleTime() < 3.0f )
         {
             return true;
         }
-        WorldObject *obj = g_app->GetWorld()->GetWorldObject( g_app->GetMapRenderer()->GetCurrentSelectionId() );
+        WorldObject *obj = g_app->GetWorld()->GetWorldObject( g_app->GetWorld()->GetView()->GetCurrentSelectionId() );
         if( !obj ||
             obj->m_fleetId != m_origin )
         {
@@ -129,10 +128,9 @@ bool Blip::Update()
                     Node *node = g_app->GetWorld()->m_nodes[n];
                     if( g_app->GetWorld()->IsSailable( m_longitude, m_latitude, node->m_longitude, node->m_latitude ) )
                     {
-                        int routeId = node->GetRouteId( m_targetNodeId );
-                        if( routeId != -1 )
+                        if( node->HasRoute( m_targetNodeId ) )
                         {
-                            Fixed totalDistance = node->m_routeTable[routeId]->m_totalDistance;
+                            Fixed totalDistance = node->GetRouteDistance( m_targetNodeId );
 
                             totalDistance += g_app->GetWorld()->GetDistance( m_longitude, m_latitude, node->m_longitude, node->m_latitude );
 
@@ -205,7 +203,7 @@ void Blip::Render()
                 fleet->GetFormationPosition( fleet->m_fleetMembers.Size(), i, &longitude, &latitude );
                 longitude += m_vel.x * Fixed::FromDouble(g_predictionTime);
                 latitude += m_vel.y * Fixed::FromDouble(g_predictionTime);
-                Image *img = g_resource->GetImage( g_app->GetMapRenderer()->m_imageFiles[ member->m_type ] );
+                Image *img = g_resource->GetImage( g_app->GetWorld()->GetView()->GetImageFile( member->m_type ) );
                 g_renderer->Blit( img, m_longitude.DoubleValue() + longitude.DoubleValue() - size,
 								  m_latitude.DoubleValue() + latitude.DoubleValue() + size,
 								  size*2, size*-2, Colour(100,100,100,200) );
@@ -6,6 +6,7 @@
 #include "lib/math/random_number.h"
 #include "lib/math/math_utils.h"
 #include "lib/language_table.h"
+#include "lib/tosser/directory.h"
  
 #include "app/app.h"
 #include "app/globals.h"
@@ -13,9 +14,6 @@
 
 #include "network/ClientToServer.h"
 
-#include "renderer/map_renderer.h"
-
-#include "interface/interface.h"
 
 #include "world/world.h"
 #include "world/bomber.h"
@@ -306,16 +304,17 @@ void Bomber::RunAI()
 {
     if( IsIdle() )
     {
+        ObjectStore &store = g_app->GetWorld()->m_objectStore;
         for( int i = 0; i < g_app->GetWorld()->m_objects.Size(); ++i )
         {
-            if( g_app->GetWorld()->m_objects.ValidIndex(i) )
+            if( g_app->GetWorld()->m_objects.ValidIndex(i) &&
+                store.IsVisible( i, m_teamId ) )
             {
                 WorldObject *obj = g_app->GetWorld()->m_objects[i];
                 if( obj )
                 {
-                    if( g_app->GetWorld()->GetAttackOdds( m_type, obj->m_type ) > 0 &&
-                        !g_app->GetWorld()->IsFriend( m_teamId, obj->m_teamId ) &&                        
-                        obj->m_visible[m_teamId] &&
+                    if( g_app->GetWorld()->GetAttackOdds( m_type, store.m_type[i] ) > 0 &&
+                        !g_app->GetWorld()->IsFriend( m_teamId, store.m_teamId[i] ) &&                        
                         g_app->GetWorld()->GetDistance( m_longitude, m_latitude, obj->m_longitude, obj->m_latitude ) < m_range - 15 )
                     {
                         SetState(0);
@@ -458,7 +457,7 @@ void Bomber::CeaseFire( int teamId )
 {
     if( m_nukeTargetLongitude != 0 && m_nukeTargetLatitude != 0)
     {
-        if( g_app->GetMapRenderer()->IsValidTerritory( teamId, m_targetLongitude, m_targetLatitude, false ) )
+        if( g_app->GetWorld()->IsValidTerritory( teamId, m_targetLongitude, m_targetLatitude, false ) )
         {
             m_nukeTargetLongitude = 0;
             m_nukeTargetLatitude = 0;
@@ -507,3 +506,25 @@ bool Bomber::SetWaypointOnAction()
 {
     return true;
 }
+
+
+void Bomber::SaveSnapshot( Directory *_dir )
+{
+    MovingObject::SaveSnapshot( _dir );
+
+    _dir->CreateData( "nukeTargetLongitude", m_nukeTargetLongitude );
+    _dir->CreateData( "nukeTargetLatitude", m_nukeTargetLatitude );
+    _dir->CreateData( "bombingRun", m_bombingRun );
+}
+
+
+void Bomber::LoadSnapshot( Directory *_dir )
+{
+    MovingObject::LoadSnapshot( _dir );
+
+    m_nukeTargetLongitude = _dir->GetDataFixed( "nukeTargetLongitude" );
+    m_nukeTargetLatitude = _dir->GetDataFixed( "nukeTargetLatitude" );
+    m_bombingRun = _dir->GetDataBool( "bombingRun" );
+}
+
+
@@ -34,6 +34,8 @@ public:
     void    CeaseFire       ( int teamId );
     bool    SetWaypointOnAction();
 
+    void    SaveSnapshot    ( Directory *_dir );
+    void    LoadSnapshot    ( Directory *_dir );
 };
 
 #endif
@@ -9,8 +9,6 @@
 #include "app/globals.h"
 #include "app/game.h"
 
-#include "renderer/map_renderer.h"
-
 #include "world/world.h"
 #include "world/carrier.h"
 #include "world/bomber.h"
@@ -245,17 +243,22 @@ void Carrier::RunAI()
             {
                 LList<int> targets;
                 int scanRange = 15.0f;
+                ObjectStore &store = g_app->GetWorld()->m_objectStore;
                 for( int i = 0; i < g_app->GetWorld()->m_objects.Size(); ++i )
                 {
                     if( g_app->GetWorld()->m_objects.ValidIndex(i) )
                     {
-                        WorldObject *obj = g_app->GetWorld()->m_objects[i];
-                        bool visible = obj->m_visible[m_teamId];
-                        if( obj->m_type == WorldObject::TypeSub && m_currentState == 1 ) visible = true;                // TODO CHRIS : This looks like a bug to me.  surely current state should be 2?
+                        bool visible = store.IsVisible( i, m_teamId );
+                        if( store.m_type[i] == WorldObject::TypeSub && m_currentState == 1 ) visible = true;                // TODO CHRIS : This looks like a bug to me.  surely current state should be 2?
+
+                        if( !visible ||
+                            g_app->GetWorld()->IsFriend( m_teamId, store.m_teamId[i] ) )
+                        {
+                            continue;
+                        }
 
-                        if( !g_app->GetWorld()->IsFriend( m_teamId, obj->m_teamId) &&                            
-                            visible &&
-                            obj->IsMovingObject() &&
+                        WorldObject *obj = g_app->GetWorld()->m_objects[i];
+                        if( obj->IsMovingObject() &&
                             team->CountTargettedUnits(i) < 3 &&
                             g_app->GetWorld()->GetDistance( m_longitude, m_latitude, obj->m_longitude, obj->m_latitude ) < scanRange )
                         {
@@ -329,15 +332,16 @@ void Carrier::RunAI()
                     if( m_nukeSupply == 0 &&
                         m_states[1]->m_numTimesPermitted > 0 )
                     {
+                        ObjectStore &store = g_app->GetWorld()->m_objectStore;
                         for( int i = 0; i < g_app->GetWorld()->m_objects.Size(); ++i )
                         {
                             if( g_app->GetWorld()->m_objects.ValidIndex(i) )
                             {
-                                WorldObject *obj = g_app->GetWorld()->m_objects[i];
-                                if( obj->m_teamId == m_teamId &&
-                                    ( obj->m_type == WorldObject::TypeCarrier ||
-                                      obj->m_type == WorldObject::TypeAirBase ) )
+                                if( store.m_teamId[i] == m_teamId &&
+                                    ( store.m_type[i] == WorldObject::TypeCarrier ||
+                                      store.m_type[i] == WorldObject::TypeAirBase ) )
                                 {
+                                    WorldObject *obj = g_app->GetWorld()->m_objects[i];
                                     if( obj->m_nukeSupply - obj->m_states[1]->m_numTimesPermitted > 0 )
                                     {
                                         if( m_currentState != 1 )
@@ -430,16 +434,17 @@ bool Carrier::IsActionQueueable()
 
 int Carrier::FindTarget()
 {
+    ObjectStore &store = g_app->GetWorld()->m_objectStore;
     for( int i = 0; i < g_app->GetWorld()->m_objects.Size(); ++i )
     {
         if( g_app->GetWorld()->m_objects.ValidIndex(i) )
         {
-            WorldObject *obj = g_app->GetWorld()->m_objects[i];
-
-            if( obj->m_teamId != m_teamId &&                
-                g_app->GetWorld()->GetAttackOdds( WorldObject::TypeFighter, obj->m_type ) > 0 &&
-                obj->m_visible[m_teamId] == true )
+            if( store.m_teamId[i] != m_teamId &&                
+                g_app->GetWorld()->GetAttackOdds( WorldObject::TypeFighter, store.m_type[i] ) > 0 &&
+                store.IsVisible( i, m_teamId ) )
             {
+                WorldObject *obj = g_app->GetWorld()->m_objects[i];
+
                 Fixed distance = g_app->GetWorld()->GetDistance( m_longitude, m_latitude, obj->m_longitude, obj->m_latitude);
 
                 if( distance <= 30 )
@@ -699,14 +704,15 @@ int Carrier::IsValidMovementTarget( Fixed longitude, Fixed latitude )
 int Carrier::CountIncomingFighters()
 {
     int num = 0;
+    ObjectStore &store = g_app->GetWorld()->m_objectStore;
     for( int i = 0; i < g_app->GetWorld()->m_objects.Size(); ++i )
     {
-        if( g_app->GetWorld()->m_objects.ValidIndex(i) )
+        if( g_app->GetWorld()->m_objects.ValidIndex(i) &&
+            store.m_type[i] == WorldObject::TypeFighter &&
+            store.m_teamId[i] == m_teamId )
         {
             MovingObject *obj = (MovingObject *)g_app->GetWorld()->m_objects[i];
-            if( obj->m_type == WorldObject::TypeFighter &&
-                obj->m_teamId == m_teamId &&
-                obj->m_isLanding == m_objectId )
+            if( obj->m_isLanding == m_objectId )
             {
                 num++;
             }
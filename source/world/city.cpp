@@ -6,6 +6,7 @@
 #include "lib/resource/image.h"
 #include "lib/language_table.h"
 #include "lib/hi_res_time.h"
+#include "lib/tosser/directory.h"
 
 #include "app/app.h"
 #include "app/globals.h"
@@ -15,9 +16,6 @@
 #include "world/team.h"
 #include "world/nuke.h"
 
-#include "interface/interface.h"
-
-#include "renderer/map_renderer.h"
 
 
 City::City()
@@ -149,7 +147,7 @@ bool City::NuclearStrike( int causedBy, Fixed intensity, Fixed range, bool direc
             sprintf( caption, "%s", LANGUAGEPHRASE("message_fallout") );
             LPREPLACESTRINGFLAG( 'D', dead, caption );
             LPREPLACESTRINGFLAG( 'C', LANGUAGEPHRASEADDITIONAL(m_name), caption );
-            g_app->GetInterface()->ShowMessage( m_longitude, m_latitude, m_teamId, caption );
+            g_app->GetWorld()->GetView()->ShowMessage( m_longitude, m_latitude, m_teamId, caption );
         }
 
         return directHit;
@@ -175,3 +173,27 @@ int City::GetEstimatedPopulation( int teamId, int cityId, int numNukes )
         return -1;
     }
 }
+
+
+void City::SaveSnapshot( Directory *_dir )
+{
+    WorldObject::SaveSnapshot( _dir );
+
+    _dir->CreateData( "population", m_population );
+    _dir->CreateData( "capital", m_capital );
+    _dir->CreateData( "numStrikes", m_numStrikes );
+    _dir->CreateData( "dead", m_dead );
+}
+
+
+void City::LoadSnapshot( Directory *_dir )
+{
+    WorldObject::LoadSnapshot( _dir );
+
+    m_population = _dir->GetDataInt( "population" );
+    m_capital = _dir->GetDataBool( "capital" );
+    m_numStrikes = _dir->GetDataInt( "numStrikes" );
+    m_dead = _dir->GetDataInt( "dead" );
+}
+
+
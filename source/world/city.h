@@ -22,7 +22,9 @@ public:
     bool    NuclearStrike( int causedBy, Fixed intensity, Fixed range, bool directHitPossible );
 
     static int GetEstimatedPopulation( int teamId, int cityId, int numNukes );    // returns the estimated population after all targeted nukes from teamId hit
-    
+
+    void    SaveSnapshot    ( Directory *_dir );
+    void    LoadSnapshot    ( Directory *_dir );
 };
 
 
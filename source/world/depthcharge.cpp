@@ -8,11 +8,11 @@
 #include "lib/math/vector3.h"
 #include "lib/math/random_number.h"
 #include "lib/sound/soundsystem.h"
+#include "lib/tosser/directory.h"
 
 #include "app/app.h"
 #include "app/globals.h"
 
-#include "renderer/map_renderer.h"
 
 #include "world/world.h"
 #include "world/explosion.h"
@@ -47,9 +47,9 @@ void DepthCharge::Render()
     float predictedTimer = m_timer.DoubleValue() - g_app->GetWorld()->GetTimeScaleFactor().DoubleValue() * g_predictionTime;
 
     float size = (predictedTimer+30)/60.0f;
-    if( g_app->GetMapRenderer()->GetZoomFactor() <=0.25f )
+    if( g_app->GetWorld()->GetView()->GetZoomFactor() <=0.25f )
     {
-        size *= g_app->GetMapRenderer()->GetZoomFactor() * 4;
+        size *= g_app->GetWorld()->GetView()->GetZoomFactor() * 4;
     }
     Colour colour = g_app->GetWorld()->GetTeam( m_teamId )->GetTeamColour();
 
@@ -78,15 +78,16 @@ void DepthCharge::Impact()
 
     g_soundSystem->TriggerEvent( "Object_carrier", "DepthCharge", Vector3<Fixed>(m_longitude, m_latitude,0) );
 
+    ObjectStore &store = g_app->GetWorld()->m_objectStore;
     for( int i = 0; i < g_app->GetWorld()->m_objects.Size(); ++i )
     {
         if( g_app->GetWorld()->m_objects.ValidIndex(i) )
         {
-            WorldObject *wobj = g_app->GetWorld()->m_objects[i];
-
-            if( wobj->m_type == WorldObject::TypeSub &&
-                wobj->m_teamId != m_teamId )
+            if( store.m_type[i] == WorldObject::TypeSub &&
+                store.m_teamId[i] != m_teamId )
             {
+                WorldObject *wobj = g_app->GetWorld()->m_objects[i];
+
                 Fixed rangeSqd = g_app->GetWorld()->GetDistanceSqd( m_longitude, m_latitude, wobj->m_longitude, wobj->m_latitude);
                 if( rangeSqd <= 5 * 5 )
                 {
@@ -106,3 +107,22 @@ void DepthCharge::Impact()
         }
     }
 }
+
+
+void DepthCharge::SaveSnapshot( Directory *_dir )
+{
+    GunFire::SaveSnapshot( _dir );
+
+    _dir->CreateData( "depthCharge", true );                    // Both are TypeInvalid
+    _dir->CreateData( "timer", m_timer );
+}
+
+
+void DepthCharge::LoadSnapshot( Directory *_dir )
+{
+    GunFire::LoadSnapshot( _dir );
+
+    m_timer = _dir->GetDataFixed( "timer" );
+}
+
+
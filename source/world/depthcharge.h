@@ -17,6 +17,9 @@ public:
     bool    Update          ();
     void    Render          ();
     void    Impact();
+
+    void    SaveSnapshot    ( Directory *_dir );
+    void    LoadSnapshot    ( Directory *_dir );
 }; 
 
 
@@ -1,18 +1,55 @@
 #include "lib/universal_include.h"
+
+#include <stdio.h>
+#include <string.h>
+
 #include "lib/filesys/file_system.h"
+#include "lib/filesys/filesys_utils.h"
+#include "lib/filesys/mapped_file.h"
+#include "lib/filesys/binary_stream_readers.h"
 #include "lib/filesys/text_stream_readers.h"
-#include "lib/math/vector3.h"
 #include "lib/hi_res_time.h"
 #include "lib/preferences.h"
 
 #include "city.h"
 #include "earthdata.h"
+#include "earthdata_format.h"
+#include "world.h"
+
+#include "app/app.h"
+
+
+
+Island::Island()
+:   m_points(NULL),
+    m_numPoints(0)
+{
+}
+
 
-#include "renderer/map_renderer.h"
+// ============================================================================
 
 
 EarthData::EarthData()
+:   m_islandPoints(NULL),
+    m_borderPoints(NULL),
+    m_islandFile(NULL),
+    m_borderFile(NULL)
+{
+}
+
+
+EarthData::~EarthData()
 {
+    m_islands.EmptyAndDelete();
+    m_borders.EmptyAndDelete();
+    m_cities.EmptyAndDelete();
+
+    if( m_islandFile )  delete m_islandFile;
+    else                delete [] m_islandPoints;
+
+    if( m_borderFile )  delete m_borderFile;
+    else                delete [] m_borderPoints;
 }
 
 
@@ -24,42 +61,402 @@ void EarthData::Initialise()
 }
 
 
-void EarthData::LoadBorders()
+// Same order FileSystem looks in, minus the archive which can't be mapped
+
+static bool FindLooseFile( char const *_filename, char *_result, int _resultSize )
 {
-    double startTime = GetHighResTime();
-    
-    m_borders.EmptyAndDelete();
+    for( int i = 0; i < g_fileSystem->m_searchPath.Size(); ++i )
+    {
+        snprintf( _result, _resultSize, "%s%s", g_fileSystem->m_searchPath[i], _filename );
+        _result[ _resultSize - 1 ] = '\x0';
+        if( DoesFileExist( _result ) ) return true;
+    }
+
+    if( DoesFileExist( _filename ) )
+    {
+        strncpy( _result, _filename, _resultSize );
+        _result[ _resultSize - 1 ] = '\x0';
+        return true;
+    }
+
+    return false;
+}
 
-    int numIslands = 0;    
-    Island *island = NULL;
 
-    TextReader *international = g_fileSystem->GetTextReader( "data/earth/international.dat" );
-    AppAssert( international && international->IsOpen() );
+static bool GetSourceHash( char const *_filename, unsigned int &_hash )
+{
+    BinaryReader *reader = g_fileSystem->GetBinaryReader( _filename );
+    if( !reader || !reader->IsOpen() )
+    {
+        delete reader;
+        return false;
+    }
 
-    while( international->ReadLine() )
+    _hash = EARTHDATA_HASHSEED;
+
+    unsigned char buffer[4096];
+    while( true )
     {
-        char *line = international->GetRestOfLine();        
-        if( line[0] == 'b' )
+        unsigned int bytesRead = reader->ReadBytes( sizeof(buffer), buffer );
+        _hash = EarthData_HashSource( buffer, bytesRead, _hash );
+        if( bytesRead < sizeof(buffer) ) break;
+    }
+
+    delete reader;
+    return true;
+}
+
+
+// The hash of a loose text file, with the size and modification time it had when hashed.
+// Kept in App::GetEarthDataCachePath rather than the .bin files, which
+// may be read only and are shipped with the game
+
+#define EARTHDATA_STAMPS_MAX        16
+
+struct EarthDataStamp
+{
+    char            m_filename[256];                // As found by FindLooseFile
+    unsigned int    m_sourceHash;
+    unsigned int    m_sourceSize;
+    unsigned int    m_sourceTime;
+};
+
+
+// Returns the number of stamps read into _stamps
+
+static int LoadStamps( EarthDataStamp *_stamps )
+{
+    FILE *file = fopen( App::GetEarthDataCachePath(), "rb" );
+    if( !file ) return 0;
+
+    int numStamps = fread( _stamps, sizeof(EarthDataStamp), EARTHDATA_STAMPS_MAX, file );
+    fclose( file );
+
+    for( int i = 0; i < numStamps; ++i )
+    {
+        _stamps[i].m_filename[ sizeof(_stamps[i].m_filename) - 1 ] = '\x0';
+    }
+
+    return numStamps;
+}
+
+
+static void SaveStamp( EarthDataStamp const &_stamp )
+{
+    EarthDataStamp stamps[EARTHDATA_STAMPS_MAX];
+    int numStamps = LoadStamps( stamps );
+
+    int index = 0;
+    while( index < numStamps &&
+           strcmp( stamps[index].m_filename, _stamp.m_filename ) != 0 )
+    {
+        ++index;
+    }
+
+    if( index == EARTHDATA_STAMPS_MAX ) index = 0;
+    stamps[index] = _stamp;
+    if( index == numStamps ) ++numStamps;
+
+    //
+    // Write to a temporary file first so a half written cache
+    // is never picked up by another running instance
+
+    char const *filename = App::GetEarthDataCachePath();
+    char tempFilename[512];
+    snprintf( tempFilename, sizeof(tempFilename), "%s.tmp", filename );
+    tempFilename[ sizeof(tempFilename) - 1 ] = '\x0';
+
+    FILE *file = fopen( tempFilename, "wb" );
+    if( !file ) return;
+
+    bool success = ( fwrite( stamps, sizeof(EarthDataStamp), numStamps, file ) == (size_t) numStamps );
+    fclose( file );
+
+    if( success )
+    {
+        remove( filename );
+        success = ( rename( tempFilename, filename ) == 0 );
+    }
+
+    if( !success )
+    {
+        remove( tempFilename );
+        AppDebugOut( "Failed to write earth data cache '%s'\n", filename );
+    }
+}
+
+
+// True if the .bin at _compiledFilename came from the _filename we would otherwise parse.
+// Only reads the text file when its stamp has changed since the last check,
+// which a source in the archive always has, having none
+
+static bool IsCompiledFrom( char const *_compiledFilename, char const *_filename, char const *_magic )
+{
+    EarthDataHeader header;
+
+    FILE *file = fopen( _compiledFilename, "rb" );
+    if( !file ) return false;
+    bool headerRead = ( fread( &header, sizeof(header), 1, file ) == 1 );
+    fclose( file );
+
+    if( !headerRead ||
+        memcmp( header.m_magic, _magic, sizeof(header.m_magic) ) != 0 ||
+        header.m_version != EARTHDATA_VERSION ||
+        header.m_byteOrder != EARTHDATA_BYTEORDER )
+    {
+        return false;
+    }
+
+    EarthDataStamp stamp;
+    memset( &stamp, 0, sizeof(stamp) );
+    bool stamped = FindLooseFile( _filename, stamp.m_filename, sizeof(stamp.m_filename) ) &&
+                   GetFileStamp( stamp.m_filename, stamp.m_sourceSize, stamp.m_sourceTime );
+
+    if( stamped )
+    {
+        EarthDataStamp stamps[EARTHDATA_STAMPS_MAX];
+        int numStamps = LoadStamps( stamps );
+        for( int i = 0; i < numStamps; ++i )
         {
-            if( island )
+            if( strcmp( stamps[i].m_filename, stamp.m_filename ) == 0 &&
+                stamps[i].m_sourceSize == stamp.m_sourceSize &&
+                stamps[i].m_sourceTime == stamp.m_sourceTime &&
+                stamps[i].m_sourceHash == header.m_sourceHash )
             {
-                m_borders.PutData( island );                  
-                ++numIslands;
+                return true;
             }
-            island = new Island();            
         }
-        else
+    }
+
+    unsigned int sourceHash;
+    if( !GetSourceHash( _filename, sourceHash ) ||
+        header.m_sourceHash != sourceHash )
+    {
+        return false;
+    }
+
+
+    //
+    // Same text, newly stamped, eg after a fresh install.
+    // Note the stamp if we can, otherwise we'll just hash again next time
+
+    if( stamped )
+    {
+        stamp.m_sourceHash = sourceHash;
+        SaveStamp( stamp );
+    }
+
+    return true;
+}
+
+
+// Maps the .bin beside _filename, if it was compiled from the _filename we would otherwise parse
+
+static MappedFile *OpenCompiledFile( char const *_filename, char const *_magic )
+{
+    char compiledFilename[512];
+    strncpy( compiledFilename, _filename, sizeof(compiledFilename) );
+    compiledFilename[ sizeof(compiledFilename) - 1 ] = '\x0';
+
+    char *extension = strrchr( compiledFilename, '.' );
+    if( !extension || strlen(extension) != 4 ) return NULL;
+    strcpy( extension, ".bin" );
+
+    char fullFilename[512];
+    if( !FindLooseFile( compiledFilename, fullFilename, sizeof(fullFilename) ) ) return NULL;
+
+    if( !IsCompiledFrom( fullFilename, _filename, _magic ) ) return NULL;
+
+    MappedFile *file = new MappedFile( fullFilename );
+    EarthDataHeader const *header = (EarthDataHeader const *) file->m_data;
+
+    if( !file->IsOpen() ||
+        file->m_size < sizeof(EarthDataHeader) ||
+        memcmp( header->m_magic, _magic, sizeof(header->m_magic) ) != 0 ||
+        header->m_version != EARTHDATA_VERSION ||
+        header->m_byteOrder != EARTHDATA_BYTEORDER ||
+        header->m_numRecords < 0 ||
+        header->m_numPoints < 0 )
+    {
+        delete file;
+        return NULL;
+    }
+
+    return file;
+}
+
+
+bool EarthData::LoadCompiledLines( char const *_filename, LList<Island *> &_islands, MappedFile *&_file )
+{
+    MappedFile *file = OpenCompiledFile( _filename, s_earthDataLinesMagic );
+    if( !file ) return false;
+
+    EarthDataHeader const *header = (EarthDataHeader const *) file->m_data;
+    int numIslands = header->m_numRecords;
+    int numPoints = header->m_numPoints;
+
+    unsigned int expectedSize = sizeof(EarthDataHeader) +
+                                ( numIslands + 1 ) * sizeof(int) +
+                                numPoints * 2 * sizeof(float);
+
+    int const *offsets = (int const *) ( file->m_data + sizeof(EarthDataHeader) );
+    float const *points = (float const *) ( offsets + numIslands + 1 );
+
+    if( file->m_size != expectedSize ||
+        offsets[numIslands] != numPoints )
+    {
+        delete file;
+        return false;
+    }
+
+    for( int i = 0; i < numIslands; ++i )
+    {
+        if( offsets[i] < 0 || offsets[i] > offsets[i+1] )
+        {
+            _islands.EmptyAndDelete();
+            delete file;
+            return false;
+        }
+
+        Island *island = new Island();
+        island->m_points = points + offsets[i] * 2;
+        island->m_numPoints = offsets[i+1] - offsets[i];
+        _islands.PutData( island );
+    }
+
+    _file = file;
+    return true;
+}
+
+
+void EarthData::LoadLines( char const *_filename, LList<Island *> &_islands, float *&_points, MappedFile *&_file )
+{
+    _islands.EmptyAndDelete();
+
+    if( _file )     delete _file;
+    else            delete [] _points;
+    _file = NULL;
+    _points = NULL;
+
+    if( LoadCompiledLines( _filename, _islands, _file ) )
+    {
+        return;
+    }
+
+    TextReader *reader = g_fileSystem->GetTextReader( _filename );
+    AppAssert( reader && reader->IsOpen() );
+
+
+    //
+    // Gather every point into one array, remembering where each island starts.
+    // An island is only kept once the next one begins, so the last in
+    // the file is dropped.  earthcompile does the same.
+
+    int maxPoints = 4096;
+    int numPoints = 0;
+    float *points = new float[ maxPoints * 2 ];
+
+    LList<int> offsets;
+    bool inIsland = false;
+
+    while( reader->ReadLine() )
+    {
+        char *line = reader->GetRestOfLine();
+        if( !line ) continue;
+
+        if( line[0] == 'b' )
+        {
+            offsets.PutDataAtEnd( numPoints );
+            inIsland = true;
+            continue;
+        }
+
+        if( !inIsland ) continue;
+
+        float longitude, latitude;
+        sscanf( line, "%f %f", &longitude, &latitude );
+
+        if( numPoints == maxPoints )
         {
-            float longitude, latitude;
-            sscanf( line, "%f %f", &longitude, &latitude );
-            island->m_points.PutData( new Vector3<float>( longitude, latitude, 0.0f ) );
+            float *newPoints = new float[ maxPoints * 4 ];
+            memcpy( newPoints, points, maxPoints * 2 * sizeof(float) );
+            delete [] points;
+            points = newPoints;
+            maxPoints *= 2;
         }
+
+        points[ numPoints * 2 ] = longitude;
+        points[ numPoints * 2 + 1 ] = latitude;
+        ++numPoints;
+    }
+
+    delete reader;
+
+    for( int i = 0; i + 1 < offsets.Size(); ++i )
+    {
+        Island *island = new Island();
+        island->m_points = points + offsets[i] * 2;
+        island->m_numPoints = offsets[i+1] - offsets[i];
+        _islands.PutData( island );
     }
+
+    _points = points;
+}
+
+
+void EarthData::LoadBorders()
+{
+    double startTime = GetHighResTime();
     
-    delete international;
+    LoadLines( "data/earth/international.dat", m_borders, m_borderPoints, m_borderFile );
 
     double totalTime = GetHighResTime() - startTime;
-    AppDebugOut( "Parsing International data (%d islands) : %dms\n", numIslands, int( totalTime * 1000.0f ) );
+    AppDebugOut( "%s International data (%d islands) : %dms\n", 
+                 m_borderFile ? "Mapping" : "Parsing", m_borders.Size(), int( totalTime * 1000.0f ) );
+}
+
+
+bool EarthData::LoadCompiledCities( char const *_filename )
+{
+    MappedFile *file = OpenCompiledFile( _filename, s_earthDataCitiesMagic );
+    if( !file ) return false;
+
+    EarthDataHeader const *header = (EarthDataHeader const *) file->m_data;
+    int numCities = header->m_numRecords;
+
+    if( file->m_size != sizeof(EarthDataHeader) + numCities * sizeof(EarthDataCity) )
+    {
+        delete file;
+        return false;
+    }
+
+    EarthDataCity const *records = (EarthDataCity const *) ( file->m_data + sizeof(EarthDataHeader) );
+
+    for( int i = 0; i < numCities; ++i )
+    {
+        EarthDataCity const *record = &records[i];
+
+        char name[sizeof(record->m_name)];
+        char country[sizeof(record->m_country)];
+        memcpy( name, record->m_name, sizeof(name) );
+        memcpy( country, record->m_country, sizeof(country) );
+        name[ sizeof(name) - 1 ] = '\x0';
+        country[ sizeof(country) - 1 ] = '\x0';
+
+        City *city = new City();
+        city->m_name = strdup( strupr(name) );
+        city->m_country = strdup( strupr(country) );
+        city->m_longitude = Fixed::FromDouble(record->m_longitude);
+        city->m_latitude = Fixed::FromDouble(record->m_latitude);
+        city->m_population = record->m_population;
+        city->m_capital = record->m_capital;         
+        city->SetRadarRange( Fixed::FromDouble(sqrtf( sqrtf(city->m_population) ) / 4.0f) );
+
+        m_cities.PutData( city );
+    }
+
+    delete file;
+    return true;
 }
 
 
@@ -69,6 +466,13 @@ void EarthData::LoadCities()
 
     m_cities.EmptyAndDelete();
 
+    if( LoadCompiledCities( "data/earth/cities.dat" ) )
+    {
+        float totalTime = GetHighResTime() - startTime;
+        AppDebugOut( "Mapping City data (%d cities) : %dms\n", m_cities.Size(), int( totalTime * 1000.0f ) );
+        return;
+    }
+
     TextReader *cities = g_fileSystem->GetTextReader( "data/earth/cities.dat" );
     AppAssert( cities && cities->IsOpen() );
     
@@ -130,10 +534,6 @@ void EarthData::LoadCoastlines()
 {
     double startTime = GetHighResTime();
 
-    m_islands.EmptyAndDelete();
-
-    int numIslands = 0;
-
     char coastFile[1024];
     if( g_preferences->GetInt(PREFS_GRAPHICS_LOWRESWORLD) == 0 )
     {
@@ -144,32 +544,9 @@ void EarthData::LoadCoastlines()
         strcpy(coastFile, "data/earth/coastlines-low.dat");
     }
 
-    TextReader *coastlines = g_fileSystem->GetTextReader( coastFile );
-    AppAssert( coastlines && coastlines->IsOpen() );
-    Island *island = NULL;
-    
-    while( coastlines->ReadLine() )
-    {        
-        char *line = coastlines->GetRestOfLine();
-        if( line[0] == 'b' )
-        {
-            if( island )
-            {           
-                m_islands.PutData( island );                  
-            }
-            island = new Island();
-            ++numIslands;
-        }
-        else
-        {
-            float longitude, latitude;
-            sscanf( line, "%f %f", &longitude, &latitude );
-            island->m_points.PutData( new Vector3<float>( longitude, latitude, 0.0f ) );            
-        }
-    }
-
-    delete coastlines;
+    LoadLines( coastFile, m_islands, m_islandPoints, m_islandFile );
 
     double totalTime = GetHighResTime() - startTime;
-    AppDebugOut( "Parsing Coastline data (%d islands) : %dms\n", numIslands, int( totalTime * 1000.0f ) );
+    AppDebugOut( "%s Coastline data (%d islands) : %dms\n", 
+                 m_islandFile ? "Mapping" : "Parsing", m_islands.Size(), int( totalTime * 1000.0f ) );
 }
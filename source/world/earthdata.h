@@ -3,13 +3,32 @@
 
 class Island;
 class City;
+class MappedFile;
 
 #include "lib/tosser/llist.h"
-#include "lib/math/vector3.h"
 
 
+/*
+ *  Coastlines, borders and cities.
+ *
+ *  Each is read from a compiled .bin beside its .dat when there is an
+ *  up to date one (see earthdata_format.h), otherwise parsed from the text.
+ *  Either way every island's points sit in one flat array per list.
+ *
+ */
+
 class EarthData
 {
+protected:
+    float           *m_islandPoints;                    // Owned unless m_islandFile is set
+    float           *m_borderPoints;
+    MappedFile      *m_islandFile;                      // Compiled file the points above live in
+    MappedFile      *m_borderFile;
+
+    void LoadLines          ( char const *_filename, LList<Island *> &_islands, float *&_points, MappedFile *&_file );
+    bool LoadCompiledLines  ( char const *_filename, LList<Island *> &_islands, MappedFile *&_file );
+    bool LoadCompiledCities ( char const *_filename );
+
 public:
     LList           <Island *>          m_islands;
     LList           <Island *>          m_borders;
@@ -17,6 +36,7 @@ public:
 
 public:
     EarthData();
+    ~EarthData();
 
     void Initialise();
 
@@ -32,8 +52,10 @@ public:
 class Island
 {
 public:
-    LList<Vector3<float> *> m_points;
+    float const *m_points;                              // m_numPoints longitude, latitude pairs
+    int     m_numPoints;
 
+    Island();
 };
 
 
@@ -0,0 +1,70 @@
+#ifndef _included_earthdataformat_h
+#define _included_earthdataformat_h
+
+/*
+ *  Compiled earth data, as written by contrib/systemIV/tools/earthcompile
+ *  and mapped straight in by EarthData.
+ *
+ *  Lines file (coastlines, borders) :
+ *      EarthDataHeader
+ *      int     offsets[m_numRecords + 1]       First point of each island, then m_numPoints
+ *      float   points[m_numPoints * 2]         Longitude, latitude pairs
+ *
+ *  Cities file :
+ *      EarthDataHeader
+ *      EarthDataCity   cities[m_numRecords]
+ *
+ *  Native byte order only.  A file written on the other kind of
+ *  machine fails the m_byteOrder check and the text file is parsed instead.
+ *
+ */
+
+#define EARTHDATA_VERSION           1
+#define EARTHDATA_BYTEORDER         0x01020304
+
+
+struct EarthDataHeader
+{
+    char            m_magic[4];
+    int             m_version;
+    unsigned int    m_byteOrder;
+    unsigned int    m_sourceHash;                   // EarthData_HashSource of the text file it came from
+    int             m_numRecords;                   // Islands or cities
+    int             m_numPoints;                    // Zero in a cities file
+};
+
+
+struct EarthDataCity
+{
+    char            m_name[48];                     // As in the text file, not yet in upper case
+    char            m_country[48];
+    float           m_longitude;
+    float           m_latitude;
+    int             m_population;
+    int             m_capital;
+};
+
+
+static char const s_earthDataLinesMagic[4]  = { 'D', 'E', 'L', 'N' };
+static char const s_earthDataCitiesMagic[4] = { 'D', 'E', 'C', 'T' };
+
+
+// FNV-1a over the raw bytes of the text file, so an edited
+// or modded text file is never paired with a stale compiled one.
+// Pass the previous result as _hash to continue over another block.
+
+#define EARTHDATA_HASHSEED          2166136261u
+
+inline unsigned int EarthData_HashSource( unsigned char const *_data, unsigned int _size, unsigned int _hash = EARTHDATA_HASHSEED )
+{
+    unsigned int hash = _hash;
+    for( unsigned int i = 0; i < _size; ++i )
+    {
+        hash ^= _data[i];
+        hash *= 16777619u;
+    }
+    return hash;
+}
+
+
+#endif
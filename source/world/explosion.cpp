@@ -1,6 +1,7 @@
 #include "lib/universal_include.h"
 #include "lib/resource/resource.h"
 #include "lib/resource/image.h"
+#include "lib/tosser/directory.h"
 
 #include "app/app.h"
 #include "app/globals.h"
@@ -82,3 +83,27 @@ void Explosion::Render()
                                     size*2, size*2, colour );
     }      
 }
+
+
+void Explosion::SaveSnapshot( Directory *_dir )
+{
+    WorldObject::SaveSnapshot( _dir );
+
+    _dir->CreateData( "initialIntensity", m_initialIntensity );
+    _dir->CreateData( "intensity", m_intensity );
+    _dir->CreateData( "underWater", m_underWater );
+    _dir->CreateData( "targetTeamId", m_targetTeamId );
+}
+
+
+void Explosion::LoadSnapshot( Directory *_dir )
+{
+    WorldObject::LoadSnapshot( _dir );
+
+    m_initialIntensity = _dir->GetDataFixed( "initialIntensity" );
+    m_intensity = _dir->GetDataFixed( "intensity" );
+    m_underWater = _dir->GetDataBool( "underWater" );
+    m_targetTeamId = _dir->GetDataInt( "targetTeamId" );
+}
+
+
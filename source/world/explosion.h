@@ -21,6 +21,8 @@ public:
 
     bool IsActionable() { return false; }
 
+    void    SaveSnapshot    ( Directory *_dir );
+    void    LoadSnapshot    ( Directory *_dir );
 };
 
 
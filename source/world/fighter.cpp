@@ -5,13 +5,12 @@
 #include "lib/math/vector3.h"
 #include "lib/math/random_number.h"
 #include "lib/language_table.h"
+#include "lib/tosser/directory.h"
 
 #include "app/app.h"
 #include "app/globals.h"
 
-#include "renderer/map_renderer.h"
 
-#include "interface/interface.h"
 
 #include "world/world.h"
 #include "world/fighter.h"
@@ -62,8 +61,7 @@ void Fighter::Action( int targetObjectId, Fixed longitude, Fixed latitude )
     if( m_teamId == g_app->GetWorld()->m_myTeamId &&
         targetObjectId == -1 )
     {
-        g_app->GetMapRenderer()->CreateAnimation( MapRenderer::AnimationTypeActionMarker, m_objectId,
-												  longitude.DoubleValue(), latitude.DoubleValue() );
+        g_app->GetWorld()->GetView()->CreateActionMarker( m_objectId, longitude, latitude );
     }
 
     MovingObject::Action( targetObjectId, longitude, latitude );
@@ -230,14 +228,15 @@ bool Fighter::UsingGuns()
 int Fighter::CountTargettedFighters( int targetId )
 {
     int counter = 0;
+    ObjectStore &store = g_app->GetWorld()->m_objectStore;
     for( int i = 0; i < g_app->GetWorld()->m_objects.Size(); ++i )
     {
-        if( g_app->GetWorld()->m_objects.ValidIndex(i) )
+        if( g_app->GetWorld()->m_objects.ValidIndex(i) &&
+            store.m_type[i] == WorldObject::TypeFighter &&
+            store.m_teamId[i] == m_teamId )
         {
             WorldObject *obj = g_app->GetWorld()->m_objects[i];
-            if( obj->m_type == WorldObject::TypeFighter &&
-                obj->m_teamId == m_teamId &&
-                obj->m_targetObjectId == targetId )
+            if( obj->m_targetObjectId == targetId )
             {
                 counter++;
             }
@@ -270,3 +269,20 @@ bool Fighter::SetWaypointOnAction()
     return true;
 }
 
+
+void Fighter::SaveSnapshot( Directory *_dir )
+{
+    MovingObject::SaveSnapshot( _dir );
+
+    _dir->CreateData( "playerSetWaypoint", m_playerSetWaypoint );
+}
+
+
+void Fighter::LoadSnapshot( Directory *_dir )
+{
+    MovingObject::LoadSnapshot( _dir );
+
+    m_playerSetWaypoint = _dir->GetDataBool( "playerSetWaypoint" );
+}
+
+
@@ -27,6 +27,9 @@ public:
 
     int     IsValidCombatTarget( int _objectId );                                      // returns TargetType...
     bool    SetWaypointOnAction();
+
+    void    SaveSnapshot    ( Directory *_dir );
+    void    LoadSnapshot    ( Directory *_dir );
 };
 
 
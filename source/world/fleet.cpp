@@ -3,6 +3,7 @@
 #include "lib/math/random_number.h"
 #include "lib/math/math_utils.h"
 #include "lib/profiler.h"
+#include "lib/tosser/directory.h"
 
 #include "app/globals.h"
 #include "app/app.h"
@@ -10,13 +11,14 @@
 
 #include "network/ClientToServer.h"
 
-#include "renderer/map_renderer.h"
-
 #include "world/team.h"
 #include "world/world.h"
 #include "world/fleet.h"
 #include "world/blip.h"
 #include "world/nuke.h"
+#include "world/world_snapshot.h"
+
+#include "network/letter_codec.h"
 
 Fleet::Fleet()
 :   m_fleetId(-1),
@@ -224,10 +226,9 @@ void Fleet::Update()
             for( int n = 0; n < g_app->GetWorld()->m_nodes.Size(); ++n )
             {
                 Node *node = g_app->GetWorld()->m_nodes[n];
-                int routeId = node->GetRouteId( m_targetNodeId );
-                if( routeId != -1 )
+                if( node->HasRoute( m_targetNodeId ) )
                 {
-                    Fixed totalDistance = node->m_routeTable[routeId]->m_totalDistance;                    
+                    Fixed totalDistance = node->GetRouteDistance( m_targetNodeId );
 
                     if( totalDistance < currentBestDistance )
                     {
@@ -586,7 +587,7 @@ bool Fleet::IsValidFleetPosition( Fixed longitude, Fixed latitude )
         Fixed thisLat = latitude;
         GetFormationPosition( m_fleetMembers.Size(), i, &thisLong, &thisLat );
 
-	    if( !g_app->GetMapRenderer()->IsValidTerritory( -1, thisLong, thisLat, true ) )
+	    if( !g_app->GetWorld()->IsValidTerritory( -1, thisLong, thisLat, true ) )
         {
             return false;
         }
@@ -788,53 +789,83 @@ void Fleet::RunAISneaking()
 }
 
 
-struct ValidTargetPoint
+AttackSpotThought::AttackSpotThought()
+:   m_pending(false),
+    m_valid(false),
+    m_attackRange(0),
+    m_numIgnored(0)
 {
-    Fixed m_longitude;
-    Fixed m_latitude;
-    Fixed m_sailRange;
-};
+}
 
 
-bool Fleet::FindGoodAttackSpot( Fixed &_longitude, Fixed &_latitude )
+Fixed Fleet::GetAttackRange()
 {
-    START_PROFILE( "FindAttackSpot" );
-
-    LList<ValidTargetPoint> validTargetPoints;
-    
     Fixed attackRange = 60;
     if( IsInFleet(WorldObject::TypeSub) &&
         CountNukesInFleet() > 0 )
     {
         attackRange = 45;
     }
+    return attackRange;
+}
 
-    for( int i = 0; i < g_app->GetWorld()->m_aiTargetPoints.Size(); ++i )
+
+void Fleet::GetAttackSpotCandidates( AISnapshot *_snapshot, Fixed _attackRange,
+                                     LList<ValidTargetPoint> &_points, LList<int> &_ignore )
+{
+    // With a snapshot this reads nothing but it, this fleet and the map,
+    // so that it can run on an AIThink worker.  Without one it reads
+    // the same things straight from the World, on the main thread
+
+    World *world = g_app->GetWorld();
+    bool threadSafe = ( _snapshot != NULL );
+
+    Vector3<Fixed> *enemyCentres;
+    int numEnemyCentres;
+    int numTargetPoints;
+    Vector3<Fixed> ownEnemyCentres[World::NumTerritories];
+
+    if( _snapshot )
+    {
+        _snapshot->GetEnemyCentres( m_teamId, enemyCentres, numEnemyCentres );
+        numTargetPoints = _snapshot->m_numTargetPoints;
+    }
+    else
+    {
+        enemyCentres = ownEnemyCentres;
+        numEnemyCentres = 0;
+        numTargetPoints = world->m_aiTargetPoints.Size();
+
+        for( int j = 0; j < World::NumTerritories; ++j )
+        {
+            int owner = world->GetTerritoryOwner(j);
+            if( owner != -1 &&
+                !world->IsFriend( owner, m_teamId ) )
+            {
+                ownEnemyCentres[numEnemyCentres] = world->m_populationCenter[j];
+                numEnemyCentres++;
+            }
+        }
+    }
+
+    for( int i = 0; i < numTargetPoints; ++i )
     {
         if( !IsIgnoringPoint(i) )
         {
-            Vector3<Fixed> *point = g_app->GetWorld()->m_aiTargetPoints[i];
+            Vector3<Fixed> *point = ( _snapshot ? &_snapshot->m_targetPoints[i] : world->m_aiTargetPoints[i] );
 
             bool inRange = false;            
-            for( int j = 0; j < World::NumTerritories; ++j )
+            for( int j = 0; j < numEnemyCentres; ++j )
             {
-                int owner = g_app->GetWorld()->GetTerritoryOwner(j);
-                if( owner != -1 &&
-                    !g_app->GetWorld()->IsFriend( owner, m_teamId ) )
+                if( world->GetDistanceSqd( point->x, point->y, enemyCentres[j].x, enemyCentres[j].y ) < _attackRange * _attackRange )
                 {
-                    Fixed popCenterLong = g_app->GetWorld()->m_populationCenter[j].x;
-                    Fixed popCenterLat = g_app->GetWorld()->m_populationCenter[j].y;
-
-                    if( g_app->GetWorld()->GetDistanceSqd( point->x, point->y, popCenterLong, popCenterLat ) < attackRange * attackRange )
-                    {
-                        inRange = true;
-                        break;
-                    }
+                    inRange = true;
+                    break;
                 }
             }
             if( inRange )
             {
-                Fixed sailRange = g_app->GetWorld()->GetSailDistance( m_longitude, m_latitude, point->x, point->y );
+                Fixed sailRange = world->GetSailDistance( m_longitude, m_latitude, point->x, point->y, threadSafe );
                 
                 ValidTargetPoint newPoint;
                 newPoint.m_longitude = point->x;
@@ -843,31 +874,105 @@ bool Fleet::FindGoodAttackSpot( Fixed &_longitude, Fixed &_latitude )
 
                 if( sailRange < 5 )
                 {
-                    m_pointIgnoreList.PutData(i);
+                    _ignore.PutData(i);
                 }
                 else
                 {
                     // Ordered insert
 
                     bool added = false;
-                    for( int j = 0; j < validTargetPoints.Size(); ++j )
+                    for( int j = 0; j < _points.Size(); ++j )
                     {
-                        ValidTargetPoint point = *validTargetPoints.GetPointer(j);
+                        ValidTargetPoint point = *_points.GetPointer(j);
                         if( sailRange < point.m_sailRange )
                         {
-                            validTargetPoints.PutDataAtIndex( newPoint, j );
+                            _points.PutDataAtIndex( newPoint, j );
                             added = true;
                             break;
                         }
                     }
                     if( !added )
                     {
-                        validTargetPoints.PutDataAtEnd(newPoint);
+                        _points.PutDataAtEnd(newPoint);
                     }
                 }
             }
         }
     }
+}
+
+
+bool Fleet::PrepareAttackSpotThought()
+{
+    // The conditions under which RunAIHunting and RunAISneaking look for a
+    // spot, as things stand before the AI runs.  A wrong guess only costs time.
+
+    if( m_fleetMembers.Size() == 0 ||
+        g_app->GetWorld()->GetDefcon() > 4 ||
+        m_targetLongitude != 0 ||
+        m_targetLatitude != 0 )
+    {
+        return false;
+    }
+
+    m_attackSpotThought.m_pending = true;
+    m_attackSpotThought.m_longitude = m_longitude;
+    m_attackSpotThought.m_latitude = m_latitude;
+    m_attackSpotThought.m_attackRange = GetAttackRange();
+    m_attackSpotThought.m_numIgnored = m_pointIgnoreList.Size();
+    return true;
+}
+
+
+void Fleet::ThinkAttackSpot( AISnapshot &_snapshot )
+{
+    m_attackSpotThought.m_points.Empty();
+    m_attackSpotThought.m_ignore.Empty();
+
+    GetAttackSpotCandidates( &_snapshot, m_attackSpotThought.m_attackRange,
+                             m_attackSpotThought.m_points, m_attackSpotThought.m_ignore );
+
+    m_attackSpotThought.m_pending = false;
+    m_attackSpotThought.m_valid = true;
+}
+
+
+bool Fleet::FindGoodAttackSpot( Fixed &_longitude, Fixed &_latitude )
+{
+    START_PROFILE( "FindAttackSpot" );
+
+    LList<ValidTargetPoint> validTargetPoints;
+    LList<int> ignore;
+    
+    Fixed attackRange = GetAttackRange();
+
+    AttackSpotThought &thought = m_attackSpotThought;
+    if( thought.m_valid &&
+        thought.m_longitude == m_longitude &&
+        thought.m_latitude == m_latitude &&
+        thought.m_attackRange == attackRange &&
+        thought.m_numIgnored == m_pointIgnoreList.Size() )
+    {
+        for( int i = 0; i < thought.m_points.Size(); ++i )
+        {
+            validTargetPoints.PutDataAtEnd( *thought.m_points.GetPointer(i) );
+        }
+        for( int i = 0; i < thought.m_ignore.Size(); ++i )
+        {
+            ignore.PutDataAtEnd( thought.m_ignore[i] );
+        }
+    }
+    else
+    {
+        GetAttackSpotCandidates( NULL, attackRange, validTargetPoints, ignore );
+    }
+
+    thought.m_valid = false;
+
+    for( int i = 0; i < ignore.Size(); ++i )
+    {
+        m_pointIgnoreList.PutData( ignore[i] );
+    }
 
 
     while(validTargetPoints.Size())
@@ -1527,4 +1632,76 @@ char *Fleet::LogState()
                         m_targetFleet );
 
     return s_buffer;
-}
\ No newline at end of file
+}
+
+
+void Fleet::SaveSnapshot( Directory *_dir )
+{
+    LetterCodec::WriteIntList( _dir, "fleetMembers", &m_fleetMembers );
+    LetterCodec::WriteIntList( _dir, "memberType", &m_memberType );
+    LetterCodec::WriteIntList( _dir, "lastHitByTeamId", &m_lastHitByTeamId );
+    _dir->CreateData( "active", m_active );
+
+    _dir->CreateData( "longitude", m_longitude );
+    _dir->CreateData( "latitude", m_latitude );
+    _dir->CreateData( "targetLongitude", m_targetLongitude );
+    _dir->CreateData( "targetLatitude", m_targetLatitude );
+    _dir->CreateData( "targetNodeId", m_targetNodeId );
+    _dir->CreateData( "pathCheckTimer", m_pathCheckTimer );
+    _dir->CreateData( "crossingSeam", m_crossingSeam );
+    _dir->CreateData( "atTarget", m_atTarget );
+    _dir->CreateData( "speedUpdateTimer", m_speedUpdateTimer );
+
+    _dir->CreateData( "currentState", m_currentState );
+    _dir->CreateData( "holdPosition", m_holdPosition );
+    _dir->CreateData( "fleetType", m_fleetType );
+    _dir->CreateData( "aiState", m_aiState );
+    _dir->CreateData( "defensive", m_defensive );
+    _dir->CreateData( "targetObjectId", m_targetObjectId );
+    _dir->CreateData( "pursueTarget", m_pursueTarget );
+    _dir->CreateData( "targetTeam", m_targetTeam );
+    _dir->CreateData( "targetFleet", m_targetFleet );
+    _dir->CreateData( "subNukesLaunched", m_subNukesLaunched );
+
+    LetterCodec::WriteIntList( _dir, "pointIgnoreList", &m_pointIgnoreList );
+    _dir->CreateData( "niceTryChecked", m_niceTryChecked );
+}
+
+
+void Fleet::LoadSnapshot( Directory *_dir )
+{
+    m_fleetMembers.Empty();
+    m_memberType.Empty();
+    m_lastHitByTeamId.Empty();
+    m_pointIgnoreList.Empty();
+
+    LetterCodec::ReadIntList( _dir, "fleetMembers", &m_fleetMembers );
+    LetterCodec::ReadIntList( _dir, "memberType", &m_memberType );
+    LetterCodec::ReadIntList( _dir, "lastHitByTeamId", &m_lastHitByTeamId );
+    m_active = _dir->GetDataBool( "active" );
+
+    m_longitude = _dir->GetDataFixed( "longitude" );
+    m_latitude = _dir->GetDataFixed( "latitude" );
+    m_targetLongitude = _dir->GetDataFixed( "targetLongitude" );
+    m_targetLatitude = _dir->GetDataFixed( "targetLatitude" );
+    m_targetNodeId = _dir->GetDataInt( "targetNodeId" );
+    m_pathCheckTimer = _dir->GetDataFixed( "pathCheckTimer" );
+    m_crossingSeam = _dir->GetDataBool( "crossingSeam" );
+    m_atTarget = _dir->GetDataBool( "atTarget" );
+    m_speedUpdateTimer = _dir->GetDataFixed( "speedUpdateTimer" );
+
+    m_currentState = _dir->GetDataInt( "currentState" );
+    m_holdPosition = _dir->GetDataBool( "holdPosition" );
+    m_fleetType = _dir->GetDataInt( "fleetType" );
+    m_aiState = _dir->GetDataInt( "aiState" );
+    m_defensive = _dir->GetDataBool( "defensive" );
+    m_targetObjectId = _dir->GetDataInt( "targetObjectId" );
+    m_pursueTarget = _dir->GetDataBool( "pursueTarget" );
+    m_targetTeam = _dir->GetDataInt( "targetTeam" );
+    m_targetFleet = _dir->GetDataInt( "targetFleet" );
+    m_subNukesLaunched = _dir->GetDataInt( "subNukesLaunched" );
+
+    LetterCodec::ReadIntList( _dir, "pointIgnoreList", &m_pointIgnoreList );
+    m_niceTryChecked = _dir->GetDataBool( "niceTryChecked" );
+}
+
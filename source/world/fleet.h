@@ -6,6 +6,43 @@
 #include "lib/render/renderer.h"
 #include "lib/math/fixed.h"
 
+class AISnapshot;
+class Directory;
+
+
+struct ValidTargetPoint
+{
+    Fixed m_longitude;
+    Fixed m_latitude;
+    Fixed m_sailRange;
+};
+
+
+/*
+ *  The target points FindGoodAttackSpot would sort by sailing distance,
+ *  worked out ahead of time by the AI think phase.  Only used if the
+ *  fleet is where it was and its attack range and ignored points are
+ *  the same, so it is exactly what FindGoodAttackSpot would have found.
+ *
+ */
+
+class AttackSpotThought
+{
+public:
+    bool                    m_pending;          // Wanted by the think phase
+    bool                    m_valid;            // Worked out, and not yet used
+    Fixed                   m_longitude;
+    Fixed                   m_latitude;
+    Fixed                   m_attackRange;
+    int                     m_numIgnored;
+    LList<ValidTargetPoint> m_points;           // Nearest first
+    LList<int>              m_ignore;           // Points to add to m_pointIgnoreList
+
+public:
+    AttackSpotThought();
+};
+
+
 class Fleet
 {
 public:
@@ -48,6 +85,7 @@ public:
     LList       <Blip *> m_movementBlips;
 
     LList<int>  m_pointIgnoreList;  // list of nuke points that the fleet should ignore because no targets were found within range
+    AttackSpotThought m_attackSpotThought;
     bool        m_niceTryChecked;
 
     enum
@@ -96,6 +134,11 @@ public:
     bool ValidFleetPlacement        ( Fixed longitude, Fixed latitude );
     bool FindGoodAttackSpotSlow     ( Fixed &_longitude, Fixed &_latitude );
     bool FindGoodAttackSpot         ( Fixed &_longitude, Fixed &_latitude );
+    Fixed GetAttackRange            ();
+    void GetAttackSpotCandidates    ( AISnapshot *_snapshot, Fixed _attackRange,              // NULL to read the World instead
+                                      LList<ValidTargetPoint> &_points, LList<int> &_ignore );
+    bool PrepareAttackSpotThought   ();         // Main thread, true if FindGoodAttackSpot looks likely
+    void ThinkAttackSpot            ( AISnapshot &_snapshot );
     void StopFleet();
 
     void GetFleetPosition( Fixed *longitude, Fixed *latitude );
@@ -132,6 +175,9 @@ public:
     char *LogState();
 
     static void GetFleetMembers( int fleetType, int *ships, int *subs, int *carriers );
+
+    void SaveSnapshot( Directory *_dir );
+    void LoadSnapshot( Directory *_dir );           // Not blips, nor an attack spot thought in progress
 };
 
 #endif
@@ -0,0 +1,90 @@
+#include "lib/universal_include.h"
+
+#include "lib/resource/resource.h"
+#include "lib/resource/image.h"
+
+#include "world/geography.h"
+#include "world/world.h"
+
+
+SonarContact::SonarContact()
+:   m_objectId(-1),
+    m_teamId(-1),
+    m_age(0),
+    m_animationId(-1)
+{
+    m_visible.Initialise( MAX_TEAMS );
+    m_visible.SetAll( false );
+}
+
+
+// ============================================================================
+
+
+Geography::Geography()
+{
+}
+
+
+Geography::~Geography()
+{
+    Clear();
+}
+
+
+void Geography::Clear()
+{
+    m_terrain.Clear();
+    m_seaClearance.Clear();
+    m_sonarPings.EmptyAndDelete();
+}
+
+
+void Geography::Initialise()
+{
+    Clear();
+
+    Image *territories[World::NumTerritories];
+    territories[World::TerritoryNorthAmerica] = g_resource->GetImage( "earth/northamerica.bmp" );
+    territories[World::TerritoryRussia]       = g_resource->GetImage( "earth/russia.bmp" );
+    territories[World::TerritorySouthAsia]    = g_resource->GetImage( "earth/southasia.bmp" );
+    territories[World::TerritorySouthAmerica] = g_resource->GetImage( "earth/southamerica.bmp" );
+    territories[World::TerritoryEurope]       = g_resource->GetImage( "earth/europe.bmp" );
+    territories[World::TerritoryAfrica]       = g_resource->GetImage( "earth/africa.bmp" );
+
+    Image *sailable = g_resource->GetImage( "earth/sailable.bmp" );
+    Image *coastlines = g_resource->GetImage( "earth/coastlines.bmp" );
+
+    m_terrain.Initialise( sailable, coastlines, territories, World::NumTerritories );
+    m_seaClearance.Initialise( sailable );
+}
+
+
+SonarContact *Geography::AddSonarPing( int objectId, int teamId, Fixed const &longitude, Fixed const &latitude )
+{
+    SonarContact *ping = new SonarContact();
+    ping->m_objectId = objectId;
+    ping->m_teamId = teamId;
+    ping->m_longitude = longitude;
+    ping->m_latitude = latitude;
+
+    m_sonarPings.PutData( ping );
+    return ping;
+}
+
+
+void Geography::AdvanceSonarPings()
+{
+    for( int i = 0; i < m_sonarPings.Size(); ++i )
+    {
+        SonarContact *ping = m_sonarPings[i];
+        ++ping->m_age;
+
+        if( ping->m_age > SONARPING_LIFETIME )
+        {
+            m_sonarPings.RemoveData(i);
+            delete ping;
+            --i;
+        }
+    }
+}
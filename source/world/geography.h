@@ -0,0 +1,68 @@
+#ifndef _included_geography_h
+#define _included_geography_h
+
+#include "lib/tosser/llist.h"
+#include "lib/tosser/bounded_array.h"
+#include "lib/math/fixed.h"
+
+#include "world/terrain_map.h"
+#include "world/land_distance_field.h"
+
+
+#define SONARPING_LIFETIME      10                  // Radar updates a ping stays in the list
+
+
+/*
+ *  A sonar ping made by a unit, with the teams able to see it.
+ *  The MapRenderer turns new pings into animations, which follow
+ *  the visibility the radar works out for as long as the ping lasts.
+ *
+ */
+
+class SonarContact
+{
+public:
+    int     m_objectId;
+    int     m_teamId;
+    Fixed   m_longitude;
+    Fixed   m_latitude;
+    int     m_age;
+    int     m_animationId;                          // The MapRenderer's animation of it, -1 until picked up
+
+    BoundedArray<bool> m_visible;
+
+public:
+    SonarContact();
+};
+
+
+// ============================================================================
+
+
+/*
+ *  Everything the simulation needs to know about the map,
+ *  built from the earth bitmaps at the start of each game
+ *  so the World's map queries don't go through the MapRenderer.
+ *
+ */
+
+class Geography
+{
+public:
+    TerrainMap              m_terrain;
+    LandDistanceField       m_seaClearance;         // Distance to land over sailable.bmp, for World::IsSailable
+    LList<SonarContact *>   m_sonarPings;
+
+public:
+    Geography();
+    ~Geography();
+
+    void    Initialise          ();
+    void    Clear               ();
+
+    SonarContact *AddSonarPing  ( int objectId, int teamId, Fixed const &longitude, Fixed const &latitude );
+    void    AdvanceSonarPings   ();                 // Ages pings and removes old ones
+};
+
+
+#endif
@@ -8,11 +8,11 @@
 #include "lib/math/vector3.h"
 #include "lib/math/random_number.h"
 #include "lib/math/math_utils.h"
+#include "lib/tosser/directory.h"
  
 #include "app/app.h"
 #include "app/globals.h"
 
-#include "renderer/map_renderer.h"
 
 #include "world/world.h"
 #include "world/gunfire.h"
@@ -83,9 +83,9 @@ void GunFire::Render()
     float predictedLongitude = (m_longitude + m_vel.x * Fixed(predictionTime)).DoubleValue();
     float predictedLatitude = (m_latitude + m_vel.y * Fixed(predictionTime)).DoubleValue(); 
     float size = 2;
-    if( g_app->GetMapRenderer()->GetZoomFactor() <= 0.25f )
+    if( g_app->GetWorld()->GetView()->GetZoomFactor() <= 0.25f )
     {
-        size *= g_app->GetMapRenderer()->GetZoomFactor() * 4;
+        size *= g_app->GetWorld()->GetView()->GetZoomFactor() * 4;
     }
     float angle = atan( -m_vel.x.DoubleValue() / m_vel.y.DoubleValue() );
     if( m_vel.y < 0 ) angle += M_PI;
@@ -251,3 +251,27 @@ void GunFire::Impact()
         targetObject->Retaliate( m_origin );
     }
 }
+
+
+void GunFire::SaveSnapshot( Directory *_dir )
+{
+    MovingObject::SaveSnapshot( _dir );
+
+    _dir->CreateData( "origin", m_origin );
+    _dir->CreateData( "killShot", m_killShot );
+    _dir->CreateData( "attackOdds", m_attackOdds );
+    _dir->CreateData( "distanceToTarget", m_distanceToTarget );
+}
+
+
+void GunFire::LoadSnapshot( Directory *_dir )
+{
+    MovingObject::LoadSnapshot( _dir );
+
+    m_origin = _dir->GetDataInt( "origin" );
+    m_killShot = _dir->GetDataBool( "killShot" );
+    m_attackOdds = _dir->GetDataFixed( "attackOdds" );
+    m_distanceToTarget = _dir->GetDataFixed( "distanceToTarget" );
+}
+
+
@@ -22,6 +22,9 @@ public:
     virtual void    Impact          ();
     bool            MoveToWaypoint  ();
     void            CalculateNewPosition( Fixed *newLongitude,Fixed *newLatitude, Fixed *newDistance );
+
+    void    SaveSnapshot    ( Directory *_dir );
+    void    LoadSnapshot    ( Directory *_dir );
 }; 
 
 
@@ -0,0 +1,148 @@
+#include "lib/universal_include.h"
+
+#include "lib/resource/image.h"
+#include "lib/render/colour.h"
+#include "lib/math/math_utils.h"
+
+#include "world/land_distance_field.h"
+
+
+LandDistanceField::LandDistanceField()
+:   m_width(0),
+    m_height(0),
+    m_distance(NULL)
+{
+}
+
+
+LandDistanceField::~LandDistanceField()
+{
+    Clear();
+}
+
+
+void LandDistanceField::Clear()
+{
+    delete [] m_distance;
+    m_distance = NULL;
+    m_width = 0;
+    m_height = 0;
+}
+
+
+bool LandDistanceField::IsInitialised()
+{
+    return( m_distance != NULL );
+}
+
+
+void LandDistanceField::Initialise( Image *_sailable )
+{
+    Clear();
+
+    m_width = _sailable->Width();
+    m_height = _sailable->Height();
+
+    int *distance = new int[ m_width * m_height ];
+
+    //
+    // Water uses the same test as TerrainMap::IsSailable
+
+    for( int y = 0; y < m_height; ++y )
+    {
+        for( int x = 0; x < m_width; ++x )
+        {
+            Colour col = _sailable->GetColour( x, y );
+            bool water = ( col.m_r > 20 && col.m_g > 20 && col.m_b > 20 );
+            distance[ y * m_width + x ] = water ? 255 : 0;
+        }
+    }
+
+    //
+    // Two pass chamfer transform with unit diagonal steps gives the exact
+    // Chebyshev distance.  Anything off the map counts as land.
+
+    for( int y = 0; y < m_height; ++y )
+    {
+        for( int x = 0; x < m_width; ++x )
+        {
+            int &d = distance[ y * m_width + x ];
+            if( d == 0 ) continue;
+
+            int left     = ( x > 0 ) ? distance[ y * m_width + x - 1 ] : 0;
+            int upLeft   = ( x > 0 && y > 0 ) ? distance[ (y-1) * m_width + x - 1 ] : 0;
+            int up       = ( y > 0 ) ? distance[ (y-1) * m_width + x ] : 0;
+            int upRight  = ( x < m_width-1 && y > 0 ) ? distance[ (y-1) * m_width + x + 1 ] : 0;
+
+            d = min( d, left + 1 );
+            d = min( d, upLeft + 1 );
+            d = min( d, up + 1 );
+            d = min( d, upRight + 1 );
+        }
+    }
+
+    for( int y = m_height-1; y >= 0; --y )
+    {
+        for( int x = m_width-1; x >= 0; --x )
+        {
+            int &d = distance[ y * m_width + x ];
+            if( d == 0 ) continue;
+
+            int right     = ( x < m_width-1 ) ? distance[ y * m_width + x + 1 ] : 0;
+            int downRight = ( x < m_width-1 && y < m_height-1 ) ? distance[ (y+1) * m_width + x + 1 ] : 0;
+            int down      = ( y < m_height-1 ) ? distance[ (y+1) * m_width + x ] : 0;
+            int downLeft  = ( x > 0 && y < m_height-1 ) ? distance[ (y+1) * m_width + x - 1 ] : 0;
+
+            d = min( d, right + 1 );
+            d = min( d, downRight + 1 );
+            d = min( d, down + 1 );
+            d = min( d, downLeft + 1 );
+        }
+    }
+
+    m_distance = new unsigned char[ m_width * m_height ];
+    for( int i = 0; i < m_width * m_height; ++i )
+    {
+        m_distance[i] = (unsigned char) min( distance[i], 255 );
+    }
+
+    delete [] distance;
+}
+
+
+int LandDistanceField::GetDistance( Fixed const &_longitude, Fixed const &_latitude )
+{
+    if( !m_distance ) return -1;
+
+    if( _latitude > 100 || _latitude < -100 ||
+        _longitude > 180 || _longitude < -180 )
+    {
+        return -1;
+    }
+
+    //
+    // Must map to exactly the pixel TerrainMap::IsSailable samples
+
+    int pixelX = ( m_width * (_longitude+180)/360 ).IntValue();
+    int pixelY = ( m_height * (_latitude+100)/200 ).IntValue();
+
+    if( pixelX < 0 || pixelX >= m_width ||
+        pixelY < 0 || pixelY >= m_height )
+    {
+        return -1;
+    }
+
+    return m_distance[ pixelY * m_width + pixelX ];
+}
+
+
+double LandDistanceField::GetPixelsPerDegreeX()
+{
+    return m_width / 360.0;
+}
+
+
+double LandDistanceField::GetPixelsPerDegreeY()
+{
+    return m_height / 200.0;
+}
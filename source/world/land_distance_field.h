@@ -0,0 +1,38 @@
+#ifndef _included_landdistancefield_h
+#define _included_landdistancefield_h
+
+#include "lib/math/fixed.h"
+
+class Image;
+
+
+/*
+ *  For every pixel of sailable.bmp, the Chebyshev distance in pixels
+ *  to the nearest land pixel (or the edge of the map).  0 means land.
+ *  Lets IsSailable skip over open water without sampling every step,
+ *  while still giving exactly the same answer as sampling.
+ *
+ */
+
+class LandDistanceField
+{
+protected:
+    int             m_width;
+    int             m_height;
+    unsigned char   *m_distance;                // m_width * m_height, capped at 255
+
+public:
+    LandDistanceField();
+    ~LandDistanceField();
+
+    void    Initialise      ( Image *_sailable );
+    void    Clear           ();
+    bool    IsInitialised   ();
+
+    int     GetDistance     ( Fixed const &_longitude, Fixed const &_latitude );     // -1 if off the map
+    double  GetPixelsPerDegreeX();
+    double  GetPixelsPerDegreeY();
+};
+
+
+#endif
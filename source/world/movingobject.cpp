@@ -6,19 +6,17 @@
 #include "lib/resource/image.h"
 #include "lib/math/math_utils.h"
 #include "lib/math/random_number.h"
-#include "lib/sound/soundsystem.h"
 #include "lib/preferences.h"
 #include "lib/gucci/input.h"
+#include "lib/tosser/directory.h"
 
 #include "app/globals.h"
 #include "app/app.h"
 #include "app/game.h"
 
-#include "renderer/map_renderer.h"
 
 #include "network/ClientToServer.h"
 
-#include "interface/interface.h"
 
 #include "world/world.h"
 #include "world/movingobject.h"
@@ -163,8 +161,8 @@ bool MovingObject::IsValidPosition ( Fixed longitude, Fixed latitude )
 {
     bool validWaypoint = false;
 
-    if( m_movementType == MovementTypeLand && !g_app->GetMapRenderer()->IsValidTerritory( -1, longitude, latitude, false ) ) validWaypoint = true;
-    if( m_movementType == MovementTypeSea && g_app->GetMapRenderer()->IsValidTerritory( -1, longitude, latitude, true ) ) validWaypoint = true;
+    if( m_movementType == MovementTypeLand && !g_app->GetWorld()->IsValidTerritory( -1, longitude, latitude, false ) ) validWaypoint = true;
+    if( m_movementType == MovementTypeSea && g_app->GetWorld()->IsValidTerritory( -1, longitude, latitude, true ) ) validWaypoint = true;
     if( m_movementType == MovementTypeAir ) validWaypoint = true;
 
     return validWaypoint;
@@ -541,12 +539,12 @@ void MovingObject::Render()
         // Current selection?
 
         colour.Set(255,255,255,255);
-        int selectionId = g_app->GetMapRenderer()->GetCurrentSelectionId();
+        int selectionId = g_app->GetWorld()->GetView()->GetCurrentSelectionId();
         for( int i = 0; i < 2; ++i )
         {
             if( i == 1 ) 
             {            
-                int highlightId = g_app->GetMapRenderer()->GetCurrentHighlightId();
+                int highlightId = g_app->GetWorld()->GetView()->GetCurrentHighlightId();
                 if( highlightId == selectionId ) break;
                 selectionId = highlightId;
             }
@@ -580,7 +578,7 @@ void MovingObject::RenderHistory()
 
     int maxSize = m_history.Size();
     
-    int sizeCap = (int)(80 * g_app->GetMapRenderer()->GetZoomFactor() );
+    int sizeCap = (int)(80 * g_app->GetWorld()->GetView()->GetZoomFactor() );
     sizeCap /= World::GetGameScale().DoubleValue();
 
     if( g_app->GetGame()->GetOptionValue("GameMode") == GAMEMODE_BIGWORLD )
@@ -588,8 +586,8 @@ void MovingObject::RenderHistory()
         switch( m_type )
         {
             case TypeNuke:
-                sizeCap = 12 * g_app->GetMapRenderer()->GetZoomFactor();
-                if( g_app->GetMapRenderer()->GetZoomFactor() < 0.25f )
+                sizeCap = 12 * g_app->GetWorld()->GetView()->GetZoomFactor();
+                if( g_app->GetWorld()->GetView()->GetZoomFactor() < 0.25f )
                 {
                     return;
                 }
@@ -786,8 +784,10 @@ void MovingObject::AutoLand()
 
 int MovingObject::GetClosestLandingPad()
 {
-    int nearestId = -1;
-    int nearestWithNukesId = -1;
+    World *world = g_app->GetWorld();
+
+    int nearestIndex = -1;
+    int nearestWithNukesIndex = -1;
 
     Fixed nearestSqd = Fixed::MAX;
     Fixed nearestWithNukesSqd = Fixed::MAX;
@@ -795,12 +795,24 @@ int MovingObject::GetClosestLandingPad()
     //
     // Look for any carrier or airbase with room
     // Favour objects with nukes if we are a bomber
+    // Ties go to the earlier slot, as they would in a scan of m_objects
+
+    ObjectGridQuery query( &world->m_objectGrid, m_longitude, m_latitude );
 
-    for( int i = 0; i < g_app->GetWorld()->m_objects.Size(); ++i )
+    while( true )
     {
-        if( g_app->GetWorld()->m_objects.ValidIndex(i) )
+        Fixed threshold = query.GetThreshold();
+        bool nearestFound = ( nearestIndex != -1 && nearestSqd < threshold );
+        bool nearestWithNukesFound = ( m_type != TypeBomber ||
+                                       ( nearestWithNukesIndex != -1 && nearestWithNukesSqd < threshold ) );
+        if( nearestFound && nearestWithNukesFound ) break;
+
+        int i = query.GetNext();
+        if( i == -1 ) break;
+
+        if( world->m_objects.ValidIndex(i) )
         {
-            WorldObject *obj = g_app->GetWorld()->m_objects[i];
+            WorldObject *obj = world->m_objects[i];
             if( obj->m_teamId == m_teamId )
             {
                 if( obj->m_type == WorldObject::TypeCarrier ||
@@ -812,19 +824,21 @@ int MovingObject::GetClosestLandingPad()
 
                     if( roomInside > 0 )
                     {
-                        Fixed distSqd = g_app->GetWorld()->GetDistanceSqd( m_longitude, m_latitude, obj->m_longitude, obj->m_latitude );
-                        if( distSqd < nearestSqd )
+                        Fixed distSqd = world->GetDistanceSqd( m_longitude, m_latitude, obj->m_longitude, obj->m_latitude );
+                        if( distSqd < nearestSqd ||
+                            ( distSqd == nearestSqd && i < nearestIndex ) )
                         {
                             nearestSqd = distSqd;
-                            nearestId = obj->m_objectId;
+                            nearestIndex = i;
                         }
 
                         if( m_type == TypeBomber && 
                             obj->m_nukeSupply > 0 &&
-                            distSqd < nearestWithNukesSqd )
+                            ( distSqd < nearestWithNukesSqd ||
+                              ( distSqd == nearestWithNukesSqd && i < nearestWithNukesIndex ) ) )
                         {
                             nearestWithNukesSqd = distSqd;
-                            nearestId = obj->m_objectId;
+                            nearestWithNukesIndex = i;
                         }
                     }
                 }
@@ -836,28 +850,21 @@ int MovingObject::GetClosestLandingPad()
     // Fighter - go for nearest landing pad
 
     if( m_type == TypeFighter && 
-        nearestId != -1 )
+        nearestIndex != -1 )
     {
-        return nearestId;
+        return world->m_objects[nearestIndex]->m_objectId;
     }
 
     //
-    // Bomber - go for nearest with nukes if in range
-
-    if( m_type == TypeBomber && 
-        nearestWithNukesId != -1 &&
-        nearestWithNukesSqd < m_range * m_range )
-    {
-        return nearestWithNukesId;
-    }
-
-    //
-    // Bomber - no nukes within range, so go for nearest
+    // Bomber - the scan through m_objects this replaces settled on whichever
+    // of the nearest pad and the nearest pad with nukes it came to last.
+    // Every client has to agree, so that choice is kept
 
     if( m_type == TypeBomber &&
-        nearestId != -1 )
+        nearestIndex != -1 )
     {
-        return nearestId;
+        int index = max( nearestIndex, nearestWithNukesIndex );
+        return world->m_objects[index]->m_objectId;
     }
 
 
@@ -984,26 +991,19 @@ void MovingObject::Retaliate( int attackerId )
 
 void MovingObject::Ping()
 {   
-    int animId = g_app->GetMapRenderer()->CreateAnimation( MapRenderer::AnimationTypeSonarPing, m_objectId,
-														   m_longitude.DoubleValue(), m_latitude.DoubleValue() );
-    AnimatedIcon *icon = g_app->GetMapRenderer()->m_animations[animId];
-    ((SonarPing *)icon)->m_teamId = m_teamId;
-    
-    if( g_app->GetWorld()->m_myTeamId == -1 ||
-        g_app->GetWorld()->m_myTeamId == m_teamId ||
-        g_app->GetMapRenderer()->m_renderEverything ||
-        g_app->GetWorld()->IsVisible( m_longitude, m_latitude, g_app->GetWorld()->m_myTeamId) )
-    {
-        g_soundSystem->TriggerEvent( SoundObjectId(m_objectId), "SonarPing" );
-    }
-    
+    g_app->GetWorld()->CreateSonarPing( m_objectId, m_teamId, m_longitude, m_latitude );
+
 
     Fleet *fleet = g_app->GetWorld()->GetTeam( m_teamId )->GetFleet( m_fleetId );
     if( fleet == NULL ||
         fleet->m_currentState == Fleet::FleetStateAggressive )
     {
-        for( int i = 0; i < g_app->GetWorld()->m_objects.Size(); ++i )
+        LList<int> nearby;
+        g_app->GetWorld()->m_objectGrid.GetNearbySlots( m_longitude, m_latitude, GetActionRange(), nearby );
+
+        for( int n = 0; n < nearby.Size(); ++n )
         {
+            int i = nearby[n];
             if( g_app->GetWorld()->m_objects.ValidIndex(i) )
             {
                 MovingObject *obj = (MovingObject *)g_app->GetWorld()->m_objects[i];
@@ -1082,8 +1082,16 @@ int MovingObject::GetTarget( Fixed range )
 {
     LList<int> farTargets;
     LList<int> closeTargets;
-    for( int i = 0; i < g_app->GetWorld()->m_objects.Size(); ++i )
+
+    Fixed radius = GetActionRange().abs();
+    if( range.abs() > radius ) radius = range.abs();
+
+    LList<int> nearby;
+    g_app->GetWorld()->m_objectGrid.GetNearbySlots( m_longitude, m_latitude, radius, nearby );
+
+    for( int n = 0; n < nearby.Size(); ++n )
     {
+        int i = nearby[n];
         if( g_app->GetWorld()->m_objects.ValidIndex(i) )
         {
             WorldObject *obj = g_app->GetWorld()->m_objects[i];
@@ -1177,3 +1185,50 @@ char *MovingObject::LogState()
     return s_result;
 }
 
+
+void MovingObject::SaveSnapshot( Directory *_dir )
+{
+    WorldObject::SaveSnapshot( _dir );
+
+    _dir->CreateData( "speed", m_speed );
+    _dir->CreateData( "turnRate", m_turnRate );
+    _dir->CreateData( "movementType", m_movementType );
+    _dir->CreateData( "targetLongitude", m_targetLongitude );
+    _dir->CreateData( "targetLatitude", m_targetLatitude );
+    _dir->CreateData( "range", m_range );
+    _dir->CreateData( "finalTargetLongitude", m_finalTargetLongitude );
+    _dir->CreateData( "finalTargetLatitude", m_finalTargetLatitude );
+    _dir->CreateData( "targetNodeId", m_targetNodeId );
+    _dir->CreateData( "targetLongitudeAcrossSeam", m_targetLongitudeAcrossSeam );
+    _dir->CreateData( "targetLatitudeAcrossSeam", m_targetLatitudeAcrossSeam );
+    _dir->CreateData( "pathCalcTimer", m_pathCalcTimer );
+    _dir->CreateData( "blockHistory", m_blockHistory );
+    _dir->CreateData( "isLanding", m_isLanding );
+    _dir->CreateData( "turning", m_turning );
+    _dir->CreateData( "angleTurned", m_angleTurned );
+}
+
+
+void MovingObject::LoadSnapshot( Directory *_dir )
+{
+    WorldObject::LoadSnapshot( _dir );
+
+    m_speed = _dir->GetDataFixed( "speed" );
+    m_turnRate = _dir->GetDataFixed( "turnRate" );
+    m_movementType = _dir->GetDataInt( "movementType" );
+    m_targetLongitude = _dir->GetDataFixed( "targetLongitude" );
+    m_targetLatitude = _dir->GetDataFixed( "targetLatitude" );
+    m_range = _dir->GetDataFixed( "range" );
+    m_finalTargetLongitude = _dir->GetDataFixed( "finalTargetLongitude" );
+    m_finalTargetLatitude = _dir->GetDataFixed( "finalTargetLatitude" );
+    m_targetNodeId = _dir->GetDataInt( "targetNodeId" );
+    m_targetLongitudeAcrossSeam = _dir->GetDataFixed( "targetLongitudeAcrossSeam" );
+    m_targetLatitudeAcrossSeam = _dir->GetDataFixed( "targetLatitudeAcrossSeam" );
+    m_pathCalcTimer = _dir->GetDataFixed( "pathCalcTimer" );
+    m_blockHistory = _dir->GetDataBool( "blockHistory" );
+    m_isLanding = _dir->GetDataInt( "isLanding" );
+    m_turning = _dir->GetDataBool( "turning" );
+    m_angleTurned = _dir->GetDataFixed( "angleTurned" );
+}
+
+
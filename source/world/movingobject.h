@@ -81,6 +81,9 @@ public:
     char            *LogState();
 
     virtual int     GetTarget( Fixed range );
+
+    void    SaveSnapshot    ( Directory *_dir );
+    void    LoadSnapshot    ( Directory *_dir );
 };
 
 /*
@@ -10,10 +10,8 @@
 
 #include "world/node.h"
 #include "world/world.h"
+#include "world/route_table.h"
 
-#include "interface/interface.h"
-
-#include "renderer/map_renderer.h"
 
 
 Node::Node()
@@ -22,42 +20,21 @@ Node::Node()
     
 }
 
-void Node::AddRoute( int targetNodeId, int nextNodeId, Fixed distance )
+bool Node::HasRoute( int targetNodeId )
+{
+    RouteTable &routes = g_app->GetWorld()->m_nodeRoutes;
+
+    return( targetNodeId >= 0 && 
+            targetNodeId < routes.Size() &&
+            routes.GetNextNode( m_objectId, targetNodeId ) != -1 );
+}
+
+int Node::GetNextNodeId( int targetNodeId )
 {
-    // Do we already have a quicker route to this node?
-    for( int i = 0; i < m_routeTable.Size(); ++i )
-    {
-        if( m_routeTable[i]->m_targetNodeId == targetNodeId &&
-            m_routeTable[i]->m_totalDistance <= distance )
-        {
-            // We already have a quicker or identical route
-            return;
-        }
-    }
-
-    int routeId = GetRouteId( targetNodeId );
-    if( routeId != -1 )
-    {
-        Route *oldRoute = m_routeTable[routeId];
-        m_routeTable.RemoveData(routeId);
-        delete oldRoute;
-    }
-
-    Route *newRoute = new Route;
-    newRoute->m_nextNodeId = nextNodeId;
-    newRoute->m_targetNodeId = targetNodeId;
-    newRoute->m_totalDistance = distance;
-    m_routeTable.PutData( newRoute );
+    return g_app->GetWorld()->m_nodeRoutes.GetNextNode( m_objectId, targetNodeId );
 }
 
-int Node::GetRouteId( int targetNodeId )
+Fixed Node::GetRouteDistance( int targetNodeId )
 {
-    for( int i = 0; i < m_routeTable.Size(); ++i )
-    {
-        if( m_routeTable[i]->m_targetNodeId == targetNodeId )
-        {
-            return i;
-        }
-    }
-    return -1;
+    return g_app->GetWorld()->m_nodeRoutes.GetDistance( m_objectId, targetNodeId );
 }
@@ -4,28 +4,18 @@
 
 #include "world/worldobject.h"
 
-struct Route;
 
 class Node : public WorldObject
 {
-
-public:
-    LList<Route *>    m_routeTable;
-
 public:
     
     Node();
-    void AddRoute(int targetNodeId, int nextNode, Fixed distance);
-    int  GetRouteId( int targetNodeId );
 
+    bool  HasRoute          ( int targetNodeId );
+    int   GetNextNodeId     ( int targetNodeId );               // Where to go first to reach the ultimate target
+    Fixed GetRouteDistance  ( int targetNodeId );               // Total sailing distance to the ultimate target
     
 };
 
-struct Route
-{
-    int m_targetNodeId;            // The ultimate target
-    int m_nextNodeId;             // Where to go first to reach the ultimate target
-    Fixed m_totalDistance;
-};
 
 #endif
@@ -0,0 +1,349 @@
+#include "lib/universal_include.h"
+
+#include <string.h>
+
+#include "lib/debug_utils.h"
+
+#include "app/app.h"
+#include "app/globals.h"
+
+#include "world/node_grid.h"
+#include "world/node.h"
+#include "world/world.h"
+
+
+NodeGrid::NodeGrid()
+:   m_numNodes(0),
+    m_longitude(NULL),
+    m_latitude(NULL),
+    m_cellStart(NULL),
+    m_cellNodes(NULL)
+{
+    memset( m_cache, 0, sizeof(m_cache) );
+}
+
+
+NodeGrid::~NodeGrid()
+{
+    Clear();
+}
+
+
+void NodeGrid::Clear()
+{
+    delete [] m_longitude;
+    delete [] m_latitude;
+    delete [] m_cellStart;
+    delete [] m_cellNodes;
+    m_longitude = NULL;
+    m_latitude = NULL;
+    m_cellStart = NULL;
+    m_cellNodes = NULL;
+    m_numNodes = 0;
+
+    memset( m_cache, 0, sizeof(m_cache) );
+}
+
+
+void NodeGrid::Initialise( LList<Node *> &_nodes )
+{
+    Clear();
+
+    int numCells = NODEGRID_COLUMNS * NODEGRID_ROWS;
+    m_numNodes = _nodes.Size();
+    m_longitude = new Fixed[ m_numNodes ];
+    m_latitude = new Fixed[ m_numNodes ];
+    m_cellStart = new int[ numCells + 1 ];
+    m_cellNodes = new int[ m_numNodes ];
+
+    int *nodeCell = new int[ m_numNodes ];
+
+    for( int i = 0; i <= numCells; ++i )
+    {
+        m_cellStart[i] = 0;
+    }
+
+    for( int i = 0; i < m_numNodes; ++i )
+    {
+        m_longitude[i] = _nodes[i]->m_longitude;
+        m_latitude[i] = _nodes[i]->m_latitude;
+
+        int x, y;
+        GetCell( m_longitude[i], m_latitude[i], x, y );
+        nodeCell[i] = y * NODEGRID_COLUMNS + x;
+        m_cellStart[ nodeCell[i] + 1 ]++;
+    }
+
+    for( int i = 0; i < numCells; ++i )
+    {
+        m_cellStart[i+1] += m_cellStart[i];
+    }
+
+    // Fill each cell in ascending node order
+
+    int *fill = new int[ numCells ];
+    for( int i = 0; i < numCells; ++i )
+    {
+        fill[i] = m_cellStart[i];
+    }
+
+    for( int i = 0; i < m_numNodes; ++i )
+    {
+        m_cellNodes[ fill[nodeCell[i]]++ ] = i;
+    }
+
+    delete [] fill;
+    delete [] nodeCell;
+}
+
+
+int NodeGrid::NumNodes()
+{
+    return m_numNodes;
+}
+
+
+void NodeGrid::GetCell( Fixed _longitude, Fixed _latitude, int &_x, int &_y )
+{
+    while( _longitude >= 180 )  _longitude -= 360;
+    while( _longitude < -180 )  _longitude += 360;
+
+    _x = ( (_longitude + 180) / NODEGRID_CELLSIZE ).IntValue();
+    _y = ( (_latitude + 100) / NODEGRID_CELLSIZE ).IntValue();
+
+    _x = max( _x, 0 );
+    _y = max( _y, 0 );
+    _x = min( _x, NODEGRID_COLUMNS - 1 );
+    _y = min( _y, NODEGRID_ROWS - 1 );
+}
+
+
+void NodeGrid::GetCellNodes( int _x, int _y, int *&_nodes, int &_numNodes )
+{
+    if( !m_cellStart )
+    {
+        // Not initialised yet, ie there are no travel nodes
+        _nodes = NULL;
+        _numNodes = 0;
+        return;
+    }
+
+    int cell = _y * NODEGRID_COLUMNS + _x;
+    _nodes = m_cellNodes + m_cellStart[cell];
+    _numNodes = m_cellStart[cell+1] - m_cellStart[cell];
+}
+
+
+static int GetCacheIndex( UInt64 _longitude, UInt64 _latitude, int _timeScaleFactor )
+{
+    UInt64 hash = _longitude * 31 + _latitude;
+    hash ^= ( hash >> 29 ) ^ ( hash >> 41 ) ^ (UInt64) _timeScaleFactor;
+    return (int)( hash & (NODEGRID_CACHESIZE - 1) );
+}
+
+
+bool NodeGrid::LookupCache( Fixed const &_longitude, Fixed const &_latitude, int _timeScaleFactor, int &_nodeId )
+{
+    // Keyed on the exact bit patterns, so a cached answer is always
+    // the one a fresh search would have produced
+
+    UInt64 longitude = _longitude.InternalValue();
+    UInt64 latitude = _latitude.InternalValue();
+
+    CacheEntry &entry = m_cache[ GetCacheIndex( longitude, latitude, _timeScaleFactor ) ];
+    if( entry.m_used &&
+        entry.m_longitude == longitude &&
+        entry.m_latitude == latitude &&
+        entry.m_timeScaleFactor == _timeScaleFactor )
+    {
+        _nodeId = entry.m_nodeId;
+        return true;
+    }
+
+    return false;
+}
+
+
+void NodeGrid::UpdateCache( Fixed const &_longitude, Fixed const &_latitude, int _timeScaleFactor, int _nodeId )
+{
+    UInt64 longitude = _longitude.InternalValue();
+    UInt64 latitude = _latitude.InternalValue();
+
+    CacheEntry &entry = m_cache[ GetCacheIndex( longitude, latitude, _timeScaleFactor ) ];
+    entry.m_longitude = longitude;
+    entry.m_latitude = latitude;
+    entry.m_timeScaleFactor = _timeScaleFactor;
+    entry.m_nodeId = _nodeId;
+    entry.m_used = true;
+}
+
+
+// ============================================================================
+
+
+NodeGridQuery::NodeGridQuery( NodeGrid *_grid, Fixed const &_longitude, Fixed const &_latitude )
+:   m_grid(_grid),
+    m_longitude(_longitude),
+    m_latitude(_latitude),
+    m_ring(0),
+    m_threshold(0),
+    m_candidates(m_localCandidates),
+    m_numCandidates(0),
+    m_maxCandidates(32),
+    m_nextCandidate(0)
+{
+    m_grid->GetCell( _longitude, _latitude, m_cellX, m_cellY );
+}
+
+
+NodeGridQuery::~NodeGridQuery()
+{
+    if( m_candidates != m_localCandidates )
+    {
+        delete [] m_candidates;
+    }
+}
+
+
+void NodeGridQuery::AddCandidate( int _nodeId )
+{
+    if( m_numCandidates == m_maxCandidates )
+    {
+        Candidate *candidates = new Candidate[ m_maxCandidates * 2 ];
+        for( int i = 0; i < m_numCandidates; ++i )
+        {
+            candidates[i] = m_candidates[i];
+        }
+        if( m_candidates != m_localCandidates ) delete [] m_candidates;
+        m_candidates = candidates;
+        m_maxCandidates *= 2;
+    }
+
+    Fixed distanceSqd = g_app->GetWorld()->GetDistanceSqd( m_longitude, m_latitude, 
+                                                           m_grid->GetLongitude(_nodeId), m_grid->GetLatitude(_nodeId) );
+
+
+    //
+    // Insertion sort into the candidates still waiting to be returned
+
+    int index = m_numCandidates;
+    while( index > m_nextCandidate )
+    {
+        Candidate &previous = m_candidates[index-1];
+        if( previous.m_distanceSqd < distanceSqd ||
+            ( previous.m_distanceSqd == distanceSqd && previous.m_nodeId < _nodeId ) )
+        {
+            break;
+        }
+        m_candidates[index] = previous;
+        --index;
+    }
+
+    m_candidates[index].m_nodeId = _nodeId;
+    m_candidates[index].m_distanceSqd = distanceSqd;
+    ++m_numCandidates;
+}
+
+
+void NodeGridQuery::AddCell( int _x, int _y )
+{
+    int *nodes;
+    int numNodes;
+    m_grid->GetCellNodes( _x, _y, nodes, numNodes );
+
+    for( int i = 0; i < numNodes; ++i )
+    {
+        AddCandidate( nodes[i] );
+    }
+}
+
+
+void NodeGridQuery::ScanRing()
+{
+    int ring = m_ring;
+    ++m_ring;
+
+    if( ring == 0 )
+    {
+        AddCell( m_cellX, m_cellY );
+    }
+    else
+    {
+        for( int y = m_cellY - ring; y <= m_cellY + ring; ++y )
+        {
+            if( y < 0 || y >= NODEGRID_ROWS ) continue;
+
+            if( y == m_cellY - ring || y == m_cellY + ring )
+            {
+                // Top and bottom rows of the ring, every column within range
+
+                if( ring * 2 + 1 >= NODEGRID_COLUMNS )
+                {
+                    for( int x = 0; x < NODEGRID_COLUMNS; ++x )
+                    {
+                        AddCell( x, y );
+                    }
+                }
+                else
+                {
+                    for( int x = m_cellX - ring; x <= m_cellX + ring; ++x )
+                    {
+                        AddCell( (x + NODEGRID_COLUMNS) % NODEGRID_COLUMNS, y );
+                    }
+                }
+            }
+            else
+            {
+                // Left and right columns of the ring, wrapping around the seam
+
+                if( ring * 2 < NODEGRID_COLUMNS )
+                {
+                    AddCell( (m_cellX - ring + NODEGRID_COLUMNS) % NODEGRID_COLUMNS, y );
+                    AddCell( (m_cellX + ring) % NODEGRID_COLUMNS, y );
+                }
+                else if( ring * 2 == NODEGRID_COLUMNS )
+                {
+                    AddCell( (m_cellX + ring) % NODEGRID_COLUMNS, y );
+                }
+            }
+        }
+    }
+
+
+    //
+    // Every node not yet scanned is at least ring * cellsize away, once the seam
+    // is taken into account.  GetDistanceSqd measures a path across the seam
+    // as a^2 + b^2, which can be as little as half the squared length of the path
+
+    int maxRing = max( NODEGRID_ROWS, NODEGRID_COLUMNS / 2 + 1 );
+    if( m_ring > maxRing )
+    {
+        m_threshold = Fixed::MAX;
+    }
+    else
+    {
+        int distance = ring * NODEGRID_CELLSIZE - 1;
+        m_threshold = ( distance > 0 ? Fixed( distance * distance / 2 ) : Fixed(0) );
+    }
+}
+
+
+int NodeGridQuery::GetNext()
+{
+    while( true )
+    {
+        if( m_nextCandidate < m_numCandidates &&
+            ( m_threshold == Fixed::MAX || 
+              m_candidates[m_nextCandidate].m_distanceSqd < m_threshold ) )
+        {
+            return m_candidates[m_nextCandidate++].m_nodeId;
+        }
+
+        if( m_threshold == Fixed::MAX )
+        {
+            return -1;
+        }
+
+        ScanRing();
+    }
+}
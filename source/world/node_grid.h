@@ -0,0 +1,105 @@
+#ifndef _included_nodegrid_h
+#define _included_nodegrid_h
+
+#include "lib/tosser/llist.h"
+#include "lib/math/fixed.h"
+
+class Node;
+
+#define NODEGRID_CELLSIZE       10                                      // degrees
+#define NODEGRID_COLUMNS        (360 / NODEGRID_CELLSIZE)
+#define NODEGRID_ROWS           (200 / NODEGRID_CELLSIZE)
+#define NODEGRID_CACHESIZE      256
+
+
+/*
+ *  Uniform grid over the travel nodes, used to find the nodes
+ *  nearest a point without sorting the whole node list.
+ *  Columns wrap around the +-180 seam.
+ *
+ */
+
+class NodeGrid
+{
+protected:
+    int     m_numNodes;
+    Fixed   *m_longitude;                           // Node positions by node id, copied out of the LList
+    Fixed   *m_latitude;                            // so they can be read from any thread
+    int     *m_cellStart;                           // Index into m_cellNodes, NODEGRID_COLUMNS * NODEGRID_ROWS + 1 entries
+    int     *m_cellNodes;                           // Node ids grouped by cell, ascending within each cell
+
+    struct CacheEntry
+    {
+        UInt64  m_longitude;
+        UInt64  m_latitude;
+        int     m_timeScaleFactor;
+        int     m_nodeId;
+        bool    m_used;
+    };
+    CacheEntry  m_cache[NODEGRID_CACHESIZE];        // Recent GetClosestNode results
+
+public:
+    NodeGrid();
+    ~NodeGrid();
+
+    void    Initialise      ( LList<Node *> &_nodes );
+    void    Clear           ();
+
+    int     NumNodes        ();
+    Fixed   GetLongitude    ( int _nodeId ) { return m_longitude[_nodeId]; }
+    Fixed   GetLatitude     ( int _nodeId ) { return m_latitude[_nodeId]; }
+    void    GetCell         ( Fixed _longitude, Fixed _latitude, int &_x, int &_y );
+    void    GetCellNodes    ( int _x, int _y, int *&_nodes, int &_numNodes );
+
+    bool    LookupCache     ( Fixed const &_longitude, Fixed const &_latitude, int _timeScaleFactor, int &_nodeId );
+    void    UpdateCache     ( Fixed const &_longitude, Fixed const &_latitude, int _timeScaleFactor, int _nodeId );
+};
+
+
+// ============================================================================
+
+
+/*
+ *  Walks the grid outwards in rings from a point, returning node ids
+ *  in the same order as sorting every node by GetDistanceSqd
+ *  (ties broken by node id).  Only reads the grid, so queries
+ *  may run on several threads at once.
+ *
+ */
+
+class NodeGridQuery
+{
+protected:
+    struct Candidate
+    {
+        int     m_nodeId;
+        Fixed   m_distanceSqd;
+    };
+
+    NodeGrid        *m_grid;
+    Fixed           m_longitude;
+    Fixed           m_latitude;
+    int             m_cellX;
+    int             m_cellY;
+    int             m_ring;                         // Next ring to be scanned
+    Fixed           m_threshold;                    // Candidates closer than this can no longer be beaten
+
+    Candidate       m_localCandidates[32];
+    Candidate       *m_candidates;
+    int             m_numCandidates;
+    int             m_maxCandidates;
+    int             m_nextCandidate;
+
+    void    AddCell         ( int _x, int _y );
+    void    AddCandidate    ( int _nodeId );
+    void    ScanRing        ();
+
+public:
+    NodeGridQuery( NodeGrid *_grid, Fixed const &_longitude, Fixed const &_latitude );
+    ~NodeGridQuery();
+
+    int     GetNext         ();                     // Returns -1 when every node has been returned
+};
+
+
+#endif
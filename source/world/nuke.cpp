@@ -11,12 +11,11 @@
 #include "lib/math/vector3.h"
 #include "lib/math/random_number.h"
 #include "lib/profiler.h"
+#include "lib/tosser/directory.h"
 
 #include "app/app.h"
 #include "app/globals.h"
 
-#include "renderer/map_renderer.h"
-
 #include "world/world.h"
 #include "world/nuke.h"
 #include "world/team.h"
@@ -206,14 +205,15 @@ void Nuke::FindTarget( int team, int targetTeam, int launchedBy, Fixed range, Fi
     }
 
     LList<int> validTargets;
+    ObjectStore &store = g_app->GetWorld()->m_objectStore;
         
     for( int i = 0; i < g_app->GetWorld()->m_objects.Size(); ++i )
     {
-        if( g_app->GetWorld()->m_objects.ValidIndex(i) )
+        if( g_app->GetWorld()->m_objects.ValidIndex(i) &&
+            store.m_teamId[i] == targetTeam )
         {
             WorldObject *obj = g_app->GetWorld()->m_objects[i];
-            if( obj->m_teamId == targetTeam &&
-                obj->m_seen[team] &&
+            if( obj->m_seen[team] &&
                 !obj->IsMovingObject() )
             {
                 Fixed distanceSqd = g_app->GetWorld()->GetDistanceSqd( launcher->m_longitude, launcher->m_latitude, obj->m_longitude, obj->m_latitude);
@@ -278,11 +278,15 @@ void Nuke::FindTarget( int team, int targetTeam, int launchedBy, Fixed range, Fi
 int Nuke::CountTargetedNukes( int teamId, Fixed longitude, Fixed latitude )
 {
     int targetedNukes = 0;
+    ObjectStore &store = g_app->GetWorld()->m_objectStore;
     for( int i = 0; i < g_app->GetWorld()->m_objects.Size(); ++i )
     {
-        if( g_app->GetWorld()->m_objects.ValidIndex(i) )
+        // Every case below is for objects of teamId only
+        if( g_app->GetWorld()->m_objects.ValidIndex(i) &&
+            store.m_teamId[i] == teamId )
         {
-            if( g_app->GetWorld()->m_objects[i]->m_type == WorldObject::TypeNuke )
+            int type = store.m_type[i];
+            if( type == WorldObject::TypeNuke )
             {
                 MovingObject *obj = (MovingObject *)g_app->GetWorld()->m_objects[i];
                 Fixed targetLongitude = obj->m_targetLongitude;
@@ -302,7 +306,7 @@ int Nuke::CountTargetedNukes( int teamId, Fixed longitude, Fixed latitude )
                     ++targetedNukes;
                 }
             }
-            else if( g_app->GetWorld()->m_objects[i]->m_type == WorldObject::TypeBomber )
+            else if( type == WorldObject::TypeBomber )
             {
                 Bomber *obj = (Bomber *)g_app->GetWorld()->m_objects[i];
                 if( obj->m_teamId == teamId &&
@@ -312,8 +316,8 @@ int Nuke::CountTargetedNukes( int teamId, Fixed longitude, Fixed latitude )
                     ++targetedNukes;
                 }
             }
-            else if( g_app->GetWorld()->m_objects[i]->m_type == WorldObject::TypeSub ||
-                     g_app->GetWorld()->m_objects[i]->m_type == WorldObject::TypeSilo)
+            else if( type == WorldObject::TypeSub ||
+                     type == WorldObject::TypeSilo)
             {
                 WorldObject *obj = g_app->GetWorld()->m_objects[i];
                 int nukeState = 0;
@@ -334,8 +338,8 @@ int Nuke::CountTargetedNukes( int teamId, Fixed longitude, Fixed latitude )
                     }
                 }
             }
-            else if( g_app->GetWorld()->m_objects[i]->m_type == WorldObject::TypeAirBase ||
-                     g_app->GetWorld()->m_objects[i]->m_type == WorldObject::TypeCarrier )
+            else if( type == WorldObject::TypeAirBase ||
+                     type == WorldObject::TypeCarrier )
             {
                 WorldObject *obj = g_app->GetWorld()->m_objects[i];
                 if( obj->m_teamId == teamId &&
@@ -359,7 +363,7 @@ int Nuke::CountTargetedNukes( int teamId, Fixed longitude, Fixed latitude )
 
 void Nuke::CeaseFire( int teamId )
 {
-    if( g_app->GetMapRenderer()->IsValidTerritory( teamId, m_targetLongitude, m_targetLatitude, false ) )
+    if( g_app->GetWorld()->IsValidTerritory( teamId, m_targetLongitude, m_targetLatitude, false ) )
     {
         SetState(1);
     }
@@ -374,3 +378,31 @@ void Nuke::LockTarget()
 {
     m_targetLocked = true;
 }
+
+
+void Nuke::SaveSnapshot( Directory *_dir )
+{
+    MovingObject::SaveSnapshot( _dir );
+
+    _dir->CreateData( "totalDistance", m_totalDistance );
+    _dir->CreateData( "curveDirection", m_curveDirection );
+    _dir->CreateData( "prevDistanceToTarget", m_prevDistanceToTarget );
+    _dir->CreateData( "newLongitude", m_newLongitude );
+    _dir->CreateData( "newLatitude", m_newLatitude );
+    _dir->CreateData( "targetLocked", m_targetLocked );
+}
+
+
+void Nuke::LoadSnapshot( Directory *_dir )
+{
+    MovingObject::LoadSnapshot( _dir );
+
+    m_totalDistance = _dir->GetDataFixed( "totalDistance" );
+    m_curveDirection = _dir->GetDataFixed( "curveDirection" );
+    m_prevDistanceToTarget = _dir->GetDataFixed( "prevDistanceToTarget" );
+    m_newLongitude = _dir->GetDataFixed( "newLongitude" );
+    m_newLatitude = _dir->GetDataFixed( "newLatitude" );
+    m_targetLocked = _dir->GetDataBool( "targetLocked" );
+}
+
+
@@ -34,6 +34,9 @@ public:
     int     IsValidMovementTarget( Fixed longitude, Fixed latitude );
 
     void    LockTarget();
+
+    void    SaveSnapshot    ( Directory *_dir );
+    void    LoadSnapshot    ( Directory *_dir );
 }; 
 
 
@@ -0,0 +1,461 @@
+#include "lib/universal_include.h"
+
+#include <stdlib.h>
+
+#include "lib/debug_utils.h"
+#include "lib/math/math_utils.h"
+
+#include "world/object_grid.h"
+#include "world/worldobject.h"
+
+
+// Rounds down, unlike IntValue, so that the cells either side of zero are the same size
+
+static int GetCellIndex( Fixed const &_value )
+{
+    int cell = ( _value / OBJECTGRID_CELLSIZE ).IntValue();
+    if( Fixed( cell * OBJECTGRID_CELLSIZE ) > _value )          --cell;
+    if( Fixed( (cell + 1) * OBJECTGRID_CELLSIZE ) <= _value )   ++cell;
+    return cell;
+}
+
+
+static void AppendSlot( int _slot, int *&_slots, int &_numSlots, int &_maxSlots, int *_localSlots )
+{
+    if( _numSlots == _maxSlots )
+    {
+        int *slots = new int[ _maxSlots * 2 ];
+        for( int i = 0; i < _numSlots; ++i )
+        {
+            slots[i] = _slots[i];
+        }
+        if( _slots != _localSlots ) delete [] _slots;
+        _slots = slots;
+        _maxSlots *= 2;
+    }
+
+    _slots[_numSlots++] = _slot;
+}
+
+
+static int CompareSlots( const void *_a, const void *_b )
+{
+    return *(int *)_a - *(int *)_b;
+}
+
+
+ObjectGrid::ObjectGrid()
+:   m_slotCell(NULL),
+    m_slotNext(NULL),
+    m_slotPrevious(NULL),
+    m_numSlots(0)
+{
+    Clear();
+}
+
+
+ObjectGrid::~ObjectGrid()
+{
+    Clear();
+}
+
+
+void ObjectGrid::Clear()
+{
+    for( int i = 0; i < OBJECTGRID_COLUMNS * OBJECTGRID_ROWS; ++i )
+    {
+        m_cellHead[i] = -1;
+    }
+
+    delete [] m_slotCell;
+    delete [] m_slotNext;
+    delete [] m_slotPrevious;
+    m_slotCell = NULL;
+    m_slotNext = NULL;
+    m_slotPrevious = NULL;
+    m_numSlots = 0;
+
+    m_pending.Empty();
+}
+
+
+void ObjectGrid::EnsureSlots( int _slot )
+{
+    if( _slot < m_numSlots ) return;
+
+    int numSlots = max( _slot + 1, m_numSlots * 2 );
+    numSlots = max( numSlots, 256 );
+
+    int *slotCell = new int[ numSlots ];
+    int *slotNext = new int[ numSlots ];
+    int *slotPrevious = new int[ numSlots ];
+
+    for( int i = 0; i < numSlots; ++i )
+    {
+        if( i < m_numSlots )
+        {
+            slotCell[i] = m_slotCell[i];
+            slotNext[i] = m_slotNext[i];
+            slotPrevious[i] = m_slotPrevious[i];
+        }
+        else
+        {
+            slotCell[i] = CellNone;
+            slotNext[i] = -1;
+            slotPrevious[i] = -1;
+        }
+    }
+
+    delete [] m_slotCell;
+    delete [] m_slotNext;
+    delete [] m_slotPrevious;
+    m_slotCell = slotCell;
+    m_slotNext = slotNext;
+    m_slotPrevious = slotPrevious;
+    m_numSlots = numSlots;
+}
+
+
+void ObjectGrid::Unlink( int _slot )
+{
+    int cell = m_slotCell[_slot];
+
+    if( cell == CellPending )
+    {
+        for( int i = 0; i < m_pending.Size(); ++i )
+        {
+            if( m_pending[i] == _slot )
+            {
+                m_pending.RemoveData(i);
+                break;
+            }
+        }
+    }
+    else if( cell != CellNone )
+    {
+        int next = m_slotNext[_slot];
+        int previous = m_slotPrevious[_slot];
+
+        if( previous != -1 )    m_slotNext[previous] = next;
+        else                    m_cellHead[cell] = next;
+
+        if( next != -1 )        m_slotPrevious[next] = previous;
+    }
+
+    m_slotCell[_slot] = CellNone;
+    m_slotNext[_slot] = -1;
+    m_slotPrevious[_slot] = -1;
+}
+
+
+void ObjectGrid::Add( int _slot )
+{
+    EnsureSlots( _slot );
+    Unlink( _slot );
+
+    m_slotCell[_slot] = CellPending;
+    m_pending.PutDataAtEnd( _slot );
+}
+
+
+void ObjectGrid::Update( int _slot, Fixed const &_longitude, Fixed const &_latitude )
+{
+    EnsureSlots( _slot );
+
+    int x, y;
+    GetCell( _longitude, _latitude, x, y );
+    int cell = y * OBJECTGRID_COLUMNS + x;
+
+    if( m_slotCell[_slot] == cell ) return;
+
+    Unlink( _slot );
+
+    int head = m_cellHead[cell];
+    m_slotCell[_slot] = cell;
+    m_slotNext[_slot] = head;
+    m_slotPrevious[_slot] = -1;
+    if( head != -1 ) m_slotPrevious[head] = _slot;
+    m_cellHead[cell] = _slot;
+}
+
+
+void ObjectGrid::Remove( int _slot )
+{
+    if( _slot < m_numSlots )
+    {
+        Unlink( _slot );
+    }
+}
+
+
+void ObjectGrid::PlacePending( FastDArray<WorldObject *> &_objects )
+{
+    while( m_pending.Size() > 0 )
+    {
+        int slot = m_pending[0];
+        if( _objects.ValidIndex(slot) )
+        {
+            Update( slot, _objects[slot]->m_longitude, _objects[slot]->m_latitude );
+        }
+        else
+        {
+            Remove( slot );
+        }
+    }
+}
+
+
+void ObjectGrid::GetCell( Fixed _longitude, Fixed _latitude, int &_x, int &_y )
+{
+    while( _longitude >= 180 )  _longitude -= 360;
+    while( _longitude < -180 )  _longitude += 360;
+
+    _x = GetCellIndex( _longitude + 180 );
+    _y = GetCellIndex( _latitude + 100 );
+
+    _x = max( _x, 0 );
+    _y = max( _y, 0 );
+    _x = min( _x, OBJECTGRID_COLUMNS - 1 );
+    _y = min( _y, OBJECTGRID_ROWS - 1 );
+}
+
+
+int ObjectGrid::GetCellHead( int _x, int _y )
+{
+    return m_cellHead[ _y * OBJECTGRID_COLUMNS + _x ];
+}
+
+
+int ObjectGrid::GetNextInCell( int _slot )
+{
+    return m_slotNext[_slot];
+}
+
+
+int ObjectGrid::NumPending()
+{
+    return m_pending.Size();
+}
+
+
+int ObjectGrid::GetPending( int _index )
+{
+    return m_pending[_index];
+}
+
+
+void ObjectGrid::GetNearbySlots( Fixed const &_longitude, Fixed const &_latitude, Fixed const &_radius, LList<int> &_slots )
+{
+    //
+    // GetDistanceSqd measures a path across the seam as a^2 + b^2, with
+    // both legs inside the radius.  So close to the seam, anything within
+    // twice the radius either way might count.
+    // Measured distances are rounded, so allow a little extra as well.
+
+    Fixed longitude = _longitude;
+    while( longitude >= 180 )  longitude -= 360;
+    while( longitude < -180 )  longitude += 360;
+
+    Fixed extent = _radius;
+    if( extent < 0 ) extent = -extent;
+    if( Fixed(180) - longitude.abs() <= extent ) extent *= 2;
+    extent += Fixed(1) / 16;
+
+    int minX = GetCellIndex( longitude + 180 - extent );
+    int maxX = GetCellIndex( longitude + 180 + extent );
+    if( maxX - minX + 1 >= OBJECTGRID_COLUMNS )
+    {
+        minX = 0;
+        maxX = OBJECTGRID_COLUMNS - 1;
+    }
+
+    int minY = GetCellIndex( _latitude + 100 - extent );
+    int maxY = GetCellIndex( _latitude + 100 + extent );
+    minY = min( max( minY, 0 ), OBJECTGRID_ROWS - 1 );
+    maxY = min( max( maxY, 0 ), OBJECTGRID_ROWS - 1 );
+
+
+    //
+    // Gather the slots, then sort them into m_objects order
+
+    int localSlots[128];
+    int *slots = localSlots;
+    int numSlots = 0;
+    int maxSlots = 128;
+
+    for( int y = minY; y <= maxY; ++y )
+    {
+        for( int x = minX; x <= maxX; ++x )
+        {
+            int cellX = ( x % OBJECTGRID_COLUMNS + OBJECTGRID_COLUMNS ) % OBJECTGRID_COLUMNS;
+            for( int slot = m_cellHead[ y * OBJECTGRID_COLUMNS + cellX ]; slot != -1; slot = m_slotNext[slot] )
+            {
+                AppendSlot( slot, slots, numSlots, maxSlots, localSlots );
+            }
+        }
+    }
+
+    for( int i = 0; i < m_pending.Size(); ++i )
+    {
+        AppendSlot( m_pending[i], slots, numSlots, maxSlots, localSlots );
+    }
+
+    qsort( slots, numSlots, sizeof(int), CompareSlots );
+
+    for( int i = 0; i < numSlots; ++i )
+    {
+        _slots.PutDataAtEnd( slots[i] );
+    }
+
+    if( slots != localSlots ) delete [] slots;
+}
+
+
+// ============================================================================
+
+
+ObjectGridQuery::ObjectGridQuery( ObjectGrid *_grid, Fixed const &_longitude, Fixed const &_latitude )
+:   m_grid(_grid),
+    m_ring(0),
+    m_threshold(0),
+    m_ringThreshold(0),
+    m_slots(m_localSlots),
+    m_numSlots(0),
+    m_maxSlots(64),
+    m_nextSlot(0)
+{
+    m_grid->GetCell( _longitude, _latitude, m_cellX, m_cellY );
+}
+
+
+ObjectGridQuery::~ObjectGridQuery()
+{
+    if( m_slots != m_localSlots )
+    {
+        delete [] m_slots;
+    }
+}
+
+
+void ObjectGridQuery::AddSlot( int _slot )
+{
+    AppendSlot( _slot, m_slots, m_numSlots, m_maxSlots, m_localSlots );
+}
+
+
+void ObjectGridQuery::AddCell( int _x, int _y )
+{
+    for( int slot = m_grid->GetCellHead( _x, _y ); slot != -1; slot = m_grid->GetNextInCell( slot ) )
+    {
+        AddSlot( slot );
+    }
+}
+
+
+void ObjectGridQuery::ScanRing()
+{
+    int ring = m_ring;
+    ++m_ring;
+
+    m_numSlots = 0;
+    m_nextSlot = 0;
+    m_ringThreshold = m_threshold;
+
+    if( ring == 0 )
+    {
+        // Objects not yet placed could be anywhere
+
+        for( int i = 0; i < m_grid->NumPending(); ++i )
+        {
+            AddSlot( m_grid->GetPending(i) );
+        }
+
+        AddCell( m_cellX, m_cellY );
+    }
+    else
+    {
+        for( int y = m_cellY - ring; y <= m_cellY + ring; ++y )
+        {
+            if( y < 0 || y >= OBJECTGRID_ROWS ) continue;
+
+            if( y == m_cellY - ring || y == m_cellY + ring )
+            {
+                // Top and bottom rows of the ring, every column within range
+
+                if( ring * 2 + 1 >= OBJECTGRID_COLUMNS )
+                {
+                    for( int x = 0; x < OBJECTGRID_COLUMNS; ++x )
+                    {
+                        AddCell( x, y );
+                    }
+                }
+                else
+                {
+                    for( int x = m_cellX - ring; x <= m_cellX + ring; ++x )
+                    {
+                        AddCell( (x + OBJECTGRID_COLUMNS) % OBJECTGRID_COLUMNS, y );
+                    }
+                }
+            }
+            else
+            {
+                // Left and right columns of the ring, wrapping around the seam
+
+                if( ring * 2 < OBJECTGRID_COLUMNS )
+                {
+                    AddCell( (m_cellX - ring + OBJECTGRID_COLUMNS) % OBJECTGRID_COLUMNS, y );
+                    AddCell( (m_cellX + ring) % OBJECTGRID_COLUMNS, y );
+                }
+                else if( ring * 2 == OBJECTGRID_COLUMNS )
+                {
+                    AddCell( (m_cellX + ring) % OBJECTGRID_COLUMNS, y );
+                }
+            }
+        }
+    }
+
+
+    //
+    // Same bound as NodeGridQuery : every slot not yet scanned is at least
+    // ring * cellsize away, and a path across the seam can measure as little
+    // as half its squared length
+
+    int maxRing = max( OBJECTGRID_ROWS, OBJECTGRID_COLUMNS / 2 + 1 );
+    if( m_ring > maxRing )
+    {
+        m_threshold = Fixed::MAX;
+    }
+    else
+    {
+        int distance = ring * OBJECTGRID_CELLSIZE - 1;
+        m_threshold = ( distance > 0 ? Fixed( distance * distance / 2 ) : Fixed(0) );
+    }
+}
+
+
+int ObjectGridQuery::GetNext()
+{
+    while( m_nextSlot == m_numSlots )
+    {
+        if( m_ring > 0 && m_threshold == Fixed::MAX )
+        {
+            return -1;
+        }
+        ScanRing();
+    }
+
+    return m_slots[m_nextSlot++];
+}
+
+
+Fixed ObjectGridQuery::GetThreshold()
+{
+    // Slots still waiting in the current ring are only bounded by the rings inside it
+
+    if( m_nextSlot < m_numSlots )
+    {
+        return m_ringThreshold;
+    }
+
+    return m_threshold;
+}
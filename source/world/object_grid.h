@@ -0,0 +1,108 @@
+#ifndef _included_objectgrid_h
+#define _included_objectgrid_h
+
+#include "lib/tosser/llist.h"
+#include "lib/tosser/fast_darray.h"
+#include "lib/math/fixed.h"
+
+class WorldObject;
+
+#define OBJECTGRID_CELLSIZE     5                                       // degrees
+#define OBJECTGRID_COLUMNS      (360 / OBJECTGRID_CELLSIZE)
+#define OBJECTGRID_ROWS         (200 / OBJECTGRID_CELLSIZE)
+
+
+/*
+ *  Uniform grid over the slots of World::m_objects, kept up to date
+ *  as objects are added, move and die.  Columns wrap around the +-180 seam.
+ *
+ *  New objects are usually positioned just after AddWorldObject, so they
+ *  wait in a pending list until the World next places them.  Every query
+ *  includes the pending objects, so nothing is ever missed.
+ *
+ */
+
+class ObjectGrid
+{
+protected:
+    int     m_cellHead[ OBJECTGRID_COLUMNS * OBJECTGRID_ROWS ];    // First slot in each cell, or -1
+    int     *m_slotCell;                            // Cell of each slot, or one of the values below
+    int     *m_slotNext;                            // Next slot in the same cell
+    int     *m_slotPrevious;
+    int     m_numSlots;                             // Size of the arrays above
+
+    LList<int>  m_pending;                          // Slots added since they were last placed
+
+    enum
+    {
+        CellNone = -1,
+        CellPending = -2
+    };
+
+    void    EnsureSlots     ( int _slot );
+    void    Unlink          ( int _slot );
+
+public:
+    ObjectGrid();
+    ~ObjectGrid();
+
+    void    Clear           ();
+
+    void    Add             ( int _slot );          // Placed by the next Update or PlacePending
+    void    Update          ( int _slot, Fixed const &_longitude, Fixed const &_latitude );
+    void    Remove          ( int _slot );
+    void    PlacePending    ( FastDArray<WorldObject *> &_objects );
+
+    void    GetCell         ( Fixed _longitude, Fixed _latitude, int &_x, int &_y );
+    int     GetCellHead     ( int _x, int _y );
+    int     GetNextInCell   ( int _slot );
+    int     NumPending      ();
+    int     GetPending      ( int _index );
+
+    // Every slot that could be within _radius of the point, by GetDistanceSqd.
+    // Ascending slot order, ie the order of a scan through World::m_objects
+    void    GetNearbySlots  ( Fixed const &_longitude, Fixed const &_latitude, Fixed const &_radius, LList<int> &_slots );
+};
+
+
+// ============================================================================
+
+
+/*
+ *  Walks the grid outwards in rings from a point, for nearest-object searches.
+ *  Slots come back a ring at a time in no particular order; GetThreshold
+ *  is a lower bound on the distance squared of every slot not yet returned,
+ *  so a search can stop once its best result is closer than that.
+ *
+ */
+
+class ObjectGridQuery
+{
+protected:
+    ObjectGrid      *m_grid;
+    int             m_cellX;
+    int             m_cellY;
+    int             m_ring;                         // Next ring to be scanned
+    Fixed           m_threshold;                    // Bound for the rings not yet scanned
+    Fixed           m_ringThreshold;                // Bound for the ring being returned
+
+    int             m_localSlots[64];
+    int             *m_slots;                       // The ring being returned
+    int             m_numSlots;
+    int             m_maxSlots;
+    int             m_nextSlot;
+
+    void    AddSlot         ( int _slot );
+    void    AddCell         ( int _x, int _y );
+    void    ScanRing        ();
+
+public:
+    ObjectGridQuery( ObjectGrid *_grid, Fixed const &_longitude, Fixed const &_latitude );
+    ~ObjectGridQuery();
+
+    int     GetNext         ();                     // Returns -1 when every slot has been returned
+    Fixed   GetThreshold    ();
+};
+
+
+#endif
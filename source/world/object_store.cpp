@@ -0,0 +1,161 @@
+#include "lib/universal_include.h"
+
+#include "lib/debug_utils.h"
+#include "lib/math/math_utils.h"
+
+#include "world/object_store.h"
+#include "world/worldobject.h"
+#include "world/world.h"
+
+
+ObjectStore::ObjectStore()
+:   m_numSlots(0),
+    m_type(NULL),
+    m_teamId(NULL),
+    m_visible(NULL),
+    m_radarInputs(NULL),
+    m_radarVisible(NULL),
+    m_radarSeen(NULL)
+{
+}
+
+
+ObjectStore::~ObjectStore()
+{
+    Clear();
+}
+
+
+void ObjectStore::Clear()
+{
+    delete [] m_type;
+    delete [] m_teamId;
+    delete [] m_visible;
+    delete [] m_radarInputs;
+    delete [] m_radarVisible;
+    delete [] m_radarSeen;
+
+    m_type = NULL;
+    m_teamId = NULL;
+    m_visible = NULL;
+    m_radarInputs = NULL;
+    m_radarVisible = NULL;
+    m_radarSeen = NULL;
+    m_numSlots = 0;
+
+    m_pending.Empty();
+}
+
+
+template <class T>
+static void GrowArray( T *&_array, int _oldSize, int _newSize, T const &_empty )
+{
+    T *array = new T[ _newSize ];
+    for( int i = 0; i < _newSize; ++i )
+    {
+        array[i] = ( i < _oldSize ? _array[i] : _empty );
+    }
+    delete [] _array;
+    _array = array;
+}
+
+
+void ObjectStore::EnsureSlots( int _slot )
+{
+    if( _slot < m_numSlots ) return;
+
+    int numSlots = max( _slot + 1, m_numSlots * 2 );
+    numSlots = max( numSlots, 256 );
+
+    GrowArray( m_type,          m_numSlots, numSlots, (unsigned char) WorldObject::TypeInvalid );
+    GrowArray( m_teamId,        m_numSlots, numSlots, -1 );
+    GrowArray( m_visible,       m_numSlots, numSlots, (unsigned char) 0 );
+    GrowArray( m_radarInputs,   m_numSlots, numSlots, -1 );
+    GrowArray( m_radarVisible,  m_numSlots, numSlots, (unsigned char) 0 );
+    GrowArray( m_radarSeen,     m_numSlots, numSlots, (unsigned char) 0 );
+
+    m_numSlots = numSlots;
+}
+
+
+void ObjectStore::Add( int _slot, WorldObject *_object )
+{
+    EnsureSlots( _slot );
+    Sync( _slot, _object );
+    m_radarInputs[_slot] = -1;
+    m_pending.PutData( _slot );
+}
+
+
+void ObjectStore::Sync( int _slot, WorldObject *_object )
+{
+    AppDebugAssert( _slot < m_numSlots );
+
+    m_type[_slot]       = (unsigned char) _object->m_type;
+    m_teamId[_slot]     = _object->m_teamId;
+
+    SyncVisibility( _slot, _object );
+}
+
+
+void ObjectStore::SyncVisibility( int _slot, WorldObject *_object )
+{
+    m_visible[_slot] = PackVisibility( _object );
+}
+
+
+unsigned char ObjectStore::PackVisibility( WorldObject *_object )
+{
+    unsigned char visible = 0;
+    for( int t = 0; t < MAX_TEAMS; ++t )
+    {
+        if( _object->m_visible[t] ) visible |= 1 << t;
+    }
+    return visible;
+}
+
+
+unsigned char ObjectStore::PackSeen( WorldObject *_object )
+{
+    unsigned char seen = 0;
+    for( int t = 0; t < MAX_TEAMS; ++t )
+    {
+        if( _object->m_seen[t] ) seen |= 1 << t;
+    }
+    return seen;
+}
+
+
+void ObjectStore::SyncPending( FastDArray<WorldObject *> &_objects )
+{
+    for( int i = 0; i < m_pending.Size(); ++i )
+    {
+        int slot = m_pending[i];
+        if( _objects.ValidIndex(slot) )
+        {
+            Sync( slot, _objects[slot] );
+        }
+    }
+
+    m_pending.Empty();
+}
+
+
+void ObjectStore::Remove( int _slot )
+{
+    AppDebugAssert( _slot < m_numSlots );
+
+    m_type[_slot] = WorldObject::TypeInvalid;
+    m_teamId[_slot] = -1;
+    m_visible[_slot] = 0;
+    m_radarInputs[_slot] = -1;
+
+    for( int i = 0; i < m_pending.Size(); ++i )
+    {
+        if( m_pending[i] == _slot )
+        {
+            m_pending.RemoveData(i);
+            break;
+        }
+    }
+}
@@ -0,0 +1,63 @@
+#ifndef _included_objectstore_h
+#define _included_objectstore_h
+
+#include "lib/tosser/llist.h"
+#include "lib/tosser/fast_darray.h"
+
+class WorldObject;
+
+
+/*
+ *  Dense copies of the fields that scans over World::m_objects test first,
+ *  one entry per slot, so a scan can reject most objects without loading them.
+ *  The WorldObjects stay authoritative and keep their virtuals for behaviour;
+ *  the World copies their fields in when they are added, after each of their
+ *  updates, and whenever the radar changes what a team can see.
+ *
+ *  Type and team never change once an object is added, and visibility is
+ *  copied as soon as the radar writes it, or after the object's own update
+ *  since some objects reveal themselves.  A new object is usually set up
+ *  just after AddWorldObject, so it is pending until the World next syncs
+ *  it, as with the ObjectGrid.  Positions stay on the objects : a copy
+ *  from their last update would be stale for the objects still to move
+ *  this tick, and the ObjectGrid already prefilters by distance.
+ *
+ */
+
+class ObjectStore
+{
+protected:
+    int             m_numSlots;                     // Size of the arrays below
+    LList<int>      m_pending;                      // Slots added since they were last synced
+
+    void    EnsureSlots     ( int _slot );
+
+public:
+    unsigned char   *m_type;                        // TypeInvalid in an empty slot
+    int             *m_teamId;
+    unsigned char   *m_visible;                     // One bit per team, as WorldObject::m_visible
+
+    int             *m_radarInputs;                 // What World::UpdateRadar last tested against, -1 to test again
+    unsigned char   *m_radarVisible;                // And the visibility it came up with
+    unsigned char   *m_radarSeen;                   // And which teams had seen it by then
+
+public:
+    ObjectStore();
+    ~ObjectStore();
+
+    void    Clear           ();
+
+    void    Add             ( int _slot, WorldObject *_object );
+    void    Sync            ( int _slot, WorldObject *_object );
+    void    SyncVisibility  ( int _slot, WorldObject *_object );
+    void    SyncPending     ( FastDArray<WorldObject *> &_objects );
+    void    Remove          ( int _slot );
+
+    inline bool IsVisible   ( int _slot, int _teamId ) { return ( m_visible[_slot] & ( 1 << _teamId ) ) != 0; }
+
+    static unsigned char PackVisibility( WorldObject *_object );
+    static unsigned char PackSeen       ( WorldObject *_object );
+};
+
+
+#endif
@@ -3,8 +3,10 @@
 #include "lib/resource/bitmap.h"
 #include "lib/resource/image.h"
 #include "lib/profiler.h"
+#include "lib/tosser/directory.h"
 
 #include "world/radargrid.h"
+#include "world/world_hash.h"
 #include "world/world.h"
 
 #include "app/app.h"
@@ -14,29 +16,42 @@
 
 RadarGrid::RadarGrid()
 :   m_radar(NULL),
-    m_resolution(0)
+    m_covered(NULL),
+    m_resolution(0),
+    m_numTeams(0),
+    m_width(0),
+    m_height(0)
 {
 }
 
 
+RadarGrid::~RadarGrid()
+{
+    delete [] m_radar;
+    delete [] m_covered;
+}
+
+
 void RadarGrid::Initialise( int _resolution, int _numTeams )
 {
     AppDebugAssert( _resolution >= 1 );
+    AppReleaseAssert( _numTeams <= 8, "RadarGrid can only hold coverage for 8 teams" );
+
+    delete [] m_radar;
+    delete [] m_covered;
 
     m_resolution = _resolution;
+    m_numTeams = _numTeams;
+    m_width = RADARGRID_WIDTH * m_resolution;
+    m_height = RADARGRID_HEIGHT * m_resolution;
 
-    m_radar = new BoundedArray<unsigned char>[ RADARGRID_WIDTH * RADARGRID_HEIGHT * m_resolution ];
+    int numCells = m_width * m_height;
 
-    for( int y = 0; y < RADARGRID_HEIGHT * m_resolution; ++y )
-    {
-        int index = y * RADARGRID_WIDTH * m_resolution;
+    m_radar = new unsigned char[ numCells * m_numTeams ];
+    m_covered = new unsigned char[ numCells ];
 
-        for( int x = 0; x < RADARGRID_WIDTH * m_resolution; ++x )
-        {
-            m_radar[ index + x ].Initialise( _numTeams );
-            m_radar[ index + x ].SetAll( 0 );
-        }
-    }    
+    memset( m_radar, 0, numCells * m_numTeams );
+    memset( m_covered, 0, numCells );
 }
 
 
@@ -100,20 +115,34 @@ void RadarGrid::GetIndicesRadar( int &_x, int &_y )
 void RadarGrid::GetWorldLocation( int _indexX, int _indexY,         
                                   Fixed &_longitude, Fixed &_latitude )
 {
-    Fixed totalW = RADARGRID_WIDTH * m_resolution;
-    Fixed totalH = RADARGRID_HEIGHT * m_resolution;
+    _longitude = GetWorldLongitude( _indexX );
+    _latitude = GetWorldLatitude( _indexY );
+}
 
+
+Fixed RadarGrid::GetWorldLongitude( int _indexX )
+{
+    Fixed totalW = RADARGRID_WIDTH * m_resolution;
     Fixed cellSizeW = 360 / totalW;
+
+    Fixed longitude = 360 * _indexX/totalW;
+    longitude += cellSizeW/2;
+    longitude -= 360/2;
+
+    return longitude;
+}
+
+
+Fixed RadarGrid::GetWorldLatitude( int _indexY )
+{
+    Fixed totalH = RADARGRID_HEIGHT * m_resolution;
     Fixed cellSizeH = 200 / totalH;
-    
-    _longitude = 360 * _indexX/totalW;
-    _latitude = 200 * _indexY/totalH;
 
-    _longitude += cellSizeW/2;
-    _latitude += cellSizeH/2;
+    Fixed latitude = 200 * _indexY/totalH;
+    latitude += cellSizeH/2;
+    latitude -= 200/2;
 
-    _longitude -= 360/2;
-    _latitude -= 200/2;
+    return latitude;
 }
 
 
@@ -133,34 +162,91 @@ void RadarGrid::ModifyCoverage( Fixed _longitude, Fixed _latitude, Fixed _radius
     int x0, y0, w, h;
     GetIndices( _longitude, _latitude, _radius, x0, y0, w, h );
 
-    for( int x = x0; x < x0+w; ++x )
+    for( int y = y0; y < y0+h; ++y )
     {
-        for( int y = y0; y < y0+h; ++y )
+        Fixed thisLatitude = GetWorldLatitude( y );
+
+        //
+        // Cell centres get further from the centre column in both directions,
+        // so the covered cells in each row are a single run.
+        // Find its ends from the outside in, then fill it in one go.
+
+        int first = x0;
+        int last = x0 + w - 1;
+
+        while( first <= last )
         {
-            Fixed thisLongitude;
-            Fixed thisLatitude;
-            GetWorldLocation( x, y, thisLongitude, thisLatitude );
+            Fixed distanceSquared = (Vector3<Fixed>(_longitude, _latitude,0) - Vector3<Fixed>(GetWorldLongitude(first), thisLatitude,0)).MagSquared();
+            if( distanceSquared < radiusSquared ) break;
+            ++first;
+        }
 
-            Fixed distanceSquared = (Vector3<Fixed>(_longitude, _latitude,0) - Vector3<Fixed>(thisLongitude, thisLatitude,0)).MagSquared();
-            if( distanceSquared < radiusSquared )
+        while( last > first )
+        {
+            Fixed distanceSquared = (Vector3<Fixed>(_longitude, _latitude,0) - Vector3<Fixed>(GetWorldLongitude(last), thisLatitude,0)).MagSquared();
+            if( distanceSquared < radiusSquared ) break;
+            --last;
+        }
+
+        if( first > last ) continue;
+
+
+        //
+        // Split the run where it wraps around the seam
+
+        int x = first;
+        while( x <= last )
+        {
+            if( x < -m_width || x >= m_width * 2 )
             {
+                // Beyond one wrap GetIndicesRadar clamps to the edge
+
                 int xRadar = x;
                 int yRadar = y;
                 GetIndicesRadar( xRadar, yRadar );
-                if( addCoverage )
-                {
-                    m_radar[ yRadar * RADARGRID_WIDTH * m_resolution + xRadar ][_teamId]++;
-                }
-                else
-                {
-                    m_radar[ yRadar * RADARGRID_WIDTH * m_resolution + xRadar ][_teamId]--;
-                }
+                ModifyRow( y, xRadar, xRadar, _teamId, addCoverage );
+                ++x;
+            }
+            else
+            {
+                int offset = 0;
+                int end = last;
+                if( x < 0 )                 { offset = m_width;     end = min( last, -1 ); }
+                else if( x < m_width )      { offset = 0;           end = min( last, m_width - 1 ); }
+                else                        { offset = -m_width;    end = min( last, m_width * 2 - 1 ); }
+
+                ModifyRow( y, x + offset, end + offset, _teamId, addCoverage );
+                x = end + 1;
             }
         }
     }
 }
 
 
+void RadarGrid::ModifyRow( int _y, int _x0, int _x1, int _teamId, bool addCoverage )
+{
+    unsigned char *counts = m_radar + ( _teamId * m_height + _y ) * m_width;
+    unsigned char *covered = m_covered + _y * m_width;
+    unsigned char bit = (unsigned char)( 1 << _teamId );
+
+    // Plain loops over contiguous bytes, so the compiler can vectorise them
+
+    if( addCoverage )
+    {
+        for( int x = _x0; x <= _x1; ++x ) counts[x]++;
+    }
+    else
+    {
+        for( int x = _x0; x <= _x1; ++x ) counts[x]--;
+    }
+
+    for( int x = _x0; x <= _x1; ++x )
+    {
+        covered[x] = ( covered[x] & ~bit ) | ( counts[x] ? bit : 0 );
+    }
+}
+
+
 void RadarGrid::AddCoverage( Fixed _longitude, Fixed _latitude, Fixed _radius, int _teamId )
 {
     ModifyCoverage( _longitude, _latitude, _radius, _teamId, true );
@@ -212,7 +298,42 @@ int RadarGrid::GetCoverage( Fixed _longitude, Fixed _latitude, int _teamId )
     int indexY;
     GetIndices( _longitude, _latitude, indexX, indexY );
 
-    return m_radar[ indexY * RADARGRID_WIDTH * m_resolution + indexX ][_teamId];
+    return m_radar[ ( _teamId * m_height + indexY ) * m_width + indexX ];
+}
+
+
+int RadarGrid::GetCoveringTeams( Fixed _longitude, Fixed _latitude )
+{
+    int indexX;
+    int indexY;
+    GetIndices( _longitude, _latitude, indexX, indexY );
+
+    return m_covered[ indexY * m_width + indexX ];
+}
+
+
+unsigned int RadarGrid::GetHash( int _teamId )
+{
+    if( _teamId < 0 || _teamId >= m_numTeams ) return 0;
+
+    int numCells = m_width * m_height;
+    unsigned char *plane = m_radar + _teamId * numCells;
+
+    unsigned int hash = 0;
+    int i = 0;
+    for( ; i + 3 < numCells; i += 4 )
+    {
+        unsigned int cells = plane[i] | ( plane[i+1] << 8 ) | ( plane[i+2] << 16 ) | ( plane[i+3] << 24 );
+        hash = WorldHash::Mix( hash, cells );
+    }
+
+    // Whatever is left over when numCells isn't a multiple of four
+    for( ; i < numCells; ++i )
+    {
+        hash = WorldHash::Mix( hash, (unsigned int) plane[i] );
+    }
+
+    return hash;
 }
 
 
@@ -220,6 +341,9 @@ void RadarGrid::Render()
 {    
     if( !m_radar ) return;
 
+    int teamId = g_app->GetWorld()->m_myTeamId;
+    if( teamId < 0 || teamId >= m_numTeams ) return;
+
     START_PROFILE( "RadarGrid" );
     
     //
@@ -228,15 +352,13 @@ void RadarGrid::Render()
     Bitmap bitmap( RADARGRID_WIDTH*m_resolution,
                    RADARGRID_HEIGHT*m_resolution );
 
-    int teamId = g_app->GetWorld()->m_myTeamId;
-
-    for( int y = 0; y < RADARGRID_HEIGHT * m_resolution; ++y )
+    for( int y = 0; y < m_height; ++y )
     {
-        int index = y * RADARGRID_WIDTH * m_resolution;
+        unsigned char *counts = m_radar + ( teamId * m_height + y ) * m_width;
 
-        for( int x = 0; x < RADARGRID_WIDTH * m_resolution; ++x )
+        for( int x = 0; x < m_width; ++x )
         {
-            int count = m_radar[index+x][teamId] * 15;
+            int count = counts[x] * 15;
             count = min( count, 200 );
             
             Colour colour( count, count, count );
@@ -262,3 +384,81 @@ void RadarGrid::Render()
     END_PROFILE( "RadarGrid" );
 }
 
+
+void RadarGrid::SaveSnapshot( Directory *_dir )
+{
+    //
+    // Most of the map is uncovered, so store ( count, run length ) pairs
+
+    int numCounts = m_width * m_height * m_numTeams;
+    unsigned char *runs = new unsigned char[ numCounts * 2 ];
+    int runsLength = 0;
+
+    int i = 0;
+    while( i < numCounts )
+    {
+        unsigned char count = m_radar[i];
+        int runLength = 1;
+        while( runLength < 255 && i + runLength < numCounts && m_radar[i + runLength] == count )
+        {
+            ++runLength;
+        }
+
+        runs[runsLength++] = count;
+        runs[runsLength++] = (unsigned char) runLength;
+        i += runLength;
+    }
+
+    _dir->CreateData( "resolution", m_resolution );
+    _dir->CreateData( "numTeams", m_numTeams );
+    _dir->CreateData( "radar", (void *) runs, runsLength );
+
+    delete [] runs;
+}
+
+
+bool RadarGrid::LoadSnapshot( Directory *_dir )
+{
+    if( _dir->GetDataInt( "resolution" ) != m_resolution ||
+        _dir->GetDataInt( "numTeams" ) != m_numTeams )
+    {
+        return false;
+    }
+
+    int runsLength = 0;
+    unsigned char *runs = (unsigned char *) _dir->GetDataVoid( "radar", &runsLength );
+    if( !runs ) return false;
+
+    int numCells = m_width * m_height;
+    int numCounts = numCells * m_numTeams;
+    int i = 0;
+
+    for( int r = 0; r + 1 < runsLength; r += 2 )
+    {
+        int runLength = runs[r+1];
+        if( i + runLength > numCounts ) return false;
+
+        memset( m_radar + i, runs[r], runLength );
+        i += runLength;
+    }
+
+    if( i != numCounts ) return false;
+
+
+    //
+    // Rebuild the coverage masks from the counts
+
+    memset( m_covered, 0, numCells );
+
+    for( int t = 0; t < m_numTeams; ++t )
+    {
+        unsigned char *plane = m_radar + t * numCells;
+        for( int c = 0; c < numCells; ++c )
+        {
+            if( plane[c] ) m_covered[c] |= ( 1 << t );
+        }
+    }
+
+    return true;
+}
+
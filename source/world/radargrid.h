@@ -2,22 +2,32 @@
 #ifndef _included_radargrid_h
 #define _included_radargrid_h
 
-#include "lib/tosser/bounded_array.h"
 #include "lib/math/fixed.h"
 
 #define RADARGRID_WIDTH     360
 #define RADARGRID_HEIGHT    200
 
 struct RadarGridCell;
+class Directory;
 
 
 
 
+/*
+ *  Radar coverage counts, one dense plane of cells per team,
+ *  plus a mask per cell of the teams whose count is non-zero.
+ *
+ */
+
 class RadarGrid
 {
 protected:
-    BoundedArray    <unsigned char> *m_radar;
+    unsigned char   *m_radar;                       // m_numTeams planes of m_width * m_height counts
+    unsigned char   *m_covered;                     // Bit per team, set where its count is non-zero
     int             m_resolution;
+    int             m_numTeams;
+    int             m_width;
+    int             m_height;
     
     void            GetIndices( Fixed _longitude, Fixed _latitude, int &_x, int &_y );
     void            GetIndices( Fixed _longitude, Fixed _latitude, Fixed _radius, int &_x, int &_y, int &_w, int &_h );
@@ -25,11 +35,15 @@ protected:
     void            GetIndicesRadar( int &_x, int &_y );
 
     void            GetWorldLocation( int _indexX, int _indexY, Fixed &_longitude, Fixed &_latitude );
+    Fixed           GetWorldLongitude( int _indexX );
+    Fixed           GetWorldLatitude( int _indexY );
 
     void            ModifyCoverage( Fixed _longitude, Fixed _latitude, Fixed _radius, int _teamId, bool addCoverage );
+    void            ModifyRow( int _y, int _x0, int _x1, int _teamId, bool addCoverage );      // _x0 to _x1 inclusive, no wrapping
 
 public:
     RadarGrid();
+    ~RadarGrid();
 
     void Initialise( int _resolution, int _numTeams );                              // Resolution should be 1 (normal), 2 (double) etc
 
@@ -40,8 +54,14 @@ public:
                           Fixed _newLongitude, Fixed _newLatitude, Fixed _newRadius, int _teamId );
 
     int  GetCoverage    ( Fixed _longitude, Fixed _latitude, int _teamId );
+    int  GetCoveringTeams( Fixed _longitude, Fixed _latitude );                     // Bit (1 << teamId) per team with coverage
+
+    unsigned int GetHash( int _teamId );                                            // Of the team's whole plane, for the WorldHash
 
     void Render();                                                                  // Very slow
+
+    void SaveSnapshot   ( Directory *_dir );                                        // Run length encoded,
+    bool LoadSnapshot   ( Directory *_dir );                                        // after Initialise
 };
 
 
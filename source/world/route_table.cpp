@@ -0,0 +1,342 @@
+#include "lib/universal_include.h"
+
+#include <string.h>
+
+#include <unrar/rarbloat.h>
+#include <unrar/sha1.h>
+
+#include "lib/debug_utils.h"
+#include "lib/hi_res_time.h"
+#include "lib/resource/bitmap.h"
+#include "lib/render/colour.h"
+#include "lib/filesys/mapped_file.h"
+
+#include "world/route_table.h"
+#include "world/world.h"
+#include "world/node.h"
+
+
+struct RouteTableHeader
+{
+    char            m_magic[4];
+    int             m_version;
+    int             m_fixedSize;
+    int             m_numNodes;
+    unsigned int    m_key[ROUTETABLE_KEYSIZE];
+    int             m_reserved;                 // Keeps the Fixed array that follows 8 byte aligned
+};
+
+
+static char const s_routeTableMagic[4] = { 'D', 'R', 'T', 'C' };
+
+
+RouteTable::RouteTable()
+:   m_numNodes(0),
+    m_distance(NULL),
+    m_nextNode(NULL),
+    m_cacheFile(NULL)
+{
+}
+
+
+RouteTable::~RouteTable()
+{
+    Clear();
+}
+
+
+void RouteTable::Clear()
+{
+    if( m_cacheFile )
+    {
+        delete m_cacheFile;
+        m_cacheFile = NULL;
+    }
+    else
+    {
+        delete [] m_distance;
+        delete [] m_nextNode;
+    }
+
+    m_distance = NULL;
+    m_nextNode = NULL;
+    m_numNodes = 0;
+}
+
+
+void RouteTable::Compile( World *_world )
+{
+    double startTime = GetHighResTime();
+
+    Clear();
+
+    int numNodes = _world->m_nodes.Size();
+    m_numNodes = numNodes;
+    m_distance = new Fixed[ numNodes * numNodes ];
+    m_nextNode = new int[ numNodes * numNodes ];
+
+
+    //
+    // Build the visibility graph once.  Fixed::MAX marks "no edge"
+
+    Fixed *edges = new Fixed[ numNodes * numNodes ];
+
+    for( int a = 0; a < numNodes; ++a )
+    {
+        Node *from = _world->m_nodes[a];
+        for( int b = 0; b < numNodes; ++b )
+        {
+            Node *to = _world->m_nodes[b];
+            if( _world->IsSailable( from->m_longitude, from->m_latitude, to->m_longitude, to->m_latitude ) )
+            {
+                edges[a * numNodes + b] = _world->GetDistance( from->m_longitude, from->m_latitude, to->m_longitude, to->m_latitude );
+            }
+            else
+            {
+                edges[a * numNodes + b] = Fixed::MAX;
+            }
+        }
+    }
+
+
+    //
+    // One Dijkstra per target node, walking the edges backwards so that
+    // cost[n] is the distance from n to the target.  Distances are summed
+    // in the same order the old iterative build used (edge + rest of route)
+
+    Fixed *cost = new Fixed[ numNodes ];
+    bool *settled = new bool[ numNodes ];
+
+    for( int t = 0; t < numNodes; ++t )
+    {
+        for( int n = 0; n < numNodes; ++n )
+        {
+            cost[n] = Fixed::MAX;
+            settled[n] = false;
+        }
+        cost[t] = 0;
+
+        while( true )
+        {
+            int current = -1;
+            for( int n = 0; n < numNodes; ++n )
+            {
+                if( !settled[n] && cost[n] != Fixed::MAX &&
+                    ( current == -1 || cost[n] < cost[current] ) )
+                {
+                    current = n;
+                }
+            }
+            if( current == -1 ) break;
+
+            settled[current] = true;
+
+            for( int n = 0; n < numNodes; ++n )
+            {
+                Fixed edge = edges[n * numNodes + current];
+                if( !settled[n] && edge != Fixed::MAX )
+                {
+                    Fixed thisCost = edge + cost[current];
+                    if( thisCost < cost[n] )
+                    {
+                        cost[n] = thisCost;
+                    }
+                }
+            }
+        }
+
+
+        //
+        // The next hop is the lowest numbered neighbour on a shortest route,
+        // so the table is identical whichever order the search settled nodes
+
+        for( int n = 0; n < numNodes; ++n )
+        {
+            int nextNode = -1;
+
+            if( n == t )
+            {
+                nextNode = t;
+            }
+            else if( cost[n] != Fixed::MAX )
+            {
+                Fixed bestCost = Fixed::MAX;
+                for( int s = 0; s < numNodes; ++s )
+                {
+                    Fixed edge = edges[n * numNodes + s];
+                    if( s != n && edge != Fixed::MAX && cost[s] != Fixed::MAX )
+                    {
+                        Fixed thisCost = edge + cost[s];
+                        if( thisCost < bestCost )
+                        {
+                            bestCost = thisCost;
+                            nextNode = s;
+                        }
+                    }
+                }
+            }
+
+            m_distance[n * numNodes + t] = cost[n];
+            m_nextNode[n * numNodes + t] = nextNode;
+        }
+    }
+
+    delete [] settled;
+    delete [] cost;
+    delete [] edges;
+
+    double totalTime = GetHighResTime() - startTime;
+    AppDebugOut( "Compiled route table (%d nodes) : %dms\n", numNodes, int( totalTime * 1000.0f ) );
+}
+
+
+bool RouteTable::Load( char const *_filename, int _numNodes, unsigned int const *_key )
+{
+    Clear();
+
+    MappedFile *file = new MappedFile( _filename );
+    if( !file->IsOpen() ||
+        file->m_size < sizeof(RouteTableHeader) )
+    {
+        delete file;
+        return false;
+    }
+
+    RouteTableHeader const *header = (RouteTableHeader const *) file->m_data;
+    unsigned int expectedSize = sizeof(RouteTableHeader) + 
+                                _numNodes * _numNodes * ( sizeof(Fixed) + sizeof(int) );
+
+    if( memcmp( header->m_magic, s_routeTableMagic, sizeof(s_routeTableMagic) ) != 0 ||
+        header->m_version != ROUTETABLE_VERSION ||
+        header->m_fixedSize != sizeof(Fixed) ||
+        header->m_numNodes != _numNodes ||
+        memcmp( header->m_key, _key, sizeof(header->m_key) ) != 0 ||
+        file->m_size != expectedSize )
+    {
+        delete file;
+        return false;
+    }
+
+    unsigned char const *data = file->m_data + sizeof(RouteTableHeader);
+
+    m_cacheFile = file;
+    m_numNodes = _numNodes;
+    m_distance = (Fixed *) data;
+    m_nextNode = (int *) ( data + _numNodes * _numNodes * sizeof(Fixed) );
+
+    AppDebugOut( "Loaded route table (%d nodes) from '%s'\n", _numNodes, _filename );
+    return true;
+}
+
+
+bool RouteTable::Save( char const *_filename, unsigned int const *_key )
+{
+    RouteTableHeader header;
+    memset( &header, 0, sizeof(header) );
+    memcpy( header.m_magic, s_routeTableMagic, sizeof(s_routeTableMagic) );
+    header.m_version = ROUTETABLE_VERSION;
+    header.m_fixedSize = sizeof(Fixed);
+    header.m_numNodes = m_numNodes;
+    memcpy( header.m_key, _key, sizeof(header.m_key) );
+
+    //
+    // Write to a temporary file first so a half written cache
+    // is never picked up by another running instance
+
+    char tempFilename[512];
+    snprintf( tempFilename, sizeof(tempFilename), "%s.tmp", _filename );
+    tempFilename[ sizeof(tempFilename) - 1 ] = '\x0';
+
+    FILE *file = fopen( tempFilename, "wb" );
+    if( !file ) return false;
+
+    int numEntries = m_numNodes * m_numNodes;
+    bool success = ( fwrite( &header, sizeof(header), 1, file ) == 1 &&
+                     fwrite( m_distance, sizeof(Fixed), numEntries, file ) == (size_t) numEntries &&
+                     fwrite( m_nextNode, sizeof(int), numEntries, file ) == (size_t) numEntries );
+    fclose( file );
+
+    if( success )
+    {
+        remove( _filename );
+        success = ( rename( tempFilename, _filename ) == 0 );
+    }
+
+    if( !success )
+    {
+        remove( tempFilename );
+        AppDebugOut( "Failed to write route table cache '%s'\n", _filename );
+    }
+
+    return success;
+}
+
+
+int RouteTable::Size()
+{
+    return m_numNodes;
+}
+
+
+int RouteTable::GetNextNode( int _fromNodeId, int _targetNodeId )
+{
+    AppDebugAssert( _fromNodeId >= 0 && _fromNodeId < m_numNodes );
+    AppDebugAssert( _targetNodeId >= 0 && _targetNodeId < m_numNodes );
+
+    return m_nextNode[ _fromNodeId * m_numNodes + _targetNodeId ];
+}
+
+
+Fixed RouteTable::GetDistance( int _fromNodeId, int _targetNodeId )
+{
+    AppDebugAssert( _fromNodeId >= 0 && _fromNodeId < m_numNodes );
+    AppDebugAssert( _targetNodeId >= 0 && _targetNodeId < m_numNodes );
+
+    return m_distance[ _fromNodeId * m_numNodes + _targetNodeId ];
+}
+
+
+// hash_process byte swaps whole blocks of its input in place, so the
+// bitmaps (which the resource cache shares) are only ever hashed a copy at a time
+
+static void HashCopy( hash_context *_context, void const *_data, int _length )
+{
+    unsigned char block[1024];
+    unsigned char const *data = (unsigned char const *) _data;
+
+    while( _length > 0 )
+    {
+        int thisLength = ( _length < (int) sizeof(block) ? _length : (int) sizeof(block) );
+        memcpy( block, data, thisLength );
+        hash_process( _context, block, thisLength );
+
+        data += thisLength;
+        _length -= thisLength;
+    }
+}
+
+
+void RouteTable::GenerateKey( Bitmap *_travelNodes, Bitmap *_sailable, int _timeScaleFactor, unsigned int *_key )
+{
+    hash_context c;
+    hash_initial(&c);
+
+    Bitmap *bitmaps[2] = { _travelNodes, _sailable };
+    for( int i = 0; i < 2; ++i )
+    {
+        int size[2] = { bitmaps[i]->m_width, bitmaps[i]->m_height };
+        HashCopy( &c, size, sizeof(size) );
+        HashCopy( &c, bitmaps[i]->m_pixels, bitmaps[i]->m_width * bitmaps[i]->m_height * sizeof(Colour) );
+    }
+
+    // IsSailable steps in different increments depending on game speed
+    HashCopy( &c, &_timeScaleFactor, sizeof(_timeScaleFactor) );
+
+    uint32 hash[ROUTETABLE_KEYSIZE];
+    hash_final( &c, hash );
+
+    for( int i = 0; i < ROUTETABLE_KEYSIZE; ++i )
+    {
+        _key[i] = hash[i];
+    }
+}
@@ -0,0 +1,50 @@
+#ifndef _included_routetable_h
+#define _included_routetable_h
+
+#include "lib/math/fixed.h"
+
+class World;
+class Bitmap;
+class MappedFile;
+
+#define ROUTETABLE_VERSION      1
+#define ROUTETABLE_KEYSIZE      5
+
+
+/*
+ *  All-pairs shortest sea routes between travel nodes.
+ *
+ *  Compiled once with one Dijkstra search per node over the
+ *  IsSailable visibility graph, then written to a binary cache
+ *  keyed on the travel node and sailable bitmaps.  Later launches
+ *  map the cache straight back in.
+ *
+ */
+
+class RouteTable
+{
+protected:
+    int             m_numNodes;
+    Fixed           *m_distance;                // [from * m_numNodes + to]
+    int             *m_nextNode;                // [from * m_numNodes + to], -1 if unreachable
+    MappedFile      *m_cacheFile;               // Non-NULL if the arrays above live in a mapped cache
+
+public:
+    RouteTable();
+    ~RouteTable();
+
+    void    Clear       ();
+
+    void    Compile     ( World *_world );
+    bool    Load        ( char const *_filename, int _numNodes, unsigned int const *_key );
+    bool    Save        ( char const *_filename, unsigned int const *_key );
+
+    int     Size        ();
+    int     GetNextNode ( int _fromNodeId, int _targetNodeId );
+    Fixed   GetDistance ( int _fromNodeId, int _targetNodeId );
+
+    static void GenerateKey( Bitmap *_travelNodes, Bitmap *_sailable, int _timeScaleFactor, unsigned int *_key );
+};
+
+
+#endif
@@ -5,11 +5,11 @@
 #include "lib/math/vector3.h"
 #include "lib/math/random_number.h"
 #include "lib/language_table.h"
+#include "lib/tosser/directory.h"
 
 #include "app/app.h"
 #include "app/globals.h"
 
-#include "interface/interface.h"
 
 #include "world/world.h"
 #include "world/saucer.h"
@@ -213,3 +213,27 @@ void Saucer::GetNewTarget()
         m_leavingWorld = true;
     }
 }
+
+
+void Saucer::SaveSnapshot( Directory *_dir )
+{
+    MovingObject::SaveSnapshot( _dir );
+
+    _dir->CreateData( "explosionSize", m_explosionSize );
+    _dir->CreateData( "damageTimer", m_damageTimer );
+    _dir->CreateData( "angle", m_angle );
+    _dir->CreateData( "leavingWorld", m_leavingWorld );
+}
+
+
+void Saucer::LoadSnapshot( Directory *_dir )
+{
+    MovingObject::LoadSnapshot( _dir );
+
+    m_explosionSize = _dir->GetDataFixed( "explosionSize" );
+    m_damageTimer = _dir->GetDataFixed( "damageTimer" );
+    m_angle = _dir->GetDataFloat( "angle" );
+    m_leavingWorld = _dir->GetDataBool( "leavingWorld" );
+}
+
+
@@ -25,6 +25,8 @@ public:
 
     void    GetNewTarget    ();
 
+    void    SaveSnapshot    ( Directory *_dir );
+    void    LoadSnapshot    ( Directory *_dir );
 };
 
 
@@ -10,10 +10,8 @@
 #include "app/game.h"
 
 #include "lib/profiler.h"
+#include "lib/tosser/directory.h"
 
-#include "renderer/map_renderer.h"
-
-#include "interface/interface.h"
 
 #include "world/world.h"
 #include "world/silo.h"
@@ -404,7 +402,7 @@ void Silo::CeaseFire( int teamId )
     for( int i = 0; i < m_actionQueue.Size(); ++i )
     {
         ActionOrder *action = m_actionQueue[i];
-        if(g_app->GetMapRenderer()->IsValidTerritory( teamId, action->m_longitude, action->m_latitude, false ) )
+        if(g_app->GetWorld()->IsValidTerritory( teamId, action->m_longitude, action->m_latitude, false ) )
         {
             m_actionQueue.RemoveData(i);
             delete action;
@@ -413,3 +411,21 @@ void Silo::CeaseFire( int teamId )
     }
     WorldObject::CeaseFire( teamId );
 }
+
+
+void Silo::SaveSnapshot( Directory *_dir )
+{
+    WorldObject::SaveSnapshot( _dir );
+
+    _dir->CreateData( "numNukesLaunched", m_numNukesLaunched );
+}
+
+
+void Silo::LoadSnapshot( Directory *_dir )
+{
+    WorldObject::LoadSnapshot( _dir );
+
+    m_numNukesLaunched = _dir->GetDataInt( "numNukesLaunched" );
+}
+
+
@@ -31,6 +31,8 @@ public:
 
     void    CeaseFire       ( int teamId );
 
+    void    SaveSnapshot    ( Directory *_dir );
+    void    LoadSnapshot    ( Directory *_dir );
 };
 
 
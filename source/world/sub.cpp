@@ -8,11 +8,9 @@
 #include "app/globals.h"
 #include "app/game.h"
 
-#include "renderer/map_renderer.h"
-
 #include "lib/profiler.h"
+#include "lib/tosser/directory.h"
 
-#include "interface/interface.h"
 
 #include "world/world.h"
 #include "world/sub.h"
@@ -284,14 +282,15 @@ void Sub::RunAI()
                     int targetsInRange = 0;
                     Fixed maxRange = 40;
                     Fixed maxRangeSqd = 40 * 40;
+                    ObjectStore &store = g_app->GetWorld()->m_objectStore;
                     for( int i = 0; i < g_app->GetWorld()->m_objects.Size(); ++i )
                     {
-                        if( g_app->GetWorld()->m_objects.ValidIndex(i) )
+                        if( g_app->GetWorld()->m_objects.ValidIndex(i) &&
+                            !g_app->GetWorld()->IsFriend( store.m_teamId[i], m_teamId ) )
                         {
                             WorldObject *obj = g_app->GetWorld()->m_objects[i];
                             if( !obj->IsMovingObject() &&
                                 obj->m_seen[m_teamId] &&
-                                !g_app->GetWorld()->IsFriend( obj->m_teamId, m_teamId ) &&
                                 g_app->GetWorld()->GetDistanceSqd( m_longitude, m_latitude, obj->m_longitude, obj->m_latitude ) < maxRangeSqd )
                             {
                                 targetsInRange ++;
@@ -369,9 +368,12 @@ WorldObject *Sub::FindTarget()
     Team *team = g_app->GetWorld()->GetTeam( m_teamId );
     Fleet *fleet = team->GetFleet( m_fleetId );
 
-    int objectsSize = g_app->GetWorld()->m_objects.Size();
-    for( int i = 0; i < objectsSize; ++i )
+    LList<int> nearby;
+    g_app->GetWorld()->m_objectGrid.GetNearbySlots( m_longitude, m_latitude, 5, nearby );
+
+    for( int n = 0; n < nearby.Size(); ++n )
     {
+        int i = nearby[n];
         if( g_app->GetWorld()->m_objects.ValidIndex(i) )
         {
             WorldObject *obj = g_app->GetWorld()->m_objects[i];
@@ -467,9 +469,9 @@ void Sub::ChangePosition()
     {
         Fixed longitude = syncsfrand(360);
         Fixed latitude = syncsfrand(180);
-        if( !g_app->GetMapRenderer()->IsValidTerritory( m_teamId, longitude, latitude, true ) &&
-            g_app->GetMapRenderer()->IsValidTerritory( -1, longitude, latitude, false ) &&
-            g_app->GetMapRenderer()->GetTerritory( longitude, latitude, true ) != -1 )
+        if( !g_app->GetWorld()->IsValidTerritory( m_teamId, longitude, latitude, true ) &&
+            g_app->GetWorld()->IsValidTerritory( -1, longitude, latitude, false ) &&
+            g_app->GetWorld()->GetTerritoryOwner( longitude, latitude, true ) != -1 )
         {
             SetWaypoint( longitude, latitude );
             break;
@@ -637,3 +639,21 @@ bool Sub::IsSafeTarget( Fleet *_fleet )
     }
     return true;
 }
+
+
+void Sub::SaveSnapshot( Directory *_dir )
+{
+    MovingObject::SaveSnapshot( _dir );
+
+    _dir->CreateData( "hidden", m_hidden );
+}
+
+
+void Sub::LoadSnapshot( Directory *_dir )
+{
+    MovingObject::LoadSnapshot( _dir );
+
+    m_hidden = _dir->GetDataBool( "hidden" );
+}
+
+
@@ -38,6 +38,9 @@ public:
     int     GetAttackOdds           ( int _defenderType );
     int     IsValidCombatTarget     ( int _objectId );
     int     IsValidMovementTarget   ( Fixed longitude, Fixed latitude );
+
+    void    SaveSnapshot    ( Directory *_dir );
+    void    LoadSnapshot    ( Directory *_dir );
 };
 
 
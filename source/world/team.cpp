@@ -4,14 +4,14 @@
 #include "lib/math/math_utils.h"
 #include "lib/hi_res_time.h"
 #include "lib/profiler.h"
+#include "lib/tosser/directory.h"
 
 #include "app/globals.h"
 #include "app/app.h"
 #include "app/game.h"
 
 #include "network/ClientToServer.h"
-
-#include "renderer/map_renderer.h"
+#include "network/letter_codec.h"
 
 #include "world/team.h"
 #include "world/world.h"
@@ -58,7 +58,8 @@ Team::Team()
     m_unitCredits(53),
     m_randSeed(0),
     m_nameSet(false),
-    m_alwaysSolo(true)
+    m_alwaysSolo(true),
+    m_playerTeam(false)
 {
     m_unitsAvailable.Initialise( WorldObject::NumObjectTypes );
     m_unitsInPlay.Initialise( WorldObject::NumObjectTypes );
@@ -401,16 +402,16 @@ void Team::RunAI()
 
         //
         // Object AI 
+        // Ours are picked out from the ObjectStore, without loading everyone else's
         
+        ObjectStore &store = g_app->GetWorld()->m_objectStore;
         for( int i = 0; i < g_app->GetWorld()->m_objects.Size(); ++i )
         {
-            if( g_app->GetWorld()->m_objects.ValidIndex(i) )
+            if( g_app->GetWorld()->m_objects.ValidIndex(i) &&
+                store.m_teamId[i] == m_teamId )
             {
                 WorldObject *obj = g_app->GetWorld()->m_objects[i];
-                if( obj->m_teamId == m_teamId )
-                {
-                    obj->RunAI();
-                }
+                obj->RunAI();
             }
         }
     }
@@ -418,6 +419,47 @@ void Team::RunAI()
     END_PROFILE("TeamAI");
 }
 
+bool Team::PrepareThinkAI()
+{
+    //
+    // Only worth it if RunAI is going to act this time
+
+    Fixed timeScaleFactor = g_app->GetWorld()->GetTimeScaleFactor();
+    bool acting = ( timeScaleFactor != 0 &&
+                    m_aiActionTimer - SERVER_ADVANCE_PERIOD * timeScaleFactor <= 0 );
+
+    bool thinking = false;
+    for( int i = 0; i < m_fleets.Size(); ++i )
+    {
+        Fleet *fleet = m_fleets[i];
+        fleet->m_attackSpotThought.m_valid = false;
+        fleet->m_attackSpotThought.m_pending = false;
+
+        if( acting && fleet->PrepareAttackSpotThought() )
+        {
+            thinking = true;
+        }
+    }
+
+    return thinking;
+}
+
+
+void Team::ThinkAI( AISnapshot &_snapshot )
+{
+    // Only our own fleets are touched here, as other teams are thinking at the same time
+
+    for( int i = 0; i < m_fleets.Size(); ++i )
+    {
+        Fleet *fleet = m_fleets[i];
+        if( fleet->m_attackSpotThought.m_pending )
+        {
+            fleet->ThinkAttackSpot( _snapshot );
+        }
+    }
+}
+
+
 /////////////////////
 // Placement AI
 // Places all units
@@ -493,7 +535,7 @@ void Team::PlacementAI()
                 for( int i = 0; i < g_app->GetWorld()->m_aiPlacementPoints.Size(); ++i )
                 {
                     Vector3<Fixed> *point = g_app->GetWorld()->m_aiPlacementPoints[i];
-                    if( g_app->GetMapRenderer()->GetTerritory( point->x, point->y, true ) == m_teamId )
+                    if( g_app->GetWorld()->GetTerritoryOwner( point->x, point->y, true ) == m_teamId )
                     {
                         //Fixed distance = Fixed::MAX;
                         //for( int j = 0; j < m_fleets.Size(); ++j )
@@ -640,8 +682,8 @@ void Team::PlacementAI()
                         }
                         
                         if( g_app->GetWorld()->IsValidPlacement( m_teamId, longitude, latitude, objectPriority ) &&
-                            g_app->GetMapRenderer()->IsCoastline( longitude, latitude ) &&
-                            g_app->GetMapRenderer()->IsValidTerritory( m_teamId, longitude, latitude, false ))
+                            g_app->GetWorld()->m_geography.m_terrain.IsCoastline( longitude, latitude ) &&
+                            g_app->GetWorld()->IsValidTerritory( m_teamId, longitude, latitude, false ))
                         {
                             if( g_app->GetWorld()->GetDistanceSqd( longitude, latitude, 
                                                                     g_app->GetWorld()->m_populationCenter[randTerritory].x, 
@@ -1001,7 +1043,7 @@ bool Team::GetUncoveredArea( bool radar, Fixed *longitude, Fixed *latitude )
 
         if( obj )
         {
-            if( g_app->GetMapRenderer()->IsValidTerritory( m_teamId, randLong, randLat, false ) &&
+            if( g_app->GetWorld()->IsValidTerritory( m_teamId, randLong, randLat, false ) &&
                 g_app->GetWorld()->GetDistance( randLong, randLat, obj->m_longitude, obj->m_latitude ) > distance )
             {
                 *longitude = randLong;
@@ -1239,24 +1281,23 @@ Event *Team::GetEvent( int id )
 int Team::CountTargettedUnits( int targetId )
 {
     int num = 0;
+    ObjectStore &store = g_app->GetWorld()->m_objectStore;
     for( int i = 0; i < g_app->GetWorld()->m_objects.Size(); ++i )
     {
-        if( g_app->GetWorld()->m_objects.ValidIndex(i) )
+        if( g_app->GetWorld()->m_objects.ValidIndex(i) &&
+            store.m_teamId[i] == m_teamId )
         {
             WorldObject *obj = g_app->GetWorld()->m_objects[i];
-            if( obj->m_teamId == m_teamId )
+            if( obj->m_targetObjectId == targetId )
             {
-                if( obj->m_targetObjectId == targetId )
+                num++;
+            }
+            for( int j = 0; j < obj->m_actionQueue.Size(); ++j )
+            {
+                if( obj->m_actionQueue[j]->m_targetObjectId == targetId )
                 {
                     num++;
                 }
-                for( int j = 0; j < obj->m_actionQueue.Size(); ++j )
-                {
-                    if( obj->m_actionQueue[j]->m_targetObjectId == targetId )
-                    {
-                        num++;
-                    }
-                }
             }
         }
     }
@@ -1266,16 +1307,17 @@ int Team::CountTargettedUnits( int targetId )
 int Team::GetNumTargets()
 {
     int num = 0;
+    ObjectStore &store = g_app->GetWorld()->m_objectStore;
     for( int i = 0; i < g_app->GetWorld()->m_objects.Size(); ++i )
     {
         if( g_app->GetWorld()->m_objects.ValidIndex(i) )
         {
-            WorldObject *obj = g_app->GetWorld()->m_objects[i];
-            if( !g_app->GetWorld()->IsFriend(obj->m_teamId, m_teamId ) &&
-                ( obj->m_visible[m_teamId] || obj->m_seen[m_teamId] ) &&
-                ( obj->m_type == WorldObject::TypeSilo ||
-                  obj->m_type == WorldObject::TypeRadarStation ||
-                  obj->m_type == WorldObject::TypeAirBase ) )           
+            int type = store.m_type[i];
+            if( ( type == WorldObject::TypeSilo ||
+                  type == WorldObject::TypeRadarStation ||
+                  type == WorldObject::TypeAirBase ) &&
+                !g_app->GetWorld()->IsFriend( store.m_teamId[i], m_teamId ) &&
+                ( store.IsVisible( i, m_teamId ) || g_app->GetWorld()->m_objects[i]->m_seen[m_teamId] ) )
             {
                 num++;
             }
@@ -1370,3 +1412,179 @@ Fleet *Team::GetFleet( int fleetId )
 }
 
 
+void Team::SaveSnapshot( Directory *_dir )
+{
+    _dir->CreateData( "type", m_type );
+    _dir->CreateData( "clientId", m_clientId );
+    _dir->CreateData( "teamId", m_teamId );
+    _dir->CreateData( "allianceId", m_allianceId );
+    _dir->CreateData( "randSeed", m_randSeed );
+    _dir->CreateData( "name", m_name );
+    _dir->CreateData( "nameSet", m_nameSet );
+    _dir->CreateData( "readyToStart", m_readyToStart );
+    _dir->CreateData( "desiredGameSpeed", m_desiredGameSpeed );
+    _dir->CreateData( "playerTeam", m_playerTeam );
+
+    _dir->CreateData( "enemyKills", m_enemyKills );
+    _dir->CreateData( "friendlyDeaths", m_friendlyDeaths );
+    _dir->CreateData( "collatoralDamage", m_collatoralDamage );
+
+    _dir->CreateData( "aiActionTimer", m_aiActionTimer );
+    _dir->CreateData( "aiActionSpeed", m_aiActionSpeed );
+    _dir->CreateData( "aggression", m_aggression );
+    _dir->CreateData( "aiAssaultTimer", m_aiAssaultTimer );
+    _dir->CreateData( "targetsVisible", m_targetsVisible );
+    _dir->CreateData( "maxTargetsSeen", m_maxTargetsSeen );
+
+    LetterCodec::WriteInts( _dir, "unitsAvailable", &m_unitsAvailable[0], m_unitsAvailable.Size() );
+    LetterCodec::WriteInts( _dir, "unitsInPlay", &m_unitsInPlay[0], m_unitsInPlay.Size() );
+    _dir->CreateData( "unitCredits", m_unitCredits );
+
+    _dir->CreateData( "numTerritories", m_numTerritories );
+    LetterCodec::WriteIntList( _dir, "territories", &m_territories );
+
+    _dir->CreateData( "currentState", m_currentState );
+    _dir->CreateData( "subState", m_subState );
+    _dir->CreateData( "previousState", m_previousState );
+    _dir->CreateData( "aiStateTimer", m_aiStateTimer );
+    _dir->CreateData( "siloSwitchTimer", m_siloSwitchTimer );
+
+    _dir->CreateData( "targetTeam", m_targetTeam );
+    _dir->CreateData( "validTargetPopulation", m_validTargetPopulation );
+    _dir->CreateData( "teamColourFader", m_teamColourFader );
+
+    int ceaseFire[MAX_TEAMS];
+    int sharingRadar[MAX_TEAMS];
+    for( int t = 0; t < MAX_TEAMS; ++t )
+    {
+        ceaseFire[t] = m_ceaseFire[t];
+        sharingRadar[t] = m_sharingRadar[t];
+    }
+    LetterCodec::WriteInts( _dir, "ceaseFire", ceaseFire, MAX_TEAMS );
+    LetterCodec::WriteInts( _dir, "sharingRadar", sharingRadar, MAX_TEAMS );
+    _dir->CreateData( "leftAllianceTimer", (void *) &m_leftAllianceTimer[0], MAX_TEAMS * sizeof(float) );
+    _dir->CreateData( "alwaysSolo", m_alwaysSolo );
+
+
+    //
+    // Fleets keep their index as their id, so go in order
+
+    for( int i = 0; i < m_fleets.Size(); ++i )
+    {
+        Directory *fleetDir = new Directory();
+        fleetDir->SetName( "fleet" );
+        m_fleets[i]->SaveSnapshot( fleetDir );
+        _dir->AddDirectory( fleetDir );
+    }
+
+    for( int i = 0; i < m_eventLog.Size(); ++i )
+    {
+        Event *event = m_eventLog[i];
+
+        Directory *eventDir = new Directory();
+        eventDir->SetName( "event" );
+        eventDir->CreateData( "type", event->m_type );
+        eventDir->CreateData( "objectId", event->m_objectId );
+        eventDir->CreateData( "actionTaken", event->m_actionTaken );
+        eventDir->CreateData( "teamId", event->m_teamId );
+        eventDir->CreateData( "fleetId", event->m_fleetId );
+        eventDir->CreateData( "longitude", event->m_longitude );
+        eventDir->CreateData( "latitude", event->m_latitude );
+        _dir->AddDirectory( eventDir );
+    }
+}
+
+
+void Team::LoadSnapshot( Directory *_dir )
+{
+    m_clientId = _dir->GetDataInt( "clientId" );
+    m_teamId = _dir->GetDataInt( "teamId" );
+    m_allianceId = _dir->GetDataInt( "allianceId" );
+    m_randSeed = _dir->GetDataInt( "randSeed" );
+    SetTeamName( _dir->GetDataString( "name" ) );
+    m_nameSet = _dir->GetDataBool( "nameSet" );
+    m_readyToStart = _dir->GetDataBool( "readyToStart" );
+    m_desiredGameSpeed = _dir->GetDataInt( "desiredGameSpeed" );
+    m_playerTeam = _dir->GetDataBool( "playerTeam" );
+
+    m_enemyKills = _dir->GetDataInt( "enemyKills" );
+    m_friendlyDeaths = _dir->GetDataInt( "friendlyDeaths" );
+    m_collatoralDamage = _dir->GetDataInt( "collatoralDamage" );
+
+    m_aiActionTimer = _dir->GetDataFixed( "aiActionTimer" );
+    m_aiActionSpeed = _dir->GetDataFixed( "aiActionSpeed" );
+    m_aggression = _dir->GetDataInt( "aggression" );
+    m_aiAssaultTimer = _dir->GetDataFixed( "aiAssaultTimer" );
+    m_targetsVisible = _dir->GetDataInt( "targetsVisible" );
+    m_maxTargetsSeen = _dir->GetDataInt( "maxTargetsSeen" );
+
+    LetterCodec::ReadInts( _dir, "unitsAvailable", &m_unitsAvailable[0], m_unitsAvailable.Size() );
+    LetterCodec::ReadInts( _dir, "unitsInPlay", &m_unitsInPlay[0], m_unitsInPlay.Size() );
+    m_unitCredits = _dir->GetDataInt( "unitCredits" );
+
+    m_numTerritories = _dir->GetDataInt( "numTerritories" );
+    m_territories.Empty();
+    LetterCodec::ReadIntList( _dir, "territories", &m_territories );
+
+    m_currentState = _dir->GetDataInt( "currentState" );
+    m_subState = _dir->GetDataInt( "subState" );
+    m_previousState = _dir->GetDataInt( "previousState" );
+    m_aiStateTimer = _dir->GetDataFixed( "aiStateTimer" );
+    m_siloSwitchTimer = _dir->GetDataFixed( "siloSwitchTimer" );
+
+    m_targetTeam = _dir->GetDataInt( "targetTeam" );
+    m_validTargetPopulation = _dir->GetDataInt( "validTargetPopulation" );
+    m_teamColourFader = _dir->GetDataFloat( "teamColourFader" );
+
+    int ceaseFire[MAX_TEAMS];
+    int sharingRadar[MAX_TEAMS];
+    memset( ceaseFire, 0, sizeof(ceaseFire) );
+    memset( sharingRadar, 0, sizeof(sharingRadar) );
+    LetterCodec::ReadInts( _dir, "ceaseFire", ceaseFire, MAX_TEAMS );
+    LetterCodec::ReadInts( _dir, "sharingRadar", sharingRadar, MAX_TEAMS );
+    for( int t = 0; t < MAX_TEAMS; ++t )
+    {
+        m_ceaseFire[t] = ( ceaseFire[t] != 0 );
+        m_sharingRadar[t] = ( sharingRadar[t] != 0 );
+    }
+
+    int timerLength = 0;
+    float *leftAllianceTimer = (float *) _dir->GetDataVoid( "leftAllianceTimer", &timerLength );
+    if( leftAllianceTimer && timerLength == MAX_TEAMS * sizeof(float) )
+    {
+        memcpy( &m_leftAllianceTimer[0], leftAllianceTimer, timerLength );
+    }
+    m_alwaysSolo = _dir->GetDataBool( "alwaysSolo" );
+
+
+    m_fleets.EmptyAndDelete();
+    m_eventLog.EmptyAndDelete();
+
+    for( int i = 0; i < _dir->m_subDirectories.Size(); ++i )
+    {
+        if( !_dir->m_subDirectories.ValidIndex(i) ) continue;
+        Directory *subDir = _dir->m_subDirectories[i];
+
+        if( strcmp( subDir->m_name, "fleet" ) == 0 )
+        {
+            Fleet *fleet = new Fleet();
+            fleet->LoadSnapshot( subDir );
+            fleet->m_fleetId = m_fleets.Size();
+            fleet->m_teamId = m_teamId;
+            m_fleets.PutDataAtEnd( fleet );
+        }
+        else if( strcmp( subDir->m_name, "event" ) == 0 )
+        {
+            Event *event = new Event();
+            event->m_type = subDir->GetDataInt( "type" );
+            event->m_objectId = subDir->GetDataInt( "objectId" );
+            event->m_actionTaken = subDir->GetDataInt( "actionTaken" );
+            event->m_teamId = subDir->GetDataInt( "teamId" );
+            event->m_fleetId = subDir->GetDataInt( "fleetId" );
+            event->m_longitude = subDir->GetDataFixed( "longitude" );
+            event->m_latitude = subDir->GetDataFixed( "latitude" );
+            m_eventLog.PutDataAtEnd( event );
+        }
+    }
+}
+
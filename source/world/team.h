@@ -12,6 +12,8 @@
 
 class Fleet;
 class Event;
+class AISnapshot;
+class Directory;
 
 class Team
 {
@@ -100,6 +102,7 @@ public:
 
     BoundedArray<float> m_leftAllianceTimer;    // achievement tracking only
     bool    m_alwaysSolo;
+    bool    m_playerTeam;       // Joined by a player, even if the AI has since taken over
     
 public:
     Team();
@@ -112,6 +115,8 @@ public:
 
     void CheckPanicState    ();
 	void RunAI			    ();
+    bool PrepareThinkAI     ();                                 // Main thread, before ThinkAI.  False if there is nothing to think about
+    void ThinkAI            ( AISnapshot &_snapshot );          // Any thread, see AIThink
     void PlacementAI        ();
     void ScoutingAI         ();
     void AssaultAI          ();
@@ -149,6 +154,9 @@ public:
     void AddEvent( int type, int objectId, int teamId, int fleetId, Fixed longitude, Fixed latitude );
     void DeleteEvent( int id );
     Event *GetEvent( int id );
+
+    void SaveSnapshot       ( Directory *_dir );
+    void LoadSnapshot       ( Directory *_dir );                // Not m_type, see WorldSnapshot
 };
 
 
@@ -0,0 +1,286 @@
+#include "lib/universal_include.h"
+
+#include <string.h>
+
+#include "lib/debug_utils.h"
+#include "lib/resource/image.h"
+#include "lib/render/colour.h"
+
+#include "world/terrain_map.h"
+
+
+TerrainMask::TerrainMask()
+:   m_width(0),
+    m_height(0),
+    m_pitch(0),
+    m_bits(NULL)
+{
+}
+
+
+TerrainMask::~TerrainMask()
+{
+    Clear();
+}
+
+
+void TerrainMask::Initialise( int _width, int _height )
+{
+    Clear();
+
+    m_width = _width;
+    m_height = _height;
+    m_pitch = ( _width + 31 ) / 32;
+    m_bits = new UInt32[ m_pitch * m_height ];
+    memset( m_bits, 0, m_pitch * m_height * sizeof(UInt32) );
+}
+
+
+void TerrainMask::Clear()
+{
+    delete [] m_bits;
+    m_bits = NULL;
+    m_width = 0;
+    m_height = 0;
+    m_pitch = 0;
+}
+
+
+void TerrainMask::GetPixel( Fixed const &_longitude, Fixed const &_latitude, int &_x, int &_y )
+{
+    _x = ( m_width * (_longitude+180)/360 ).IntValue();
+    _y = ( m_height * (_latitude+100)/200 ).IntValue();
+}
+
+
+bool TerrainMask::SameSize( TerrainMask const &_other ) const
+{
+    return( m_width == _other.m_width &&
+            m_height == _other.m_height );
+}
+
+
+void TerrainMask::Set( int _x, int _y )
+{
+    AppDebugAssert( _x >= 0 && _x < m_width && _y >= 0 && _y < m_height );
+    m_bits[ _y * m_pitch + (_x >> 5) ] |= ( 1u << (_x & 31) );
+}
+
+
+// ============================================================================
+
+
+TerrainMap::TerrainMap()
+:   m_numTerritories(0),
+    m_territory(NULL),
+    m_territoryLand(NULL),
+    m_territorySea(NULL)
+{
+}
+
+
+TerrainMap::~TerrainMap()
+{
+    Clear();
+}
+
+
+void TerrainMap::Clear()
+{
+    m_sailable.Clear();
+    m_coastline.Clear();
+
+    delete [] m_territory;
+    delete [] m_territoryLand;
+    delete [] m_territorySea;
+    m_territory = NULL;
+    m_territoryLand = NULL;
+    m_territorySea = NULL;
+    m_numTerritories = 0;
+}
+
+
+void TerrainMap::BuildMask( TerrainMask &_mask, Image *_image, int _threshold )
+{
+    _mask.Initialise( _image->Width(), _image->Height() );
+
+    for( int y = 0; y < _image->Height(); ++y )
+    {
+        for( int x = 0; x < _image->Width(); ++x )
+        {
+            Colour col = _image->GetColour( x, y );
+            if( col.m_r > _threshold &&
+                col.m_g > _threshold &&
+                col.m_b > _threshold )
+            {
+                _mask.Set( x, y );
+            }
+        }
+    }
+}
+
+
+void TerrainMap::Initialise( Image *_sailable, Image *_coastlines, Image **_territories, int _numTerritories )
+{
+    Clear();
+
+    BuildMask( m_sailable, _sailable, 20 );
+    BuildMask( m_coastline, _coastlines, 20 );
+
+    m_numTerritories = _numTerritories;
+    m_territory = new TerrainMask[ _numTerritories ];
+    m_territoryLand = new TerrainMask[ _numTerritories ];
+    m_territorySea = new TerrainMask[ _numTerritories ];
+
+    int landThreshold = 130;
+    int waterThreshold = 60;
+
+    for( int i = 0; i < _numTerritories; ++i )
+    {
+        Image *img = _territories[i];
+        AppReleaseAssert( img, "Missing territory bitmap %d", i );
+
+        BuildMask( m_territory[i], img, 20 );
+        m_territoryLand[i].Initialise( img->Width(), img->Height() );
+        m_territorySea[i].Initialise( img->Width(), img->Height() );
+
+        //
+        // The sailable bitmap is sampled at the territory bitmap's pixel,
+        // as the territory tests always have
+
+        for( int y = 0; y < img->Height(); ++y )
+        {
+            for( int x = 0; x < img->Width(); ++x )
+            {
+                Colour theCol = img->GetColour( x, y );
+                Colour sailableCol = _sailable->GetColour( x, y );
+
+                if( theCol.m_r > landThreshold &&
+                    theCol.m_g > landThreshold &&
+                    theCol.m_b > landThreshold &&
+                    sailableCol.m_r <= waterThreshold &&
+                    sailableCol.m_g <= waterThreshold &&
+                    sailableCol.m_b <= waterThreshold )
+                {
+                    m_territoryLand[i].Set( x, y );
+                }
+
+                if( theCol.m_r > waterThreshold &&
+                    theCol.m_g > waterThreshold &&
+                    theCol.m_b > waterThreshold &&
+                    sailableCol.m_r > waterThreshold &&
+                    sailableCol.m_g > waterThreshold &&
+                    sailableCol.m_b > waterThreshold )
+                {
+                    m_territorySea[i].Set( x, y );
+                }
+            }
+        }
+    }
+}
+
+
+bool TerrainMap::IsSailable( Fixed longitude, Fixed latitude )
+{
+    if( latitude > 100 || latitude < -100 )
+    {
+        return false;
+    }
+
+    if( longitude < -180 )
+    {
+        longitude = -180;
+    }
+    else if( longitude > 180 )
+    {
+        longitude = 179;
+    }
+
+    int pixelX, pixelY;
+    m_sailable.GetPixel( longitude, latitude, pixelX, pixelY );
+    return m_sailable.Get( pixelX, pixelY );
+}
+
+
+bool TerrainMap::IsValidTerritory( int territoryId, Fixed longitude, Fixed latitude, bool seaUnit )
+{
+    if( territoryId < 0 || territoryId >= m_numTerritories )
+    {
+        return false;
+    }
+
+    if( latitude > 100 || latitude < -100 )
+    {
+        return false;
+    }
+
+    if( longitude < -180 )
+    {
+        longitude = -180;
+    }
+    else if( longitude > 180 )
+    {
+        longitude = 179;
+    }
+
+    TerrainMask &mask = seaUnit ? m_territorySea[territoryId] : m_territoryLand[territoryId];
+
+    int pixelX, pixelY;
+    mask.GetPixel( longitude, latitude, pixelX, pixelY );
+    return mask.Get( pixelX, pixelY );
+}
+
+
+bool TerrainMap::IsCoastline( Fixed const &longitude, Fixed const &latitude )
+{
+    int pixelX, pixelY;
+    m_coastline.GetPixel( longitude, latitude, pixelX, pixelY );
+    return m_coastline.Get( pixelX, pixelY );
+}
+
+
+int TerrainMap::GetTerritoryId( Fixed const &longitude, Fixed const &latitude )
+{
+    int pixelX = 0;
+    int pixelY = 0;
+
+    for( int i = 0; i < m_numTerritories; ++i )
+    {
+        if( i == 0 || !m_territory[i].SameSize( m_territory[i-1] ) )
+        {
+            m_territory[i].GetPixel( longitude, latitude, pixelX, pixelY );
+        }
+
+        if( m_territory[i].Get( pixelX, pixelY ) )
+        {
+            return i;
+        }
+    }
+    return -1;
+}
+
+
+int TerrainMap::GetTerritoryIdUnique( Fixed const &longitude, Fixed const &latitude )
+{
+    int pixelX = 0;
+    int pixelY = 0;
+    int prevTerritory = -1;
+
+    for( int i = 0; i < m_numTerritories; ++i )
+    {
+        if( i == 0 || !m_territory[i].SameSize( m_territory[i-1] ) )
+        {
+            m_territory[i].GetPixel( longitude, latitude, pixelX, pixelY );
+        }
+
+        if( m_territory[i].Get( pixelX, pixelY ) )
+        {
+            if( prevTerritory != -1 )
+            {
+                return -1;
+            }
+            prevTerritory = i;
+        }
+    }
+    return prevTerritory;
+}
@@ -0,0 +1,94 @@
+#ifndef _included_terrainmap_h
+#define _included_terrainmap_h
+
+#include "lib/math/fixed.h"
+
+class Image;
+
+
+/*
+ *  One bit per pixel of an earth bitmap, set where the pixel
+ *  passed a colour threshold test when the bitmap was loaded.
+ *  Pixels outside the bitmap read as clear, matching the
+ *  black returned by Image::GetColour.
+ *
+ */
+
+class TerrainMask
+{
+protected:
+    int     m_width;
+    int     m_height;
+    int     m_pitch;                                // UInt32 words per row
+    UInt32  *m_bits;
+
+public:
+    TerrainMask();
+    ~TerrainMask();
+
+    void    Initialise  ( int _width, int _height );
+    void    Clear       ();
+
+    void    GetPixel    ( Fixed const &_longitude, Fixed const &_latitude, int &_x, int &_y );
+    bool    SameSize    ( TerrainMask const &_other ) const;
+
+    void    Set         ( int _x, int _y );
+    bool    Get         ( int _x, int _y ) const;
+};
+
+
+// ============================================================================
+
+
+/*
+ *  Packed copies of the earth bitmaps used by the simulation
+ *  (sailable water, coastlines and the territories), answering
+ *  the same questions as sampling the bitmaps directly.
+ *
+ */
+
+class TerrainMap
+{
+protected:
+    TerrainMask m_sailable;                         // sailable.bmp brighter than 20
+    TerrainMask m_coastline;                        // coastlines.bmp brighter than 20
+
+    int         m_numTerritories;
+    TerrainMask *m_territory;                       // Territory brighter than 20
+    TerrainMask *m_territoryLand;                   // Territory brighter than 130, sailable no brighter than 60
+    TerrainMask *m_territorySea;                    // Territory and sailable both brighter than 60
+
+    static void BuildMask( TerrainMask &_mask, Image *_image, int _threshold );
+
+public:
+    TerrainMap();
+    ~TerrainMap();
+
+    void    Initialise          ( Image *_sailable, Image *_coastlines, Image **_territories, int _numTerritories );
+    void    Clear               ();
+
+    bool    IsSailable          ( Fixed longitude, Fixed latitude );
+    bool    IsValidTerritory    ( int territoryId, Fixed longitude, Fixed latitude, bool seaUnit );
+    bool    IsCoastline         ( Fixed const &longitude, Fixed const &latitude );
+
+    int     GetTerritoryId      ( Fixed const &longitude, Fixed const &latitude );
+    int     GetTerritoryIdUnique( Fixed const &longitude, Fixed const &latitude );
+};
+
+
+// ============================================================================
+
+
+inline bool TerrainMask::Get( int _x, int _y ) const
+{
+    if( _x < 0 || _x >= m_width ||
+        _y < 0 || _y >= m_height )
+    {
+        return false;
+    }
+
+    return( ( m_bits[ _y * m_pitch + (_x >> 5) ] >> (_x & 31) ) & 1 );
+}
+
+
+#endif
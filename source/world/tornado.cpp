@@ -7,13 +7,11 @@
 #include "lib/render/renderer.h"
 #include "lib/math/vector3.h"
 #include "lib/math/random_number.h"
+#include "lib/tosser/directory.h"
 
 #include "app/app.h"
 #include "app/globals.h"
 
-#include "renderer/map_renderer.h"
-
-#include "interface/interface.h"
 
 #include "world/world.h"
 #include "world/tornado.h"
@@ -50,11 +48,12 @@ void Tornado::Action( int targetObjectId, float longitude, float latitude )
 
 bool Tornado::Update()
 {   
+	ObjectStore &store = g_app->GetWorld()->m_objectStore;
 	for(int i = 0; i < g_app->GetWorld()->m_objects.Size(); ++i)
 	{
 		if( g_app->GetWorld()->m_objects.ValidIndex(i) )
 		{
-			if( g_app->GetWorld()->m_objects[i]->m_type == WorldObject::TypeNuke )
+			if( store.m_type[i] == WorldObject::TypeNuke )
 			{
 				Nuke *nuke = (Nuke *)g_app->GetWorld()->m_objects[i];
 				Fixed distance = g_app->GetWorld()->GetDistance( m_longitude, m_latitude, nuke->m_longitude, nuke->m_latitude);
@@ -140,3 +139,35 @@ void Tornado::GetNewTarget()
 	Fixed targetLatitude = syncsfrand(180);  
     SetWaypoint( targetLongitude, targetLatitude );
 }
+
+
+void Tornado::SaveSnapshot( Directory *_dir )
+{
+    MovingObject::SaveSnapshot( _dir );
+
+    _dir->CreateData( "tornadoTargetObjectId", m_targetObjectId );
+    _dir->CreateData( "totalDistance", m_totalDistance );
+    _dir->CreateData( "curveDirection", m_curveDirection );
+    _dir->CreateData( "prevDistanceToTarget", m_prevDistanceToTarget );
+    _dir->CreateData( "newLongitude", m_newLongitude );
+    _dir->CreateData( "newLatitude", m_newLatitude );
+    _dir->CreateData( "angle", m_angle );
+    _dir->CreateData( "size", m_size );
+}
+
+
+void Tornado::LoadSnapshot( Directory *_dir )
+{
+    MovingObject::LoadSnapshot( _dir );
+
+    m_targetObjectId = _dir->GetDataInt( "tornadoTargetObjectId" );
+    m_totalDistance = _dir->GetDataFixed( "totalDistance" );
+    m_curveDirection = _dir->GetDataFixed( "curveDirection" );
+    m_prevDistanceToTarget = _dir->GetDataFixed( "prevDistanceToTarget" );
+    m_newLongitude = _dir->GetDataFixed( "newLongitude" );
+    m_newLatitude = _dir->GetDataFixed( "newLatitude" );
+    m_angle = _dir->GetDataFloat( "angle" );
+    m_size = _dir->GetDataFixed( "size" );
+}
+
+
@@ -37,6 +37,8 @@ public:
 
     void    GetNewTarget    ();
 
+    void    SaveSnapshot    ( Directory *_dir );
+    void    LoadSnapshot    ( Directory *_dir );
 };
 
 
@@ -1,20 +1,20 @@
 #include "lib/universal_include.h"
 #include "lib/hi_res_time.h"
 #include "lib/resource/resource.h"
+#include "lib/tosser/directory.h"
 
 #include "world/votingsystem.h"
 #include "world/world.h"
 
+#include "network/letter_codec.h"
+
 #include "app/globals.h"
 #include "app/app.h"
 #include "app/game.h"
 #include "app/statusicon.h"
 
-#include "lib/eclipse/eclipse.h"
 #include "lib/language_table.h"
 
-#include "interface/alliances_window.h"
-#include "interface/interface.h"
 
 
 
@@ -106,18 +106,7 @@ void VotingSystem::RegisterNewVote( int _createTeamId, int _voteType, int _voteD
 
     if( canSeeVote )
     {
-        if( !EclGetWindow("Alliances") )
-        {
-            EclRegisterWindow( new AlliancesWindow() );
-        }
-
-        VotingWindow *vote = (VotingWindow *) EclGetWindow("Vote");
-        if( !vote || vote->m_voteId != voteId )
-        {
-            VotingWindow *window = new VotingWindow();
-            window->m_voteId = voteId;
-            EclRegisterWindow( window );
-        }
+        g_app->GetWorld()->GetView()->ShowVote( voteId );
     }
 }
 
@@ -393,7 +382,7 @@ void Vote::Finish( int _result )
         }
 
         strupr( msg );
-        g_app->GetInterface()->ShowMessage( 0, 0, -1, msg, true );
+        g_app->GetWorld()->GetView()->ShowMessage( 0, 0, -1, msg, true );
         
         if( g_app->m_hidden )
         {
@@ -427,3 +416,62 @@ void Vote::Finish( int _result )
         }
     }
 }
+
+
+void VotingSystem::SaveSnapshot( Directory *_dir )
+{
+    _dir->CreateData( "updateTimer", m_updateTimer );
+
+    for( int i = 0; i < m_votes.Size(); ++i )
+    {
+        if( m_votes.ValidIndex(i) )
+        {
+            Vote *vote = m_votes[i];
+
+            Directory *voteDir = new Directory();
+            voteDir->SetName( "vote" );
+            voteDir->CreateData( "voteId", i );
+            voteDir->CreateData( "createTeamId", vote->m_createTeamId );
+            voteDir->CreateData( "voteType", vote->m_voteType );
+            voteDir->CreateData( "voteData", vote->m_voteData );
+            voteDir->CreateData( "timer", vote->m_timer );
+            LetterCodec::WriteInts( voteDir, "votes", &vote->m_votes[0], vote->m_votes.Size() );
+            voteDir->CreateData( "result", vote->m_result );
+            voteDir->CreateData( "resultYes", vote->m_resultYes );
+            voteDir->CreateData( "resultNo", vote->m_resultNo );
+            voteDir->CreateData( "resultAbstain", vote->m_resultAbstain );
+            _dir->AddDirectory( voteDir );
+        }
+    }
+}
+
+
+void VotingSystem::LoadSnapshot( Directory *_dir )
+{
+    m_updateTimer = _dir->GetDataFixed( "updateTimer" );
+
+    m_votes.EmptyAndDelete();
+
+    for( int i = 0; i < _dir->m_subDirectories.Size(); ++i )
+    {
+        if( !_dir->m_subDirectories.ValidIndex(i) ) continue;
+        Directory *voteDir = _dir->m_subDirectories[i];
+        if( strcmp( voteDir->m_name, "vote" ) != 0 ) continue;
+
+        int voteId = voteDir->GetDataInt( "voteId" );
+        if( voteId < 0 || m_votes.ValidIndex(voteId) ) continue;
+
+        Vote *vote = new Vote();
+        vote->m_createTeamId = voteDir->GetDataInt( "createTeamId" );
+        vote->m_voteType = voteDir->GetDataInt( "voteType" );
+        vote->m_voteData = voteDir->GetDataInt( "voteData" );
+        vote->m_timer = voteDir->GetDataFloat( "timer" );
+        LetterCodec::ReadInts( voteDir, "votes", &vote->m_votes[0], vote->m_votes.Size() );
+        vote->m_result = voteDir->GetDataInt( "result" );
+        vote->m_resultYes = voteDir->GetDataInt( "resultYes" );
+        vote->m_resultNo = voteDir->GetDataInt( "resultNo" );
+        vote->m_resultAbstain = voteDir->GetDataInt( "resultAbstain" );
+        m_votes.PutData( vote, voteId );
+    }
+}
+
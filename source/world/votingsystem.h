@@ -6,6 +6,7 @@
 #include "lib/math/fixed.h"
 
 class Vote;
+class Directory;
 
 
 // ============================================================================
@@ -28,6 +29,9 @@ public:
     void CastVote           ( int _teamId, int _voteId, int _vote );
 
     Vote    *LookupVote     ( int _voteId );
+
+    void    SaveSnapshot    ( Directory *_dir );
+    void    LoadSnapshot    ( Directory *_dir );
 };
 
 
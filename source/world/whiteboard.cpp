@@ -4,12 +4,14 @@
 
 #include "lib/debug_utils.h"
 #include "lib/math/math_utils.h"
+#include "lib/tosser/directory.h"
 
 #include "app/globals.h"
 #include "app/app.h"
 #include "app/game.h"
 
 #include "network/ClientToServer.h"
+#include "network/letter_codec.h"
 
 #include "world/world.h"
 #include "world/whiteboard.h"
@@ -631,3 +633,62 @@ WhiteBoardPoint::WhiteBoardPoint( int id, float longitude, float latitude, bool
 	m_startPoint(startPoint)
 {
 }
+
+void WhiteBoard::SaveSnapshot( Directory *_dir )
+{
+	int sizePoints = m_points.Size();
+	int *ids = new int[sizePoints + 1];
+	int *startPoints = new int[sizePoints + 1];
+	float *positions = new float[2 * sizePoints + 1];
+
+	for ( int i = 0; i < sizePoints; i++ )
+	{
+		WhiteBoardPoint *pt = m_points.GetData( i );
+		ids[i] = pt->m_id;
+		startPoints[i] = pt->m_startPoint;
+		positions[2 * i] = pt->m_longitude;
+		positions[2 * i + 1] = pt->m_latitude;
+	}
+
+	_dir->CreateData( "nextPointId", m_nextPointId );
+	LetterCodec::WriteInts( _dir, "ids", ids, sizePoints );
+	LetterCodec::WriteInts( _dir, "startPoints", startPoints, sizePoints );
+	_dir->CreateData( "positions", (void *) positions, 2 * sizePoints * sizeof(float) );
+
+	delete [] ids;
+	delete [] startPoints;
+	delete [] positions;
+}
+
+void WhiteBoard::LoadSnapshot( Directory *_dir )
+{
+	int sizePoints = m_points.Size();
+	for ( int i = 0; i < sizePoints; i++ )
+	{
+		delete m_points.GetData( i );
+	}
+	m_points.Empty();
+	m_hasChanged = true;
+
+	m_nextPointId = _dir->GetDataInt( "nextPointId" );
+
+	int positionsLength = 0;
+	float *positions = (float *) _dir->GetDataVoid( "positions", &positionsLength );
+	sizePoints = positions ? positionsLength / ( 2 * sizeof(float) ) : 0;
+
+	int *ids = new int[sizePoints + 1];
+	int *startPoints = new int[sizePoints + 1];
+	if ( LetterCodec::ReadInts( _dir, "ids", ids, sizePoints ) != sizePoints ||
+	     LetterCodec::ReadInts( _dir, "startPoints", startPoints, sizePoints ) != sizePoints )
+	{
+		sizePoints = 0;
+	}
+
+	for ( int i = 0; i < sizePoints; i++ )
+	{
+		m_points.PutData( new WhiteBoardPoint( ids[i], positions[2 * i], positions[2 * i + 1], startPoints[i] != 0 ) );
+	}
+
+	delete [] ids;
+	delete [] startPoints;
+}
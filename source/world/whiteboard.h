@@ -4,6 +4,8 @@
 
 #include "lib/tosser/llist.h"
 
+class Directory;
+
 
 class WhiteBoardPoint
 {
@@ -58,6 +60,9 @@ public:
 
 	bool HasChanges() const;
 	void ClearChanges();
+
+	void SaveSnapshot( Directory *_dir );
+	void LoadSnapshot( Directory *_dir );
 };
 
 #endif
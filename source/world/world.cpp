@@ -46,15 +46,16 @@
 #include "world/bomber.h"
 #include "world/earthdata.h"
 
-#include "interface/interface.h"
 
-#include "renderer/map_renderer.h"
 
 
 World::World()
 :   m_myTeamId(-1),
     m_timeScaleFactor(20.0f),
     m_nextUniqueId(0),
+    m_radarPermitDefection(-1),
+    m_radarRetestAll(true),
+    m_view(new WorldViewInterface()),
     m_numNukesGivenToEachTeam(0)
 {    
     m_populationCenter.Initialise(NumTerritories);
@@ -63,6 +64,8 @@ World::World()
     for( int i = 0; i < MAX_TEAMS; ++i )
     {        
         m_firstLaunch[i] = false;
+        m_radarMask[i] = 0;
+        m_radarAlliance[i] = -1;
     }
     
     m_defconTime.Initialise(6);
@@ -80,6 +83,23 @@ World::World()
 
 }
 
+World::~World()
+{
+    delete m_view;
+}
+
+void World::SetView( WorldViewInterface *_view )
+{
+    AppAssert( _view );
+    delete m_view;
+    m_view = _view;
+}
+
+WorldViewInterface *World::GetView()
+{
+    return m_view;
+}
+
 int World::GenerateUniqueId() 
 { 
     m_nextUniqueId++; 
@@ -100,6 +120,14 @@ void World::Init()
 }
 
 
+void World::LoadGeography()
+{
+    // Rebuilt for every game, as mods may have changed the earth bitmaps
+
+    m_geography.Initialise();
+}
+
+
 void World::LoadNodes()
 {
     // create travel nodes
@@ -136,37 +164,29 @@ void World::LoadNodes()
         }
     }
 
-    // Go through all nodes in the world
-    for( int i = 0; i < m_nodes.Size(); ++i)
-    {
-        for( int n = 0; n < m_nodes.Size(); ++n )
-        {
-            Node *startNode = m_nodes[n];
-            for( int s = 0; s < m_nodes.Size(); ++s )
-            {
-                Node *targetNode = m_nodes[s];
-                if( IsSailable( startNode->m_longitude, startNode->m_latitude, targetNode->m_longitude, targetNode->m_latitude ) )
-                {
-                    Fixed distance = GetDistance( startNode->m_longitude, startNode->m_latitude, targetNode->m_longitude, targetNode->m_latitude);
-                    startNode->AddRoute( n, s, distance );
+    m_nodeGrid.Initialise( m_nodes );
 
-                    for( int e = 0; e < targetNode->m_routeTable.Size(); ++e )
-                    {
-                        Node *nextNode = m_nodes[ targetNode->m_routeTable[e]->m_targetNodeId ];
-                        Fixed totalDistance = distance + targetNode->m_routeTable[e]->m_totalDistance;                                                           
+    // Load the all-pairs route table from the cache,
+    // compiling it first if the cache is missing or stale
 
-                        startNode->AddRoute( nextNode->m_objectId, targetNode->m_objectId, totalDistance );
-                    }
-                }
-            }
-        }
+    Image *sailableImage = g_resource->GetImage( "earth/sailable.bmp" );
+    unsigned int routeKey[ROUTETABLE_KEYSIZE];
+    RouteTable::GenerateKey( nodeImage->m_bitmap, sailableImage->m_bitmap, GetTimeScaleFactor().IntValue(), routeKey );
+
+    if( !m_nodeRoutes.Load( App::GetRouteCachePath(), m_nodes.Size(), routeKey ) )
+    {
+        m_nodeRoutes.Compile( this );
+        m_nodeRoutes.Save( App::GetRouteCachePath(), routeKey );
     }
 
-    for( int i = 0; i < m_nodes.Size(); ++i )
+    for( int n = 0; n < m_nodes.Size(); ++n )
     {
-        if( m_nodes[i]->m_routeTable.Size() != m_nodes.Size() )
+        for( int t = 0; t < m_nodes.Size(); ++t )
         {
-            AppReleaseAssert( false, "Node route size mismatch" );
+            if( m_nodeRoutes.GetNextNode( n, t ) == -1 )
+            {
+                AppReleaseAssert( false, "Node route size mismatch" );
+            }
         }
     }
 
@@ -347,7 +367,7 @@ void World::AssignCities()
     for( int i = 0; i < g_app->GetEarthData()->m_cities.Size(); ++i )
     {
         City *city = g_app->GetEarthData()->m_cities[i];
-        city->m_teamId = g_app->GetMapRenderer()->GetTerritory( city->m_longitude, city->m_latitude );        
+        city->m_teamId = GetTerritoryOwner( city->m_longitude, city->m_latitude );        
     }
 
     // take the 20 most populated cities (or capitals) from each territory and discard the rest
@@ -369,7 +389,7 @@ void World::AssignCities()
         City *city = g_app->GetEarthData()->m_cities[i];
         if( city->m_teamId == -1 ) continue;
 
-        int territoryId = g_app->GetMapRenderer()->GetTerritoryIdUnique( city->m_longitude, city->m_latitude );
+        int territoryId = m_geography.m_terrain.GetTerritoryIdUnique( city->m_longitude, city->m_latitude );
         if( territoryId != -1 )
         {
             // Nearest city in this territory?
@@ -455,7 +475,7 @@ void World::AssignCities()
         Fixed totalLat = 0;
         for( int j = 0; j < tempList[i].Size(); ++j )
         {
-            if( g_app->GetMapRenderer()->GetTerritory( tempList[i][j]->m_longitude, tempList[i][j]->m_latitude ) != -1 )
+            if( GetTerritoryOwner( tempList[i][j]->m_longitude, tempList[i][j]->m_latitude ) != -1 )
             {
                 m_cities.PutData( tempList[i][j] );
                 totalLong += tempList[i][j]->m_longitude;
@@ -683,6 +703,7 @@ void World::InitialiseTeam ( int teamId, int teamType, int clientId )
     team->m_allianceId = FindFreeAllianceId();
     team->m_clientId = clientId;
     team->m_readyToStart = false;
+    team->m_playerTeam = ( teamType != Team::TypeAI );
  
     if( teamType == Team::TypeLocalPlayer )
     {
@@ -800,7 +821,7 @@ void World::ReassignTeams( int _clientId )
             sprintf( msg, LANGUAGEPHRASE("dialog_world_rejoined") );
 			LPREPLACESTRINGFLAG( 'T', team->m_name, msg );
             strupr(msg);
-            g_app->GetInterface()->ShowMessage( 0, 0, -1, msg, true );
+            m_view->ShowMessage( 0, 0, -1, msg, true );
         }
     }
 }
@@ -839,13 +860,14 @@ void World::RemoveTeams( int clientId, int reason )
                     case Disconnect_KeyAuthFailed:
                     case Disconnect_BadPassword:
                     case Disconnect_KickedFromGame:
+                    case Disconnect_NumericsMismatch:
 						sprintf( msg, LANGUAGEPHRASE("dialog_world_kicked") );
 						LPREPLACESTRINGFLAG( 'T', team->m_name, msg );
                         break;
                 }
 
                 strupr(msg);
-                g_app->GetInterface()->ShowMessage( 0, 0, -1, msg, true );
+                m_view->ShowMessage( 0, 0, -1, msg, true );
             }
 
             char msg[256];
@@ -1106,17 +1128,7 @@ void World::LaunchNuke( int teamId, int objId, Fixed longitude, Fixed latitude,
                 char msg[64];
                 sprintf( msg, "%s", LANGUAGEPHRASE("message_nukelaunch") );
                 AddWorldMessage( fromLongitude, fromLatitude, teamId, msg, WorldMessage::TypeLaunch );
-                int id = g_app->GetMapRenderer()->CreateAnimation( MapRenderer::AnimationTypeNukePointer, objId,
-																   from->m_longitude.DoubleValue(), from->m_latitude.DoubleValue() );
-                if( g_app->GetMapRenderer()->m_animations.ValidIndex( id ) )
-                {
-                    NukePointer *pointer = (NukePointer *)g_app->GetMapRenderer()->m_animations[id];
-                    if( pointer->m_animationType == MapRenderer::AnimationTypeNukePointer )
-                    {
-                        pointer->m_targetId = from->m_objectId;
-                        pointer->Merge();
-                    }
-                }
+                m_view->CreateNukePointer( objId, from->m_longitude, from->m_latitude, from->m_objectId );
             }
 
             if( g_app->m_hidden )
@@ -1132,7 +1144,7 @@ void World::LaunchNuke( int teamId, int objId, Fixed longitude, Fixed latitude,
                 sprintf( msg, "%s", LANGUAGEPHRASE("message_firstlaunch") );
                 LPREPLACESTRINGFLAG('T', GetTeam(teamId)->GetTeamName(), msg );
                 strupr(msg);
-                g_app->GetInterface()->ShowMessage( 0, 0, teamId, msg, true );
+                m_view->ShowMessage( 0, 0, teamId, msg, true );
                 g_soundSystem->TriggerEvent( "Interface", "FirstLaunch" );
 
             }
@@ -1151,10 +1163,20 @@ void World::LaunchNuke( int teamId, int objId, Fixed longitude, Fixed latitude,
 int World::GetNearestObject( int teamId, Fixed longitude, Fixed latitude, int objectType, bool enemyTeam )
 {
     int result = -1;
+    int resultIndex = -1;
     Fixed nearestSqd = Fixed::MAX;
 
-    for( int i = 0; i < m_objects.Size(); ++i )
+    //
+    // Search outwards until nothing unseen could be closer.
+    // Ties go to the earlier slot, as they would in a scan of m_objects
+
+    ObjectGridQuery query( &m_objectGrid, longitude, latitude );
+
+    while( result == -1 || !(nearestSqd < query.GetThreshold()) )
     {
+        int i = query.GetNext();
+        if( i == -1 ) break;
+
         if( m_objects.ValidIndex(i) )
         {
             WorldObject *obj = m_objects[i];
@@ -1166,9 +1188,11 @@ int World::GetNearestObject( int teamId, Fixed longitude, Fixed latitude, int ob
                 !GetTeam( teamId )->m_ceaseFire[obj->m_teamId])
             {
                 Fixed distanceSqd = GetDistanceSqd( longitude, latitude, obj->m_longitude, obj->m_latitude);
-                if( distanceSqd < nearestSqd )
+                if( distanceSqd < nearestSqd ||
+                    ( distanceSqd == nearestSqd && i < resultIndex ) )
                 {
                     result = obj->m_objectId;
+                    resultIndex = i;
                     nearestSqd = distanceSqd;
                 }
             }
@@ -1188,7 +1212,7 @@ bool World::IsValidPlacement( int teamId, Fixed longitude, Fixed latitude, int o
         case WorldObject::TypeRadarStation:
         case WorldObject::TypeAirBase:
         {
-            if( g_app->GetMapRenderer()->IsValidTerritory( teamId, longitude, latitude, false ) )
+            if( IsValidTerritory( teamId, longitude, latitude, false ) )
             {
                 int nearestIndex = GetNearestObject( teamId, longitude, latitude );
                 if( nearestIndex == -1 ) return true;
@@ -1207,7 +1231,7 @@ bool World::IsValidPlacement( int teamId, Fixed longitude, Fixed latitude, int o
         case WorldObject::TypeBattleShip:
         case WorldObject::TypeCarrier:
         {
-            if( g_app->GetMapRenderer()->IsValidTerritory( teamId, longitude, latitude, true ) )
+            if( IsValidTerritory( teamId, longitude, latitude, true ) )
             {
                 int nearestIndex = GetNearestObject( teamId, longitude, latitude );
                 if( nearestIndex == -1 ) return true;
@@ -1261,8 +1285,10 @@ int World::AddWorldObject( WorldObject *obj )
     {
         team->m_unitsInPlay[ obj->m_type ]++;
     }
-    m_objects.PutData( obj);
+    int slot = m_objects.PutData( obj);
+    m_objectGrid.Add( slot );
     obj->m_objectId = GenerateUniqueId();
+    m_objectStore.Add( slot, obj );
     return obj->m_objectId;
 }
 
@@ -1316,8 +1342,12 @@ void World::CreateExplosion ( int teamId, Fixed longitude, Fixed latitude, Fixed
 
     if( intensity > 10 )
     {
-        for( int i = 0; i < m_objects.Size(); ++i )
+        LList<int> nearby;
+        m_objectGrid.GetNearbySlots( longitude, latitude, intensity/50, nearby );
+
+        for( int n = 0; n < nearby.Size(); ++n )
         {
+            int i = nearby[n];
             if( m_objects.ValidIndex(i) )
             {
                 WorldObject *wobj = m_objects[i];
@@ -1449,14 +1479,14 @@ void World::ObjectAction( int objectId, int targetObjectId, Fixed longitude, Fix
         // If that was the last possible action deselect this unit now
         // (assuming we have it selected)
 
-        if( g_app->GetMapRenderer()->GetCurrentSelectionId() == objectId )
+        if( m_view->GetCurrentSelectionId() == objectId )
         {
             int numTimesRemaining = wobj->m_states[wobj->m_currentState]->m_numTimesPermitted;
             if( numTimesRemaining > -1 ) numTimesRemaining -= wobj->m_actionQueue.Size();
 
             if( numTimesRemaining <= 0)
             {
-                g_app->GetMapRenderer()->SetCurrentSelectionId(-1);
+                m_view->SetCurrentSelectionId(-1);
             }
         }
     }
@@ -1594,7 +1624,7 @@ void World::AddWorldMessage( Fixed longitude, Fixed latitude, int teamId, char *
 {
     if( showOnToolbar )
     {
-        g_app->GetInterface()->ShowMessage( longitude, latitude, teamId, msg );
+        m_view->ShowMessage( longitude, latitude, teamId, msg );
     }
 
     WorldMessage *wm = new WorldMessage();
@@ -1614,7 +1644,7 @@ void World::AddWorldMessage( int objectId, int teamId, char *msg, int msgType, b
         if( GetWorldObject(objectId) )
         {
             WorldObject *obj = GetWorldObject(objectId);            
-            g_app->GetInterface()->ShowMessage( obj->m_longitude, obj->m_latitude, teamId, msg );
+            m_view->ShowMessage( obj->m_longitude, obj->m_latitude, teamId, msg );
         }
     }
 
@@ -1856,8 +1886,13 @@ void World::Update()
 
     //
     // Update all objects
+    // The object grid and store follow each one as it updates, so that
+    // queries from the objects after it see it as it is now
 
     START_PROFILE( "Objects" );
+    m_objectGrid.PlacePending( m_objects );
+    m_objectStore.SyncPending( m_objects );
+
     for( int i = 0; i < m_objects.Size(); ++i )
     {
         if( m_objects.ValidIndex(i) )
@@ -1883,14 +1918,19 @@ void World::Update()
                 {
                     m_radarGrid.RemoveCoverage( oldLongitude, oldLatitude, oldRadarSize, wobj->m_teamId );
                     m_objects.RemoveData(i);
+                    m_objectGrid.Remove(i);
+                    m_objectStore.Remove(i);
                     delete wobj;
                 }
                 else
                 {
+                    m_objectGrid.Update( i, wobj->m_longitude, wobj->m_latitude );
+
                     Fixed newRadarRange = wobj->GetRadarRange();
                     m_radarGrid.UpdateCoverage( oldLongitude, oldLatitude, oldRadarSize, 
                         wobj->m_longitude, wobj->m_latitude, newRadarRange, wobj->m_teamId );
                     wobj->m_previousRadarRange = newRadarRange;
+                    m_objectStore.Sync( i, wobj );
                 }
             }
             else
@@ -1898,8 +1938,15 @@ void World::Update()
                 if( amIdead )
                 {
                     m_objects.RemoveData(i);
+                    m_objectGrid.Remove(i);
+                    m_objectStore.Remove(i);
                     delete wobj;
                 }
+                else
+                {
+                    m_objectGrid.Update( i, wobj->m_longitude, wobj->m_latitude );
+                    m_objectStore.Sync( i, wobj );
+                }
             }
 
             END_PROFILE( name );
@@ -1994,9 +2041,14 @@ void World::Update()
 
 
     //
-    // Run AI for computer teams
+    // Run AI for computer teams.  The expensive read-only part is thought
+    // about by every team at once, then the teams act in order as always
 
     START_PROFILE( "AI" );
+    START_PROFILE( "AIThink" );
+    m_aiThink.Think();
+    END_PROFILE( "AIThink" );
+
     for( int i = 0; i < m_teams.Size(); ++i )
     {
         if( m_teams[i]->m_type == Team::TypeAI )
@@ -2045,7 +2097,7 @@ void World::Update()
         }
     }
         
-    if( !g_app->GetInterface()->UsingChatWindow() )
+    if( !m_view->UsingChatWindow() )
     {
         //
         // If team switching is enabled, num keys select team ID
@@ -2060,7 +2112,7 @@ void World::Update()
             if( g_keys[KEY_5] )    m_myTeamId = 4;
             if( g_keys[KEY_6] )    m_myTeamId = 5;
             if( g_keys[KEY_7] )    m_myTeamId = 6;
-            if( g_keys[KEY_8] )    g_app->GetMapRenderer()->m_renderEverything = !g_app->GetMapRenderer()->m_renderEverything;
+            if( g_keys[KEY_8] )    m_view->ToggleRenderEverything();
 
             if( m_myTeamId >= m_teams.Size() )
             {
@@ -2137,41 +2189,57 @@ bool World::IsVisible( Fixed longitude, Fixed latitude, int teamId )
 {       
     if( teamId == -1 ) return false;
 
-    //
-    // Check our own radar first
-
-    if( m_radarGrid.GetCoverage( longitude, latitude, teamId ) > 0 )
-    {
-        return true;
-    }
+    return ( m_radarGrid.GetCoveringTeams( longitude, latitude ) & GetRadarMask( teamId ) ) != 0;
+}
 
 
+int World::GetRadarMask( int teamId )
+{
     //
-    // Not on our radar - but maybe its on our allies radar
-    // And maybe our allies are nice enough to share their radar (the fools)
+    // Our own radar, plus any allies nice enough to share theirs (the fools)
+
+    int teamMask = 1 << teamId;
 
     for( int t = 0; t < m_teams.Size(); ++t )
     {
         Team *team = m_teams[t];
         if( teamId != team->m_teamId &&
-            teamId != -1 &&
-            team->m_sharingRadar[teamId] &&
-            m_radarGrid.GetCoverage( longitude, latitude, team->m_teamId ) )
+            team->m_sharingRadar[teamId] )
         {
-            return true;
+            teamMask |= 1 << team->m_teamId;
         }
     }
 
+    return teamMask;
+}
 
-    //
-    // Nope, can't see it
 
-    return false;
+void World::CreateSonarPing( int objectId, int teamId, Fixed const &longitude, Fixed const &latitude )
+{
+    // Visibility is worked out straight away, as the MapRenderer
+    // may pick the ping up before the next radar update
+
+    SonarContact *ping = m_geography.AddSonarPing( objectId, teamId, longitude, latitude );
+    UpdateSonarPingVisibility( ping );
+}
+
+
+void World::UpdateSonarPingVisibility( SonarContact *ping )
+{
+    for( int k = 0; k < m_teams.Size(); ++k )
+    {
+        Team *team = m_teams[k];
+        ping->m_visible[team->m_teamId] = (team->m_teamId == ping->m_teamId) ||
+                                           IsVisible( ping->m_longitude, ping->m_latitude, team->m_teamId );
+    }
 }
 
 
 void World::UpdateRadar()
 {
+    // Objects added since the last update have been positioned by now
+    m_objectStore.SyncPending( m_objects );
+
     if( GetDefcon() == 5 )
     {
         // show ONLY allies during defcon 5
@@ -2200,12 +2268,53 @@ void World::UpdateRadar()
                         wobj->m_visible[thisTeamId] = true;
                     }
                 }
+
+                m_objectStore.SyncVisibility( i, wobj );
             }
         }   
 
+        // The results above don't follow from the radar, so
+        // every object is tested again once defcon 5 is over
+        m_radarRetestAll = true;
         return;
     }
 
+
+    //
+    // Work out once what each team sees through, and compare it
+    // with the last update : if any of it has changed, every object
+    // has to be tested again
+
+    int radarMask[MAX_TEAMS];
+    int radarAlliance[MAX_TEAMS];
+    int anyRadarMask = 0;
+
+    for( int t = 0; t < MAX_TEAMS; ++t )
+    {
+        radarMask[t] = 0;
+        radarAlliance[t] = -1;
+    }
+
+    for( int t = 0; t < m_teams.Size(); ++t )
+    {
+        Team *team = m_teams[t];
+        radarMask[team->m_teamId] = GetRadarMask( team->m_teamId );
+        radarAlliance[team->m_teamId] = team->m_allianceId;
+        anyRadarMask |= radarMask[team->m_teamId];
+    }
+
+    int permitDefection = g_app->GetGame()->GetOptionValue("PermitDefection");
+
+    bool retestAll = m_radarRetestAll ||
+                     permitDefection != m_radarPermitDefection ||
+                     memcmp( radarMask, m_radarMask, sizeof(radarMask) ) != 0 ||
+                     memcmp( radarAlliance, m_radarAlliance, sizeof(radarAlliance) ) != 0;
+
+    memcpy( m_radarMask, radarMask, sizeof(radarMask) );
+    memcpy( m_radarAlliance, radarAlliance, sizeof(radarAlliance) );
+    m_radarPermitDefection = permitDefection;
+    m_radarRetestAll = false;
+
     
     //
     // Update gunfire visibility
@@ -2215,32 +2324,31 @@ void World::UpdateRadar()
         if( m_gunfire.ValidIndex(j) )
         {
             WorldObject *potential = m_gunfire[j];
+            int covering = m_radarGrid.GetCoveringTeams( potential->m_longitude, potential->m_latitude );
+
             for( int k = 0; k < m_teams.Size(); ++k )
             {
                 Team *team = m_teams[k];
-                potential->m_visible[team->m_teamId] = IsVisible( potential->m_longitude, potential->m_latitude, team->m_teamId );
+                potential->m_visible[team->m_teamId] = ( covering & radarMask[team->m_teamId] ) != 0;
             }
         }
     }
 
     //
-    // Update animation visibility
+    // Update sonar ping visibility
     
-    for( int j = 0; j < g_app->GetMapRenderer()->m_animations.Size(); ++j )
+    m_geography.AdvanceSonarPings();
+
+    for( int j = 0; j < m_geography.m_sonarPings.Size(); ++j )
     {
-        if( g_app->GetMapRenderer()->m_animations.ValidIndex(j) )
+        SonarContact *ping = m_geography.m_sonarPings[j];
+        int covering = m_radarGrid.GetCoveringTeams( ping->m_longitude, ping->m_latitude );
+
+        for( int k = 0; k < m_teams.Size(); ++k )
         {
-            SonarPing *ping = (SonarPing *)g_app->GetMapRenderer()->m_animations[j];
-            if( ping->m_animationType == MapRenderer::AnimationTypeSonarPing )
-            {
-                for( int k = 0; k < m_teams.Size(); ++k )
-                {
-                    Team *team = m_teams[k];
-                    ping->m_visible[team->m_teamId] = (team->m_teamId == ping->m_teamId) ||
-                                                       IsVisible( Fixed::FromDouble(ping->m_longitude),
-																  Fixed::FromDouble(ping->m_latitude), team->m_teamId );
-                }
-            }
+            Team *team = m_teams[k];
+            ping->m_visible[team->m_teamId] = (team->m_teamId == ping->m_teamId) ||
+                                               ( covering & radarMask[team->m_teamId] ) != 0;
         }
     }
 
@@ -2253,14 +2361,15 @@ void World::UpdateRadar()
         if( m_explosions.ValidIndex(j) )
         {
             Explosion *explosion = m_explosions[j];
+            int covering = m_radarGrid.GetCoveringTeams( explosion->m_longitude, explosion->m_latitude );
             
-            for( int k = 0; k < g_app->GetWorld()->m_teams.Size(); ++k )
+            for( int k = 0; k < m_teams.Size(); ++k )
             {
-                Team *team = g_app->GetWorld()->m_teams[k];
+                Team *team = m_teams[k];
                 explosion->m_visible[team->m_teamId] = explosion->m_targetTeamId == team->m_teamId ||
                                                        explosion->m_teamId == team->m_teamId ||
                                                        explosion->m_initialIntensity > 30 ||
-                                                       IsVisible( explosion->m_longitude, explosion->m_latitude, team->m_teamId );
+                                                       ( covering & radarMask[team->m_teamId] ) != 0;
             }
         }
     }
@@ -2268,12 +2377,41 @@ void World::UpdateRadar()
 
     //
     // Update object visibility
+    // An object is only tested again if something the test depends on has
+    // changed : the teams covering its cell, whether it is hidden, the masks
+    // above, or its visibility or seen flags having been set elsewhere (a silo
+    // launching, or a MovingObject forgetting it was seen).  Otherwise the test
+    // would give the same result, and it has already marked the object as seen,
+    // so it would raise no events either.
     
     for( int i = 0; i < m_objects.Size(); ++i ) 
     {
         if( m_objects.ValidIndex(i) )
         {
             WorldObject *wobj = m_objects[i];
+            bool special = ( wobj->m_teamId == TEAMID_SPECIALOBJECTS );
+            int covering = m_radarGrid.GetCoveringTeams( wobj->m_longitude, wobj->m_latitude );
+
+
+            //
+            // IsHiddenFrom is only asked where some team could see the object,
+            // as a sub's answer can depend on whether it was asked before
+
+            int inputs = covering;
+            bool hidden = false;
+            if( special || ( covering & anyRadarMask ) )
+            {
+                hidden = wobj->IsHiddenFrom();
+                inputs |= ( hidden ? 0x300 : 0x100 );
+            }
+
+            if( !retestAll &&
+                m_objectStore.m_radarInputs[i] == inputs &&
+                m_objectStore.m_radarVisible[i] == ObjectStore::PackVisibility( wobj ) &&
+                m_objectStore.m_radarSeen[i] == ObjectStore::PackSeen( wobj ) )
+            {
+                continue;
+            }
             
             for( int t = 0; t < m_teams.Size(); ++t )
             {
@@ -2287,11 +2425,10 @@ void World::UpdateRadar()
                     wobj->m_visible[owner->m_teamId] = true;
                 }
 
-                if( wobj->m_teamId == TEAMID_SPECIALOBJECTS ||
-                    IsVisible( wobj->m_longitude, wobj->m_latitude, team->m_teamId ) )
+                if( special ||
+                    ( covering & radarMask[team->m_teamId] ) != 0 )
                 {
-                    int permitDefection = g_app->GetGame()->GetOptionValue("PermitDefection");
-                    if( !wobj->IsHiddenFrom() || 
+                    if( !hidden || 
                         (IsFriend( wobj->m_teamId, team->m_teamId ) && permitDefection == 0) ||
                         wobj->m_teamId == team->m_teamId)
                     {
@@ -2315,7 +2452,7 @@ void World::UpdateRadar()
                             {
                                 if( wobj->m_type == WorldObject::TypeSub )
                                 {
-                                    if( g_app->GetMapRenderer()->IsValidTerritory( team->m_teamId, wobj->m_longitude, wobj->m_latitude, true ) )
+                                    if( IsValidTerritory( team->m_teamId, wobj->m_longitude, wobj->m_latitude, true ) )
                                     {
                                         team->AddEvent(Event::TypeEnemyIncursion, wobj->m_objectId, wobj->m_teamId, wobj->m_fleetId, wobj->m_longitude, wobj->m_latitude );
                                     }
@@ -2327,7 +2464,7 @@ void World::UpdateRadar()
                                 else if (wobj->m_type == WorldObject::TypeFighter ||
                                          wobj->m_type == WorldObject::TypeBomber )
                                 {
-                                    if( g_app->GetMapRenderer()->IsValidTerritory( team->m_teamId, wobj->m_longitude, wobj->m_latitude, false ) )
+                                    if( IsValidTerritory( team->m_teamId, wobj->m_longitude, wobj->m_latitude, false ) )
                                     {
                                         team->AddEvent( Event::TypeIncomingAircraft, wobj->m_objectId, wobj->m_teamId, wobj->m_fleetId, wobj->m_longitude, wobj->m_latitude );                                         
                                     }
@@ -2336,7 +2473,7 @@ void World::UpdateRadar()
                                           wobj->m_type == WorldObject::TypeSub ||
                                           wobj->m_type == WorldObject::TypeCarrier )
                                 {
-                                    if( g_app->GetMapRenderer()->IsValidTerritory( team->m_teamId, wobj->m_longitude, wobj->m_latitude, true ) )
+                                    if( IsValidTerritory( team->m_teamId, wobj->m_longitude, wobj->m_latitude, true ) )
                                     {
                                         team->AddEvent(Event::TypeEnemyIncursion, wobj->m_objectId, wobj->m_teamId, wobj->m_fleetId, wobj->m_longitude, wobj->m_latitude );
                                     }
@@ -2348,6 +2485,11 @@ void World::UpdateRadar()
                     }
                 }
             }
+
+            m_objectStore.SyncVisibility( i, wobj );
+            m_objectStore.m_radarInputs[i] = inputs;
+            m_objectStore.m_radarVisible[i] = m_objectStore.m_visible[i];
+            m_objectStore.m_radarSeen[i] = ObjectStore::PackSeen( wobj );
         }
     }
 }
@@ -2429,7 +2571,40 @@ void World::GenerateWorldEvent()
             }
             break;
     }
-    g_app->GetInterface()->ShowMessage( 0, 0, -1, msg, true );
+    m_view->ShowMessage( 0, 0, -1, msg, true );
+}
+
+
+bool World::IsValidTerritory( int teamId, Fixed longitude, Fixed latitude, bool seaUnit )
+{
+    if( teamId == -1 )
+    {
+        return m_geography.m_terrain.IsSailable( longitude, latitude );
+    }
+
+    Team *team = GetTeam(teamId);
+    for( int i = 0; i < team->m_territories.Size(); ++i )
+    {
+        if( m_geography.m_terrain.IsValidTerritory( team->m_territories[i], longitude, latitude, seaUnit ) )
+        {
+            return true;
+        }
+    }
+    return false;
+}
+
+
+int World::GetTerritoryOwner( Fixed longitude, Fixed latitude, bool seaArea )
+{
+    for( int i = 0; i < m_teams.Size(); ++i )
+    {
+        Team *team = m_teams[i];
+        if( IsValidTerritory( team->m_teamId, longitude, latitude, seaArea ) )
+        {
+            return team->m_teamId;
+        }
+    }
+    return -1;
 }
 
 
@@ -2473,6 +2648,16 @@ bool World::IsSailable( Fixed const &fromLongitude, Fixed const &fromLatitude, F
         vel *= zeroPointFive;
     }
     
+    //
+    // Steps are still taken one at a time so every position is the same as before,
+    // but a step only samples the map once it may have left the open water
+    // known to surround the last sampled position.
+    // One pixel of the clearance is kept back to absorb rounding.
+
+    double pixelsPerStep = max( fabs( vel.x.DoubleValue() ) * m_geography.m_seaClearance.GetPixelsPerDegreeX(),
+                                fabs( vel.y.DoubleValue() ) * m_geography.m_seaClearance.GetPixelsPerDegreeY() );
+    int stepsToSkip = 0;
+
     for( int i = 0; i < nbIterations; ++i )
     {
         longitude += vel.x;
@@ -2481,10 +2666,28 @@ bool World::IsSailable( Fixed const &fromLongitude, Fixed const &fromLatitude, F
         // For debugging purposes
         //glVertex2f( longitude.DoubleValue(), latitude.DoubleValue() );
 
-        if( !g_app->GetMapRenderer()->IsValidTerritory( -1, longitude, latitude, false ) )
+        if( stepsToSkip > 0 )
+        {
+            --stepsToSkip;
+            continue;
+        }
+
+        int clearance = m_geography.m_seaClearance.GetDistance( longitude, latitude );
+        if( clearance == -1 )
+        {
+            if( !m_geography.m_terrain.IsSailable( longitude, latitude ) )
+            {
+                return false;
+            }
+        }
+        else if( clearance == 0 )
         {
             return false;
         }
+        else if( clearance > 2 && pixelsPerStep > 0 )
+        {
+            stepsToSkip = int( ( clearance - 2 ) / pixelsPerStep );
+        }
     }
 
     return true;
@@ -2535,7 +2738,7 @@ bool World::IsSailableSlow( Fixed const &fromLongitude, Fixed const &fromLatitud
 
         glVertex2f( longitude.DoubleValue(), latitude.DoubleValue() );
 
-        if(!g_app->GetMapRenderer()->IsValidTerritory( -1, longitude, latitude, false ) )
+        if(!m_geography.m_terrain.IsSailable( longitude, latitude ) )
         {
             END_PROFILE( "IsSailable" );
             return false;
@@ -2554,57 +2757,43 @@ bool World::IsSailableSlow( Fixed const &fromLongitude, Fixed const &fromLatitud
 }
 
 
-struct nodeInfoStruct
+int World::GetClosestNode( Fixed const &longitude, Fixed const &latitude )
 {
-    Node *node;
-    int index;
-    Fixed distanceSqd;
-};
+    START_PROFILE( "GetClosestNode" );
 
+    int timeScaleFactor = GetTimeScaleFactor().IntValue();
+    int nodeId = -1;
 
-static int NodeInfoStructCompare( const void *elem1, const void *elem2 )
-{
-    const struct nodeInfoStruct *id1 = (const struct nodeInfoStruct *) elem1;
-    const struct nodeInfoStruct *id2 = (const struct nodeInfoStruct *) elem2;
+    if( m_nodeGrid.LookupCache( longitude, latitude, timeScaleFactor, nodeId ) )
+    {
+        END_PROFILE( "GetClosestNode" );
+        return nodeId;
+    }
 
-    if      ( id1->distanceSqd > id2->distanceSqd )     return +1;
-    else if ( id1->distanceSqd < id2->distanceSqd )     return -1;
-    else                                                return 0;
-}
+    nodeId = FindClosestNode( longitude, latitude );
 
+    m_nodeGrid.UpdateCache( longitude, latitude, timeScaleFactor, nodeId );
 
-int World::GetClosestNode( Fixed const &longitude, Fixed const &latitude )
-{
-    START_PROFILE( "GetClosestNode" );
-    int nodeId = -1;
+    END_PROFILE( "GetClosestNode" );
+    return nodeId;
+}
 
-    int nodesSize = m_nodes.Size();
-    struct nodeInfoStruct *nodeInfo = new struct nodeInfoStruct[nodesSize];
 
-    for( int i = 0; i < nodesSize; ++i )
-    {
-        Node *node = m_nodes[i];
-        nodeInfo[i].node = node;
-        nodeInfo[i].index = i;
-        nodeInfo[i].distanceSqd = GetDistanceSqd( longitude, latitude, node->m_longitude, node->m_latitude );
-    }
+int World::FindClosestNode( Fixed const &longitude, Fixed const &latitude )
+{
+    // Visit nodes nearest first, stopping at the first one we can sail from
 
-    qsort( nodeInfo, nodesSize, sizeof(struct nodeInfoStruct), NodeInfoStructCompare );
+    NodeGridQuery query( &m_nodeGrid, longitude, latitude );
 
-    for( int j = 0; j < nodesSize; j++ )
+    for( int candidate = query.GetNext(); candidate != -1; candidate = query.GetNext() )
     {
-        Node *node = nodeInfo[j].node;
-        if( IsSailable( node->m_longitude, node->m_latitude, longitude, latitude ) )
+        if( IsSailable( m_nodeGrid.GetLongitude(candidate), m_nodeGrid.GetLatitude(candidate), longitude, latitude ) )
         {
-            nodeId = nodeInfo[j].index;
-            break;
+            return candidate;
         }
     }
 
-	delete [] nodeInfo;
-
-    END_PROFILE( "GetClosestNode" );
-    return nodeId;
+    return -1;
 }
 
 
@@ -2724,10 +2913,9 @@ Fixed World::GetSailDistanceSlow( Fixed const &fromLongitude, Fixed const &fromL
                     (currentNodeId != -1 ||
                      g_app->GetWorld()->IsSailable( currentLong, currentLat, node->m_longitude, node->m_latitude )) )
                 {
-                    int routeId = node->GetRouteId( targetNodeId );
-                    if( routeId != -1 )
+                    if( node->HasRoute( targetNodeId ) )
                     {
-                        Fixed distanceSqd = node->m_routeTable[routeId]->m_totalDistance;
+                        Fixed distanceSqd = node->GetRouteDistance( targetNodeId );
                         distanceSqd *= distanceSqd;
 
                         distanceSqd += g_app->GetWorld()->GetDistanceSqd( currentLong, currentLat, node->m_longitude, node->m_latitude, false );
@@ -2764,8 +2952,10 @@ Fixed World::GetSailDistanceSlow( Fixed const &fromLongitude, Fixed const &fromL
 }
 
 
-Fixed World::GetSailDistance( Fixed const &fromLongitude, Fixed const &fromLatitude, Fixed const &toLongitude, Fixed const &toLatitude )
+Fixed World::GetSailDistance( Fixed const &fromLongitude, Fixed const &fromLatitude, Fixed const &toLongitude, Fixed const &toLatitude, bool threadSafe )
 {
+    // With threadSafe set the NodeGrid cache is left alone and the
+    // nodes are only read through the NodeGrid, for the AI think phase
     Fixed totalDistance = 0;
 
 
@@ -2786,14 +2976,14 @@ Fixed World::GetSailDistance( Fixed const &fromLongitude, Fixed const &fromLatit
     //
     // Find node nearest the target and add that distance
 
-    int targetNodeId = GetClosestNode( toLongitude, toLatitude );
+    int targetNodeId = threadSafe ? FindClosestNode( toLongitude, toLatitude ) :
+                                    GetClosestNode( toLongitude, toLatitude );
     if( targetNodeId == -1 )
     {
         return Fixed::MAX;
     }
 
-    Node *targetNode = m_nodes[ targetNodeId ];
-    totalDistance += GetDistanceSqd( targetNode->m_longitude, targetNode->m_latitude, toLongitude, toLatitude );
+    totalDistance += GetDistanceSqd( m_nodeGrid.GetLongitude(targetNodeId), m_nodeGrid.GetLatitude(targetNodeId), toLongitude, toLatitude );
 
 
     //
@@ -2801,25 +2991,26 @@ Fixed World::GetSailDistance( Fixed const &fromLongitude, Fixed const &fromLatit
 
     Fixed bestDistance = Fixed::MAX;
     int bestNodeId = -1;
+    int numNodes = m_nodeGrid.NumNodes();
 
-    for( int i = 0; i < m_nodes.Size(); ++i )
+    for( int i = 0; i < numNodes; ++i )
     {
-        Node *node = m_nodes[i];
-        int routeId = node->GetRouteId( targetNodeId );
-        if( routeId != -1 )
+        if( targetNodeId < m_nodeRoutes.Size() &&
+            m_nodeRoutes.GetNextNode( i, targetNodeId ) != -1 )
         {
-            Route *route = node->m_routeTable[routeId];
-
-            Fixed thisDistance = route->m_totalDistance;
+            Fixed thisDistance = m_nodeRoutes.GetDistance( i, targetNodeId );
 
             if( thisDistance < bestDistance )
             {
-                thisDistance += GetDistance( fromLongitude, fromLatitude, node->m_longitude, node->m_latitude );
+                Fixed nodeLongitude = m_nodeGrid.GetLongitude(i);
+                Fixed nodeLatitude = m_nodeGrid.GetLatitude(i);
+
+                thisDistance += GetDistance( fromLongitude, fromLatitude, nodeLongitude, nodeLatitude );
                 if( thisDistance < bestDistance )
                 {
                     // The check "thisDistance < bestDistance" is done twice to quickly exclude long routes
                     // without having to call the expensive IsSailable function
-                    bool sailable = IsSailable( fromLongitude, fromLatitude, node->m_longitude, node->m_latitude );
+                    bool sailable = IsSailable( fromLongitude, fromLatitude, nodeLongitude, nodeLatitude );
                     if( sailable )
                     {
                         bestDistance = thisDistance;
@@ -3410,6 +3601,8 @@ void World::ClearWorld()
     }
     Update();
     m_objects.EmptyAndDelete();
+    m_objectGrid.Clear();
+    m_objectStore.Clear();
     m_gunfire.EmptyAndDelete();
     m_explosions.EmptyAndDelete();
     m_radiation.EmptyAndDelete();
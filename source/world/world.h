@@ -9,17 +9,23 @@
 #include "lib/tosser/bounded_array.h"
 #include "lib/math/vector3.h"
 
-#include "renderer/animated_icon.h"
-
 #include "world/worldobject.h"
 #include "world/team.h"
 #include "world/date.h"
 #include "world/node.h"
+#include "world/route_table.h"
+#include "world/node_grid.h"
+#include "world/object_grid.h"
+#include "world/object_store.h"
+#include "world/ai_think.h"
+#include "world/geography.h"
 #include "world/gunfire.h"
 #include "world/explosion.h"
 #include "world/radargrid.h"
 #include "world/votingsystem.h"
 #include "world/whiteboard.h"
+#include "world/world_hash.h"
+#include "world/world_view_interface.h"
 
 
 
@@ -43,12 +49,25 @@ struct CityLocation;
 #define GAMESPEED_MEDIUM        10
 #define GAMESPEED_FAST          20
 
+#define PREFS_GRAPHICS_LOWRESWORLD      "RenderLowDetailWorld"
+#define PREFS_GRAPHICS_TRAILS           "RenderObjectTrails"
+
 
 class World
 {
 protected:    
     int         m_timeScaleFactor;
     int         m_nextUniqueId;
+
+    int         m_radarMask[MAX_TEAMS];                     // GetRadarMask of each team, as of the last UpdateRadar
+    int         m_radarAlliance[MAX_TEAMS];                 // Alliance of each team, as of the last UpdateRadar
+    int         m_radarPermitDefection;
+    bool        m_radarRetestAll;                           // Next UpdateRadar must test every object
+
+    WorldViewInterface  *m_view;                            // Whatever is showing the World, if anything
+
+    friend class WorldSnapshot;
+    friend class WorldHash;
     
 public:
     enum
@@ -110,7 +129,14 @@ public:
     int             m_myTeamId;
     Date            m_theDate;
     RadarGrid       m_radarGrid;
+    RouteTable      m_nodeRoutes;                           // All-pairs sea routes between m_nodes
+    NodeGrid        m_nodeGrid;                             // Spatial index over m_nodes for GetClosestNode
+    ObjectGrid      m_objectGrid;                           // Spatial index over m_objects, by slot
+    ObjectStore     m_objectStore;                          // Dense copies of the hot fields of m_objects, by slot
+    AIThink         m_aiThink;                              // Runs the read-only part of the AI teams on worker threads
+    Geography       m_geography;                            // Terrain and sonar pings, independent of the MapRenderer
     VotingSystem    m_votingSystem;
+    WorldHash       m_hash;                                 // Trees of hashes over the latest letters, to find desyncs
 
     BoundedArray<int>   m_defconTime;     // time in minutes when each defcon starts
     BoundedArray<bool>  m_firstLaunch;    // 
@@ -123,12 +149,16 @@ public:
 
 public:   
     World();
+    ~World();
 
     void Init();
     void Shutdown();
     void LoadCoastlines();
 
     int  GenerateUniqueId   ();
+
+    void                SetView     ( WorldViewInterface *_view );     // Takes ownership
+    WorldViewInterface *GetView     ();
     
     void InitialiseTeam     ( int teamId, int teamType, int clientId );
     void RemoveTeams        ( int clientId, int reason );
@@ -138,6 +168,7 @@ public:
     void RemoveTeam         ( int _teamId );    
     void InitialiseSpectator( int _clientId );
 
+    void LoadGeography      ();
     void LoadNodes          ();
     void AssignCities       ();
     void RandomObjects      ( int teamId );
@@ -164,6 +195,7 @@ public:
     void CreateExplosion    ( int teamId, Fixed longitude, Fixed latitude, Fixed intensity, int targetTeamId=-1 );
 
     bool IsVisible          ( Fixed longitude, Fixed latitude, int teamId );
+    int  GetRadarMask       ( int teamId );                                                 // Bit per team whose radar teamId sees through
 
     void ObjectPlacement        ( int teamId, int unitType, Fixed longitude, Fixed latitude, int fleetId );
     void ObjectStateChange      ( int objectId, int newState );
@@ -200,19 +232,26 @@ public:
     void Update         ();
     void UpdateRadar    ();
 
+    void CreateSonarPing            ( int objectId, int teamId, Fixed const &longitude, Fixed const &latitude );
+    void UpdateSonarPingVisibility  ( SonarContact *ping );
+
 	void GenerateWorldEvent ();
     
 
+    bool  IsValidTerritory          ( int teamId, Fixed longitude, Fixed latitude, bool seaUnit );      // teamId -1 means any sailable water
+    int   GetTerritoryOwner         ( Fixed longitude, Fixed latitude, bool seaArea = false );
+
     bool  IsSailable                ( Fixed const &fromLongitude, Fixed const &fromLatitude, Fixed const &toLongitude, Fixed const &toLatitude);
     bool  IsSailableSlow            ( Fixed const &fromLongitude, Fixed const &fromLatitude, Fixed const &toLongitude, Fixed const &toLatitude);
     int   GetClosestNode            ( Fixed const &longitude, Fixed const &latitude );
+    int   FindClosestNode           ( Fixed const &longitude, Fixed const &latitude );                  // Uncached, safe on any thread
     int   GetClosestNodeSlow        ( Fixed const &longitude, Fixed const &latitude );
 
     Fixed GetDistanceAcrossSeam     ( Fixed const &fromLongitude, Fixed const &fromLatitude, Fixed const &toLongitude, Fixed const &toLatitude );
     Fixed GetDistanceAcrossSeamSqd  ( Fixed const &fromLongitude, Fixed const &fromLatitude, Fixed const &toLongitude, Fixed const &toLatitude );
     Fixed GetDistance               ( Fixed const &fromLongitude, Fixed const &fromLatitude, Fixed const &toLongitude, Fixed const &toLatitude, bool ignoreSeam = false );
     Fixed GetDistanceSqd            ( Fixed const &fromLongitude, Fixed const &fromLatitude, Fixed const &toLongitude, Fixed const &toLatitude, bool ignoreSeam = false );
-    Fixed GetSailDistance           ( Fixed const &fromLongitude, Fixed const &fromLatitude, Fixed const &toLongitude, Fixed const &toLatitude );
+    Fixed GetSailDistance           ( Fixed const &fromLongitude, Fixed const &fromLatitude, Fixed const &toLongitude, Fixed const &toLatitude, bool threadSafe = false );
     Fixed GetSailDistanceSlow       ( Fixed const &fromLongitude, Fixed const &fromLatitude, Fixed const &toLongitude, Fixed const &toLatitude );
     
     void  GetSeamCrossLatitude  ( Vector3<Fixed> _to, Vector3<Fixed> _from, Fixed *longitude, Fixed *latitude );
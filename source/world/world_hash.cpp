@@ -0,0 +1,505 @@
+#include "lib/universal_include.h"
+
+#include <stdio.h>
+#include <string.h>
+
+#include "lib/debug_utils.h"
+
+#include "world/world.h"
+#include "world/world_hash.h"
+#include "world/team.h"
+#include "world/fleet.h"
+#include "world/city.h"
+
+
+#define WORLDHASH_OFFSET                2166136261u             // FNV-1a
+#define WORLDHASH_PRIME                 16777619u
+
+
+// ============================================================================
+// WorldHashTree
+
+WorldHashTree::WorldHashTree()
+:   m_nodes(NULL),
+    m_numNodes(0),
+    m_maxNodes(0),
+    m_seqId(-1)
+{
+}
+
+
+WorldHashTree::~WorldHashTree()
+{
+    delete [] m_nodes;
+}
+
+
+void WorldHashTree::Clear()
+{
+    m_numNodes = 0;
+    m_seqId = -1;
+}
+
+
+int WorldHashTree::AddNodes( int _count )
+{
+    if( m_numNodes + _count > m_maxNodes )
+    {
+        int maxNodes = m_maxNodes * 2;
+        if( maxNodes < m_numNodes + _count ) maxNodes = m_numNodes + _count + 256;
+
+        WorldHashNode *nodes = new WorldHashNode[maxNodes];
+        if( m_numNodes > 0 ) memcpy( nodes, m_nodes, m_numNodes * sizeof(WorldHashNode) );
+
+        delete [] m_nodes;
+        m_nodes = nodes;
+        m_maxNodes = maxNodes;
+    }
+
+    int first = m_numNodes;
+    m_numNodes += _count;
+
+    for( int i = first; i < m_numNodes; ++i )
+    {
+        m_nodes[i].m_key = 0;
+        m_nodes[i].m_hash = WORLDHASH_OFFSET;
+        m_nodes[i].m_firstChild = -1;
+        m_nodes[i].m_numChildren = 0;
+    }
+
+    return first;
+}
+
+
+void WorldHashTree::CopyFrom( WorldHashTree *_tree )
+{
+    Clear();
+    AddNodes( _tree->m_numNodes );
+
+    if( m_numNodes > 0 ) memcpy( m_nodes, _tree->m_nodes, m_numNodes * sizeof(WorldHashNode) );
+    m_seqId = _tree->m_seqId;
+}
+
+
+WorldHashNode *WorldHashTree::GetNode( int _index )
+{
+    AppAssert( _index >= 0 && _index < m_numNodes );
+    return &m_nodes[_index];
+}
+
+
+WorldHashNode *WorldHashTree::FindNode( int *_path, int _depth )
+{
+    if( m_numNodes == 0 ) return NULL;
+
+    WorldHashNode *node = &m_nodes[0];
+
+    for( int i = 0; i < _depth; ++i )
+    {
+        WorldHashNode *child = NULL;
+
+        for( int j = 0; j < node->m_numChildren; ++j )
+        {
+            WorldHashNode *thisChild = &m_nodes[ node->m_firstChild + j ];
+            if( thisChild->m_key == _path[i] )
+            {
+                child = thisChild;
+                break;
+            }
+        }
+
+        if( !child ) return NULL;
+        node = child;
+    }
+
+    return node;
+}
+
+
+unsigned int WorldHashTree::GetRootHash()
+{
+    if( m_numNodes == 0 ) return 0;
+    return m_nodes[0].m_hash;
+}
+
+
+// ============================================================================
+// WorldHash
+
+WorldHash::WorldHash()
+:   m_leaves(NULL),
+    m_numLeaves(0),
+    m_maxLeaves(0)
+{
+}
+
+
+WorldHash::~WorldHash()
+{
+    delete [] m_leaves;
+}
+
+
+void WorldHash::Reset()
+{
+    for( int i = 0; i < WORLDHASH_HISTORY; ++i )
+    {
+        m_trees[i].Clear();
+    }
+
+    m_pinned.Clear();
+}
+
+
+unsigned int WorldHash::Mix( unsigned int _hash, unsigned int _value )
+{
+    for( int i = 0; i < 4; ++i )
+    {
+        _hash ^= ( _value & 0xFF );
+        _hash *= WORLDHASH_PRIME;
+        _value >>= 8;
+    }
+
+    return _hash;
+}
+
+
+unsigned int WorldHash::Mix( unsigned int _hash, Fixed const &_value )
+{
+    unsigned long long value = _value.InternalValue();
+
+    _hash = Mix( _hash, (unsigned int) ( value & 0xFFFFFFFF ) );
+    _hash = Mix( _hash, (unsigned int) ( value >> 32 ) );
+    return _hash;
+}
+
+
+unsigned int WorldHash::HashObject( WorldObject *_object )
+{
+    unsigned int hash = WORLDHASH_OFFSET;
+
+    hash = Mix( hash, (unsigned int) _object->m_type );
+    hash = Mix( hash, (unsigned int) _object->m_teamId );
+    hash = Mix( hash, (unsigned int) _object->m_objectId );
+    hash = Mix( hash, (unsigned int) _object->m_fleetId );
+    hash = Mix( hash, _object->m_longitude );
+    hash = Mix( hash, _object->m_latitude );
+    hash = Mix( hash, _object->m_vel.x );
+    hash = Mix( hash, _object->m_vel.y );
+    hash = Mix( hash, (unsigned int) _object->m_life );
+    hash = Mix( hash, (unsigned int) _object->m_currentState );
+    hash = Mix( hash, _object->m_stateTimer );
+    hash = Mix( hash, (unsigned int) _object->m_targetObjectId );
+    hash = Mix( hash, (unsigned int) _object->m_actionQueue.Size() );
+
+    return hash;
+}
+
+
+static unsigned int HashTeam( Team *_team )
+{
+    // Not m_type : the local player is a remote player everywhere else
+
+    unsigned int hash = WORLDHASH_OFFSET;
+
+    hash = WorldHash::Mix( hash, (unsigned int) _team->m_teamId );
+    hash = WorldHash::Mix( hash, (unsigned int) _team->m_allianceId );
+    hash = WorldHash::Mix( hash, (unsigned int) _team->m_randSeed );
+    hash = WorldHash::Mix( hash, (unsigned int) _team->m_desiredGameSpeed );
+    hash = WorldHash::Mix( hash, (unsigned int) _team->m_enemyKills );
+    hash = WorldHash::Mix( hash, (unsigned int) _team->m_friendlyDeaths );
+    hash = WorldHash::Mix( hash, (unsigned int) _team->m_collatoralDamage );
+    hash = WorldHash::Mix( hash, (unsigned int) _team->m_aggression );
+    hash = WorldHash::Mix( hash, (unsigned int) _team->m_unitCredits );
+    hash = WorldHash::Mix( hash, (unsigned int) _team->m_currentState );
+    hash = WorldHash::Mix( hash, (unsigned int) _team->m_subState );
+    hash = WorldHash::Mix( hash, (unsigned int) _team->m_targetTeam );
+    hash = WorldHash::Mix( hash, _team->m_aiActionTimer );
+    hash = WorldHash::Mix( hash, _team->m_aiAssaultTimer );
+    hash = WorldHash::Mix( hash, _team->m_aiStateTimer );
+
+    for( int i = 0; i < _team->m_unitsAvailable.Size(); ++i )
+    {
+        hash = WorldHash::Mix( hash, (unsigned int) _team->m_unitsAvailable[i] );
+        hash = WorldHash::Mix( hash, (unsigned int) _team->m_unitsInPlay[i] );
+    }
+
+    for( int i = 0; i < _team->m_territories.Size(); ++i )
+    {
+        hash = WorldHash::Mix( hash, (unsigned int) _team->m_territories[i] );
+    }
+
+    for( int i = 0; i < _team->m_ceaseFire.Size(); ++i )
+    {
+        unsigned int flags = ( _team->m_ceaseFire[i] ? 1 : 0 ) | ( _team->m_sharingRadar[i] ? 2 : 0 );
+        hash = WorldHash::Mix( hash, flags );
+    }
+
+    return hash;
+}
+
+
+static unsigned int HashFleet( Fleet *_fleet )
+{
+    unsigned int hash = WORLDHASH_OFFSET;
+
+    hash = WorldHash::Mix( hash, (unsigned int) _fleet->m_fleetId );
+    hash = WorldHash::Mix( hash, (unsigned int) _fleet->m_teamId );
+    hash = WorldHash::Mix( hash, (unsigned int) _fleet->m_active );
+    hash = WorldHash::Mix( hash, _fleet->m_longitude );
+    hash = WorldHash::Mix( hash, _fleet->m_latitude );
+    hash = WorldHash::Mix( hash, _fleet->m_targetLongitude );
+    hash = WorldHash::Mix( hash, _fleet->m_targetLatitude );
+    hash = WorldHash::Mix( hash, (unsigned int) _fleet->m_currentState );
+    hash = WorldHash::Mix( hash, (unsigned int) _fleet->m_aiState );
+    hash = WorldHash::Mix( hash, (unsigned int) _fleet->m_holdPosition );
+    hash = WorldHash::Mix( hash, (unsigned int) _fleet->m_targetObjectId );
+
+    for( int i = 0; i < _fleet->m_fleetMembers.Size(); ++i )
+    {
+        hash = WorldHash::Mix( hash, (unsigned int) _fleet->m_fleetMembers[i] );
+    }
+
+    return hash;
+}
+
+
+void WorldHash::AddLeaf( int _group, int _key, unsigned int _hash )
+{
+    if( m_numLeaves == m_maxLeaves )
+    {
+        int maxLeaves = m_maxLeaves * 2 + 256;
+        Leaf *leaves = new Leaf[maxLeaves];
+        if( m_numLeaves > 0 ) memcpy( leaves, m_leaves, m_numLeaves * sizeof(Leaf) );
+
+        delete [] m_leaves;
+        m_leaves = leaves;
+        m_maxLeaves = maxLeaves;
+    }
+
+    Leaf *leaf = &m_leaves[m_numLeaves++];
+    leaf->m_group = _group;
+    leaf->m_key = _key;
+    leaf->m_hash = _hash;
+}
+
+
+unsigned int WorldHash::HashChildren( WorldHashTree *_tree, WorldHashNode *_node )
+{
+    unsigned int hash = WORLDHASH_OFFSET;
+
+    for( int i = 0; i < _node->m_numChildren; ++i )
+    {
+        WorldHashNode *child = _tree->GetNode( _node->m_firstChild + i );
+        hash = Mix( hash, (unsigned int) child->m_key );
+        hash = Mix( hash, child->m_hash );
+    }
+
+    return hash;
+}
+
+
+int WorldHash::AddLeafNodes( WorldHashTree *_tree, int _from, int _count )
+{
+    int first = _tree->AddNodes( _count );
+
+    for( int i = 0; i < _count; ++i )
+    {
+        WorldHashNode *node = _tree->GetNode( first + i );
+        node->m_key = m_leaves[_from + i].m_key;
+        node->m_hash = m_leaves[_from + i].m_hash;
+    }
+
+    return first;
+}
+
+
+void WorldHash::FinishSubsystem( WorldHashTree *_tree, int _node, bool _grouped )
+{
+    //
+    // Ungrouped, the leaves go straight under the subsystem.  Grouped, they
+    // arrive in order of group, and each run of them gets a node of its own.
+    // Nodes move as the tree grows, so only hold on to their indices.
+
+    int firstChild;
+    int numChildren;
+
+    if( !_grouped )
+    {
+        firstChild = AddLeafNodes( _tree, 0, m_numLeaves );
+        numChildren = m_numLeaves;
+    }
+    else
+    {
+        numChildren = 0;
+        for( int i = 0; i < m_numLeaves; ++i )
+        {
+            if( i == 0 || m_leaves[i].m_group != m_leaves[i-1].m_group ) ++numChildren;
+        }
+
+        firstChild = _tree->AddNodes( numChildren );
+
+        int from = 0;
+        for( int i = 0; i < numChildren; ++i )
+        {
+            int count = 1;
+            while( from + count < m_numLeaves &&
+                   m_leaves[from + count].m_group == m_leaves[from].m_group )
+            {
+                ++count;
+            }
+
+            int first = AddLeafNodes( _tree, from, count );
+
+            WorldHashNode *group = _tree->GetNode( firstChild + i );
+            group->m_key = m_leaves[from].m_group;
+            group->m_firstChild = first;
+            group->m_numChildren = count;
+            group->m_hash = HashChildren( _tree, group );
+
+            from += count;
+        }
+    }
+
+    WorldHashNode *subsystem = _tree->GetNode( _node );
+    subsystem->m_firstChild = firstChild;
+    subsystem->m_numChildren = numChildren;
+    subsystem->m_hash = HashChildren( _tree, subsystem );
+
+    m_numLeaves = 0;
+}
+
+
+unsigned int WorldHash::Generate( World *_world, int _seqId, Fixed _random )
+{
+    AppAssert( _seqId >= 0 );
+
+    WorldHashTree *tree = &m_trees[ _seqId % WORLDHASH_HISTORY ];
+    tree->Clear();
+    tree->m_seqId = _seqId;
+
+    int root = tree->AddNodes( 1 );
+    int subsystems = tree->AddNodes( WorldHash_NumSubsystems );
+
+    for( int i = 0; i < WorldHash_NumSubsystems; ++i )
+    {
+        tree->GetNode( subsystems + i )->m_key = i;
+    }
+
+
+    //
+    // Single leaves
+
+    tree->GetNode( subsystems + WorldHash_Random )->m_hash = Mix( WORLDHASH_OFFSET, _random );
+
+    unsigned int worldHash = WORLDHASH_OFFSET;
+    worldHash = Mix( worldHash, (unsigned int) _world->m_theDate.m_numDays );
+    worldHash = Mix( worldHash, _world->m_theDate.m_theDate );
+    worldHash = Mix( worldHash, (unsigned int) _world->m_nextUniqueId );
+    worldHash = Mix( worldHash, (unsigned int) _world->GetDefcon() );
+    worldHash = Mix( worldHash, (unsigned int) _world->m_radiation.Size() );
+    tree->GetNode( subsystems + WorldHash_World )->m_hash = worldHash;
+
+
+    //
+    // Teams, their fleets and their radar coverage
+
+    for( int i = 0; i < _world->m_teams.Size(); ++i )
+    {
+        Team *team = _world->m_teams[i];
+        AddLeaf( 0, team->m_teamId, HashTeam( team ) );
+    }
+    FinishSubsystem( tree, subsystems + WorldHash_Teams, false );
+
+    for( int i = 0; i < _world->m_teams.Size(); ++i )
+    {
+        Team *team = _world->m_teams[i];
+        for( int j = 0; j < team->m_fleets.Size(); ++j )
+        {
+            Fleet *fleet = team->m_fleets[j];
+            AddLeaf( team->m_teamId, fleet->m_fleetId, HashFleet( fleet ) );
+        }
+    }
+    FinishSubsystem( tree, subsystems + WorldHash_Fleets, true );
+
+    for( int i = 0; i < _world->m_teams.Size(); ++i )
+    {
+        Team *team = _world->m_teams[i];
+        AddLeaf( 0, team->m_teamId, _world->m_radarGrid.GetHash( team->m_teamId ) );
+    }
+    FinishSubsystem( tree, subsystems + WorldHash_Radar, false );
+
+
+    //
+    // Everything else, in buckets of array slots
+
+    for( int i = 0; i < _world->m_cities.Size(); ++i )
+    {
+        AddLeaf( i / WORLDHASH_BUCKETSIZE, i, HashObject( _world->m_cities[i] ) );
+    }
+    FinishSubsystem( tree, subsystems + WorldHash_Cities, true );
+
+    for( int i = 0; i < _world->m_gunfire.Size(); ++i )
+    {
+        if( _world->m_gunfire.ValidIndex(i) )
+        {
+            AddLeaf( i / WORLDHASH_BUCKETSIZE, i, HashObject( _world->m_gunfire[i] ) );
+        }
+    }
+    FinishSubsystem( tree, subsystems + WorldHash_GunFire, true );
+
+    for( int i = 0; i < _world->m_explosions.Size(); ++i )
+    {
+        if( _world->m_explosions.ValidIndex(i) )
+        {
+            AddLeaf( i / WORLDHASH_BUCKETSIZE, i, HashObject( _world->m_explosions[i] ) );
+        }
+    }
+    FinishSubsystem( tree, subsystems + WorldHash_Explosions, true );
+
+    for( int type = 0; type < WorldObject::NumObjectTypes; ++type )
+    {
+        for( int i = 0; i < _world->m_objects.Size(); ++i )
+        {
+            if( _world->m_objects.ValidIndex(i) )
+            {
+                WorldObject *obj = _world->m_objects[i];
+                if( obj->m_type == type )
+                {
+                    AddLeaf( i / WORLDHASH_BUCKETSIZE, i, HashObject( obj ) );
+                }
+            }
+        }
+        FinishSubsystem( tree, subsystems + WorldHash_Objects + type, true );
+    }
+
+
+    WorldHashNode *rootNode = tree->GetNode( root );
+    rootNode->m_firstChild = subsystems;
+    rootNode->m_numChildren = WorldHash_NumSubsystems;
+    rootNode->m_hash = HashChildren( tree, rootNode );
+
+    return rootNode->m_hash;
+}
+
+
+WorldHashTree *WorldHash::GetTree( int _seqId )
+{
+    if( _seqId < 0 ) return NULL;
+    if( m_pinned.m_seqId == _seqId ) return &m_pinned;
+
+    WorldHashTree *tree = &m_trees[ _seqId % WORLDHASH_HISTORY ];
+    if( tree->m_seqId == _seqId ) return tree;
+
+    return NULL;
+}
+
+
+WorldHashTree *WorldHash::Pin( int _seqId )
+{
+    WorldHashTree *tree = GetTree( _seqId );
+    if( !tree || tree == &m_pinned ) return tree;
+
+    m_pinned.CopyFrom( tree );
+    return &m_pinned;
+}
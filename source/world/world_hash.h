@@ -0,0 +1,135 @@
+
+/*
+ * ==========
+ * WORLD HASH
+ * ==========
+ *
+ * A tree of hashes over the simulation state, built after each letter
+ * has been processed.  The root is what the sync byte is cut from, and
+ * below it come the subsystems : the sync random numbers, the World
+ * itself, teams, fleets, cities, radar coverage, gunfire, explosions
+ * and the objects of each type.  The larger ones are split into
+ * buckets of array slots, down to a leaf for each team, fleet and
+ * object.
+ *
+ * When clients disagree the Server asks two of them for the children
+ * of one node at a time, and follows the first child that differs
+ * until it reaches a leaf.  Every node has a key, unique among its
+ * siblings, so the same path of keys finds the same node on every
+ * client even once their trees have drifted apart.
+ *
+ * The last WORLDHASH_HISTORY trees are kept, since the Server only
+ * notices a difference once every client has reported in.  The first
+ * request for a tree pins it, so it outlives the history for as long
+ * as the Server takes to finish.
+ *
+ * Bump WORLDHASH_REVISION whenever what goes into the hash changes :
+ * clients only play together when they cut the sync byte the same way.
+ *
+ */
+
+#ifndef _included_worldhash_h
+#define _included_worldhash_h
+
+#include "lib/math/fixed.h"
+
+#include "world/worldobject.h"
+
+class World;
+
+
+#define WORLDHASH_REVISION          1                       // Sent by clients when they join, older ones send nothing
+#define WORLDHASH_HISTORY           64                      // Trees kept, one per letter
+#define WORLDHASH_BUCKETSIZE        64                      // Array slots under each bucket node
+#define WORLDHASH_MAXDEPTH          4                       // Root, subsystem, bucket, leaf
+#define WORLDHASH_MAXCHILDREN       1024                    // Most children sent to the Server for one node
+
+
+enum                                                        // Keys of the subsystem nodes, under the root
+{
+    WorldHash_Random,
+    WorldHash_World,                                        // Date, defcon, unique ids, radiation
+    WorldHash_Teams,
+    WorldHash_Fleets,                                       // By team, then by fleet
+    WorldHash_Cities,
+    WorldHash_Radar,                                        // Coverage by team
+    WorldHash_GunFire,
+    WorldHash_Explosions,
+    WorldHash_Objects,                                      // Plus the WorldObject type
+    WorldHash_NumSubsystems = WorldHash_Objects + WorldObject::NumObjectTypes
+};
+
+
+struct WorldHashNode
+{
+    int             m_key;
+    unsigned int    m_hash;
+    int             m_firstChild;                           // Children are together in the tree
+    int             m_numChildren;                          // 0 for a leaf
+};
+
+
+class WorldHashTree
+{
+protected:
+    WorldHashNode   *m_nodes;                               // The root is the first
+    int             m_numNodes;
+    int             m_maxNodes;
+
+public:
+    int             m_seqId;                                // -1 until built
+
+public:
+    WorldHashTree();
+    ~WorldHashTree();
+
+    void            Clear       ();
+    int             AddNodes    ( int _count );             // Index of the first
+    void            CopyFrom    ( WorldHashTree *_tree );
+
+    WorldHashNode   *GetNode    ( int _index );
+    WorldHashNode   *FindNode   ( int *_path, int _depth ); // NULL if this tree has no such node
+    unsigned int    GetRootHash ();
+};
+
+
+class WorldHash
+{
+protected:
+    WorldHashTree   m_trees[WORLDHASH_HISTORY];             // By seqId
+    WorldHashTree   m_pinned;                               // Being compared by the Server
+
+    struct Leaf
+    {
+        int             m_group;
+        int             m_key;
+        unsigned int    m_hash;
+    };
+
+    Leaf            *m_leaves;                              // Collected for one subsystem at a time
+    int             m_numLeaves;
+    int             m_maxLeaves;
+
+    void            AddLeaf         ( int _group, int _key, unsigned int _hash );
+    int             AddLeafNodes    ( WorldHashTree *_tree, int _from, int _count );       // Index of the first
+    void            FinishSubsystem ( WorldHashTree *_tree, int _node, bool _grouped );     // Adds the leaves under _node
+
+    static unsigned int HashChildren( WorldHashTree *_tree, WorldHashNode *_node );
+
+public:
+    WorldHash();
+    ~WorldHash();
+
+    unsigned int    Generate        ( World *_world, int _seqId, Fixed _random );   // Returns the root hash
+    void            Reset           ();
+
+    WorldHashTree   *GetTree        ( int _seqId );                                 // NULL once forgotten
+    WorldHashTree   *Pin            ( int _seqId );
+
+    static unsigned int Mix         ( unsigned int _hash, unsigned int _value );
+    static unsigned int Mix         ( unsigned int _hash, Fixed const &_value );
+    static unsigned int HashObject  ( WorldObject *_object );
+};
+
+
+#endif
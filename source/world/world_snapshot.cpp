@@ -0,0 +1,561 @@
+#include "lib/universal_include.h"
+
+#include <string.h>
+
+#include "lib/debug_utils.h"
+#include "lib/math/random_number.h"
+#include "lib/tosser/directory.h"
+
+#include "app/app.h"
+#include "app/globals.h"
+#include "app/game.h"
+
+#include "network/ClientToServer.h"
+#include "network/letter_codec.h"
+
+#include "world/world.h"
+#include "world/world_snapshot.h"
+#include "world/earthdata.h"
+#include "world/city.h"
+#include "world/saucer.h"
+#include "world/gunfire.h"
+#include "world/depthcharge.h"
+#include "world/explosion.h"
+
+
+#define SYNCRAND_STATESIZE              625                     // The 624 words of getSeed, then its index
+
+
+// ============================================================================
+// Helpers for Save/LoadSnapshot
+
+
+void WorldSnapshot::WriteVector( Directory *_dir, char *_name, Vector3<Fixed> const &_vector )
+{
+    char name[256];
+
+    snprintf( name, sizeof(name), "%s.x", _name );
+    _dir->CreateData( name, _vector.x );
+    snprintf( name, sizeof(name), "%s.y", _name );
+    _dir->CreateData( name, _vector.y );
+    snprintf( name, sizeof(name), "%s.z", _name );
+    _dir->CreateData( name, _vector.z );
+}
+
+
+Vector3<Fixed> WorldSnapshot::ReadVector( Directory *_dir, char *_name )
+{
+    char name[256];
+    Vector3<Fixed> result;
+
+    snprintf( name, sizeof(name), "%s.x", _name );
+    result.x = _dir->GetDataFixed( name );
+    snprintf( name, sizeof(name), "%s.y", _name );
+    result.y = _dir->GetDataFixed( name );
+    snprintf( name, sizeof(name), "%s.z", _name );
+    result.z = _dir->GetDataFixed( name );
+
+    return result;
+}
+
+
+// ============================================================================
+// Objects
+
+
+template <class T>
+static void SaveArray( Directory *_dir, FastDArray<T *> &_array, char *_name )
+{
+    _dir->CreateData( "arraySize", _array.Size() );
+
+    LList<int> freeList;
+    _array.GetFreeList( &freeList );
+    LetterCodec::WriteIntList( _dir, "freeList", &freeList );
+
+    for( int i = 0; i < _array.Size(); ++i )
+    {
+        if( _array.ValidIndex(i) )
+        {
+            Directory *objDir = new Directory();
+            objDir->SetName( _name );
+            objDir->CreateData( "slot", i );
+            _array[i]->SaveSnapshot( objDir );
+            _dir->AddDirectory( objDir );
+        }
+    }
+}
+
+
+template <class T>
+static bool LoadArray( Directory *_dir, FastDArray<T *> &_array, char *_name, T *(*_create)( Directory * ) )
+{
+    int arraySize = _dir->GetDataInt( "arraySize" );
+    if( arraySize < 0 || arraySize > 1000000 ) return false;
+
+    _array.SetSize( arraySize );
+
+    for( int i = 0; i < _dir->m_subDirectories.Size(); ++i )
+    {
+        if( !_dir->m_subDirectories.ValidIndex(i) ) continue;
+        Directory *objDir = _dir->m_subDirectories[i];
+        if( strcmp( objDir->m_name, _name ) != 0 ) continue;
+
+        int slot = objDir->GetDataInt( "slot" );
+        if( slot < 0 || slot >= arraySize || _array.ValidIndex(slot) ) return false;
+
+        T *obj = _create( objDir );
+        if( !obj ) return false;
+
+        obj->LoadSnapshot( objDir );
+        _array.PutData( obj, slot );
+    }
+
+
+    //
+    // The free list decides the slot of everything created from here on
+
+    LList<int> freeList;
+    LetterCodec::ReadIntList( _dir, "freeList", &freeList );
+    if( freeList.Size() != arraySize - _array.NumUsed() ) return false;
+
+    for( int i = 0; i < freeList.Size(); ++i )
+    {
+        int slot = freeList[i];
+        if( slot < 0 || slot >= arraySize || _array.ValidIndex(slot) ) return false;
+    }
+
+    _array.SetFreeList( &freeList );
+    return true;
+}
+
+
+static WorldObject *CreateWorldObject( Directory *_dir )
+{
+    int type = _dir->GetDataInt( "type" );
+    if( type == WorldObject::TypeSaucer ) return new Saucer();
+    if( type == WorldObject::TypeCity ) return NULL;
+
+    return WorldObject::CreateObject( type );
+}
+
+
+static GunFire *CreateGunFire( Directory *_dir )
+{
+    if( _dir->HasData( "depthCharge" ) ) return new DepthCharge( 0 );
+
+    return new GunFire( 0 );
+}
+
+
+static Explosion *CreateExplosion( Directory *_dir )
+{
+    return new Explosion();
+}
+
+
+void WorldSnapshot::SaveObjects( Directory *_snapshot )
+{
+    World *world = g_app->GetWorld();
+
+    SaveArray( _snapshot->AddDirectory( "objects" ), world->m_objects, "object" );
+    SaveArray( _snapshot->AddDirectory( "gunfire" ), world->m_gunfire, "gunfire" );
+    SaveArray( _snapshot->AddDirectory( "explosions" ), world->m_explosions, "explosion" );
+}
+
+
+bool WorldSnapshot::LoadObjects( Directory *_snapshot )
+{
+    World *world = g_app->GetWorld();
+
+    Directory *objects = _snapshot->GetDirectory( "objects" );
+    Directory *gunfire = _snapshot->GetDirectory( "gunfire" );
+    Directory *explosions = _snapshot->GetDirectory( "explosions" );
+    if( !objects || !gunfire || !explosions ) return false;
+
+    if( !LoadArray( objects, world->m_objects, "object", CreateWorldObject ) ||
+        !LoadArray( gunfire, world->m_gunfire, "gunfire", CreateGunFire ) ||
+        !LoadArray( explosions, world->m_explosions, "explosion", CreateExplosion ) )
+    {
+        return false;
+    }
+
+    for( int i = 0; i < world->m_objects.Size(); ++i )
+    {
+        if( world->m_objects.ValidIndex(i) )
+        {
+            world->m_objectGrid.Add( i );
+            world->m_objectStore.Add( i, world->m_objects[i] );
+        }
+    }
+
+    world->m_radarRetestAll = true;
+    return true;
+}
+
+
+// ============================================================================
+// Sync random numbers
+
+
+void WorldSnapshot::SaveSyncRand( Directory *_snapshot )
+{
+    int state[SYNCRAND_STATESIZE];
+
+    for( int i = 0; i < SYNCRAND_STATESIZE; ++i )
+    {
+        state[i] = (int) getSeed(i);
+    }
+
+    LetterCodec::WriteInts( _snapshot, "syncRand", state, SYNCRAND_STATESIZE );
+}
+
+
+bool WorldSnapshot::LoadSyncRand( Directory *_snapshot )
+{
+    int state[SYNCRAND_STATESIZE];
+
+    if( LetterCodec::ReadInts( _snapshot, "syncRand", state, SYNCRAND_STATESIZE ) != SYNCRAND_STATESIZE ) return false;
+    if( state[SYNCRAND_STATESIZE-1] < 0 || state[SYNCRAND_STATESIZE-1] > SYNCRAND_STATESIZE - 1 ) return false;
+
+    for( int i = 0; i < SYNCRAND_STATESIZE; ++i )
+    {
+        setSeed( i, (unsigned int) state[i] );
+    }
+
+    return true;
+}
+
+
+// ============================================================================
+// WorldSnapshot
+
+
+char *WorldSnapshot::Save( int _seqId, int &_length )
+{
+    World *world = g_app->GetWorld();
+    ClientToServer *clientToServer = g_app->GetClientToServer();
+
+    Directory snapshot;
+    snapshot.SetName( "snapshot" );
+    snapshot.CreateData( "version", WORLDSNAPSHOT_VERSION );
+    snapshot.CreateData( "seqId", _seqId );
+
+    g_app->GetGame()->SaveSnapshot( snapshot.AddDirectory( "game" ) );
+
+
+    //
+    // The World itself
+
+    snapshot.CreateData( "timeScaleFactor", world->m_timeScaleFactor );
+    snapshot.CreateData( "nextUniqueId", world->m_nextUniqueId );
+    snapshot.CreateData( "numDays", world->m_theDate.m_numDays );
+    snapshot.CreateData( "theDate", world->m_theDate.m_theDate );
+    snapshot.CreateData( "numNukesGivenToEachTeam", world->m_numNukesGivenToEachTeam );
+
+    LetterCodec::WriteInts( &snapshot, "defconTime", &world->m_defconTime[0], world->m_defconTime.Size() );
+
+    int firstLaunch[MAX_TEAMS];
+    for( int t = 0; t < MAX_TEAMS; ++t ) firstLaunch[t] = world->m_firstLaunch[t];
+    LetterCodec::WriteInts( &snapshot, "firstLaunch", firstLaunch, MAX_TEAMS );
+
+    int citiesNuked[World::NumAchievementCities];
+    for( int i = 0; i < World::NumAchievementCities; ++i ) citiesNuked[i] = world->m_achievementCitiesNuked[i];
+    LetterCodec::WriteInts( &snapshot, "achievementCitiesNuked", citiesNuked, World::NumAchievementCities );
+
+    Directory *populationCenters = snapshot.AddDirectory( "populationCenter" );
+    for( int i = 0; i < World::NumTerritories; ++i )
+    {
+        char name[32];
+        sprintf( name, "%d", i );
+        WriteVector( populationCenters, name, world->m_populationCenter[i] );
+    }
+
+    LetterCodec::WriteIntList( &snapshot, "populationTotals", &world->m_populationTotals );
+
+    for( int i = 0; i < world->m_radiation.Size(); ++i )
+    {
+        Directory *radiation = new Directory();
+        radiation->SetName( "radiation" );
+        WriteVector( radiation, "position", *world->m_radiation[i] );
+        snapshot.AddDirectory( radiation );
+    }
+
+
+    //
+    // Teams and spectators
+
+    for( int i = 0; i < world->m_teams.Size(); ++i )
+    {
+        Directory *teamDir = new Directory();
+        teamDir->SetName( "team" );
+        world->m_teams[i]->SaveSnapshot( teamDir );
+        snapshot.AddDirectory( teamDir );
+    }
+
+    for( int i = 0; i < world->m_spectators.Size(); ++i )
+    {
+        Spectator *spectator = world->m_spectators[i];
+
+        Directory *spectatorDir = new Directory();
+        spectatorDir->SetName( "spectator" );
+        spectatorDir->CreateData( "name", spectator->m_name );
+        spectatorDir->CreateData( "clientId", spectator->m_clientId );
+        snapshot.AddDirectory( spectatorDir );
+    }
+
+
+    //
+    // Cities are found again in the EarthData by index
+
+    LList<City *> &earthCities = g_app->GetEarthData()->m_cities;
+
+    for( int i = 0; i < world->m_cities.Size(); ++i )
+    {
+        City *city = world->m_cities[i];
+
+        int earthIndex = -1;
+        for( int j = 0; j < earthCities.Size(); ++j )
+        {
+            if( earthCities[j] == city )
+            {
+                earthIndex = j;
+                break;
+            }
+        }
+        AppAssert( earthIndex != -1 );
+
+        Directory *cityDir = new Directory();
+        cityDir->SetName( "city" );
+        cityDir->CreateData( "earthIndex", earthIndex );
+        city->SaveSnapshot( cityDir );
+        snapshot.AddDirectory( cityDir );
+    }
+
+    SaveObjects( &snapshot );
+
+
+    //
+    // Everything else the simulation keeps
+
+    world->m_radarGrid.SaveSnapshot( snapshot.AddDirectory( "radarGrid" ) );
+    world->m_votingSystem.SaveSnapshot( snapshot.AddDirectory( "votingSystem" ) );
+
+    for( int t = 0; t < MAX_TEAMS; ++t )
+    {
+        Directory *whiteBoard = new Directory();
+        whiteBoard->SetName( "whiteBoard" );
+        world->m_whiteBoards[t].SaveSnapshot( whiteBoard );
+        snapshot.AddDirectory( whiteBoard );
+    }
+
+    for( int i = 0; i < world->m_geography.m_sonarPings.Size(); ++i )
+    {
+        SonarContact *ping = world->m_geography.m_sonarPings[i];
+
+        int visible[MAX_TEAMS];
+        for( int t = 0; t < MAX_TEAMS; ++t ) visible[t] = ping->m_visible[t];
+
+        Directory *pingDir = new Directory();
+        pingDir->SetName( "sonarPing" );
+        pingDir->CreateData( "objectId", ping->m_objectId );
+        pingDir->CreateData( "teamId", ping->m_teamId );
+        pingDir->CreateData( "longitude", ping->m_longitude );
+        pingDir->CreateData( "latitude", ping->m_latitude );
+        pingDir->CreateData( "age", ping->m_age );
+        LetterCodec::WriteInts( pingDir, "visible", visible, MAX_TEAMS );
+        snapshot.AddDirectory( pingDir );
+    }
+
+    LetterCodec::WriteIntList( &snapshot, "outOfSyncClients", &clientToServer->m_outOfSyncClients );
+    LetterCodec::WriteIntList( &snapshot, "demoClients", &clientToServer->m_demoClients );
+
+    SaveSyncRand( &snapshot );
+
+
+    char *buffer = NULL;
+    int bufferSize = 0;
+    _length = LetterCodec::Write( &snapshot, LETTER_FORMAT_BINARY, buffer, bufferSize );
+
+    return buffer;
+}
+
+
+bool WorldSnapshot::Load( char *_data, int _length, int _seqId )
+{
+    World *world = g_app->GetWorld();
+    ClientToServer *clientToServer = g_app->GetClientToServer();
+
+    //
+    // The snapshot is read in place, so keep our own copy of the data
+    // for as long as the Directory lives
+
+    char *data = new char[_length];
+    memcpy( data, _data, _length );
+
+    Directory *snapshot = new Directory();
+    bool success = LetterCodec::Read( snapshot, data, _length ) &&
+                   snapshot->GetDataInt( "version" ) == WORLDSNAPSHOT_VERSION &&
+                   snapshot->GetDataInt( "seqId" ) == _seqId;
+
+    Directory *gameDir = snapshot->GetDirectory( "game" );
+    Directory *populationCenters = snapshot->GetDirectory( "populationCenter" );
+    Directory *radarGrid = snapshot->GetDirectory( "radarGrid" );
+    Directory *votingSystem = snapshot->GetDirectory( "votingSystem" );
+
+    if( !gameDir || !populationCenters || !radarGrid || !votingSystem )
+    {
+        success = false;
+    }
+
+    if( success )
+    {
+        g_app->GetGame()->LoadSnapshot( gameDir );
+
+
+        //
+        // The World itself, then the map as StartGame builds it
+
+        world->m_timeScaleFactor = snapshot->GetDataInt( "timeScaleFactor" );
+        world->m_nextUniqueId = snapshot->GetDataInt( "nextUniqueId" );
+        world->m_theDate.m_numDays = snapshot->GetDataInt( "numDays" );
+        world->m_theDate.m_theDate = snapshot->GetDataFixed( "theDate" );
+        world->m_numNukesGivenToEachTeam = snapshot->GetDataInt( "numNukesGivenToEachTeam" );
+
+        LetterCodec::ReadInts( snapshot, "defconTime", &world->m_defconTime[0], world->m_defconTime.Size() );
+
+        int firstLaunch[MAX_TEAMS];
+        memset( firstLaunch, 0, sizeof(firstLaunch) );
+        LetterCodec::ReadInts( snapshot, "firstLaunch", firstLaunch, MAX_TEAMS );
+        for( int t = 0; t < MAX_TEAMS; ++t ) world->m_firstLaunch[t] = ( firstLaunch[t] != 0 );
+
+        int citiesNuked[World::NumAchievementCities];
+        memset( citiesNuked, 0, sizeof(citiesNuked) );
+        LetterCodec::ReadInts( snapshot, "achievementCitiesNuked", citiesNuked, World::NumAchievementCities );
+        for( int i = 0; i < World::NumAchievementCities; ++i ) world->m_achievementCitiesNuked[i] = ( citiesNuked[i] != 0 );
+
+        for( int i = 0; i < World::NumTerritories; ++i )
+        {
+            char name[32];
+            sprintf( name, "%d", i );
+            world->m_populationCenter[i] = ReadVector( populationCenters, name );
+        }
+
+        world->m_populationTotals.Empty();
+        LetterCodec::ReadIntList( snapshot, "populationTotals", &world->m_populationTotals );
+
+        world->LoadGeography();
+        world->LoadNodes();
+        g_app->GetEarthData()->LoadCities();
+    }
+
+
+    //
+    // Everything kept in subdirectories, in the order saved
+
+    LList<City *> &earthCities = g_app->GetEarthData()->m_cities;
+    int myClientId = clientToServer->m_clientId;
+    int whiteBoardTeamId = 0;
+
+    for( int i = 0; success && i < snapshot->m_subDirectories.Size(); ++i )
+    {
+        if( !snapshot->m_subDirectories.ValidIndex(i) ) continue;
+        Directory *subDir = snapshot->m_subDirectories[i];
+
+        if( strcmp( subDir->m_name, "radiation" ) == 0 )
+        {
+            world->m_radiation.PutData( new Vector3<Fixed>( ReadVector( subDir, "position" ) ) );
+        }
+        else if( strcmp( subDir->m_name, "team" ) == 0 )
+        {
+            Team *team = new Team();
+            team->LoadSnapshot( subDir );
+
+            // Whose team is local depends on who is loading
+
+            int teamType = subDir->GetDataInt( "type" );
+            if( teamType == Team::TypeLocalPlayer || teamType == Team::TypeRemotePlayer )
+            {
+                teamType = ( team->m_clientId == myClientId ? Team::TypeLocalPlayer : Team::TypeRemotePlayer );
+            }
+            team->SetTeamType( teamType );
+
+            if( team->m_playerTeam && team->m_clientId == myClientId )
+            {
+                world->m_myTeamId = team->m_teamId;
+            }
+
+            world->m_teams.PutData( team );
+        }
+        else if( strcmp( subDir->m_name, "spectator" ) == 0 )
+        {
+            Spectator *spectator = new Spectator();
+            strncpy( spectator->m_name, subDir->GetDataString( "name" ), sizeof(spectator->m_name) );
+            spectator->m_name[ sizeof(spectator->m_name) - 1 ] = '\x0';
+            spectator->m_clientId = subDir->GetDataInt( "clientId" );
+            world->m_spectators.PutData( spectator );
+        }
+        else if( strcmp( subDir->m_name, "city" ) == 0 )
+        {
+            int earthIndex = subDir->GetDataInt( "earthIndex" );
+            if( !earthCities.ValidIndex( earthIndex ) )
+            {
+                success = false;
+                break;
+            }
+
+            City *city = earthCities[earthIndex];
+            city->LoadSnapshot( subDir );
+            world->m_cities.PutData( city );
+        }
+        else if( strcmp( subDir->m_name, "whiteBoard" ) == 0 )
+        {
+            if( whiteBoardTeamId < MAX_TEAMS ) world->m_whiteBoards[whiteBoardTeamId].LoadSnapshot( subDir );
+            ++whiteBoardTeamId;
+        }
+        else if( strcmp( subDir->m_name, "sonarPing" ) == 0 )
+        {
+            SonarContact *ping = world->m_geography.AddSonarPing( subDir->GetDataInt( "objectId" ),
+                                                                  subDir->GetDataInt( "teamId" ),
+                                                                  subDir->GetDataFixed( "longitude" ),
+                                                                  subDir->GetDataFixed( "latitude" ) );
+            ping->m_age = subDir->GetDataInt( "age" );
+
+            int visible[MAX_TEAMS];
+            memset( visible, 0, sizeof(visible) );
+            LetterCodec::ReadInts( subDir, "visible", visible, MAX_TEAMS );
+            for( int t = 0; t < MAX_TEAMS; ++t ) ping->m_visible[t] = ( visible[t] != 0 );
+        }
+    }
+
+    if( success )
+    {
+        success = LoadObjects( snapshot ) &&
+                  world->m_radarGrid.LoadSnapshot( radarGrid );
+    }
+
+    if( success )
+    {
+        world->m_votingSystem.LoadSnapshot( votingSystem );
+
+        clientToServer->m_outOfSyncClients.Empty();
+        clientToServer->m_demoClients.Empty();
+        LetterCodec::ReadIntList( snapshot, "outOfSyncClients", &clientToServer->m_outOfSyncClients );
+        LetterCodec::ReadIntList( snapshot, "demoClients", &clientToServer->m_demoClients );
+
+
+        //
+        // Last, as loading the map above may have used them
+
+        success = LoadSyncRand( snapshot );
+    }
+
+    if( !success )
+    {
+        AppDebugOut( "Failed to load the world snapshot at sequence %d\n", _seqId );
+    }
+
+    delete snapshot;
+    delete [] data;
+
+    return success;
+}
@@ -0,0 +1,55 @@
+
+/*
+ * ==============
+ * WORLD SNAPSHOT
+ * ==============
+ *
+ * Everything the simulation reads, from the World, its objects, teams
+ * and fleets, the Game and the sync random numbers, as it stands just
+ * after a letter has been processed.  A client that loads one and then
+ * processes the following letters ends up exactly where the client
+ * that took it did, without replaying the whole history.
+ *
+ * Geography, travel nodes and cities are rebuilt from the game files
+ * as StartGame does; only the city state is saved.  Purely visual
+ * state (messages, chat, blips, movement history) starts again empty.
+ *
+ * Bump WORLDSNAPSHOT_VERSION whenever what is saved changes : clients
+ * only ever load a snapshot taken by the same version as themselves.
+ *
+ */
+
+#ifndef _included_worldsnapshot_h
+#define _included_worldsnapshot_h
+
+#include "lib/math/vector3.h"
+#include "lib/math/fixed.h"
+
+class Directory;
+
+
+#define WORLDSNAPSHOT_VERSION           1
+
+
+class WorldSnapshot
+{
+protected:
+    static void     SaveObjects     ( Directory *_snapshot );
+    static bool     LoadObjects     ( Directory *_snapshot );
+    static void     SaveSyncRand    ( Directory *_snapshot );
+    static bool     LoadSyncRand    ( Directory *_snapshot );
+
+public:
+    static char     *Save           ( int _seqId, int &_length );               // New array, in the binary letter format
+    static bool     Load            ( char *_data, int _length, int _seqId );   // False if bogus, and the World is then unusable
+
+    //
+    // For the Save/LoadSnapshot of each class,
+    // which use LetterCodec::WriteInts and friends for int arrays
+
+    static void             WriteVector ( Directory *_dir, char *_name, Vector3<Fixed> const &_vector );
+    static Vector3<Fixed>   ReadVector  ( Directory *_dir, char *_name );
+};
+
+
+#endif
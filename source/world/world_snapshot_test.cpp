@@ -0,0 +1,249 @@
+// Build from the root directory once defcon.full is built, in place of defcon.o, eg
+//
+//   g++ -O2 -DTARGET_FULLGAME -DTARGET_OS_LINUX -Isource -Isource/app -Isource/lib -Icontrib/systemIV
+//       -Icontrib/systemIV/contrib -Icontrib/systemIV/contrib/unrar -Icontrib/systemIV/lib/gucci
+//       -Icontrib/systemIV/lib/netlib -o world_snapshot_test source/world/world_snapshot_test.cpp
+//       `find .linux-objs/full -name "*.o" ! -name defcon.o` -lSDL -lGL -lGLU -lvorbisfile -lvorbis -logg -lpthread
+//
+// Plays an all AI game on its own for a while, then does what a rejoining client does :
+// saves the World with WorldSnapshot and loads it into a fresh one.  The WorldHash, the
+// free lists of the object arrays and the sync random state must all match straight after
+// the load, and the WorldHash must keep matching while the loaded World plays on.
+// Needs no window, sound or network.  Returns non-zero on any difference.
+
+#include "lib/universal_include.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <float.h>
+
+#include "lib/math/random_number.h"
+#include "lib/netlib/net_mutex.h"
+#include "lib/resource/resource.h"
+#include "lib/sound/soundsystem.h"
+#include "lib/tosser/llist.h"
+
+#include "app/app.h"
+#include "app/globals.h"
+
+#include "world/world.h"
+#include "world/world_snapshot.h"
+#include "world/team.h"
+#include "world/world_view_interface.h"
+
+
+#define NUM_TEAMS               3
+#define TICKS_BEFORE_SNAPSHOT   1500
+#define TICKS_AFTER_SNAPSHOT    300
+#define SYNCRAND_STATESIZE      625                     // As in world_snapshot.cpp
+
+
+//
+// What defcon.o would otherwise provide
+
+NetMutex g_renderLock;
+double   g_startTime = FLT_MAX;
+double   g_gameTime = 0.0f;
+float    g_advanceTime = 0.0f;
+double   g_lastServerAdvance = 0.0f;
+float    g_predictionTime = 0.0f;
+int      g_lastProcessedSequenceId = -2;
+bool     g_catchingUp = false;
+
+
+static int s_numFailures = 0;
+
+static void Fail( int _seqId, char const *_what )
+{
+    printf( "FAILED at sequence %d : %s\n", _seqId, _what );
+    ++s_numFailures;
+}
+
+
+// Everything about a World that must survive the snapshot, beyond what the WorldHash covers
+
+struct WorldState
+{
+    unsigned int    m_hash;
+    LList<int>      m_objectsFree;
+    LList<int>      m_gunfireFree;
+    LList<int>      m_explosionsFree;
+    unsigned int    m_syncRand[SYNCRAND_STATESIZE];
+};
+
+
+static void GetState( int _seqId, Fixed const &_random, WorldState &_state )
+{
+    World *world = g_app->GetWorld();
+
+    _state.m_hash = world->m_hash.Generate( world, _seqId, _random );
+
+    world->m_objects.GetFreeList( &_state.m_objectsFree );
+    world->m_gunfire.GetFreeList( &_state.m_gunfireFree );
+    world->m_explosions.GetFreeList( &_state.m_explosionsFree );
+
+    for( int i = 0; i < SYNCRAND_STATESIZE; ++i )
+    {
+        _state.m_syncRand[i] = getSeed(i);
+    }
+}
+
+
+static bool SameList( LList<int> &_a, LList<int> &_b )
+{
+    if( _a.Size() != _b.Size() ) return false;
+
+    for( int i = 0; i < _a.Size(); ++i )
+    {
+        if( _a[i] != _b[i] ) return false;
+    }
+
+    return true;
+}
+
+
+static void CompareState( int _seqId, WorldState &_saved, WorldState &_loaded )
+{
+    if( _loaded.m_hash != _saved.m_hash )                                   Fail( _seqId, "WorldHash differs" );
+    if( !SameList( _loaded.m_objectsFree, _saved.m_objectsFree ) )          Fail( _seqId, "m_objects free list differs" );
+    if( !SameList( _loaded.m_gunfireFree, _saved.m_gunfireFree ) )          Fail( _seqId, "m_gunfire free list differs" );
+    if( !SameList( _loaded.m_explosionsFree, _saved.m_explosionsFree ) )    Fail( _seqId, "m_explosions free list differs" );
+
+    for( int i = 0; i < SYNCRAND_STATESIZE; ++i )
+    {
+        if( _loaded.m_syncRand[i] != _saved.m_syncRand[i] )
+        {
+            Fail( _seqId, "sync random state differs" );
+            break;
+        }
+    }
+}
+
+
+// One server letter with nothing in it, as ProcessNextServerLetter handles it.
+// Returns the WorldHash that GenerateSyncValue would report
+
+static unsigned int Advance( int _seqId, Fixed &_random )
+{
+    World *world = g_app->GetWorld();
+
+    world->Update();
+
+    _random = syncfrand(255);
+    return world->m_hash.Generate( world, _seqId, _random );
+}
+
+
+// As the lobby and App::StartGame do, minus the interface
+
+static void StartGame()
+{
+    g_app->InitWorld();
+    World *world = g_app->GetWorld();
+    world->SetView( new WorldViewInterface() );         // Nothing to show it on
+
+    int randSeed = 0;
+    for( int t = 0; t < NUM_TEAMS; ++t )
+    {
+        world->InitialiseTeam( t, Team::TypeAI, -1 );
+        world->AssignTerritory( t, t, 1 );
+        world->GetTeam(t)->m_readyToStart = true;
+        randSeed += world->GetTeam(t)->m_randSeed;
+    }
+    syncrandseed( randSeed );
+
+    world->LoadGeography();
+    world->LoadNodes();
+    world->AssignCities();
+
+    g_app->m_gameRunning = true;
+}
+
+
+void AppMain()
+{
+    g_app = new App();
+    g_app->InitSimulation();
+
+    g_resource->SetTexturesEnabled( false );            // No window, so no OpenGL
+    g_soundSystem = new SoundSystem();                  // Never initialised, so silent
+
+    StartGame();
+
+    Fixed random = 0;
+    int seqId = 0;
+
+    for( ; seqId < TICKS_BEFORE_SNAPSHOT; ++seqId )
+    {
+        Advance( seqId, random );
+    }
+
+
+    //
+    // Take the snapshot after the last letter, as ClientToServer::UploadSnapshot does
+
+    int snapshotSeqId = seqId - 1;
+    Fixed snapshotRandom = random;
+
+    World *world = g_app->GetWorld();
+    printf( "Sequence %d : Defcon %d, %d objects, %d gunfire, %d explosions\n",
+            snapshotSeqId, world->GetDefcon(), world->m_objects.NumUsed(),
+            world->m_gunfire.NumUsed(), world->m_explosions.NumUsed() );
+
+    int length = 0;
+    char *data = WorldSnapshot::Save( snapshotSeqId, length );
+
+    WorldState *saved = new WorldState();
+    GetState( snapshotSeqId, snapshotRandom, *saved );
+
+    unsigned int hashes[TICKS_AFTER_SNAPSHOT];
+    for( int i = 0; i < TICKS_AFTER_SNAPSHOT; ++i )
+    {
+        hashes[i] = Advance( seqId + i, random );
+    }
+
+
+    //
+    // Rejoin, as StartFromSnapshot does.  The old World is left alone,
+    // as its cities now belong to the EarthData the new one loads
+
+    g_app->m_world = NULL;
+    g_app->InitWorld();
+    g_app->GetWorld()->SetView( new WorldViewInterface() );
+
+    if( !WorldSnapshot::Load( data, length, snapshotSeqId ) )
+    {
+        printf( "FAILED : WorldSnapshot::Load refused its own snapshot\n" );
+        exit( 1 );
+    }
+
+    WorldState *loaded = new WorldState();
+    GetState( snapshotSeqId, snapshotRandom, *loaded );
+    CompareState( snapshotSeqId, *saved, *loaded );
+
+    for( int i = 0; i < TICKS_AFTER_SNAPSHOT; ++i )
+    {
+        if( Advance( seqId + i, random ) != hashes[i] )
+        {
+            Fail( seqId + i, "WorldHash differs after playing on" );
+            break;
+        }
+    }
+
+    world = g_app->GetWorld();
+    printf( "Sequence %d : Defcon %d, %d objects, %d gunfire, %d explosions\n",
+            seqId + TICKS_AFTER_SNAPSHOT - 1, world->GetDefcon(), world->m_objects.NumUsed(),
+            world->m_gunfire.NumUsed(), world->m_explosions.NumUsed() );
+
+    delete saved;
+    delete loaded;
+    delete [] data;
+
+    if( s_numFailures > 0 )
+    {
+        printf( "%d failures\n", s_numFailures );
+        exit( 1 );
+    }
+
+    printf( "Snapshot of %d bytes round trips\n", length );
+}
@@ -0,0 +1,79 @@
+#include "lib/universal_include.h"
+
+#include "world/world_view_interface.h"
+
+
+int WorldViewInterface::GetCurrentSelectionId()
+{
+    return -1;
+}
+
+
+int WorldViewInterface::GetCurrentHighlightId()
+{
+    return -1;
+}
+
+
+void WorldViewInterface::SetCurrentSelectionId( int _id )
+{
+}
+
+
+float WorldViewInterface::GetZoomFactor()
+{
+    return 1.0f;
+}
+
+
+float WorldViewInterface::GetMouseIdleTime()
+{
+    return 0.0f;
+}
+
+
+char *WorldViewInterface::GetImageFile( int _objectType )
+{
+    return NULL;
+}
+
+
+void WorldViewInterface::CreateActionMarker( int _objectId, Fixed const &_longitude, Fixed const &_latitude )
+{
+}
+
+
+void WorldViewInterface::CreateNukePointer( int _objectId, Fixed const &_longitude, Fixed const &_latitude, int _targetId )
+{
+}
+
+
+void WorldViewInterface::ToggleRenderEverything()
+{
+}
+
+
+void WorldViewInterface::ShowMessage( Fixed _longitude, Fixed _latitude, int _teamId, char *_msg, bool _showLarge )
+{
+}
+
+
+bool WorldViewInterface::UsingChatWindow()
+{
+    return false;
+}
+
+
+void WorldViewInterface::ShowVote( int _voteId )
+{
+}
+
+
+void WorldViewInterface::ClosePlacement()
+{
+}
+
+
+void WorldViewInterface::ShowGameOver()
+{
+}
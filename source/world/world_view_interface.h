@@ -0,0 +1,49 @@
+#ifndef _included_worldviewinterface_h
+#define _included_worldviewinterface_h
+
+/*
+ *	This module sits between the World and whatever is showing it.
+ *  The World uses it to read the player's selection and zoom, and to
+ *  put markers, messages and votes on screen.
+ *
+ *
+ *  Instructions for use:
+ *  - Derive your own class from WorldViewInterface and write the virtual
+ *    methods you need, then pass an instance of it to World::SetView.
+ *    The World deletes it.
+ *  - The methods here are what a World with nothing watching it sees:
+ *    no selection, full zoom, and nowhere to put anything.  This lets
+ *    the World be built and run without the renderer or the interface.
+ *
+ */
+
+
+#include "lib/math/fixed.h"
+
+
+class WorldViewInterface
+{
+public:
+    virtual ~WorldViewInterface() {}
+
+    virtual int     GetCurrentSelectionId   ();
+    virtual int     GetCurrentHighlightId   ();
+    virtual void    SetCurrentSelectionId   ( int _id );
+    virtual float   GetZoomFactor           ();
+    virtual float   GetMouseIdleTime        ();
+    virtual char   *GetImageFile            ( int _objectType );
+
+    virtual void    CreateActionMarker      ( int _objectId, Fixed const &_longitude, Fixed const &_latitude );
+    virtual void    CreateNukePointer       ( int _objectId, Fixed const &_longitude, Fixed const &_latitude, int _targetId );
+    virtual void    ToggleRenderEverything  ();
+
+    virtual void    ShowMessage             ( Fixed _longitude, Fixed _latitude, int _teamId, char *_msg, bool _showLarge=false );
+    virtual bool    UsingChatWindow         ();
+    virtual void    ShowVote                ( int _voteId );
+    virtual void    ClosePlacement          ();
+    virtual void    ShowGameOver            ();
+};
+
+
+
+#endif
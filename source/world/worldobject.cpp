@@ -8,6 +8,7 @@
 #include "lib/language_table.h"
 #include "lib/math/random_number.h"
 #include "lib/hi_res_time.h"
+#include "lib/tosser/directory.h"
 
 #include "app/app.h"
 #include "app/globals.h"
@@ -17,9 +18,7 @@
 #include "world/worldobject.h"
 #include "world/team.h"
 
-#include "interface/interface.h"
 
-#include "renderer/map_renderer.h"
 
 #include "world/radarstation.h"
 #include "world/silo.h"
@@ -34,6 +33,9 @@
 #include "world/tornado.h"
 #include "world/saucer.h"
 #include "world/fleet.h"
+#include "world/world_snapshot.h"
+
+#include "network/letter_codec.h"
 
 
 WorldObject::WorldObject()
@@ -390,12 +392,12 @@ void WorldObject::Render ()
     // Current selection?
 
     colour.Set(255,255,255,255);
-    int selectionId = g_app->GetMapRenderer()->GetCurrentSelectionId();
+    int selectionId = g_app->GetWorld()->GetView()->GetCurrentSelectionId();
     for( int i = 0; i < 2; ++i )
     {
         if( i == 1 )
         {
-            int highlightId = g_app->GetMapRenderer()->GetCurrentHighlightId();
+            int highlightId = g_app->GetWorld()->GetView()->GetCurrentHighlightId();
             if( highlightId == selectionId ) break;
             selectionId = highlightId;
         }
@@ -467,9 +469,9 @@ Fixed WorldObject::GetSize()
         size *= 1;
     }
 
-    if( g_app->GetMapRenderer()->GetZoomFactor() <= 0.25f )
+    if( g_app->GetWorld()->GetView()->GetZoomFactor() <= 0.25f )
     {
-        size *= Fixed::FromDouble(g_app->GetMapRenderer()->GetZoomFactor()) * 4;
+        size *= Fixed::FromDouble(g_app->GetWorld()->GetView()->GetZoomFactor()) * 4;
     }
 
     size /= g_app->GetWorld()->GetGameScale();
@@ -541,29 +543,6 @@ int WorldObject::GetType( char *_name )
 }
 
 
-char *WorldObject::GetTypeName (int _type)
-{
-    switch( _type )
-    {
-        case TypeSilo:          return "silo";
-        case TypeNuke:          return "nuke";
-        case TypeCity:          return "city";
-        case TypeExplosion:     return "explosion";
-        case TypeSub:           return "sub";
-        case TypeRadarStation:  return "radar";
-        case TypeBattleShip:    return "battleship";
-        case TypeAirBase:       return "airbase";
-        case TypeFighter:       return "fighter";
-        case TypeBomber:        return "bomber";
-        case TypeCarrier:       return "carrier";
-		case TypeTornado:       return "tornado";
-        case TypeSaucer:        return "saucer";
-    }
-
-    return "?";
-}
-
-
 void WorldObject::SetRadarRange ( Fixed radarRange )
 {
     m_radarRange = radarRange;
@@ -1012,3 +991,174 @@ char *WorldObject::LogState()
 }
 
 
+void WorldObject::SaveSnapshot( Directory *_dir )
+{
+    _dir->CreateData( "type", m_type );
+    _dir->CreateData( "teamId", m_teamId );
+    _dir->CreateData( "objectId", m_objectId );
+    _dir->CreateData( "longitude", m_longitude );
+    _dir->CreateData( "latitude", m_latitude );
+    _dir->CreateData( "life", m_life );
+    _dir->CreateData( "lastHitByTeamId", m_lastHitByTeamId );
+    _dir->CreateData( "selectable", m_selectable );
+    WorldSnapshot::WriteVector( _dir, "vel", m_vel );
+
+    LList<int> numTimesPermitted;
+    for( int i = 0; i < m_states.Size(); ++i )
+    {
+        numTimesPermitted.PutDataAtEnd( m_states[i]->m_numTimesPermitted );
+    }
+    LetterCodec::WriteIntList( _dir, "numTimesPermitted", &numTimesPermitted );
+
+    _dir->CreateData( "currentState", m_currentState );
+    _dir->CreateData( "previousState", m_previousState );
+    _dir->CreateData( "stateTimer", m_stateTimer );
+    _dir->CreateData( "previousRadarRange", m_previousRadarRange );
+
+    _dir->CreateData( "fleetId", m_fleetId );
+    _dir->CreateData( "nukeSupply", m_nukeSupply );
+    _dir->CreateData( "offensive", m_offensive );
+    _dir->CreateData( "aiTimer", m_aiTimer );
+    _dir->CreateData( "aiSpeed", m_aiSpeed );
+    _dir->CreateData( "ghostFadeTime", m_ghostFadeTime );
+    _dir->CreateData( "targetObjectId", m_targetObjectId );
+    _dir->CreateData( "isRetaliating", m_isRetaliating );
+    _dir->CreateData( "forceAction", m_forceAction );
+    _dir->CreateData( "numNukesInFlight", m_numNukesInFlight );
+    _dir->CreateData( "numNukesInQueue", m_numNukesInQueue );
+    _dir->CreateData( "maxFighters", m_maxFighters );
+    _dir->CreateData( "maxBombers", m_maxBombers );
+    _dir->CreateData( "bmpImageFilename", bmpImageFilename );
+    _dir->CreateData( "radarRange", m_radarRange );
+    _dir->CreateData( "retargetTimer", m_retargetTimer );
+
+
+    //
+    // What each team knows about us, only where they know anything
+
+    for( int t = 0; t < MAX_TEAMS; ++t )
+    {
+        if( !m_visible[t] && !m_seen[t] && m_lastSeenTime[t] == 0 && m_lastSeenState[t] == 0 &&
+            m_lastKnownPosition[t].x == 0 && m_lastKnownPosition[t].y == 0 && m_lastKnownPosition[t].z == 0 &&
+            m_lastKnownVelocity[t].x == 0 && m_lastKnownVelocity[t].y == 0 && m_lastKnownVelocity[t].z == 0 )
+        {
+            continue;
+        }
+
+        Directory *teamDir = new Directory();
+        teamDir->SetName( "team" );
+        teamDir->CreateData( "teamId", t );
+        teamDir->CreateData( "visible", m_visible[t] );
+        teamDir->CreateData( "seen", m_seen[t] );
+        WorldSnapshot::WriteVector( teamDir, "lastKnownPosition", m_lastKnownPosition[t] );
+        WorldSnapshot::WriteVector( teamDir, "lastKnownVelocity", m_lastKnownVelocity[t] );
+        teamDir->CreateData( "lastSeenTime", m_lastSeenTime[t] );
+        teamDir->CreateData( "lastSeenState", m_lastSeenState[t] );
+        _dir->AddDirectory( teamDir );
+    }
+
+    for( int i = 0; i < m_actionQueue.Size(); ++i )
+    {
+        ActionOrder *action = m_actionQueue[i];
+
+        Directory *actionDir = new Directory();
+        actionDir->SetName( "action" );
+        actionDir->CreateData( "targetObjectId", action->m_targetObjectId );
+        actionDir->CreateData( "longitude", action->m_longitude );
+        actionDir->CreateData( "latitude", action->m_latitude );
+        actionDir->CreateData( "pursueTarget", action->m_pursueTarget );
+        _dir->AddDirectory( actionDir );
+    }
+}
+
+
+void WorldObject::LoadSnapshot( Directory *_dir )
+{
+    m_teamId = _dir->GetDataInt( "teamId" );
+    m_objectId = _dir->GetDataInt( "objectId" );
+    m_longitude = _dir->GetDataFixed( "longitude" );
+    m_latitude = _dir->GetDataFixed( "latitude" );
+    m_life = _dir->GetDataInt( "life" );
+    m_lastHitByTeamId = _dir->GetDataInt( "lastHitByTeamId" );
+    m_selectable = _dir->GetDataBool( "selectable" );
+    m_vel = WorldSnapshot::ReadVector( _dir, "vel" );
+
+    LList<int> numTimesPermitted;
+    LetterCodec::ReadIntList( _dir, "numTimesPermitted", &numTimesPermitted );
+    for( int i = 0; i < m_states.Size() && i < numTimesPermitted.Size(); ++i )
+    {
+        m_states[i]->m_numTimesPermitted = numTimesPermitted[i];
+    }
+
+    m_currentState = _dir->GetDataInt( "currentState" );
+    m_previousState = _dir->GetDataInt( "previousState" );
+    m_stateTimer = _dir->GetDataFixed( "stateTimer" );
+    m_previousRadarRange = _dir->GetDataFixed( "previousRadarRange" );
+
+    m_fleetId = _dir->GetDataInt( "fleetId" );
+    m_nukeSupply = _dir->GetDataInt( "nukeSupply" );
+    m_offensive = _dir->GetDataBool( "offensive" );
+    m_aiTimer = _dir->GetDataFixed( "aiTimer" );
+    m_aiSpeed = _dir->GetDataFixed( "aiSpeed" );
+    m_ghostFadeTime = _dir->GetDataFixed( "ghostFadeTime" );
+    m_targetObjectId = _dir->GetDataInt( "targetObjectId" );
+    m_isRetaliating = _dir->GetDataBool( "isRetaliating" );
+    m_forceAction = _dir->GetDataBool( "forceAction" );
+    m_numNukesInFlight = _dir->GetDataInt( "numNukesInFlight" );
+    m_numNukesInQueue = _dir->GetDataInt( "numNukesInQueue" );
+    m_nukeCountTimer = GetHighResTime();
+    m_maxFighters = _dir->GetDataInt( "maxFighters" );
+    m_maxBombers = _dir->GetDataInt( "maxBombers" );
+    m_radarRange = _dir->GetDataFixed( "radarRange" );
+    m_retargetTimer = _dir->GetDataFixed( "retargetTimer" );
+
+    char *filename = _dir->GetDataString( "bmpImageFilename" );
+    if( filename )
+    {
+        strncpy( bmpImageFilename, filename, sizeof(bmpImageFilename) );
+        bmpImageFilename[ sizeof(bmpImageFilename) - 1 ] = '\x0';
+    }
+
+
+    //
+    // Per team arrays are only cleared by the constructor while the game is running
+
+    m_visible.SetAll( false );
+    m_seen.SetAll( false );
+    m_lastKnownPosition.SetAll( Vector3<Fixed>::ZeroVector() );
+    m_lastKnownVelocity.SetAll( Vector3<Fixed>::ZeroVector() );
+    m_lastSeenTime.SetAll( 0 );
+    m_lastSeenState.SetAll( 0 );
+
+    m_actionQueue.EmptyAndDelete();
+
+    for( int i = 0; i < _dir->m_subDirectories.Size(); ++i )
+    {
+        if( !_dir->m_subDirectories.ValidIndex(i) ) continue;
+        Directory *subDir = _dir->m_subDirectories[i];
+
+        if( strcmp( subDir->m_name, "team" ) == 0 )
+        {
+            int t = subDir->GetDataInt( "teamId" );
+            if( t < 0 || t >= MAX_TEAMS ) continue;
+
+            m_visible[t] = subDir->GetDataBool( "visible" );
+            m_seen[t] = subDir->GetDataBool( "seen" );
+            m_lastKnownPosition[t] = WorldSnapshot::ReadVector( subDir, "lastKnownPosition" );
+            m_lastKnownVelocity[t] = WorldSnapshot::ReadVector( subDir, "lastKnownVelocity" );
+            m_lastSeenTime[t] = subDir->GetDataFixed( "lastSeenTime" );
+            m_lastSeenState[t] = subDir->GetDataInt( "lastSeenState" );
+        }
+        else if( strcmp( subDir->m_name, "action" ) == 0 )
+        {
+            ActionOrder *action = new ActionOrder();
+            action->m_targetObjectId = subDir->GetDataInt( "targetObjectId" );
+            action->m_longitude = subDir->GetDataFixed( "longitude" );
+            action->m_latitude = subDir->GetDataFixed( "latitude" );
+            action->m_pursueTarget = subDir->GetDataBool( "pursueTarget" );
+            m_actionQueue.PutDataAtEnd( action );
+        }
+    }
+}
+
+
@@ -8,6 +8,7 @@
 #include "lib/math/fixed.h"
 
 class Image;
+class Directory;
 class WorldObjectState;
 class ActionOrder;
 
@@ -154,7 +155,7 @@ public:
 
     static char         *GetName        ( int _type );
     static int          GetType         ( char *_name );
-	static char         *GetTypeName    ( int _type );
+	static char         *GetTypeName    ( int _type );                  // Inline, so code without the World can name types
 	static WorldObject  *CreateObject   ( int _type );
 
     virtual int         IsValidCombatTarget     ( int _objectId );                                      // returns TargetType...
@@ -171,6 +172,9 @@ public:
     
     virtual char        *LogState();
 
+    virtual void        SaveSnapshot    ( Directory *_dir );                    // Everything the simulation reads, see WorldSnapshot
+    virtual void        LoadSnapshot    ( Directory *_dir );                    // Over a newly created object of the same type
+
     virtual Image       *GetBmpImage     ( int state );
 
     char                *GetBmpBlurFilename();
@@ -225,4 +229,28 @@ public:
     }
 };
 
+
+inline char *WorldObject::GetTypeName( int _type )
+{
+    switch( _type )
+    {
+        case TypeSilo:          return "silo";
+        case TypeNuke:          return "nuke";
+        case TypeCity:          return "city";
+        case TypeExplosion:     return "explosion";
+        case TypeSub:           return "sub";
+        case TypeRadarStation:  return "radar";
+        case TypeBattleShip:    return "battleship";
+        case TypeAirBase:       return "airbase";
+        case TypeFighter:       return "fighter";
+        case TypeBomber:        return "bomber";
+        case TypeCarrier:       return "carrier";
+		case TypeTornado:       return "tornado";
+        case TypeSaucer:        return "saucer";
+    }
+
+    return "?";
+}
+
+
 #endif